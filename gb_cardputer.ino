@@ -12,6 +12,13 @@
 #define ENABLE_PROFILING 1
 #endif
 
+// Log-scale histograms of frame, emulation, render and ROM bank load time and
+// speaker queue depth, printed as p50/p90/p99/p99.9 every 5 s. Independent of
+// the profiler so release builds keep them.
+#ifndef ENABLE_FRAME_HISTOGRAMS
+#define ENABLE_FRAME_HISTOGRAMS 1
+#endif
+
 #ifndef ENABLE_BLUETOOTH
 #define ENABLE_BLUETOOTH 1
 #endif
@@ -24,18 +31,86 @@
 #define ENABLE_MBC7 1
 #endif
 
+// Detach the scanline callback while frame skip is discarding a frame so the
+// core skips tile fetch and sprite resolution; LY/STAT timing is unaffected.
+#ifndef ENABLE_RENDER_SUPPRESSION
+#define ENABLE_RENDER_SUPPRESSION 1
+#endif
+
+// Keep framebuffers and the display cache in the panel's byte order so SPI
+// flushes can hand pixels to DMA without a per-pixel swap.
+#ifndef ENABLE_NATIVE_PANEL_FORMAT
+#define ENABLE_NATIVE_PANEL_FORMAT 1
+#endif
+
+// Print one "[FT] kind active_us handoff_us level" line per frame for
+// scripts/frame_controller_sim.py.
+#ifndef ENABLE_FRAME_TRACE
+#define ENABLE_FRAME_TRACE 0
+#endif
+
+// Stream one fixed-size binary record per frame over USB serial for
+// scripts/telemetry_decode.py.
+#ifndef ENABLE_TELEMETRY
+#define ENABLE_TELEMETRY 0
+#endif
+
+// Cycle-counter scoped probes (TRACE_SCOPE) recorded into per-core rings;
+// Fn+T dumps them as Chrome trace-event JSON. Compiled out when 0.
+#ifndef ENABLE_TRACE_PROBES
+#define ENABLE_TRACE_PROBES 0
+#endif
+
+// Fn+H toggles an on-screen HUD (fps, emu/render time, ROM hit rate, audio
+// fill, frame-time sparkline) composited into the presented rows. It keeps
+// its own counters, so release builds without the profiler have it too.
+#ifndef ENABLE_PERF_HUD
+#define ENABLE_PERF_HUD ENABLE_LCD
+#endif
+
+#if ENABLE_PERF_HUD && !ENABLE_LCD
+#error "ENABLE_PERF_HUD requires ENABLE_LCD"
+#endif
+
+// Fn+W records the emulator's audio output to /recordings as WAV files.
+#ifndef ENABLE_AUDIO_CAPTURE
+#define ENABLE_AUDIO_CAPTURE ENABLE_SOUND
+#endif
+
+#if ENABLE_AUDIO_CAPTURE && !ENABLE_SOUND
+#error "ENABLE_AUDIO_CAPTURE requires ENABLE_SOUND"
+#endif
+
+// Fn+B toggles audio-only mode: display off, renderTask suspended, no pixel
+// generation, and the CPU clocked down as far as audio keeps up.
+#ifndef ENABLE_AUDIO_ONLY
+#define ENABLE_AUDIO_ONLY (ENABLE_SOUND && ENABLE_LCD)
+#endif
+
+#if ENABLE_AUDIO_ONLY && !(ENABLE_SOUND && ENABLE_LCD)
+#error "ENABLE_AUDIO_ONLY requires ENABLE_SOUND and ENABLE_LCD"
+#endif
+
+// Host benchmark build (PlatformIO `native` env): boots straight into the ROM
+// given on the command line, runs unpaced and exits after a set frame count.
+#ifndef ENABLE_NATIVE_BENCH
+#define ENABLE_NATIVE_BENCH 0
+#endif
+
 #define MAX_FILES 256
 #define MAX_PATH_LEN 256
 
 #include <vector>
 #include <algorithm>
 #include <memory>
+#include <atomic>
 #include <new>
 #include <cstring>
 #include <cstdio>
 #include <cstddef>
 #include <cctype>
 #include <cstdlib>
+#include <cstdarg>
 #include <cmath>
 #include <limits.h>
 #include <time.h>
@@ -57,6 +132,10 @@
 #include <esp_err.h>
 #include <esp_rom_sys.h>
 #include <esp_timer.h>
+#if ENABLE_TRACE_PROBES
+#include <esp_idf_version.h>
+#include <esp_cpu.h>
+#endif
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/semphr.h>
@@ -74,6 +153,9 @@
 #include "cgb_bootstrap_palettes.h"
 #include "mbc7_cardputer.h"
 #include "embedded_rom.h"
+#if ENABLE_NATIVE_BENCH
+#include "native/native_bench.h"
+#endif
 
 struct PaletteState;
 
@@ -174,6 +256,154 @@ static bool g_rom_storage_partition_checked = false;
 
 static constexpr const char *FLASHED_ROM_SENTINEL = ":flash";
 
+#if ENABLE_PROFILING || ENABLE_FRAME_HISTOGRAMS
+// Log-scale histogram with 8 linear sub-buckets per power of two: values
+// below 8 are exact, larger ones land in a bucket at most 12.5% wide. 176
+// buckets reach 2^24 (~16.7 s in microseconds); anything larger is clamped
+// into the last one. Adding a sample is a CLZ, a shift and an increment, so
+// the histograms stay on in release builds (ENABLE_FRAME_HISTOGRAMS).
+static constexpr uint32_t LOG_HIST_SUB_BITS = 3;
+static constexpr uint32_t LOG_HIST_SUB_BUCKETS = 1u << LOG_HIST_SUB_BITS;
+static constexpr uint32_t LOG_HIST_MAX_EXPONENT = 23;
+static constexpr uint32_t LOG_HIST_BUCKETS =
+    (LOG_HIST_MAX_EXPONENT - LOG_HIST_SUB_BITS + 2) * LOG_HIST_SUB_BUCKETS;
+
+struct LogHistogram {
+  uint32_t buckets[LOG_HIST_BUCKETS];
+  uint32_t count;
+};
+
+static inline uint32_t log_hist_bucket(uint64_t value) {
+  if(value < LOG_HIST_SUB_BUCKETS) {
+    return static_cast<uint32_t>(value);
+  }
+  if(value >= (1ULL << (LOG_HIST_MAX_EXPONENT + 1))) {
+    return LOG_HIST_BUCKETS - 1;
+  }
+  const uint32_t exponent = 31u - static_cast<uint32_t>(__builtin_clz(static_cast<uint32_t>(value)));
+  const uint32_t mantissa = static_cast<uint32_t>(value >> (exponent - LOG_HIST_SUB_BITS));
+  return (exponent - LOG_HIST_SUB_BITS + 1) * LOG_HIST_SUB_BUCKETS + (mantissa - LOG_HIST_SUB_BUCKETS);
+}
+
+// Largest value that maps to `bucket`.
+static inline uint32_t log_hist_bucket_upper(uint32_t bucket) {
+  if(bucket < LOG_HIST_SUB_BUCKETS) {
+    return bucket;
+  }
+  const uint32_t exponent = bucket / LOG_HIST_SUB_BUCKETS + LOG_HIST_SUB_BITS - 1;
+  const uint32_t mantissa = bucket % LOG_HIST_SUB_BUCKETS + LOG_HIST_SUB_BUCKETS;
+  return ((mantissa + 1) << (exponent - LOG_HIST_SUB_BITS)) - 1;
+}
+
+static inline void log_hist_add(LogHistogram &hist, uint64_t value) {
+  hist.buckets[log_hist_bucket(value)]++;
+  hist.count++;
+}
+
+// Upper edge of the bucket holding the given percentile, in per-mille
+// (500 = p50, 999 = p99.9).
+static uint32_t log_hist_percentile(const LogHistogram &hist, uint32_t permille) {
+  if(hist.count == 0) {
+    return 0;
+  }
+  const uint64_t rank = (static_cast<uint64_t>(hist.count) * permille + 999) / 1000;
+  uint64_t seen = 0;
+  for(uint32_t bucket = 0; bucket < LOG_HIST_BUCKETS; bucket++) {
+    seen += hist.buckets[bucket];
+    if(seen >= rank) {
+      return log_hist_bucket_upper(bucket);
+    }
+  }
+  return log_hist_bucket_upper(LOG_HIST_BUCKETS - 1);
+}
+#endif
+
+#if ENABLE_FRAME_HISTOGRAMS
+static constexpr uint64_t FRAME_HIST_LOG_INTERVAL_US = 5ULL * 1000 * 1000;
+
+// The main loop owns the frame and emulation histograms; the render task, the
+// ROM loader and the audio task add to the shared ones under
+// frame_hist_spinlock, and frame_hist_log swaps those out once per window.
+struct FrameHistograms {
+  uint64_t last_log_us;
+  LogHistogram frame;
+  LogHistogram emu;
+};
+
+static FrameHistograms g_frame_hists = {};
+static LogHistogram g_render_hist = {};
+static LogHistogram g_rom_load_hist = {};
+static LogHistogram g_audio_queue_hist = {};
+static portMUX_TYPE frame_hist_spinlock = portMUX_INITIALIZER_UNLOCKED;
+
+static inline void frame_hist_add_shared(LogHistogram &hist, uint64_t value) {
+  portENTER_CRITICAL(&frame_hist_spinlock);
+  log_hist_add(hist, value);
+  portEXIT_CRITICAL(&frame_hist_spinlock);
+}
+
+static void frame_hist_take(LogHistogram &shared, LogHistogram &out) {
+  portENTER_CRITICAL(&frame_hist_spinlock);
+  out = shared;
+  shared = {};
+  portEXIT_CRITICAL(&frame_hist_spinlock);
+}
+
+static void frame_hist_log(uint64_t now) {
+  static LogHistogram render_hist;
+  static LogHistogram rom_hist;
+  static LogHistogram audio_hist;
+  frame_hist_take(g_render_hist, render_hist);
+  frame_hist_take(g_rom_load_hist, rom_hist);
+  frame_hist_take(g_audio_queue_hist, audio_hist);
+
+  const LogHistogram *hists[] = {
+    &g_frame_hists.frame,
+    &g_frame_hists.emu,
+    &render_hist,
+    &rom_hist,
+    &audio_hist
+  };
+  static constexpr uint32_t kPermille[] = {500, 900, 990, 999};
+  uint32_t values[5][4];
+  for(size_t h = 0; h < 5; ++h) {
+    for(size_t p = 0; p < 4; ++p) {
+      values[h][p] = log_hist_percentile(*hists[h], kPermille[p]);
+    }
+  }
+
+  Serial.printf(
+    "[PROF] pct(50/90/99/99.9) frame=%u/%u/%u/%u emu=%u/%u/%u/%u render=%u/%u/%u/%u romLoad=%u/%u/%u/%u (n=%u) audioQ=%u/%u/%u/%u\n",
+    values[0][0], values[0][1], values[0][2], values[0][3],
+    values[1][0], values[1][1], values[1][2], values[1][3],
+    values[2][0], values[2][1], values[2][2], values[2][3],
+    values[3][0], values[3][1], values[3][2], values[3][3],
+    static_cast<unsigned>(rom_hist.count),
+    values[4][0], values[4][1], values[4][2], values[4][3]);
+
+  g_frame_hists.frame = {};
+  g_frame_hists.emu = {};
+  g_frame_hists.last_log_us = now;
+}
+
+static void frame_hist_record(uint64_t frame_us, uint64_t emu_us, uint64_t now) {
+  log_hist_add(g_frame_hists.frame, frame_us);
+  log_hist_add(g_frame_hists.emu, emu_us);
+#if !ENABLE_PROFILING
+  // profiler_log prints the percentiles with its own window when it is built.
+  if(g_frame_hists.last_log_us == 0) {
+    g_frame_hists.last_log_us = now;
+    return;
+  }
+  if(now - g_frame_hists.last_log_us >= FRAME_HIST_LOG_INTERVAL_US) {
+    frame_hist_log(now);
+  }
+#else
+  (void)now;
+#endif
+}
+#endif
+
 #if ENABLE_PROFILING
 static constexpr uint64_t PROFILER_LOG_INTERVAL_US = 5ULL * 1000 * 1000;
 
@@ -188,6 +418,12 @@ struct MainLoopProfiler {
   uint64_t accum_idle_us;
   uint64_t accum_requested_idle_us;
   uint64_t max_frame_us;
+  uint64_t accum_emu_shown_us;
+  uint64_t accum_emu_skipped_us;
+  uint32_t shown_frames;
+  uint32_t skipped_frames;
+  uint64_t pace_max_us;
+  LogHistogram pace_hist;
 };
 
 struct RenderProfiler {
@@ -196,6 +432,13 @@ struct RenderProfiler {
   uint32_t frames;
   uint32_t rows_written;
   uint32_t segments_flushed;
+  uint64_t latency_total_us;
+  uint64_t latency_max_us;
+  uint32_t latency_samples;
+  uint64_t field_total_us[3];   // indexed by FRAME_FIELD_EVEN/ODD/FULL
+  uint32_t field_frames[3];
+  uint64_t dma_setup_total_us;  // CPU time in setAddrWindow + writePixelsDMA
+  uint64_t pixels_written;
 };
 
 struct RomCacheProfiler {
@@ -218,7 +461,12 @@ static portMUX_TYPE profiler_spinlock = portMUX_INITIALIZER_UNLOCKED;
 
 static void profiler_add_render_sample(uint64_t duration_us,
                                        uint32_t rows_written,
-                                       uint32_t segments_flushed);
+                                       uint32_t segments_flushed,
+                                       uint32_t pixels_written,
+                                       uint64_t dma_setup_us,
+                                       uint8_t field);
+static void profiler_add_latency_sample(uint64_t latency_us);
+static void profiler_record_pacing(uint64_t deviation_us);
 static RenderProfiler profiler_consume_render_stats();
 static void profiler_record_frame(uint64_t frame_us,
                                   uint64_t poll_us,
@@ -227,9 +475,18 @@ static void profiler_record_frame(uint64_t frame_us,
                                   uint64_t idle_us,
                                   uint64_t requested_idle_us,
                                   bool over_budget,
+                                  bool frame_skipped,
                                   uint64_t now);
 #endif
 
+#if ENABLE_PERF_HUD
+// Render time since the HUD last sampled it, under perf_hud_spinlock.
+static uint64_t g_perf_hud_render_total_us = 0;
+static uint32_t g_perf_hud_render_frames = 0;
+static std::atomic<bool> g_perf_hud_visible{false};
+static portMUX_TYPE perf_hud_spinlock = portMUX_INITIALIZER_UNLOCKED;
+#endif
+
 struct CacheRecoveryState {
   bool pending_display;
   size_t desired_rom_banks;
@@ -242,7 +499,7 @@ static CacheRecoveryState g_cache_recovery = {false, 0, 0};
 #define DEST_H 135
 
 static constexpr uint32_t RENDER_TASK_STACK_SIZE = 2048;
-static constexpr uint32_t AUDIO_TASK_STACK_SIZE = 2048;
+static constexpr uint32_t AUDIO_TASK_STACK_SIZE = 4096;
 
 #define DEBUG_DELAY 0
 
@@ -254,7 +511,30 @@ static constexpr size_t ROM_CACHE_BANK_MAX = 24;
 static constexpr size_t ROM_CACHE_BANK_LIMIT_NO_PSRAM = 5;
 static constexpr size_t ROM_CACHE_POSIX_ERROR_THRESHOLD = 3;
 
-static const uint16_t DMG_DEFAULT_PALETTE_RGB565[4] = { 0xFFFF, 0xAD55, 0x528A, 0x0000 };
+// Framebuffer pixel encoding. With ENABLE_NATIVE_PANEL_FORMAT pixels are kept
+// byte-swapped (big-endian RGB565, as the ST7789 expects) from the palette LUTs
+// through swap_fb; otherwise they are host-order RGB565 and M5GFX swaps them
+// during each transfer.
+static constexpr bool PANEL_WRITE_SWAP = (ENABLE_NATIVE_PANEL_FORMAT == 0);
+
+static constexpr uint16_t panel_pixel_from_rgb565(uint16_t colour) {
+#if ENABLE_NATIVE_PANEL_FORMAT
+  return static_cast<uint16_t>((colour << 8) | (colour >> 8));
+#else
+  return colour;
+#endif
+}
+
+static constexpr uint16_t panel_pixel_to_rgb565(uint16_t pixel) {
+  return panel_pixel_from_rgb565(pixel);
+}
+
+static const uint16_t DMG_DEFAULT_PALETTE_PANEL[4] = {
+  panel_pixel_from_rgb565(0xFFFF),
+  panel_pixel_from_rgb565(0xAD55),
+  panel_pixel_from_rgb565(0x528A),
+  panel_pixel_from_rgb565(0x0000),
+};
 static constexpr uint16_t FALLBACK_COLOUR_RGB565 = 0x0000;
 static const char * const GBC_PALETTE_NAMES[GBC_PALETTE_COUNT] = {
   "Default (No buttons)",
@@ -291,13 +571,81 @@ static bool display_cache_valid = false;
 static bool frame_row_map_initialised = false;
 static uint8_t frame_row_map[DEST_H];
 static uint16_t frame_row_weight[DEST_H];
+static uint8_t frame_row_last_src[DEST_H];
+// Destination rows to visit per frame: every row, or only those that read an
+// even/odd source line when the core is drawing a single interlaced field.
+static uint8_t frame_all_rows[DEST_H];
+static uint8_t frame_field_rows[2][DEST_H];
+static uint8_t frame_field_row_count[2];
 static uint32_t swap_row_hash[DEST_H];
 static constexpr unsigned int FALLBACK_SEGMENT_ROWS = 4;
+// Rough cost of opening an address window (CASET/RASET/RAMWR plus DMA
+// descriptor setup) expressed in pixel transfers at the panel SPI clock.
+static constexpr uint32_t DIRTY_RECT_SETUP_COST_PIXELS = 48;
+// Framebuffer whose content the panel currently shows in full; column spans
+// recorded against it are only trusted while this holds.
+static const uint16_t *display_span_base_fb = nullptr;
 static uint16_t fallback_segment_buffer[FALLBACK_SEGMENT_ROWS * DEST_W];
 static uint8_t g_last_display_fb_index = 0;
 static bool g_last_display_frame_valid = false;
 static uint64_t g_last_display_frame_timestamp_us = 0;
 
+// Band rendering lets renderTask compose and flush the top of a frame while
+// the core is still drawing the bottom. lcd_draw_line posts a band message
+// every `render_band_lines` source lines and the main loop posts a final
+// message once the frame completes.
+static constexpr uint8_t RENDER_BAND_LINES_SMALL = 8;
+static constexpr uint8_t RENDER_BAND_LINES_LARGE = 16;
+static constexpr uint8_t FRAME_RENDER_FLAG_FINAL = 0x01;
+static constexpr UBaseType_t FRAME_QUEUE_LENGTH = 2 + (LCD_HEIGHT / RENDER_BAND_LINES_SMALL);
+
+struct FrameRenderMessage {
+  uint8_t fb_index;
+  uint8_t ready_lines;
+  uint8_t flags;
+  uint8_t sequence;
+};
+
+// Which source lines a framebuffer holds for the current frame.
+static constexpr uint8_t FRAME_FIELD_EVEN = 0;
+static constexpr uint8_t FRAME_FIELD_ODD = 1;
+static constexpr uint8_t FRAME_FIELD_FULL = 2;
+// framebuffer_field_mask value once every source line has been drawn.
+static constexpr uint8_t FRAME_FIELD_MASK_ALL = 0x03;
+
+// Changed column range of a source line versus the previous frame;
+// first > last means the line is unchanged.
+struct RowSpan {
+  uint8_t first;
+  uint8_t last;
+};
+
+struct FramePresentState {
+  const uint16_t *fb;
+  const uint32_t *row_hash;
+  uint8_t *row_dirty;
+  const RowSpan *row_span;
+  uint64_t input_us;
+  uint64_t render_us;
+  uint64_t dma_setup_us;
+  uint32_t rows_written;
+  uint32_t segments_flushed;
+  uint32_t pixels_written;
+  const uint8_t *row_list;
+  uint16_t row_list_count;
+  uint16_t row_cursor;
+  uint16_t next_row;
+  uint8_t field;
+  uint8_t ready_lines;
+  uint8_t sequence;
+  bool stretch;
+  bool cache_was_valid;
+  bool use_spans;
+  bool any_change;
+  bool active;
+  bool hud_visible;
+};
+
 static void disable_display_cache() {
   if(swap_fb_enabled) {
     if(swap_fb != nullptr) {
@@ -317,6 +665,9 @@ static void disable_display_cache() {
 static bool stretch_col_map_initialised = false;
 static uint16_t stretch_col_map[DEST_W];
 static uint16_t stretch_col_weight[DEST_W];
+// First/last destination column that samples each source column.
+static uint8_t stretch_src_first[LCD_WIDTH];
+static uint8_t stretch_src_last[LCD_WIDTH];
 static bool last_stretch_mode = false;
 static uint16_t stretch_line_buffer[DEST_W];
 static uint16_t stretch_blend_buffer[LCD_WIDTH];
@@ -422,6 +773,49 @@ enum FrameSkipMode : uint8_t {
   FRAME_SKIP_MODE_COUNT
 };
 
+enum PacingMode : uint8_t {
+  PACING_MODE_VIDEO = 0,   // absolute VERTICAL_SYNC deadlines
+  PACING_MODE_AUDIO = 1,   // speaker DMA consumption sets emulation speed
+  PACING_MODE_COUNT
+};
+
+// Mirrors enum audio_quality in minigb_apu.h. The setting is parsed and saved
+// even without ENABLE_SOUND, where that header is not included, so the values
+// live here and are checked against the header whenever it is.
+enum AudioQualityMode : uint8_t {
+  AUDIO_QUALITY_MODE_FAST = 0,    // channels rendered at the speaker rate
+  AUDIO_QUALITY_MODE_NATIVE = 1,  // 32768 Hz, 8-tap resampler
+  AUDIO_QUALITY_MODE_HIGH = 2,    // 65536 Hz, 16-tap resampler
+  AUDIO_QUALITY_MODE_COUNT
+};
+
+#if ENABLE_SOUND
+static_assert(static_cast<int>(AUDIO_QUALITY_MODE_FAST) == static_cast<int>(AUDIO_QUALITY_DIRECT) &&
+                  static_cast<int>(AUDIO_QUALITY_MODE_NATIVE) == static_cast<int>(AUDIO_QUALITY_NATIVE) &&
+                  static_cast<int>(AUDIO_QUALITY_MODE_HIGH) == static_cast<int>(AUDIO_QUALITY_HIGH) &&
+                  static_cast<int>(AUDIO_QUALITY_MODE_COUNT) == static_cast<int>(AUDIO_QUALITY_COUNT),
+              "AudioQualityMode must match enum audio_quality in minigb_apu.h");
+#endif
+
+// Speaker DMA layouts for the audio latency tuner, shallowest first.
+struct AudioDepthLevel {
+  uint16_t dma_buf_len;
+  uint8_t dma_buf_count;
+};
+
+static constexpr AudioDepthLevel AUDIO_DEPTH_LEVELS[] = {
+  {256, 2},
+  {256, 4},
+  {512, 4},
+  {512, 8},
+  {1024, 8},
+  {1024, 12},
+};
+static constexpr uint8_t AUDIO_DEPTH_LEVEL_COUNT =
+    static_cast<uint8_t>(sizeof(AUDIO_DEPTH_LEVELS) / sizeof(AUDIO_DEPTH_LEVELS[0]));
+// Deepest level that fits the internal DMA heap when there is no PSRAM.
+static constexpr uint8_t AUDIO_DEPTH_MAX_LEVEL_NO_PSRAM = 2;
+
 struct FirmwareSettings {
   bool audio_enabled;
   bool cgb_bootstrap_palettes;
@@ -429,15 +823,22 @@ struct FirmwareSettings {
   uint8_t rom_cache_banks;
   uint8_t master_volume;
   uint8_t frame_skip_mode;
+  uint8_t render_band_lines;
+  uint8_t pacing_mode;
+  uint8_t audio_depth;
+  uint8_t audio_quality;
   uint8_t button_mapping[JOYPAD_BUTTON_COUNT];
 };
 
 static constexpr uint8_t DEFAULT_MASTER_VOLUME = 255;
-static constexpr uint8_t SETTINGS_VERSION = 4;
+static constexpr uint8_t SETTINGS_VERSION = 8;
 static constexpr uint8_t VOLUME_STEP = 16;
 static constexpr const char *SETTINGS_DIR = "/config";
 static constexpr const char *SETTINGS_FILE_PATH = "/config/cardputer_settings.ini";
-static constexpr const char *SD_MOUNT_POINT = "/sd";
+#ifndef SD_MOUNT_POINT_PATH
+#define SD_MOUNT_POINT_PATH "/sd"
+#endif
+static const char *const SD_MOUNT_POINT = SD_MOUNT_POINT_PATH;
 static constexpr uint32_t SD_SPI_FAST_FREQUENCY_HZ = 25000000;
 static constexpr uint32_t SD_SPI_MEDIUM_FREQUENCY_HZ = 20000000;
 static constexpr uint32_t SD_SPI_SAFE_FREQUENCY_HZ = 10000000;
@@ -458,6 +859,10 @@ static FirmwareSettings g_settings = {
   ROM_CACHE_BANK_MAX,
   DEFAULT_MASTER_VOLUME,
   static_cast<uint8_t>(FRAME_SKIP_MODE_AUTO),
+  0,
+  static_cast<uint8_t>(PACING_MODE_VIDEO),
+  0,
+  static_cast<uint8_t>(AUDIO_QUALITY_MODE_FAST),
   {
     static_cast<uint8_t>('e'),
     static_cast<uint8_t>('s'),
@@ -516,6 +921,7 @@ static uint32_t g_status_message_expiry_ms = 0;
 static uint16_t g_status_message_fg = 0xFFFF;
 static uint16_t g_status_message_bg = 0x0000;
 static uint16_t g_save_state_hotkey_mask = 0;
+static int8_t g_last_loaded_save_slot = -1;  // movies start from here; -1 is power-on
 static bool g_psram_available = false;
 static bool g_sd_mounted = false;
 static uint32_t g_sd_active_frequency_hz = SD_SPI_FAST_FREQUENCY_HZ;
@@ -580,6 +986,7 @@ static bool ensure_sd_card(bool blocking);
 static bool ensure_settings_dir();
 static bool load_settings_from_sd();
 static bool save_settings_to_sd();
+static void save_settings_if_dirty();
 static void apply_settings_constraints();
 static void reset_save_state(struct priv_t *priv);
 static void set_sd_rom_path(struct priv_t *priv, const char *path);
@@ -616,6 +1023,7 @@ static bool save_state_store_slot(size_t slot_index);
 static bool save_state_load_slot(size_t slot_index);
 static int save_state_slot_from_key(char key);
 static bool handle_save_state_shortcuts(const Keyboard_Class::KeysState &status);
+static bool input_movie_forces_full_render();
 static void gb_printer_serial_tx(struct gb_s *gb, const uint8_t tx);
 static void request_cache_recovery(bool restore_display, size_t desired_rom_banks);
 static void process_cache_recovery();
@@ -626,279 +1034,873 @@ static void apply_speaker_volume();
 static void apply_speaker_volume() {}
 #endif
 
-static constexpr uint8_t FRAME_SKIP_ENABLE_STREAK_DEFAULT = 6;
-static constexpr uint8_t FRAME_SKIP_DISABLE_STREAK_DEFAULT = 30;
-static constexpr uint8_t FRAME_SKIP_MIN_ACTIVE_FRAMES_DEFAULT = 24;
-static constexpr uint8_t FRAME_SKIP_HOLD_FRAMES_DEFAULT = 6;
-
-static constexpr uint8_t FRAME_SKIP_ENABLE_STREAK_FALLBACK = 4;
-static constexpr uint8_t FRAME_SKIP_DISABLE_STREAK_FALLBACK = 18;
-static constexpr uint8_t FRAME_SKIP_MIN_ACTIVE_FRAMES_FALLBACK = 16;
-static constexpr uint8_t FRAME_SKIP_HOLD_FRAMES_FALLBACK = 4;
-
-static constexpr uint8_t INTERLACE_ENABLE_STREAK = 4;
-static constexpr uint8_t INTERLACE_DISABLE_STREAK = 24;
-static constexpr uint8_t INTERLACE_HOLD_FRAMES = 16;
 static constexpr uint8_t INTERLACE_COOLDOWN_FRAMES = 12;
 static constexpr uint16_t INTERLACE_DIRTY_NUMERATOR = 3;
 static constexpr uint16_t INTERLACE_DIRTY_DENOMINATOR = 4;
 static constexpr uint8_t INTERLACE_PALETTE_CHANGE_THRESHOLD = 12;
 
 struct AdaptiveInterlaceState {
-  uint8_t over_budget_streak;
-  uint8_t under_budget_streak;
-  uint8_t hold_frames;
   uint8_t cooldown_frames;
   bool active;
 };
 
 static AdaptiveInterlaceState g_interlace_state = {};
 
+// Predictive frame-time controller.
+//
+// Every completed frame's active time (poll + emulation + handoff) is fitted
+// online to cost = base + lines * pixel + handoff, where `lines` is the share
+// of scanlines the PPU produced (1 for a full frame, 0.5 for an interlaced
+// field, 0 for a suppressed frame) and handoff only applies to frames that
+// were presented. The model predicts the average per-frame cost of each
+// degradation level; the controller picks the least degraded level that is
+// expected to fit the frame budget with a jitter margin. It degrades once an
+// overrun has been predicted for a few consecutive frames and only recovers
+// once a better level has been predicted to fit with headroom for a sustained
+// run, which avoids the on/off oscillation of streak counters. Gains were
+// tuned with scripts/frame_controller_sim.py.
+enum FramePacingLevel : uint8_t {
+  FRAME_LEVEL_FULL = 0,
+  FRAME_LEVEL_INTERLACE,
+  FRAME_LEVEL_SKIP,
+  FRAME_LEVEL_INTERLACE_SKIP,
+  FRAME_LEVEL_COUNT
+};
+
+struct FrameCostSample {
+  uint64_t active_us;   // poll + emulation + handoff for this frame
+  uint64_t handoff_us;  // time spent handing the frame to the presenter
+  bool skipped;         // pixels were suppressed by frame skip
+  bool interlaced;      // only one field of scanlines was produced
+};
+
+struct FrameCostController {
+  float base_us;
+  float pixel_us;
+  float handoff_us;
+  float jitter_us;
+  uint8_t level;
+  uint8_t degrade_frames;
+  uint8_t recover_frames;
+  uint32_t level_frames[FRAME_LEVEL_COUNT];
+  bool primed;
+};
+
+static constexpr float FRAME_BUDGET_US = 1000000.0f / static_cast<float>(VERTICAL_SYNC);
+static constexpr float FRAME_MODEL_ALPHA = 0.0625f;
+static constexpr float FRAME_MODEL_JITTER_ALPHA = 0.0625f;
+static constexpr float FRAME_MODEL_JITTER_MARGIN = 1.0f;
+// One-off stalls (SD reads, ROM bank loads) would otherwise widen the margin
+// for dozens of frames, so each frame's deviation is capped at this share of
+// the budget before it feeds the jitter estimate.
+static constexpr float FRAME_MODEL_JITTER_CLAMP = 0.05f;
+static constexpr float FRAME_MODEL_RECOVER_HEADROOM = 0.02f;
+static constexpr uint8_t FRAME_MODEL_DEGRADE_FRAMES = 4;
+static constexpr uint8_t FRAME_MODEL_RECOVER_FRAMES = 30;
+// Initial split of a full frame's emulation time before enough mixed samples
+// have been observed to separate CPU from PPU pixel work.
+static constexpr float FRAME_MODEL_INITIAL_PIXEL_SHARE = 0.35f;
+
+static FrameCostController g_frame_controller = {};
+
 struct priv_t;
 
 static inline void request_interlace_cooldown(struct gb_s *gb) {
   AdaptiveInterlaceState &interlace = g_interlace_state;
   interlace.cooldown_frames = INTERLACE_COOLDOWN_FRAMES;
-  if(interlace.active) {
-    interlace.active = false;
-  }
-  interlace.over_budget_streak = 0;
-  interlace.under_budget_streak = 0;
-  interlace.hold_frames = 0;
+  interlace.active = false;
   gb->direct.interlace = 0;
   gb->display.interlace_count = 0;
 }
 
 static bool detect_palette_change(struct gb_s *gb, bool frame_completed);
 
-static inline void updateAdaptiveFrameSkip(struct gb_s *gb,
-                                           bool over_budget,
-                                           bool frame_completed) {
-  auto &state = gb->display.frame_skip_state;
-  struct priv_t *priv = (struct priv_t *)gb->direct.priv;
-
-  const bool full_cache_mode = swap_fb_enabled && swap_fb_psram_backed;
-  const bool fallback_mode = !full_cache_mode;
+static inline bool frame_level_interlaced(uint8_t level) {
+  return level == FRAME_LEVEL_INTERLACE || level == FRAME_LEVEL_INTERLACE_SKIP;
+}
 
-  const uint8_t enable_streak = fallback_mode ? FRAME_SKIP_ENABLE_STREAK_FALLBACK
-                                              : FRAME_SKIP_ENABLE_STREAK_DEFAULT;
-  const uint8_t disable_streak = fallback_mode ? FRAME_SKIP_DISABLE_STREAK_FALLBACK
-                                               : FRAME_SKIP_DISABLE_STREAK_DEFAULT;
-  const uint8_t hold_frames_target = fallback_mode ? FRAME_SKIP_HOLD_FRAMES_FALLBACK
-                                                   : FRAME_SKIP_HOLD_FRAMES_DEFAULT;
-  const uint8_t min_active_frames_target = fallback_mode ? FRAME_SKIP_MIN_ACTIVE_FRAMES_FALLBACK
-                                                         : FRAME_SKIP_MIN_ACTIVE_FRAMES_DEFAULT;
+static inline bool frame_level_skips(uint8_t level) {
+  return level == FRAME_LEVEL_SKIP || level == FRAME_LEVEL_INTERLACE_SKIP;
+}
 
-  // Lazily initialise tunable parameters if the core hasn't set them yet.
-  if(state.hold_frames == 0) {
-    state.hold_frames = hold_frames_target;
-  }
-  if(state.minimum_active_frames == 0) {
-    state.minimum_active_frames = min_active_frames_target;
+// Predicted average active time per frame at `level`.
+static float frame_controller_level_cost(const FrameCostController &ctl, uint8_t level) {
+  const float full = ctl.base_us + ctl.pixel_us + ctl.handoff_us;
+  const float field = ctl.base_us + (0.5f * ctl.pixel_us) + ctl.handoff_us;
+  const float skipped = ctl.base_us;
+  switch(level) {
+    case FRAME_LEVEL_FULL:
+      return full;
+    case FRAME_LEVEL_INTERLACE:
+      return field;
+    case FRAME_LEVEL_SKIP:
+      return 0.5f * (full + skipped);
+    default:
+      return 0.5f * (field + skipped);
+  }
+}
+
+static void frame_controller_observe(FrameCostController &ctl, const FrameCostSample &sample) {
+  const float active = static_cast<float>(sample.active_us);
+  const float handoff = sample.skipped ? 0.0f : static_cast<float>(sample.handoff_us);
+  const float lines = sample.skipped ? 0.0f : (sample.interlaced ? 0.5f : 1.0f);
+  const float work = active - handoff;
+
+  if(!ctl.primed) {
+    const float full_equivalent = (lines > 0.0f)
+                                      ? work / (1.0f - FRAME_MODEL_INITIAL_PIXEL_SHARE +
+                                                FRAME_MODEL_INITIAL_PIXEL_SHARE * lines)
+                                      : work / (1.0f - FRAME_MODEL_INITIAL_PIXEL_SHARE);
+    ctl.pixel_us = full_equivalent * FRAME_MODEL_INITIAL_PIXEL_SHARE;
+    ctl.base_us = full_equivalent - ctl.pixel_us;
+    ctl.handoff_us = handoff;
+    ctl.jitter_us = 0.0f;
+    ctl.primed = true;
+    return;
   }
 
-  if(state.hold_frames != hold_frames_target) {
-    state.hold_frames = hold_frames_target;
+  const float predicted = ctl.base_us + (lines * ctl.pixel_us) + (sample.skipped ? 0.0f : ctl.handoff_us);
+  float error = active - predicted;
+  const float deviation = fminf(fabsf(error), FRAME_MODEL_JITTER_CLAMP * FRAME_BUDGET_US);
+  ctl.jitter_us += FRAME_MODEL_JITTER_ALPHA * (deviation - ctl.jitter_us);
+
+  // Normalised LMS step on (base, pixel): skipped frames pin down the CPU
+  // share, presented frames the pixel share.
+  error = work - (ctl.base_us + lines * ctl.pixel_us);
+  const float norm = 1.0f + lines * lines;
+  ctl.base_us += FRAME_MODEL_ALPHA * error / norm;
+  ctl.pixel_us += FRAME_MODEL_ALPHA * error * lines / norm;
+  if(ctl.base_us < 0.0f) {
+    ctl.base_us = 0.0f;
   }
-  if(state.minimum_active_frames != min_active_frames_target) {
-    state.minimum_active_frames = min_active_frames_target;
+  if(ctl.pixel_us < 0.0f) {
+    ctl.pixel_us = 0.0f;
   }
+  if(!sample.skipped) {
+    ctl.handoff_us += FRAME_MODEL_ALPHA * (handoff - ctl.handoff_us);
+  }
+}
+
+static uint8_t frame_controller_select(FrameCostController &ctl,
+                                       bool interlace_allowed,
+                                       bool skip_allowed,
+                                       bool frame_completed) {
+  auto allowed = [&](uint8_t level) -> bool {
+    if(frame_level_interlaced(level) && !interlace_allowed) {
+      return false;
+    }
+    if(frame_level_skips(level) && !skip_allowed) {
+      return false;
+    }
+    return true;
+  };
 
-  const bool frame_skip_supported = (priv != nullptr);
+  // Least degraded level predicted to fit `budget`; if none does, this settles
+  // on the most degraded level that is allowed.
+  const float margin = FRAME_MODEL_JITTER_MARGIN * ctl.jitter_us;
+  auto best_level = [&](float budget) -> uint8_t {
+    uint8_t best = FRAME_LEVEL_FULL;
+    for(uint8_t level = 0; level < FRAME_LEVEL_COUNT; ++level) {
+      if(!allowed(level)) {
+        continue;
+      }
+      best = level;
+      if(frame_controller_level_cost(ctl, level) + margin <= budget) {
+        break;
+      }
+    }
+    return best;
+  };
 
-  if(state.debounce_frames_remaining > 0) {
-    state.debounce_frames_remaining--;
+  const uint8_t desired = best_level(FRAME_BUDGET_US);
+  if(!allowed(ctl.level)) {
+    ctl.level = desired;
+    ctl.degrade_frames = 0;
+    ctl.recover_frames = 0;
+    return ctl.level;
+  }
+  // The hysteresis counters advance once per emulated frame, not per loop
+  // iteration.
+  if(!frame_completed) {
+    return ctl.level;
+  }
+  if(desired > ctl.level) {
+    ctl.recover_frames = 0;
+    if(++ctl.degrade_frames >= FRAME_MODEL_DEGRADE_FRAMES) {
+      ctl.level = desired;
+      ctl.degrade_frames = 0;
+    }
+    return ctl.level;
   }
+  ctl.degrade_frames = 0;
 
-  if(state.frames_since_toggle < 0xFF) {
-    state.frames_since_toggle++;
+  const uint8_t recover_target = best_level(FRAME_BUDGET_US * (1.0f - FRAME_MODEL_RECOVER_HEADROOM));
+  if(recover_target < ctl.level) {
+    if(++ctl.recover_frames >= FRAME_MODEL_RECOVER_FRAMES) {
+      ctl.level = recover_target;
+      ctl.recover_frames = 0;
+    }
+  } else {
+    ctl.recover_frames = 0;
   }
+  return ctl.level;
+}
 
+static inline void updatePredictiveFrameControl(struct gb_s *gb,
+                                                const FrameCostSample &sample,
+                                                bool frame_completed,
+                                                bool skip_permitted) {
+  auto &state = gb->display.frame_skip_state;
+  struct priv_t *priv = (struct priv_t *)gb->direct.priv;
+  FrameCostController &ctl = g_frame_controller;
   AdaptiveInterlaceState &interlace = g_interlace_state;
+
   if(frame_completed && interlace.cooldown_frames > 0) {
     interlace.cooldown_frames--;
   }
+  if(frame_completed) {
+    frame_controller_observe(ctl, sample);
+  }
 
-  if(over_budget) {
-    if(state.over_budget_streak < 0xFF) {
-      state.over_budget_streak++;
-    }
-    state.under_budget_streak = 0;
+  const bool interlace_allowed = (gb->cgb.enabled != 0) &&
+                                 swap_fb_enabled &&
+                                 swap_fb_psram_backed &&
+                                 (interlace.cooldown_frames == 0);
+  const bool skip_allowed = skip_permitted && (priv != nullptr);
+
+  const uint8_t level = frame_controller_select(ctl, interlace_allowed, skip_allowed, frame_completed);
+  if(frame_completed) {
+    ctl.level_frames[level]++;
+  }
+
+  const bool want_interlace = frame_level_interlaced(level);
+  if(want_interlace != interlace.active) {
+    interlace.active = want_interlace;
+    gb->display.interlace_count = 0;
+  }
+  gb->direct.interlace = interlace.active ? 1 : 0;
+
+  const bool want_skip = frame_level_skips(level);
+  if(want_skip) {
+    gb->direct.frame_skip = 1;
   } else {
-    if(state.under_budget_streak < 0xFF) {
-      state.under_budget_streak++;
-    }
-    if(state.over_budget_streak > 0) {
-      state.over_budget_streak--;
-    }
+    gb->direct.frame_skip = 0;
+    gb->display.frame_skip_count = 0;
   }
+  state.current_frame_skip = want_skip ? 1 : 0;
+}
+
+// Absolute-deadline frame pacer.
+//
+// Frame n is due at epoch + n * period, with the period kept in Q16
+// microseconds so the schedule follows VERTICAL_SYNC exactly instead of
+// accumulating tick rounding. Between frames the main task blocks on a task
+// notification from a one-shot esp_timer armed just ahead of the deadline, so
+// the core idles rather than spinning, and only the last few microseconds are
+// busy-waited. A late frame is not waited for: the following frames start
+// back to back until the schedule is met again. If the loop falls more than
+// FRAME_PACER_MAX_LAG_FRAMES behind (SD stalls, screenshots) the schedule is
+// restarted from the current time instead of fast-forwarding through the debt.
+struct FramePacer {
+  esp_timer_handle_t timer;
+  TaskHandle_t task;
+  uint64_t epoch_us;
+  uint64_t frame_index;
+  uint64_t deadline_us;   // scheduled start of the next frame
+  uint64_t dropped_us;    // schedule time discarded by resyncs
+  uint32_t resyncs;
+  bool scheduled;         // deadline_us applies to the upcoming frame start
+};
 
-  const bool can_toggle = (state.debounce_frames_remaining == 0) &&
-                          (state.frames_since_toggle >= state.minimum_active_frames);
+static constexpr uint64_t FRAME_PACER_PERIOD_Q16 =
+    static_cast<uint64_t>(1000000.0 * 65536.0 / VERTICAL_SYNC + 0.5);
+static constexpr uint32_t FRAME_PACER_MAX_LAG_FRAMES = 4;
+// esp_timer callbacks run from the esp_timer task; waking a little early and
+// spinning the remainder hides its dispatch latency.
+static constexpr uint64_t FRAME_PACER_SPIN_US = 80;
 
-  const bool allow_interlace = (gb->cgb.enabled != 0) &&
-                               swap_fb_enabled &&
-                               swap_fb_psram_backed &&
-                               (interlace.cooldown_frames == 0);
+static FramePacer g_frame_pacer = {};
 
-  if(allow_interlace) {
-    if(over_budget) {
-      if(interlace.over_budget_streak < 0xFF) {
-        interlace.over_budget_streak++;
-      }
-      interlace.under_budget_streak = 0;
-      interlace.hold_frames = INTERLACE_HOLD_FRAMES;
-    } else {
-      if(interlace.under_budget_streak < 0xFF) {
-        interlace.under_budget_streak++;
-      }
-      if(interlace.over_budget_streak > 0) {
-        interlace.over_budget_streak--;
-      }
-      if(interlace.hold_frames > 0) {
-        interlace.hold_frames--;
-      }
-    }
+static void frame_pacer_timer_cb(void *arg) {
+  TaskHandle_t task = static_cast<TaskHandle_t>(arg);
+  if(task != nullptr) {
+    xTaskNotifyGive(task);
+  }
+}
 
-    if(!interlace.active) {
-      if(interlace.over_budget_streak >= INTERLACE_ENABLE_STREAK) {
-        interlace.active = true;
-        interlace.hold_frames = INTERLACE_HOLD_FRAMES;
-        interlace.under_budget_streak = 0;
-        gb->display.interlace_count = 0;
-        interlace.cooldown_frames = 0;
-      }
-    } else {
-      const bool ready_to_disable =
-          (interlace.hold_frames == 0) && (interlace.under_budget_streak >= INTERLACE_DISABLE_STREAK);
-      if(ready_to_disable) {
-        interlace.active = false;
-        interlace.over_budget_streak = 0;
-        interlace.under_budget_streak = 0;
-        interlace.hold_frames = 0;
-        interlace.cooldown_frames = 0;
-      }
-    }
+static inline uint64_t frame_pacer_deadline(const FramePacer &pacer, uint64_t frame_index) {
+  return pacer.epoch_us + ((frame_index * FRAME_PACER_PERIOD_Q16) >> 16);
+}
 
-    gb->direct.interlace = interlace.active ? 1 : 0;
+static void frame_pacer_reset(FramePacer &pacer, uint64_t now) {
+  pacer.epoch_us = now;
+  pacer.frame_index = 0;
+  pacer.deadline_us = now;
+  pacer.scheduled = false;
+}
 
-    if(interlace.active) {
-      // Delay enabling frame skip until interlacing alone fails to recover.
-      if(state.over_budget_streak > enable_streak * 2) {
-        interlace.over_budget_streak = INTERLACE_ENABLE_STREAK; // keep active but allow skip logic
-      } else {
-        over_budget = false;
-      }
-    }
-  } else {
-    if(interlace.active) {
-      interlace.active = false;
-      interlace.over_budget_streak = 0;
-      interlace.under_budget_streak = 0;
-      interlace.hold_frames = 0;
+static void frame_pacer_init(FramePacer &pacer, uint64_t now) {
+  pacer.task = xTaskGetCurrentTaskHandle();
+  if(pacer.timer == nullptr) {
+    esp_timer_create_args_t args = {};
+    args.callback = &frame_pacer_timer_cb;
+    args.arg = pacer.task;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "frame_pacer";
+    if(esp_timer_create(&args, &pacer.timer) != ESP_OK) {
+      pacer.timer = nullptr;
+      Serial.println("Frame pacer timer unavailable; falling back to tick delays");
     }
-    gb->direct.interlace = 0;
-    gb->display.interlace_count = 0;
   }
+  pacer.resyncs = 0;
+  pacer.dropped_us = 0;
+  frame_pacer_reset(pacer, now);
+}
 
-  if(!frame_skip_supported && state.current_frame_skip) {
-    state.current_frame_skip = 0;
-    gb->direct.frame_skip = 0;
-    gb->display.frame_skip_count = 0;
-    state.over_budget_streak = 0;
+#if !ENABLE_NATIVE_BENCH
+// Advances the schedule by one frame. Returns the start deadline for the next
+// frame, or 0 when the loop is too far behind and the schedule was restarted.
+// The native benchmark runs unpaced and never calls it.
+static uint64_t frame_pacer_advance(FramePacer &pacer, uint64_t now) {
+  pacer.frame_index++;
+  uint64_t deadline = frame_pacer_deadline(pacer, pacer.frame_index);
+  const uint64_t max_lag_us = (FRAME_PACER_MAX_LAG_FRAMES * FRAME_PACER_PERIOD_Q16) >> 16;
+  if(now > deadline && now - deadline > max_lag_us) {
+    pacer.dropped_us += now - deadline;
+    pacer.resyncs++;
+    frame_pacer_reset(pacer, now);
+    return 0;
   }
+  pacer.deadline_us = deadline;
+  pacer.scheduled = true;
+  return deadline;
+}
+#endif
 
-  if(!state.current_frame_skip) {
-   if(frame_skip_supported && can_toggle &&
-     state.over_budget_streak >= enable_streak) {
-      state.current_frame_skip = 1;
-      gb->direct.frame_skip = 1;
-      state.debounce_frames_remaining = state.hold_frames;
-      state.frames_since_toggle = 0;
-      state.over_budget_streak = 0;
-      state.under_budget_streak = 0;
+// Blocks until `deadline`. Returns the time actually spent waiting.
+static uint64_t frame_pacer_wait(FramePacer &pacer, uint64_t deadline) {
+  const uint64_t wait_start = micros64();
+  uint64_t now = wait_start;
+  while(now + FRAME_PACER_SPIN_US < deadline) {
+    const uint64_t sleep_us = deadline - now - FRAME_PACER_SPIN_US;
+    if(pacer.timer != nullptr) {
+      esp_timer_stop(pacer.timer);
+      if(esp_timer_start_once(pacer.timer, sleep_us) == ESP_OK) {
+        // The tick timeout only guards against a lost notification; a stale
+        // one from an earlier wait just sends us round the loop again.
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(sleep_us / 1000 + 2));
+        now = micros64();
+        continue;
+      }
     }
-  } else {
-    if(can_toggle && state.under_budget_streak >= disable_streak) {
-      state.current_frame_skip = 0;
-      gb->direct.frame_skip = 0;
-      gb->display.frame_skip_count = 0;
-      state.debounce_frames_remaining = state.hold_frames;
-      state.frames_since_toggle = 0;
-      state.over_budget_streak = 0;
-      state.under_budget_streak = 0;
+    const TickType_t ticks = pdMS_TO_TICKS(sleep_us / 1000);
+    if(ticks == 0) {
+      break;
     }
-  }
+    vTaskDelay(ticks);
+    now = micros64();
+  }
+  while(now < deadline) {
+    now = micros64();
+  }
+  return now - wait_start;
+}
+
+#if ENABLE_TELEMETRY
+// Binary per-frame telemetry.
+//
+// The main loop fills one TelemetryFrameRecord per loop iteration into a
+// single-producer/single-consumer ring; telemetryTask, at the lowest useful
+// priority on core 0, drains it to Serial in contiguous writes. A full ring
+// drops the record instead of blocking the emulator and the cumulative drop
+// count travels in every record. Each record starts with a two-byte sync word
+// and ends with a CRC-8, so the decoder can resynchronise around the text log
+// lines that share the port.
+static constexpr uint8_t TELEMETRY_SYNC0 = 0xA5;
+static constexpr uint8_t TELEMETRY_SYNC1 = 0x5A;
+static constexpr uint8_t TELEMETRY_RECORD_FRAME = 0x01;
+static constexpr uint32_t TELEMETRY_RING_RECORDS = 128;
+static constexpr uint32_t TELEMETRY_DRAIN_PERIOD_MS = 20;
+static constexpr uint32_t TELEMETRY_TASK_STACK_SIZE = 2048;
+
+static constexpr uint8_t TELEMETRY_FLAG_COMPLETED = 0x01;
+static constexpr uint8_t TELEMETRY_FLAG_SUPPRESSED = 0x02;
+static constexpr uint8_t TELEMETRY_FLAG_INTERLACED = 0x04;
+static constexpr uint8_t TELEMETRY_FLAG_OVER_BUDGET = 0x08;
+static constexpr uint8_t TELEMETRY_FLAG_AUDIO_PACED = 0x10;
+
+struct TelemetryFrameRecord {
+  uint8_t sync0;
+  uint8_t sync1;
+  uint8_t type;
+  uint8_t length;          // whole record, header and CRC included
+  uint32_t frame;          // main loop iteration
+  uint32_t start_us;       // low 32 bits of the frame start timestamp
+  uint16_t frame_us;       // durations saturate at 65535
+  uint16_t poll_us;
+  uint16_t emu_us;
+  uint16_t handoff_us;
+  uint16_t idle_us;
+  uint16_t render_us;      // most recent completed presenter pass
+  uint16_t pace_dev_us;    // frame start minus its scheduled deadline
+  uint16_t rom_misses;     // ROM cache misses since the previous record
+  uint16_t audio_fill;     // audio ring fill, stereo frames (0 when the ring is off)
+  uint16_t dropped;        // records lost to a full ring (wraps)
+  uint8_t dirty_rows;
+  uint8_t flags;           // TELEMETRY_FLAG_*
+  uint8_t level;           // FramePacingLevel
+  uint8_t audio_queue;     // speaker buffers queued
+  uint8_t reserved;
+  uint8_t crc;             // CRC-8 (poly 0x07) over all preceding bytes
+} __attribute__((packed));
+
+static_assert(sizeof(TelemetryFrameRecord) == 38, "telemetry record layout changed; update scripts/telemetry_decode.py");
+
+struct TelemetryState {
+  TelemetryFrameRecord ring[TELEMETRY_RING_RECORDS];
+  std::atomic<uint32_t> head;   // records written (producer)
+  std::atomic<uint32_t> tail;   // records sent (consumer)
+  std::atomic<uint32_t> last_render_us;
+  uint32_t dropped;
+  size_t last_rom_misses;
+  TaskHandle_t task;
+};
+
+static TelemetryState g_telemetry = {};
+
+static inline uint16_t telemetry_clamp16(uint64_t value) {
+  return value > 0xFFFFu ? 0xFFFFu : static_cast<uint16_t>(value);
 }
 
-static size_t rom_cache_preferred_bank_limit() {
-  return g_psram_available ? ROM_CACHE_BANK_MAX : ROM_CACHE_BANK_LIMIT_NO_PSRAM;
+static uint8_t telemetry_crc8(const uint8_t *data, size_t length) {
+  uint8_t crc = 0;
+  for(size_t i = 0; i < length; ++i) {
+    crc ^= data[i];
+    for(int bit = 0; bit < 8; ++bit) {
+      crc = (crc & 0x80) ? static_cast<uint8_t>((crc << 1) ^ 0x07) : static_cast<uint8_t>(crc << 1);
+    }
+  }
+  return crc;
 }
 
-static size_t rom_cache_preferred_block_size() {
-  return g_psram_available ? ROM_STREAM_BLOCK_SIZE : ROM_BANK_SIZE;
+// Called by the presenter once a frame has been flushed.
+static inline void telemetry_note_render(uint64_t render_us) {
+  g_telemetry.last_render_us.store(static_cast<uint32_t>(render_us), std::memory_order_relaxed);
 }
 
-static inline void rom_cache_update_geometry(RomCache *cache) {
-  if(cache == nullptr) {
+// Fills in the header, render time, drop count and CRC, then queues the
+// record. Never blocks.
+static void telemetry_submit(TelemetryFrameRecord &record) {
+  const uint32_t head = g_telemetry.head.load(std::memory_order_relaxed);
+  const uint32_t tail = g_telemetry.tail.load(std::memory_order_acquire);
+  if(head - tail >= TELEMETRY_RING_RECORDS) {
+    g_telemetry.dropped++;
     return;
   }
 
-  cache->bank_mask = 0;
-  cache->bank_shift = 0;
-  cache->bank_shift_valid = 0;
+  record.sync0 = TELEMETRY_SYNC0;
+  record.sync1 = TELEMETRY_SYNC1;
+  record.type = TELEMETRY_RECORD_FRAME;
+  record.length = static_cast<uint8_t>(sizeof(TelemetryFrameRecord));
+  record.render_us = telemetry_clamp16(g_telemetry.last_render_us.load(std::memory_order_relaxed));
+  record.dropped = static_cast<uint16_t>(g_telemetry.dropped);
+  record.reserved = 0;
+  record.crc = telemetry_crc8(reinterpret_cast<const uint8_t *>(&record),
+                              sizeof(TelemetryFrameRecord) - 1);
 
-  const size_t block_size = cache->bank_size;
-  if(block_size == 0) {
-    return;
-  }
+  g_telemetry.ring[head % TELEMETRY_RING_RECORDS] = record;
+  g_telemetry.head.store(head + 1, std::memory_order_release);
+}
 
-  if((block_size & (block_size - 1)) == 0) {
-    cache->bank_mask = static_cast<uint32_t>(block_size - 1);
-    cache->bank_shift = static_cast<uint8_t>(__builtin_ctzll(static_cast<unsigned long long>(block_size)));
-    cache->bank_shift_valid = 1;
+static void telemetryTask(void *param) {
+  (void)param;
+  const TickType_t period = pdMS_TO_TICKS(TELEMETRY_DRAIN_PERIOD_MS);
+  while(true) {
+    uint32_t tail = g_telemetry.tail.load(std::memory_order_relaxed);
+    const uint32_t head = g_telemetry.head.load(std::memory_order_acquire);
+    while(tail != head) {
+      // Write up to the end of the ring in one go, then wrap.
+      const uint32_t index = tail % TELEMETRY_RING_RECORDS;
+      uint32_t count = head - tail;
+      if(count > TELEMETRY_RING_RECORDS - index) {
+        count = TELEMETRY_RING_RECORDS - index;
+      }
+      Serial.write(reinterpret_cast<const uint8_t *>(&g_telemetry.ring[index]),
+                   count * sizeof(TelemetryFrameRecord));
+      tail += count;
+      g_telemetry.tail.store(tail, std::memory_order_release);
+    }
+    vTaskDelay(period);
   }
 }
 
-static inline uint32_t rom_cache_bank_base(const RomCache *cache, uint32_t bank) {
-  const size_t block_size = cache->bank_size ? cache->bank_size : ROM_STREAM_BLOCK_SIZE;
-  if(cache->bank_shift_valid) {
-    return bank << cache->bank_shift;
+static void telemetry_start() {
+  if(g_telemetry.task != nullptr) {
+    return;
+  }
+  g_telemetry.head.store(0, std::memory_order_relaxed);
+  g_telemetry.tail.store(0, std::memory_order_relaxed);
+  g_telemetry.dropped = 0;
+  g_telemetry.last_rom_misses = 0;
+  if(xTaskCreatePinnedToCore(telemetryTask,
+                             "Telemetry",
+                             TELEMETRY_TASK_STACK_SIZE,
+                             nullptr,
+                             tskIDLE_PRIORITY + 1,
+                             &g_telemetry.task,
+                             0) != pdPASS) {
+    g_telemetry.task = nullptr;
+    Serial.println("Telemetry task creation failed; telemetry disabled");
   }
-  return bank * static_cast<uint32_t>(block_size);
 }
+#endif
 
-struct PaletteState {
-  bool gbc_enabled;
-  uint8_t active_index;
-  bool auto_assigned;
-  bool combo_override;
-  char label[32];
-  uint16_t bg_rgb565[4];
-  uint16_t obj0_rgb565[4];
-  uint16_t obj1_rgb565[4];
+#if ENABLE_TRACE_PROBES
+// Scoped trace probes.
+//
+// TRACE_SCOPE(id) emits a begin event when the scope is entered and an end
+// event when it is left. Events carry the raw 32-bit CPU cycle counter, so a
+// probe costs a few dozen cycles. Each core has its own ring and writers
+// reserve a slot with an atomic fetch_add, so tasks preempting each other on
+// the same core never share a slot and no lock is taken. The rings keep the
+// most recent TRACE_RING_EVENTS events per core.
+//
+// The cycle counter is per core and wraps every ~18 s at 240 MHz, so the
+// first event of every TRACE_ANCHOR_BLOCK also records an esp_timer timestamp
+// and the clock frequency. The dump converts each event against the anchor
+// of its block, which lines the two cores up on one timeline.
+enum TraceProbeId : uint8_t {
+  TRACE_PROBE_RUN_FRAME = 0,
+  TRACE_PROBE_LCD_DRAW_LINE,
+  TRACE_PROBE_FIT_FRAME,
+  TRACE_PROBE_ROM_FILL_BANK,
+  TRACE_PROBE_AUDIO_PUMP,
+  TRACE_PROBE_SAVE_CART_RAM,
+  TRACE_PROBE_COUNT
 };
 
-struct priv_t;
-static void rom_cache_reset(RomCache *cache);
-static bool rom_cache_open(RomCache *cache, const char *path);
-static bool rom_cache_open_memory(RomCache *cache, const uint8_t *data, size_t size);
-static inline uint8_t IRAM_ATTR rom_cache_read(RomCache *cache, uint32_t addr);
-static void rom_cache_close(RomCache *cache);
-static uint8_t rom_cache_cgb_flag(const RomCache *cache);
-static uint8_t* rom_cache_alloc_block(size_t bytes, bool prefer_internal_first);
-static inline int16_t IRAM_ATTR rom_cache_bank_index(const RomCache *cache, const RomCacheBank *bank);
-static void rom_cache_disable_posix(RomCache *cache);
-static bool rom_cache_ensure_file_stream(RomCache *cache);
-static inline void IRAM_ATTR rom_cache_detach_entry(RomCache *cache, int16_t index);
-static inline void IRAM_ATTR rom_cache_attach_front(RomCache *cache, int16_t index, RomCacheSegment segment);
-static inline void IRAM_ATTR rom_cache_touch_hit(RomCache *cache, int16_t index);
-static inline int16_t IRAM_ATTR rom_cache_select_victim(RomCache *cache);
-static inline void rom_cache_update_segment_targets(RomCache *cache);
-static inline void IRAM_ATTR rom_cache_enforce_protected_capacity(RomCache *cache);
-static const char* gbc_palette_name(size_t index);
-static void palette_apply_dmg(PaletteState *palette);
-static void palette_set_label(PaletteState *palette, const char *label);
+static const char *const TRACE_PROBE_NAMES[TRACE_PROBE_COUNT] = {
+  "gb_run_frame",
+  "lcd_draw_line",
+  "fit_frame_rows",
+  "rom_cache_fill_bank",
+  "audioPump",
+  "save_cart_ram_to_sd"
+};
+
+static constexpr uint32_t TRACE_RING_EVENTS = 8192;         // per core, power of two
+static constexpr uint32_t TRACE_RING_EVENTS_NO_PSRAM = 1024;
+static constexpr uint32_t TRACE_ANCHOR_BLOCK = 256;         // events per timestamp anchor
+static constexpr double TRACE_ANCHOR_TOLERANCE_US = 2.0;    // anchor rounding plus the read between clocks
+static constexpr const char *TRACE_DIR = "/traces";
+
+static constexpr uint8_t TRACE_PHASE_BEGIN = 0;
+static constexpr uint8_t TRACE_PHASE_END = 1;
+
+struct TraceEvent {
+  uint32_t cycles;
+  TaskHandle_t task;
+  uint8_t probe;
+  uint8_t phase;
+  uint16_t reserved;
+};
+
+struct TraceAnchor {
+  uint64_t time_us;
+  uint32_t cycles;
+  uint32_t cpu_mhz;
+};
+
+struct TraceCoreRing {
+  TraceEvent *events;
+  TraceAnchor *anchors;
+  uint32_t mask;
+  std::atomic<uint32_t> head;
+};
+
+static TraceCoreRing g_trace_rings[portNUM_PROCESSORS] = {};
+static std::atomic<bool> g_trace_enabled(false);
+
+static inline uint32_t trace_cycle_count() {
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+  return static_cast<uint32_t>(esp_cpu_get_cycle_count());
+#else
+  return static_cast<uint32_t>(esp_cpu_get_ccount());
+#endif
+}
+
+static inline void trace_emit(TraceProbeId probe, uint8_t phase) {
+  if(!g_trace_enabled.load(std::memory_order_relaxed)) {
+    return;
+  }
+  TraceCoreRing &ring = g_trace_rings[xPortGetCoreID()];
+  const uint32_t cycles = trace_cycle_count();
+  const uint32_t index = ring.head.fetch_add(1, std::memory_order_relaxed);
+  if((index & (TRACE_ANCHOR_BLOCK - 1)) == 0) {
+    TraceAnchor &anchor = ring.anchors[(index & ring.mask) / TRACE_ANCHOR_BLOCK];
+    anchor.time_us = micros64();
+    anchor.cycles = cycles;
+    anchor.cpu_mhz = getCpuFrequencyMhz();
+  }
+  TraceEvent &event = ring.events[index & ring.mask];
+  event.cycles = cycles;
+  event.task = xTaskGetCurrentTaskHandle();
+  event.probe = probe;
+  event.phase = phase;
+}
+
+struct TraceScope {
+  explicit TraceScope(TraceProbeId probe) : probe_(probe) {
+    trace_emit(probe_, TRACE_PHASE_BEGIN);
+  }
+  ~TraceScope() {
+    trace_emit(probe_, TRACE_PHASE_END);
+  }
+  TraceScope(const TraceScope &) = delete;
+  TraceScope &operator=(const TraceScope &) = delete;
+
+ private:
+  TraceProbeId probe_;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(probe) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(probe)
+
+static void trace_init() {
+  const uint32_t events = g_psram_available ? TRACE_RING_EVENTS : TRACE_RING_EVENTS_NO_PSRAM;
+  const uint32_t caps = g_psram_available ? (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+                                          : (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  for(size_t core = 0; core < portNUM_PROCESSORS; ++core) {
+    TraceCoreRing &ring = g_trace_rings[core];
+    if(ring.events == nullptr) {
+      ring.events = static_cast<TraceEvent *>(heap_caps_calloc(events, sizeof(TraceEvent), caps));
+      ring.anchors = static_cast<TraceAnchor *>(
+          heap_caps_calloc(events / TRACE_ANCHOR_BLOCK, sizeof(TraceAnchor), caps));
+      ring.mask = events - 1;
+    }
+    if(ring.events == nullptr || ring.anchors == nullptr) {
+      Serial.println("Trace ring allocation failed; probes disabled");
+      return;
+    }
+    ring.head.store(0, std::memory_order_relaxed);
+  }
+  Serial.printf("Trace probes enabled: %u events per core (Fn+T to dump)\n", static_cast<unsigned>(events));
+  g_trace_enabled.store(true, std::memory_order_release);
+}
+
+// Buffers small JSON fragments so SD and USB see large writes.
+struct TraceWriter {
+  Print &out;
+  char buffer[512];
+  size_t used;
+  bool first_event;
+
+  explicit TraceWriter(Print &target) : out(target), used(0), first_event(true) {}
+
+  void flush() {
+    if(used > 0) {
+      out.write(reinterpret_cast<const uint8_t *>(buffer), used);
+      used = 0;
+    }
+  }
+
+  void printf(const char *format, ...) __attribute__((format(printf, 2, 3))) {
+    char line[192];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if(length <= 0) {
+      return;
+    }
+    if(static_cast<size_t>(length) >= sizeof(line)) {
+      length = sizeof(line) - 1;
+    }
+    if(used + length > sizeof(buffer)) {
+      flush();
+    }
+    memcpy(buffer + used, line, length);
+    used += length;
+  }
+
+  void event_separator() {
+    if(!first_event) {
+      printf(",\n");
+    }
+    first_event = false;
+  }
+};
+
+// Writes every retained event as Chrome trace-event JSON (load it in
+// chrome://tracing or ui.perfetto.dev). Processes are cores and threads are
+// FreeRTOS tasks. Probes are paused while the rings are read.
+static size_t trace_dump(Print &out) {
+  g_trace_enabled.store(false, std::memory_order_release);
+  vTaskDelay(pdMS_TO_TICKS(2));  // let probes already past the enabled check land
+
+  TraceWriter writer(out);
+  writer.printf("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+  static constexpr size_t kMaxTasks = 16;
+  TaskHandle_t tasks[kMaxTasks] = {nullptr};
+  uint8_t task_cores[kMaxTasks] = {0};
+  size_t task_count = 0;
+  size_t written = 0;
+
+  for(size_t core = 0; core < portNUM_PROCESSORS; ++core) {
+    TraceCoreRing &ring = g_trace_rings[core];
+    if(ring.events == nullptr) {
+      continue;
+    }
+    writer.event_separator();
+    writer.printf("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"args\":{\"name\":\"core%u\"}}",
+                  static_cast<unsigned>(core),
+                  static_cast<unsigned>(core));
+
+    const uint32_t capacity = ring.mask + 1;
+    const uint32_t head = ring.head.load(std::memory_order_acquire);
+    // Drop the oldest, partly overwritten anchor block once the ring wraps.
+    const uint32_t retained = head < capacity ? head : capacity - TRACE_ANCHOR_BLOCK;
+    bool have_previous = false;
+    uint32_t previous_cycles = 0;
+    double previous_us = 0.0;
+    for(uint32_t index = head - retained; index != head; ++index) {
+      const TraceEvent &event = ring.events[index & ring.mask];
+      const TraceAnchor &anchor = ring.anchors[(index & ring.mask) / TRACE_ANCHOR_BLOCK];
+      if(event.probe >= TRACE_PROBE_COUNT || anchor.cpu_mhz == 0) {
+        continue;
+      }
+      const int32_t delta_cycles = static_cast<int32_t>(event.cycles - anchor.cycles);
+      double ts_us = static_cast<double>(anchor.time_us) +
+                     static_cast<double>(delta_cycles) / static_cast<double>(anchor.cpu_mhz);
+      // Anchors hold whole microseconds, so neighbouring blocks can disagree
+      // by up to one and a short scope across a block boundary could end
+      // before it began. Carry the previous event's time forward by the
+      // cycles in between instead, unless that lands further from the anchor
+      // than rounding explains (a clock change, or a gap the counter wrapped).
+      if(have_previous) {
+        const double carried_us = previous_us + static_cast<double>(static_cast<int32_t>(event.cycles - previous_cycles)) /
+                                                    static_cast<double>(anchor.cpu_mhz);
+        if(fabs(carried_us - ts_us) < TRACE_ANCHOR_TOLERANCE_US) {
+          ts_us = carried_us;
+        }
+      }
+      have_previous = true;
+      previous_cycles = event.cycles;
+      previous_us = ts_us;
+
+      size_t tid = 0;
+      while(tid < task_count && tasks[tid] != event.task) {
+        ++tid;
+      }
+      if(tid == task_count && task_count < kMaxTasks) {
+        tasks[task_count] = event.task;
+        task_cores[task_count] = static_cast<uint8_t>(core);
+        task_count++;
+      }
+
+      writer.event_separator();
+      writer.printf("{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%u,\"tid\":%u}",
+                    TRACE_PROBE_NAMES[event.probe],
+                    event.phase == TRACE_PHASE_BEGIN ? 'B' : 'E',
+                    ts_us,
+                    static_cast<unsigned>(core),
+                    static_cast<unsigned>(tid));
+      written++;
+    }
+  }
+
+  for(size_t tid = 0; tid < task_count; ++tid) {
+    const char *name = pcTaskGetName(tasks[tid]);
+    writer.event_separator();
+    writer.printf("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                  static_cast<unsigned>(task_cores[tid]),
+                  static_cast<unsigned>(tid),
+                  name != nullptr ? name : "?");
+  }
+  writer.printf("\n]}\n");
+  writer.flush();
+
+  for(size_t core = 0; core < portNUM_PROCESSORS; ++core) {
+    g_trace_rings[core].head.store(0, std::memory_order_relaxed);
+  }
+  g_trace_enabled.store(true, std::memory_order_release);
+  return written;
+}
+#else
+#define TRACE_SCOPE(probe) do {} while(0)
+#endif
+
+static size_t rom_cache_preferred_bank_limit() {
+  return g_psram_available ? ROM_CACHE_BANK_MAX : ROM_CACHE_BANK_LIMIT_NO_PSRAM;
+}
+
+static size_t rom_cache_preferred_block_size() {
+  return g_psram_available ? ROM_STREAM_BLOCK_SIZE : ROM_BANK_SIZE;
+}
+
+static inline void rom_cache_update_geometry(RomCache *cache) {
+  if(cache == nullptr) {
+    return;
+  }
+
+  cache->bank_mask = 0;
+  cache->bank_shift = 0;
+  cache->bank_shift_valid = 0;
+
+  const size_t block_size = cache->bank_size;
+  if(block_size == 0) {
+    return;
+  }
+
+  if((block_size & (block_size - 1)) == 0) {
+    cache->bank_mask = static_cast<uint32_t>(block_size - 1);
+    cache->bank_shift = static_cast<uint8_t>(__builtin_ctzll(static_cast<unsigned long long>(block_size)));
+    cache->bank_shift_valid = 1;
+  }
+}
+
+static inline uint32_t rom_cache_bank_base(const RomCache *cache, uint32_t bank) {
+  const size_t block_size = cache->bank_size ? cache->bank_size : ROM_STREAM_BLOCK_SIZE;
+  if(cache->bank_shift_valid) {
+    return bank << cache->bank_shift;
+  }
+  return bank * static_cast<uint32_t>(block_size);
+}
+
+struct PaletteState {
+  bool gbc_enabled;
+  uint8_t active_index;
+  bool auto_assigned;
+  bool combo_override;
+  char label[32];
+  // Framebuffer-encoded colours (see panel_pixel_from_rgb565).
+  uint16_t bg_rgb565[4];
+  uint16_t obj0_rgb565[4];
+  uint16_t obj1_rgb565[4];
+};
+
+struct priv_t;
+static void rom_cache_reset(RomCache *cache);
+static bool rom_cache_open(RomCache *cache, const char *path);
+static bool rom_cache_open_memory(RomCache *cache, const uint8_t *data, size_t size);
+static inline uint8_t IRAM_ATTR rom_cache_read(RomCache *cache, uint32_t addr);
+static void rom_cache_close(RomCache *cache);
+static uint8_t rom_cache_cgb_flag(const RomCache *cache);
+static uint8_t* rom_cache_alloc_block(size_t bytes, bool prefer_internal_first);
+static inline int16_t IRAM_ATTR rom_cache_bank_index(const RomCache *cache, const RomCacheBank *bank);
+static void rom_cache_disable_posix(RomCache *cache);
+static bool rom_cache_ensure_file_stream(RomCache *cache);
+static inline void IRAM_ATTR rom_cache_detach_entry(RomCache *cache, int16_t index);
+static inline void IRAM_ATTR rom_cache_attach_front(RomCache *cache, int16_t index, RomCacheSegment segment);
+static inline void IRAM_ATTR rom_cache_touch_hit(RomCache *cache, int16_t index);
+static inline int16_t IRAM_ATTR rom_cache_select_victim(RomCache *cache);
+static inline void rom_cache_update_segment_targets(RomCache *cache);
+static inline void IRAM_ATTR rom_cache_enforce_protected_capacity(RomCache *cache);
+static const char* gbc_palette_name(size_t index);
+static void palette_apply_dmg(PaletteState *palette);
+static void palette_set_label(PaletteState *palette, const char *label);
 static void palette_apply_gbc_index(PaletteState *palette, size_t index,
                                     bool auto_selected,
                                     bool combo_selected);
@@ -916,9 +1918,10 @@ static void palette_configure_for_dmg(struct priv_t *priv);
 static void apply_default_button_mapping();
 static void wait_for_keyboard_release();
 static void show_home_menu();
+#if !ENABLE_NATIVE_BENCH
 static void show_boot_splash();
+#endif
 static void show_options_menu();
-static void show_boot_splash();
 static void show_keymap_menu();
 #if ENABLE_BLUETOOTH_CONTROLLERS
 static void show_bluetooth_menu();
@@ -926,7 +1929,68 @@ static void show_bluetooth_menu();
 #if ENABLE_SOUND
 static void audioSetup();
 static void audioPump();
+static float audio_output_latency_ms();
+static float audio_depth_latency_ms(uint8_t level);
+static void audio_depth_apply_pending();
 static size_t audio_queue_count = 0;
+#if ENABLE_AUDIO_CAPTURE
+static void audio_capture_toggle();
+#endif
+#if ENABLE_AUDIO_ONLY
+static void audio_only_request_toggle();
+#endif
+
+// Audio output ring. The main loop renders each completed frame's audio into
+// `ring`, resampled by `ratio` to hold the fill at `target_buffers`, and
+// audioTask feeds the speaker from it. In audio-clock-master pacing mode the
+// main loop also waits on the ring, so the I2S DMA consumption rate decides
+// when the next frame may run; in video pacing mode only the resampler
+// absorbs the drift between the frame schedule and the I2S clock.
+struct AudioSyncState {
+  int16_t *ring;
+  int16_t *scratch;
+  uint32_t capacity;                // interleaved samples, a power of two
+  uint32_t mask;                    // capacity - 1
+  std::atomic<uint32_t> write_pos;  // free-running interleaved sample counters
+  std::atomic<uint32_t> read_pos;
+  TaskHandle_t emu_task;
+  float target_buffers;             // fill the resampler steers towards
+  float fill_avg;                   // smoothed fill, in speaker buffers
+  float ratio;                      // output/input resampling ratio
+  float frac;                       // fractional output frame carried over
+  uint32_t underruns;
+  uint32_t overruns;                // frames of audio dropped on a full ring
+  uint32_t stalls;
+  bool starving;
+  bool paced;                       // emulation waits on the ring
+  bool active;                      // ring in use; audioTask renders directly otherwise
+};
+
+static AudioSyncState g_audio_sync = {};
+
+// Output buffering depth (an AUDIO_DEPTH_LEVELS index). The main loop's tuner
+// sets `requested`; audioTask restarts the speaker with that DMA layout and
+// then publishes `applied`. `underruns` counts the speaker queue running dry.
+struct AudioDepthState {
+  std::atomic<uint8_t> requested;
+  std::atomic<uint8_t> applied;
+  std::atomic<uint32_t> underruns;
+  bool primed;                      // audioTask: a buffer was queued since the last restart
+  bool dry;
+  uint32_t seen_underruns;          // tuner fields below are main loop only
+  uint32_t last_tick_ms;
+  uint32_t level_since_ms;
+  uint32_t stable_since_ms;
+  uint32_t failed_levels;           // bit per level that underran recently
+  uint32_t last_failure_ms;
+  uint32_t last_slow_ms;            // last frame the emulator fell behind
+  uint32_t slow_underruns;          // underruns blamed on the emulator, not the depth
+  uint32_t steps_up;
+  uint32_t steps_down;
+  bool persist_pending;
+};
+
+static AudioDepthState g_audio_depth = {};
 #endif
 
 // SD card SPI class.
@@ -1024,11 +2088,13 @@ void debugPrint(const char* str) {
 #endif
 }
 
-static void configure_performance_profile() {
+// Pins the CPU clock to `mhz`; with power management enabled the PM limits
+// are pinned too, so the driver doesn't scale it back.
+static void set_cpu_frequency(uint32_t mhz) {
 #if defined(CONFIG_PM_ENABLE) && CONFIG_PM_ENABLE
   esp_pm_config_t pm_config = {
-      .max_freq_mhz = 240,
-      .min_freq_mhz = 240,
+      .max_freq_mhz = static_cast<int>(mhz),
+      .min_freq_mhz = static_cast<int>(mhz),
       .light_sleep_enable = false
   };
   esp_err_t err = esp_pm_configure(&pm_config);
@@ -1036,7 +2102,11 @@ static void configure_performance_profile() {
     Serial.printf("esp_pm_configure failed (%d)\n", static_cast<int>(err));
   }
 #endif
-  setCpuFrequencyMhz(240);
+  setCpuFrequencyMhz(mhz);
+}
+
+static void configure_performance_profile() {
+  set_cpu_frequency(240);
 }
 
 static uint8_t* alloc_gb_buffer(size_t bytes, const char *label, bool prefer_internal_first = false) {
@@ -1080,6 +2150,19 @@ static inline uint16_t rgb888_to_rgb565(uint32_t colour) {
   return (uint16_t)(((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3));
 }
 
+// RGB888 straight to framebuffer encoding; the swapped form is built
+// directly rather than converting and swapping afterwards.
+static inline uint16_t rgb888_to_panel(uint32_t colour) {
+#if ENABLE_NATIVE_PANEL_FORMAT
+  uint16_t r = (colour >> 16) & 0xFF;
+  uint16_t g = (colour >> 8) & 0xFF;
+  uint16_t b = colour & 0xFF;
+  return (uint16_t)(((((g & 0x1C) << 3) | (b >> 3)) << 8) | (r & 0xF8) | (g >> 5));
+#else
+  return rgb888_to_rgb565(colour);
+#endif
+}
+
 static inline uint16_t rgb888_to_gb555(uint32_t colour) {
   const uint16_t r = (colour >> 16) & 0xFF;
   const uint16_t g = (colour >> 8) & 0xFF;
@@ -1120,12 +2203,18 @@ struct priv_t
   uint16_t *framebuffers[2];
   uint32_t framebuffer_row_hash[2][LCD_HEIGHT];
   uint8_t framebuffer_row_dirty[2][LCD_HEIGHT];
+  RowSpan framebuffer_row_span[2][LCD_HEIGHT];
   uint16_t current_frame_dirty_rows;
   uint16_t last_frame_dirty_rows;
   uint8_t write_fb_index;
   bool single_buffer_mode;
   QueueHandle_t frame_queue;
   SemaphoreHandle_t frame_buffer_free[2];
+  uint64_t framebuffer_input_us[2];
+  uint8_t framebuffer_field_mask[2];  // bit 0: even lines drawn, bit 1: odd lines drawn
+  uint8_t render_band_lines;
+  uint8_t render_band_next_line;
+  uint8_t present_sequence;
   size_t cart_ram_size;
   bool cart_ram_dirty;
   bool cart_ram_loaded;
@@ -1213,10 +2302,15 @@ static bool detect_palette_change(struct gb_s *gb, bool frame_completed) {
 }
 
 static inline void apply_frame_skip_policy(struct gb_s *gb,
-                                           bool over_budget,
+                                           const FrameCostSample &sample,
                                            bool frame_completed,
                                            bool interlace_was_active) {
   FrameSkipMode mode = static_cast<FrameSkipMode>(g_settings.frame_skip_mode);
+  // Movies hash every frame, so every line has to be drawn.
+  const bool full_render = input_movie_forces_full_render();
+  if(full_render) {
+    mode = FRAME_SKIP_MODE_DISABLED;
+  }
 
   bool palette_changed = detect_palette_change(gb, frame_completed);
 
@@ -1233,12 +2327,13 @@ static inline void apply_frame_skip_policy(struct gb_s *gb,
     }
   }
 
-  if(palette_changed || mass_dirty) {
+  if(palette_changed || mass_dirty || full_render) {
     request_interlace_cooldown(gb);
   }
 
-  // Always run adaptive logic to maintain interlace and internal state.
-  updateAdaptiveFrameSkip(gb, over_budget, frame_completed);
+  // The controller always runs so its cost model keeps tracking; forced and
+  // disabled modes only take frame skip out of its hands.
+  updatePredictiveFrameControl(gb, sample, frame_completed, mode == FRAME_SKIP_MODE_AUTO);
 
   auto &state = gb->display.frame_skip_state;
 
@@ -1248,21 +2343,11 @@ static inline void apply_frame_skip_policy(struct gb_s *gb,
     case FRAME_SKIP_MODE_FORCED:
       gb->direct.frame_skip = 1;
       state.current_frame_skip = 1;
-      state.over_budget_streak = 0;
-      state.under_budget_streak = 0;
-      state.debounce_frames_remaining = 0;
-      state.frames_since_toggle = 0;
       return;
     case FRAME_SKIP_MODE_DISABLED:
       gb->direct.frame_skip = 0;
       gb->display.frame_skip_count = 0;
       state.current_frame_skip = 0;
-      state.over_budget_streak = 0;
-      state.under_budget_streak = 0;
-      state.debounce_frames_remaining = 0;
-      if(state.frames_since_toggle < state.minimum_active_frames) {
-        state.frames_since_toggle = state.minimum_active_frames;
-      }
       return;
     default:
       g_settings.frame_skip_mode = static_cast<uint8_t>(FRAME_SKIP_MODE_AUTO);
@@ -2199,6 +3284,55 @@ static bool save_state_store_slot(size_t slot_index) {
   return true;
 }
 
+// Copies a saved core over the running one, keeping this session's buffer
+// pointers and callbacks.
+static void save_state_adopt_core(const struct gb_s &core) {
+  struct PointerSnapshot {
+    uint8_t *wram;
+    uint8_t *vram;
+    uint8_t *oam;
+    uint8_t *hram_io;
+    void (*lcd_draw_line)(struct gb_s *, const uint8_t *, const uint_fast8_t);
+    void (*serial_tx)(struct gb_s *, const uint8_t);
+    enum gb_serial_rx_ret_e (*serial_rx)(struct gb_s *, uint8_t *);
+    uint8_t (*bootrom_read)(struct gb_s *, const uint_fast16_t);
+    mbc7_accel_read_t mbc7_accel_read;
+    void *direct_priv;
+  } snapshot = {
+    gb.wram,
+    gb.vram,
+    gb.oam,
+    gb.hram_io,
+    gb.display.lcd_draw_line,
+    gb.gb_serial_tx,
+    gb.gb_serial_rx,
+    gb.gb_bootrom_read,
+    gb.mbc7_accel_read,
+    gb.direct.priv
+  };
+  memcpy(&gb, &core, sizeof(gb));
+  gb.wram = snapshot.wram;
+  gb.vram = snapshot.vram;
+  gb.oam = snapshot.oam;
+  gb.hram_io = snapshot.hram_io;
+  gb.display.lcd_draw_line = snapshot.lcd_draw_line;
+  gb.gb_serial_tx = snapshot.serial_tx;
+  gb.gb_serial_rx = snapshot.serial_rx;
+  gb.gb_bootrom_read = snapshot.bootrom_read;
+  gb.mbc7_accel_read = snapshot.mbc7_accel_read;
+  gb.direct.priv = snapshot.direct_priv;
+  gb.gb_rom_read = &gb_rom_read;
+  gb.gb_cart_ram_read = &gb_cart_ram_read;
+  gb.gb_cart_ram_write = &gb_cart_ram_write;
+  gb.gb_error = &gb_error;
+
+#if ENABLE_MBC7
+  if(gb.mbc == 7) {
+    gb.mbc7_accel_read = mbc7_cardputer_accel_read;
+  }
+#endif
+}
+
 static bool save_state_load_slot(size_t slot_index) {
   if(slot_index >= SAVE_STATE_SLOT_COUNT) {
     return false;
@@ -2291,29 +3425,6 @@ static bool save_state_load_slot(size_t slot_index) {
   }
 
   struct gb_s core_buffer;
-  struct PointerSnapshot {
-    uint8_t *wram;
-    uint8_t *vram;
-    uint8_t *oam;
-    uint8_t *hram_io;
-    void (*lcd_draw_line)(struct gb_s *, const uint8_t *, const uint_fast8_t);
-    void (*serial_tx)(struct gb_s *, const uint8_t);
-    enum gb_serial_rx_ret_e (*serial_rx)(struct gb_s *, uint8_t *);
-    uint8_t (*bootrom_read)(struct gb_s *, const uint_fast16_t);
-    mbc7_accel_read_t mbc7_accel_read;
-    void *direct_priv;
-  } snapshot = {
-    gb.wram,
-    gb.vram,
-    gb.oam,
-    gb.hram_io,
-    gb.display.lcd_draw_line,
-    gb.gb_serial_tx,
-    gb.gb_serial_rx,
-    gb.gb_bootrom_read,
-    gb.mbc7_accel_read,
-    gb.direct.priv
-  };
   bool ok = true;
   auto read_block = [&](void *dest, size_t bytes) {
     if(!ok) {
@@ -2348,27 +3459,7 @@ static bool save_state_load_slot(size_t slot_index) {
     return false;
   }
 
-  memcpy(&gb, &core_buffer, sizeof(gb));
-  gb.wram = snapshot.wram;
-  gb.vram = snapshot.vram;
-  gb.oam = snapshot.oam;
-  gb.hram_io = snapshot.hram_io;
-  gb.display.lcd_draw_line = snapshot.lcd_draw_line;
-  gb.gb_serial_tx = snapshot.serial_tx;
-  gb.gb_serial_rx = snapshot.serial_rx;
-  gb.gb_bootrom_read = snapshot.bootrom_read;
-  gb.mbc7_accel_read = snapshot.mbc7_accel_read;
-  gb.direct.priv = snapshot.direct_priv;
-  gb.gb_rom_read = &gb_rom_read;
-  gb.gb_cart_ram_read = &gb_cart_ram_read;
-  gb.gb_cart_ram_write = &gb_cart_ram_write;
-  gb.gb_error = &gb_error;
-
-#if ENABLE_MBC7
-  if(gb.mbc == 7) {
-    gb.mbc7_accel_read = mbc7_cardputer_accel_read;
-  }
-#endif
+  save_state_adopt_core(core_buffer);
 
   if(priv.cart_ram != nullptr && priv.cart_ram_size > 0) {
     priv.cart_ram_dirty = true;
@@ -2391,6 +3482,7 @@ static bool save_state_load_slot(size_t slot_index) {
   slot.version = header.version;
   slot.timestamp_us = header.timestamp_us;
   slot.cart_ram_size = header.cart_ram_size;
+  g_last_loaded_save_slot = static_cast<int8_t>(slot_index);
 
   char message[48];
   snprintf(message, sizeof(message), "%s loaded", save_state_slot_label(slot_index));
@@ -2449,6 +3541,8 @@ static bool handle_save_state_shortcuts(const Keyboard_Class::KeysState &status)
     }
     if(perform_save) {
       save_state_store_slot(static_cast<size_t>(slot));
+      // The emulator is already stopped for this SD write.
+      save_settings_if_dirty();
       handled = true;
       continue;
     }
@@ -2694,7 +3788,7 @@ static bool capture_screenshot() {
       const size_t src_y = LCD_HEIGHT - 1 - y;
       const uint16_t *src_row = frame_data + (src_y * LCD_WIDTH);
       for(size_t x = 0; x < LCD_WIDTH; ++x) {
-        const uint16_t pixel = src_row[x];
+        const uint16_t pixel = panel_pixel_to_rgb565(src_row[x]);
         const uint8_t r5 = static_cast<uint8_t>((pixel >> 11) & 0x1F);
         const uint8_t g6 = static_cast<uint8_t>((pixel >> 5) & 0x3F);
         const uint8_t b5 = static_cast<uint8_t>(pixel & 0x1F);
@@ -2764,14 +3858,729 @@ static bool handle_screenshot_shortcut(const Keyboard_Class::KeysState &status,
   return false;
 }
 
+#if ENABLE_TRACE_PROBES
+static void dump_trace_probes() {
+  char path[64];
+  bool to_sd = false;
+  if(g_sd_mounted && (SD.exists(TRACE_DIR) || SD.mkdir(TRACE_DIR))) {
+    snprintf(path, sizeof(path), "%s/trace_%lu.json", TRACE_DIR, static_cast<unsigned long>(millis()));
+    to_sd = true;
+  }
 
-static void apply_default_button_mapping() {
-  memcpy(g_settings.button_mapping,
-         DEFAULT_JOYPAD_KEYMAP,
-         sizeof(DEFAULT_JOYPAD_KEYMAP));
-}
-
-static void apply_settings_constraints() {
+  if(to_sd) {
+    File file = SD.open(path, FILE_WRITE);
+    if(file) {
+      const size_t events = trace_dump(file);
+      file.close();
+      Serial.printf("Trace: %u events written to %s\n", static_cast<unsigned>(events), path);
+      show_status_message("Trace saved", StatusMessageKind::Success);
+      return;
+    }
+    Serial.printf("Trace: failed to open %s; dumping to serial\n", path);
+  }
+
+  Serial.println("[TRACE-BEGIN]");
+  const size_t events = trace_dump(Serial);
+  Serial.printf("[TRACE-END] %u events\n", static_cast<unsigned>(events));
+  show_status_message("Trace sent to serial", StatusMessageKind::Success);
+}
+#endif
+
+// Fn+T dumps the trace probe rings. Returns true when the key was consumed.
+static bool handle_trace_shortcut(const Keyboard_Class::KeysState &status) {
+#if ENABLE_TRACE_PROBES
+  static bool hotkey_latched = false;
+  bool has_trigger_key = false;
+  for(char key : status.word) {
+    if(key == 't' || key == 'T') {
+      has_trigger_key = true;
+      break;
+    }
+  }
+  if(status.fn && has_trigger_key) {
+    if(!hotkey_latched) {
+      hotkey_latched = true;
+      dump_trace_probes();
+    }
+    return true;
+  }
+  hotkey_latched = false;
+#else
+  (void)status;
+#endif
+  return false;
+}
+
+// Fn+H shows or hides the performance HUD. Returns true when the key was
+// consumed.
+static bool handle_perf_hud_shortcut(const Keyboard_Class::KeysState &status) {
+#if ENABLE_PERF_HUD
+  static bool hotkey_latched = false;
+  bool has_trigger_key = false;
+  for(char key : status.word) {
+    if(key == 'h' || key == 'H') {
+      has_trigger_key = true;
+      break;
+    }
+  }
+  if(status.fn && has_trigger_key) {
+    if(!hotkey_latched) {
+      hotkey_latched = true;
+      const bool visible = !g_perf_hud_visible.load(std::memory_order_relaxed);
+      g_perf_hud_visible.store(visible, std::memory_order_relaxed);
+      Serial.printf("Perf HUD %s\n", visible ? "on" : "off");
+    }
+    return true;
+  }
+  hotkey_latched = false;
+#else
+  (void)status;
+#endif
+  return false;
+}
+
+// Fn+W starts or stops a WAV capture. Returns true when the key was consumed.
+static bool handle_audio_capture_shortcut(const Keyboard_Class::KeysState &status) {
+#if ENABLE_AUDIO_CAPTURE
+  static bool hotkey_latched = false;
+  bool has_trigger_key = false;
+  for(char key : status.word) {
+    if(key == 'w' || key == 'W') {
+      has_trigger_key = true;
+      break;
+    }
+  }
+  if(status.fn && has_trigger_key) {
+    if(!hotkey_latched) {
+      hotkey_latched = true;
+      audio_capture_toggle();
+    }
+    return true;
+  }
+  hotkey_latched = false;
+#else
+  (void)status;
+#endif
+  return false;
+}
+
+// Fn+B enters or leaves audio-only mode at the next frame boundary. Returns
+// true when the key was consumed.
+static bool handle_audio_only_shortcut(const Keyboard_Class::KeysState &status) {
+#if ENABLE_AUDIO_ONLY
+  static bool hotkey_latched = false;
+  bool has_trigger_key = false;
+  for(char key : status.word) {
+    if(key == 'b' || key == 'B') {
+      has_trigger_key = true;
+      break;
+    }
+  }
+  if(status.fn && has_trigger_key) {
+    if(!hotkey_latched) {
+      hotkey_latched = true;
+      audio_only_request_toggle();
+    }
+    return true;
+  }
+  hotkey_latched = false;
+#else
+  (void)status;
+#endif
+  return false;
+}
+
+// Input movies. Fn+R starts or stops recording the joypad byte each
+// main-loop iteration polls; Fn+Y replays the movie for the running ROM, or
+// cancels a replay. A movie starts from the save-state slot loaded last this
+// session, or from a console reset when none was; a reset start also saves
+// the core and battery RAM it reset with, so a replay starts from the same
+// save and clock. While either runs, frame
+// skip and interlace are held off and every completed frame's row hashes are
+// folded into one hash, so a replay doubles as a rendering regression check.
+static constexpr const char *MOVIE_DIR = "/movies";
+static constexpr uint32_t INPUT_MOVIE_MAGIC = 0x564D4247;      // "GBMV"
+static constexpr uint16_t INPUT_MOVIE_VERSION = 2;
+static constexpr uint32_t FRAME_HASH_FILE_MAGIC = 0x48464247;  // "GBFH"
+static constexpr uint32_t MOVIE_START_FILE_MAGIC = 0x53464247; // "GBFS"
+static constexpr uint8_t INPUT_MOVIE_POWER_ON = 0xFF;
+static constexpr uint16_t INPUT_MOVIE_MAX_RUN = 256;
+static constexpr size_t INPUT_MOVIE_IO_BLOCK = 512;
+
+// File layout: this header, then (joypad, run length - 1) byte pairs.
+struct InputMovieHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint8_t start_slot;          // save-state slot index or INPUT_MOVIE_POWER_ON
+  uint8_t header_checksum;     // ROM header bytes 0x14D-0x14F
+  uint16_t global_checksum;
+  uint16_t reserved;
+  uint64_t slot_timestamp_us;  // the slot's save timestamp when recorded
+  uint32_t start_hash;         // FNV-1a of the .sav payload for power-on starts
+  uint32_t frames;             // main-loop iterations, one joypad byte each
+  uint32_t hashed_frames;      // completed frames in the .fbh file
+  char title[16];
+} __attribute__((packed));
+
+// Power-on start snapshot: this header, the core after the reset (MBC3 clock
+// and MBC7 EEPROM included), then the cartridge RAM.
+struct MovieStartFileHeader {
+  uint32_t magic;
+  uint32_t core_size;
+  uint32_t cart_ram_size;
+} __attribute__((packed));
+
+// File layout: this header, then one uint32_t per completed frame.
+struct FrameHashFileHeader {
+  uint32_t magic;
+  uint32_t frames;
+} __attribute__((packed));
+
+enum class InputMovieMode : uint8_t {
+  Idle = 0,
+  Recording,
+  Replaying
+};
+
+// Sequential file access in whole blocks, so the main loop touches the card
+// once every few hundred frames.
+struct MovieStream {
+  File file;
+  uint8_t block[INPUT_MOVIE_IO_BLOCK];
+  size_t pos;
+  size_t len;
+  bool failed;
+};
+
+struct InputMovieState {
+  InputMovieMode mode;
+  InputMovieHeader header;
+  MovieStream movie;
+  MovieStream hashes;     // hashes written by this run
+  MovieStream reference;  // hashes stored by the recording, read during replay
+  bool reference_open;
+  uint32_t reference_frames;
+  uint32_t frame;
+  uint32_t hashed;
+  uint8_t run_value;
+  uint16_t run_length;
+  uint32_t mismatches;
+  uint32_t first_mismatch;
+  char base_path[MAX_PATH_LEN];
+};
+
+static InputMovieState g_movie;
+
+static bool input_movie_forces_full_render() {
+  return g_movie.mode != InputMovieMode::Idle;
+}
+
+static void movie_stream_open(MovieStream &stream, File file) {
+  stream.file = file;
+  stream.pos = 0;
+  stream.len = 0;
+  stream.failed = !stream.file;
+}
+
+static void movie_stream_flush(MovieStream &stream) {
+  if(stream.len > 0 && !stream.failed && stream.file.write(stream.block, stream.len) != stream.len) {
+    stream.failed = true;
+  }
+  stream.len = 0;
+}
+
+static bool movie_stream_write(MovieStream &stream, const void *data, size_t bytes) {
+  const uint8_t *src = static_cast<const uint8_t *>(data);
+  while(bytes > 0 && !stream.failed) {
+    const size_t chunk = std::min(bytes, INPUT_MOVIE_IO_BLOCK - stream.len);
+    memcpy(stream.block + stream.len, src, chunk);
+    stream.len += chunk;
+    src += chunk;
+    bytes -= chunk;
+    if(stream.len == INPUT_MOVIE_IO_BLOCK) {
+      movie_stream_flush(stream);
+    }
+  }
+  return !stream.failed;
+}
+
+static bool movie_stream_read(MovieStream &stream, void *data, size_t bytes) {
+  uint8_t *dst = static_cast<uint8_t *>(data);
+  while(bytes > 0 && !stream.failed) {
+    if(stream.pos == stream.len) {
+      stream.len = stream.file.read(stream.block, INPUT_MOVIE_IO_BLOCK);
+      stream.pos = 0;
+      if(stream.len == 0) {
+        stream.failed = true;
+        break;
+      }
+    }
+    const size_t chunk = std::min(bytes, stream.len - stream.pos);
+    memcpy(dst, stream.block + stream.pos, chunk);
+    stream.pos += chunk;
+    dst += chunk;
+    bytes -= chunk;
+  }
+  return !stream.failed;
+}
+
+// Flushes a written stream, rewrites its header in place and closes it.
+static bool movie_stream_finish(MovieStream &stream, const void *header, size_t header_bytes) {
+  movie_stream_flush(stream);
+  bool ok = !stream.failed;
+  if(ok && header != nullptr) {
+    ok = stream.file.seek(0) &&
+         stream.file.write(static_cast<const uint8_t *>(header), header_bytes) == header_bytes;
+  }
+  if(stream.file) {
+    stream.file.flush();
+    stream.file.close();
+  }
+  return ok;
+}
+
+static void input_movie_read_rom_id(InputMovieHeader &header) {
+  for(size_t i = 0; i < sizeof(header.title); ++i) {
+    header.title[i] = static_cast<char>(gb.gb_rom_read(&gb, 0x134 + i));
+  }
+  header.header_checksum = gb.gb_rom_read(&gb, 0x14D);
+  header.global_checksum = static_cast<uint16_t>((gb.gb_rom_read(&gb, 0x14E) << 8) | gb.gb_rom_read(&gb, 0x14F));
+}
+
+static bool input_movie_build_base_path(const InputMovieHeader &header, char *out, size_t out_len) {
+  char title[sizeof(header.title) + 1];
+  memcpy(title, header.title, sizeof(header.title));
+  title[sizeof(header.title)] = '\0';
+  char identifier[32];
+  sanitise_identifier(title, identifier, sizeof(identifier));
+  if(identifier[0] == '\0') {
+    strncpy(identifier, "movie", sizeof(identifier) - 1);
+    identifier[sizeof(identifier) - 1] = '\0';
+  }
+  const int written = snprintf(out, out_len, "%s/%s", MOVIE_DIR, identifier);
+  return written > 0 && static_cast<size_t>(written) + 12 < out_len;
+}
+
+static File input_movie_open(const char *base, const char *extension, const char *mode) {
+  char path[MAX_PATH_LEN];
+  snprintf(path, sizeof(path), "%s%s", base, extension);
+  if(mode[0] == 'w') {
+    SD.remove(path);
+  }
+  return SD.open(path, mode);
+}
+
+// Console reset for movies that start at power-on. Work RAM is cleared so
+// the run does not depend on whatever the previous game session left there.
+static void input_movie_power_on() {
+  memset(gb.wram, 0, WRAM_TOTAL_SIZE);
+  memset(gb.vram, 0, VRAM_TOTAL_SIZE);
+  memset(gb.oam, 0, OAM_SIZE);
+  gb_reset(&gb);
+  gb.direct.joypad = 0xFF;
+
+  display_cache_valid = false;
+  memset(priv.framebuffer_row_dirty[0], 1, sizeof(priv.framebuffer_row_dirty[0]));
+  if(!priv.single_buffer_mode) {
+    memset(priv.framebuffer_row_dirty[1], 1, sizeof(priv.framebuffer_row_dirty[1]));
+  }
+  if(swap_fb_enabled) {
+    memset(swap_row_hash, 0, sizeof(swap_row_hash));
+  }
+}
+
+static uint32_t input_movie_hash_bytes(uint32_t hash, const void *data, size_t bytes) {
+  const uint8_t *src = static_cast<const uint8_t *>(data);
+  for(size_t i = 0; i < bytes; ++i) {
+    hash ^= src[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+// Saves the core and cartridge RAM a power-on recording starts from next to
+// the movie, and records their hash in the header.
+static bool input_movie_save_start(InputMovieHeader &header) {
+  File file = input_movie_open(g_movie.base_path, ".sav", FILE_WRITE);
+  if(!file) {
+    return false;
+  }
+  const MovieStartFileHeader start = {MOVIE_START_FILE_MAGIC,
+                                      static_cast<uint32_t>(sizeof(gb)),
+                                      static_cast<uint32_t>(priv.cart_ram_size)};
+  bool ok = file.write(reinterpret_cast<const uint8_t *>(&start), sizeof(start)) == sizeof(start) &&
+            file.write(reinterpret_cast<const uint8_t *>(&gb), sizeof(gb)) == sizeof(gb);
+  uint32_t hash = input_movie_hash_bytes(2166136261u, &gb, sizeof(gb));
+  if(ok && priv.cart_ram_size > 0) {
+    ok = file.write(priv.cart_ram, priv.cart_ram_size) == priv.cart_ram_size;
+    hash = input_movie_hash_bytes(hash, priv.cart_ram, priv.cart_ram_size);
+  }
+  file.close();
+  header.start_hash = hash;
+  return ok;
+}
+
+// Power-on start for a replay: checks the saved start against the movie's
+// hash before touching the console, then resets and puts back the core and
+// cartridge RAM the recording started with.
+static bool input_movie_restore_start(const InputMovieHeader &header) {
+  File file = input_movie_open(g_movie.base_path, ".sav", FILE_READ);
+  MovieStartFileHeader start = {};
+  if(!file || file.read(reinterpret_cast<uint8_t *>(&start), sizeof(start)) != sizeof(start) ||
+     start.magic != MOVIE_START_FILE_MAGIC || start.core_size != sizeof(gb) ||
+     start.cart_ram_size != priv.cart_ram_size) {
+    file.close();
+    Serial.printf("Movie: %s.sav is missing or from another build\n", g_movie.base_path);
+    show_status_message("Replay: start save missing", StatusMessageKind::Error);
+    return false;
+  }
+
+  uint8_t block[INPUT_MOVIE_IO_BLOCK];
+  uint32_t hash = 2166136261u;
+  size_t remaining = sizeof(gb) + priv.cart_ram_size;
+  while(remaining > 0) {
+    const size_t chunk = std::min(remaining, INPUT_MOVIE_IO_BLOCK);
+    if(file.read(block, chunk) != static_cast<int>(chunk)) {
+      break;
+    }
+    hash = input_movie_hash_bytes(hash, block, chunk);
+    remaining -= chunk;
+  }
+  if(remaining != 0 || hash != header.start_hash) {
+    file.close();
+    Serial.printf("Movie: %s.sav does not match the movie\n", g_movie.base_path);
+    show_status_message("Replay: start save changed", StatusMessageKind::Error);
+    return false;
+  }
+
+  struct gb_s core;
+  bool ok = file.seek(sizeof(start)) &&
+            file.read(reinterpret_cast<uint8_t *>(&core), sizeof(core)) == static_cast<int>(sizeof(core));
+  if(ok && priv.cart_ram_size > 0) {
+    ok = file.read(priv.cart_ram, priv.cart_ram_size) == static_cast<int>(priv.cart_ram_size);
+  }
+  file.close();
+  if(!ok) {
+    Serial.printf("Movie: %s.sav read failed\n", g_movie.base_path);
+    show_status_message("Replay: start save unreadable", StatusMessageKind::Error);
+    return false;
+  }
+
+  input_movie_power_on();
+  save_state_adopt_core(core);
+  gb.direct.joypad = 0xFF;
+  if(priv.cart_ram_size > 0) {
+    priv.cart_ram_dirty = true;
+    priv.cart_ram_loaded = true;
+    priv.cart_ram_last_flush_ms = millis();
+  }
+  return true;
+}
+
+// Puts the console where the movie starts and clears per-run state.
+static bool input_movie_rewind(const InputMovieHeader &header, bool replay) {
+  if(header.start_slot == INPUT_MOVIE_POWER_ON) {
+    if(!replay) {
+      input_movie_power_on();
+    } else if(!input_movie_restore_start(header)) {
+      return false;
+    }
+  } else {
+    if(!save_state_load_slot(header.start_slot)) {
+      return false;
+    }
+    if(replay && priv.save_slots[header.start_slot].timestamp_us != header.slot_timestamp_us) {
+      Serial.printf("Movie: %s was saved again after recording\n", save_state_slot_label(header.start_slot));
+      show_status_message("Replay: start slot changed", StatusMessageKind::Error);
+      return false;
+    }
+  }
+  gb.direct.frame_skip = 0;
+  gb.display.frame_skip_count = 0;
+  request_interlace_cooldown(&gb);
+
+  g_movie.frame = 0;
+  g_movie.hashed = 0;
+  g_movie.run_value = 0xFF;
+  g_movie.run_length = 0;
+  g_movie.mismatches = 0;
+  g_movie.first_mismatch = 0;
+  return true;
+}
+
+static void input_movie_close_all() {
+  g_movie.movie.file.close();
+  g_movie.hashes.file.close();
+  g_movie.reference.file.close();
+  g_movie.reference_open = false;
+  g_movie.mode = InputMovieMode::Idle;
+}
+
+static void input_movie_start_recording() {
+  if(!ensure_sd_card(false) || (!SD.exists(MOVIE_DIR) && !SD.mkdir(MOVIE_DIR))) {
+    show_status_message("Record failed: SD required", StatusMessageKind::Error);
+    return;
+  }
+
+  InputMovieHeader &header = g_movie.header;
+  header = {};
+  header.magic = INPUT_MOVIE_MAGIC;
+  header.version = INPUT_MOVIE_VERSION;
+  header.start_slot = g_last_loaded_save_slot >= 0 ? static_cast<uint8_t>(g_last_loaded_save_slot)
+                                                    : INPUT_MOVIE_POWER_ON;
+  input_movie_read_rom_id(header);
+  if(!input_movie_build_base_path(header, g_movie.base_path, sizeof(g_movie.base_path))) {
+    show_status_message("Record failed: path error", StatusMessageKind::Error);
+    return;
+  }
+
+  if(!input_movie_rewind(header, false)) {
+    return;
+  }
+  if(header.start_slot != INPUT_MOVIE_POWER_ON) {
+    header.slot_timestamp_us = priv.save_slots[header.start_slot].timestamp_us;
+  } else if(!input_movie_save_start(header)) {
+    Serial.printf("Movie: cannot create %s.sav\n", g_movie.base_path);
+    show_status_message("Record failed: SD write", StatusMessageKind::Error);
+    return;
+  }
+
+  movie_stream_open(g_movie.movie, input_movie_open(g_movie.base_path, ".gbm", FILE_WRITE));
+  movie_stream_open(g_movie.hashes, input_movie_open(g_movie.base_path, ".fbh", FILE_WRITE));
+  const FrameHashFileHeader hash_header = {FRAME_HASH_FILE_MAGIC, 0};
+  if(!movie_stream_write(g_movie.movie, &header, sizeof(header)) ||
+     !movie_stream_write(g_movie.hashes, &hash_header, sizeof(hash_header))) {
+    input_movie_close_all();
+    Serial.printf("Movie: cannot create %s.gbm\n", g_movie.base_path);
+    show_status_message("Record failed: SD write", StatusMessageKind::Error);
+    return;
+  }
+
+  g_movie.mode = InputMovieMode::Recording;
+  Serial.printf("Movie: recording %s.gbm from %s\n",
+                g_movie.base_path,
+                header.start_slot == INPUT_MOVIE_POWER_ON ? "power-on" : save_state_slot_label(header.start_slot));
+  show_status_message("Recording movie", StatusMessageKind::Info);
+}
+
+static void input_movie_stop_recording() {
+  if(g_movie.run_length > 0) {
+    const uint8_t run[2] = {g_movie.run_value, static_cast<uint8_t>(g_movie.run_length - 1)};
+    movie_stream_write(g_movie.movie, run, sizeof(run));
+  }
+  g_movie.header.frames = g_movie.frame;
+  g_movie.header.hashed_frames = g_movie.hashed;
+  const FrameHashFileHeader hash_header = {FRAME_HASH_FILE_MAGIC, g_movie.hashed};
+  const bool movie_ok = movie_stream_finish(g_movie.movie, &g_movie.header, sizeof(g_movie.header));
+  const bool hashes_ok = movie_stream_finish(g_movie.hashes, &hash_header, sizeof(hash_header));
+  input_movie_close_all();
+
+  if(!movie_ok) {
+    Serial.printf("Movie: write failed for %s.gbm\n", g_movie.base_path);
+    show_status_message("Movie write failed", StatusMessageKind::Error);
+    return;
+  }
+  Serial.printf("Movie: recorded %lu frames (%lu hashed%s) to %s.gbm\n",
+                static_cast<unsigned long>(g_movie.frame),
+                static_cast<unsigned long>(g_movie.hashed),
+                hashes_ok ? "" : ", hash file failed",
+                g_movie.base_path);
+  show_status_message("Movie saved", StatusMessageKind::Success);
+}
+
+static void input_movie_start_replay() {
+  if(!ensure_sd_card(false)) {
+    show_status_message("Replay failed: SD required", StatusMessageKind::Error);
+    return;
+  }
+
+  InputMovieHeader current = {};
+  input_movie_read_rom_id(current);
+  if(!input_movie_build_base_path(current, g_movie.base_path, sizeof(g_movie.base_path))) {
+    show_status_message("Replay failed: path error", StatusMessageKind::Error);
+    return;
+  }
+
+  InputMovieHeader &header = g_movie.header;
+  movie_stream_open(g_movie.movie, input_movie_open(g_movie.base_path, ".gbm", FILE_READ));
+  if(!movie_stream_read(g_movie.movie, &header, sizeof(header))) {
+    input_movie_close_all();
+    show_status_message("No movie for this ROM", StatusMessageKind::Info);
+    return;
+  }
+  if(header.magic != INPUT_MOVIE_MAGIC || header.version != INPUT_MOVIE_VERSION ||
+     header.header_checksum != current.header_checksum || header.global_checksum != current.global_checksum ||
+     (header.start_slot != INPUT_MOVIE_POWER_ON && header.start_slot >= SAVE_STATE_SLOT_COUNT)) {
+    input_movie_close_all();
+    Serial.printf("Movie: %s.gbm is not a movie for this ROM\n", g_movie.base_path);
+    show_status_message("Replay: movie mismatch", StatusMessageKind::Error);
+    return;
+  }
+
+  movie_stream_open(g_movie.reference, input_movie_open(g_movie.base_path, ".fbh", FILE_READ));
+  FrameHashFileHeader reference_header = {};
+  g_movie.reference_open = movie_stream_read(g_movie.reference, &reference_header, sizeof(reference_header)) &&
+                           reference_header.magic == FRAME_HASH_FILE_MAGIC;
+  g_movie.reference_frames = g_movie.reference_open ? reference_header.frames : 0;
+  if(!g_movie.reference_open) {
+    g_movie.reference.file.close();
+  }
+
+  if(!input_movie_rewind(header, true)) {
+    input_movie_close_all();
+    return;
+  }
+
+  movie_stream_open(g_movie.hashes, input_movie_open(g_movie.base_path, ".replay.fbh", FILE_WRITE));
+  const FrameHashFileHeader hash_header = {FRAME_HASH_FILE_MAGIC, 0};
+  movie_stream_write(g_movie.hashes, &hash_header, sizeof(hash_header));
+
+  g_movie.mode = InputMovieMode::Replaying;
+  Serial.printf("Movie: replaying %lu frames from %s.gbm (%s reference hashes)\n",
+                static_cast<unsigned long>(header.frames),
+                g_movie.base_path,
+                g_movie.reference_open ? "with" : "no");
+  show_status_message("Replaying movie", StatusMessageKind::Info);
+}
+
+static void input_movie_stop_replay(bool completed) {
+  const FrameHashFileHeader hash_header = {FRAME_HASH_FILE_MAGIC, g_movie.hashed};
+  movie_stream_finish(g_movie.hashes, &hash_header, sizeof(hash_header));
+  input_movie_close_all();
+
+  if(!completed) {
+    Serial.printf("Movie: replay stopped at frame %lu\n", static_cast<unsigned long>(g_movie.frame));
+    show_status_message("Replay stopped", StatusMessageKind::Info);
+    return;
+  }
+  if(g_movie.mismatches == 0) {
+    Serial.printf("Movie: replay done, %lu frames, %lu/%lu hashes match\n",
+                  static_cast<unsigned long>(g_movie.frame),
+                  static_cast<unsigned long>(std::min(g_movie.hashed, g_movie.reference_frames)),
+                  static_cast<unsigned long>(g_movie.reference_frames));
+    show_status_message("Replay OK", StatusMessageKind::Success);
+    return;
+  }
+  Serial.printf("Movie: replay done, %lu frames, %lu hash mismatches (first at frame %lu)\n",
+                static_cast<unsigned long>(g_movie.frame),
+                static_cast<unsigned long>(g_movie.mismatches),
+                static_cast<unsigned long>(g_movie.first_mismatch));
+  show_status_message("Replay: frames differ", StatusMessageKind::Error);
+}
+
+// Called at the end of poll_keyboard: logs the polled joypad byte, or
+// replaces it with the recorded one.
+static void input_movie_poll() {
+  if(g_movie.mode == InputMovieMode::Recording) {
+    const uint8_t value = gb.direct.joypad;
+    if(g_movie.run_length > 0 && (value != g_movie.run_value || g_movie.run_length == INPUT_MOVIE_MAX_RUN)) {
+      const uint8_t run[2] = {g_movie.run_value, static_cast<uint8_t>(g_movie.run_length - 1)};
+      if(!movie_stream_write(g_movie.movie, run, sizeof(run))) {
+        Serial.println("Movie: SD write failed; recording stopped");
+        input_movie_stop_recording();
+        return;
+      }
+      g_movie.run_length = 0;
+    }
+    g_movie.run_value = value;
+    g_movie.run_length++;
+    g_movie.frame++;
+  } else if(g_movie.mode == InputMovieMode::Replaying) {
+    if(g_movie.frame >= g_movie.header.frames) {
+      input_movie_stop_replay(true);
+      return;
+    }
+    if(g_movie.run_length == 0) {
+      uint8_t run[2];
+      if(!movie_stream_read(g_movie.movie, run, sizeof(run))) {
+        Serial.println("Movie: file ended early");
+        input_movie_stop_replay(false);
+        return;
+      }
+      g_movie.run_value = run[0];
+      g_movie.run_length = static_cast<uint16_t>(run[1]) + 1;
+    }
+    gb.direct.joypad = g_movie.run_value;
+    g_movie.run_length--;
+    g_movie.frame++;
+  }
+}
+
+// Called for each completed frame with the row hashes lcd_draw_line left in
+// the framebuffer that was just drawn.
+static void input_movie_frame_completed(const uint32_t *row_hash) {
+  if(g_movie.mode == InputMovieMode::Idle) {
+    return;
+  }
+  uint32_t hash = 2166136261u;
+  for(uint16_t row = 0; row < LCD_HEIGHT; ++row) {
+    hash ^= row_hash[row];
+    hash *= 16777619u;
+  }
+  movie_stream_write(g_movie.hashes, &hash, sizeof(hash));
+
+  if(g_movie.mode == InputMovieMode::Replaying && g_movie.reference_open &&
+     g_movie.hashed < g_movie.reference_frames) {
+    uint32_t expected = 0;
+    if(!movie_stream_read(g_movie.reference, &expected, sizeof(expected))) {
+      g_movie.reference_open = false;
+    } else if(expected != hash) {
+      if(g_movie.mismatches == 0) {
+        g_movie.first_mismatch = g_movie.hashed;
+        Serial.printf("Movie: frame %lu hash %08lx, recorded %08lx\n",
+                      static_cast<unsigned long>(g_movie.hashed),
+                      static_cast<unsigned long>(hash),
+                      static_cast<unsigned long>(expected));
+      }
+      g_movie.mismatches++;
+    }
+  }
+  g_movie.hashed++;
+}
+
+// Fn+R toggles recording, Fn+Y starts or cancels a replay. Returns true when
+// the keys were consumed.
+static bool handle_movie_shortcut(const Keyboard_Class::KeysState &status) {
+  static bool hotkey_latched = false;
+  bool record_key = false;
+  bool replay_key = false;
+  for(char key : status.word) {
+    if(key == 'r' || key == 'R') {
+      record_key = true;
+    } else if(key == 'y' || key == 'Y') {
+      replay_key = true;
+    }
+  }
+  if(!status.fn || (!record_key && !replay_key)) {
+    hotkey_latched = false;
+    return false;
+  }
+  if(hotkey_latched) {
+    return true;
+  }
+  hotkey_latched = true;
+
+  if(record_key) {
+    if(g_movie.mode == InputMovieMode::Recording) {
+      input_movie_stop_recording();
+    } else if(g_movie.mode == InputMovieMode::Idle) {
+      input_movie_start_recording();
+    }
+  } else if(g_movie.mode == InputMovieMode::Replaying) {
+    input_movie_stop_replay(false);
+  } else if(g_movie.mode == InputMovieMode::Idle) {
+    input_movie_start_replay();
+  }
+  return true;
+}
+
+static void apply_default_button_mapping() {
+  memcpy(g_settings.button_mapping,
+         DEFAULT_JOYPAD_KEYMAP,
+         sizeof(DEFAULT_JOYPAD_KEYMAP));
+}
+
+static void apply_settings_constraints() {
   const uint8_t min_banks = 1;
   if(g_settings.rom_cache_banks < min_banks) {
     g_settings.rom_cache_banks = min_banks;
@@ -2792,6 +4601,21 @@ static void apply_settings_constraints() {
   if(g_settings.frame_skip_mode >= FRAME_SKIP_MODE_COUNT) {
     g_settings.frame_skip_mode = static_cast<uint8_t>(FRAME_SKIP_MODE_AUTO);
   }
+  if(g_settings.render_band_lines != 0 &&
+     g_settings.render_band_lines != RENDER_BAND_LINES_SMALL &&
+     g_settings.render_band_lines != RENDER_BAND_LINES_LARGE) {
+    g_settings.render_band_lines = 0;
+  }
+  if(g_settings.pacing_mode >= PACING_MODE_COUNT) {
+    g_settings.pacing_mode = static_cast<uint8_t>(PACING_MODE_VIDEO);
+  }
+  const uint8_t depth_limit = g_psram_available ? AUDIO_DEPTH_LEVEL_COUNT - 1 : AUDIO_DEPTH_MAX_LEVEL_NO_PSRAM;
+  if(g_settings.audio_depth > depth_limit) {
+    g_settings.audio_depth = depth_limit;
+  }
+  if(g_settings.audio_quality >= AUDIO_QUALITY_MODE_COUNT) {
+    g_settings.audio_quality = static_cast<uint8_t>(AUDIO_QUALITY_MODE_FAST);
+  }
 }
 
 static bool ensure_settings_dir() {
@@ -2832,6 +4656,10 @@ static bool save_settings_to_sd() {
   file.printf("cache=%u\n", static_cast<unsigned>(g_settings.rom_cache_banks));
   file.printf("volume=%u\n", static_cast<unsigned>(g_settings.master_volume));
   file.printf("frame_skip=%u\n", static_cast<unsigned>(g_settings.frame_skip_mode));
+  file.printf("render_bands=%u\n", static_cast<unsigned>(g_settings.render_band_lines));
+  file.printf("pacing=%u\n", static_cast<unsigned>(g_settings.pacing_mode));
+  file.printf("audio_depth=%u\n", static_cast<unsigned>(g_settings.audio_depth));
+  file.printf("audio_quality=%u\n", static_cast<unsigned>(g_settings.audio_quality));
   file.print("keys=");
   for(size_t i = 0; i < JOYPAD_BUTTON_COUNT; ++i) {
     file.printf("0x%02X", static_cast<unsigned>(g_settings.button_mapping[i]));
@@ -2848,6 +4676,14 @@ static bool save_settings_to_sd() {
   return true;
 }
 
+// Writes settings changed in the background (audio depth tuner, ROM cache
+// recovery) at a point where an SD stall is not heard or seen.
+static void save_settings_if_dirty() {
+  if(g_settings_dirty && g_sd_mounted) {
+    save_settings_to_sd();
+  }
+}
+
 static bool load_settings_from_sd() {
   if(!g_sd_mounted) {
     return false;
@@ -2917,6 +4753,30 @@ static bool load_settings_from_sd() {
         parsed = FRAME_SKIP_MODE_AUTO;
       }
       g_settings.frame_skip_mode = static_cast<uint8_t>(parsed);
+    } else if(key == "render_bands") {
+      long parsed = value.toInt();
+      if(parsed < 0 || parsed > 255) {
+        parsed = 0;
+      }
+      g_settings.render_band_lines = static_cast<uint8_t>(parsed);
+    } else if(key == "pacing") {
+      long parsed = value.toInt();
+      if(parsed < 0 || parsed >= PACING_MODE_COUNT) {
+        parsed = PACING_MODE_VIDEO;
+      }
+      g_settings.pacing_mode = static_cast<uint8_t>(parsed);
+    } else if(key == "audio_depth") {
+      long parsed = value.toInt();
+      if(parsed < 0 || parsed >= AUDIO_DEPTH_LEVEL_COUNT) {
+        parsed = 0;
+      }
+      g_settings.audio_depth = static_cast<uint8_t>(parsed);
+    } else if(key == "audio_quality") {
+      long parsed = value.toInt();
+      if(parsed < 0 || parsed >= AUDIO_QUALITY_MODE_COUNT) {
+        parsed = AUDIO_QUALITY_MODE_FAST;
+      }
+      g_settings.audio_quality = static_cast<uint8_t>(parsed);
     } else if(key == "keys") {
       size_t index = 0;
       int start = 0;
@@ -3260,6 +5120,7 @@ static bool load_cart_ram_from_sd(struct priv_t *priv) {
 }
 
 static bool save_cart_ram_to_sd(const struct priv_t *priv) {
+  TRACE_SCOPE(TRACE_PROBE_SAVE_CART_RAM);
   if(priv == nullptr || priv->cart_ram == nullptr || priv->cart_ram_size == 0) {
     return false;
   }
@@ -3511,6 +5372,11 @@ static void poll_keyboard() {
   handle_save_state_shortcuts(status);
   bool consume_screenshot_key = false;
   handle_screenshot_shortcut(status, &consume_screenshot_key);
+  const bool consume_trace_key = handle_trace_shortcut(status);
+  const bool consume_hud_key = handle_perf_hud_shortcut(status);
+  const bool consume_movie_key = handle_movie_shortcut(status);
+  const bool consume_capture_key = handle_audio_capture_shortcut(status);
+  const bool consume_audio_only_key = handle_audio_only_shortcut(status);
   const bool local_keyboard_pressed = M5Cardputer.Keyboard.isPressed();
 
 #if ENABLE_BLUETOOTH_CONTROLLERS
@@ -3579,6 +5445,21 @@ static void poll_keyboard() {
       if(consume_screenshot_key && (key == 'p' || key == 'P')) {
         continue;
       }
+      if(consume_trace_key && (key == 't' || key == 'T')) {
+        continue;
+      }
+      if(consume_hud_key && (key == 'h' || key == 'H')) {
+        continue;
+      }
+      if(consume_movie_key && (key == 'r' || key == 'R' || key == 'y' || key == 'Y')) {
+        continue;
+      }
+      if(consume_capture_key && (key == 'w' || key == 'W')) {
+        continue;
+      }
+      if(consume_audio_only_key && (key == 'b' || key == 'B')) {
+        continue;
+      }
       if((save_hotkeys_active || load_hotkeys_active) && save_state_slot_from_key(key) >= 0) {
         continue;
       }
@@ -3597,6 +5478,8 @@ static void poll_keyboard() {
     }
   });
 #endif
+
+  input_movie_poll();
 }
 
 static void poll_keyboard();
@@ -4320,6 +6203,7 @@ static size_t rom_cache_restore_banks(RomCache *cache, size_t desired_count) {
 }
 
 static bool rom_cache_fill_bank(RomCache *cache, RomCacheBank *slot, uint32_t bank) {
+  TRACE_SCOPE(TRACE_PROBE_ROM_FILL_BANK);
   if(cache == nullptr || slot == nullptr) {
     return false;
   }
@@ -4363,8 +6247,10 @@ static bool rom_cache_fill_bank(RomCache *cache, RomCacheBank *slot, uint32_t ba
   size_t to_read = remaining > block_size ? block_size : remaining;
   size_t read_total = 0;
 
-#if ENABLE_PROFILING
+#if ENABLE_PROFILING || ENABLE_FRAME_HISTOGRAMS
   const uint64_t load_start_us = micros64();
+#endif
+#if ENABLE_PROFILING
   bool profile_posix_attempted = false;
   bool profile_posix_success = false;
   bool profile_posix_disabled = false;
@@ -4439,6 +6325,9 @@ static bool rom_cache_fill_bank(RomCache *cache, RomCacheBank *slot, uint32_t ba
   slot->bank_number = bank;
   slot->valid = true;
 
+#if ENABLE_FRAME_HISTOGRAMS
+  frame_hist_add_shared(g_rom_load_hist, micros64() - load_start_us);
+#endif
 #if ENABLE_PROFILING
   profiler_track_rom_load(micros64() - load_start_us,
                           profile_posix_attempted,
@@ -4530,8 +6419,10 @@ static bool rom_cache_open(RomCache *cache, const char *path) {
   const size_t to_read = cache->size > cache->bank_size ? cache->bank_size : cache->size;
   memset(cache->bank0, 0xFF, cache->bank_size);
 
-#if ENABLE_PROFILING
+#if ENABLE_PROFILING || ENABLE_FRAME_HISTOGRAMS
   const uint64_t bank0_start_us = micros64();
+#endif
+#if ENABLE_PROFILING
   bool profile_posix_attempted = false;
   bool profile_posix_success = false;
   bool profile_posix_disabled = false;
@@ -4607,6 +6498,9 @@ static bool rom_cache_open(RomCache *cache, const char *path) {
   cache->hot_bank_ptr = cache->bank0;
   cache->hot_bank_base = rom_cache_bank_base(cache, 0);
 
+#if ENABLE_FRAME_HISTOGRAMS
+  frame_hist_add_shared(g_rom_load_hist, micros64() - bank0_start_us);
+#endif
 #if ENABLE_PROFILING
   profiler_track_rom_load(micros64() - bank0_start_us,
                           profile_posix_attempted,
@@ -5563,9 +7457,9 @@ static void palette_apply_dmg(PaletteState *palette) {
   palette_set_label(palette, "DMG Default");
 
   for(size_t i = 0; i < 4; ++i) {
-    palette->bg_rgb565[i] = DMG_DEFAULT_PALETTE_RGB565[i];
-    palette->obj0_rgb565[i] = DMG_DEFAULT_PALETTE_RGB565[i];
-    palette->obj1_rgb565[i] = DMG_DEFAULT_PALETTE_RGB565[i];
+    palette->bg_rgb565[i] = DMG_DEFAULT_PALETTE_PANEL[i];
+    palette->obj0_rgb565[i] = DMG_DEFAULT_PALETTE_PANEL[i];
+    palette->obj1_rgb565[i] = DMG_DEFAULT_PALETTE_PANEL[i];
   }
 }
 
@@ -5590,9 +7484,9 @@ static void palette_apply_gbc_index(PaletteState *palette,
   palette_set_label(palette, gbc_palette_name(index));
 
   for(size_t i = 0; i < 4; ++i) {
-    const uint16_t bg = rgb888_to_rgb565(GBC_PALETTES[base + i]);
-    const uint16_t obj0 = rgb888_to_rgb565(GBC_PALETTES[base + 4 + i]);
-    const uint16_t obj1 = rgb888_to_rgb565(GBC_PALETTES[base + 8 + i]);
+    const uint16_t bg = rgb888_to_panel(GBC_PALETTES[base + i]);
+    const uint16_t obj0 = rgb888_to_panel(GBC_PALETTES[base + 4 + i]);
+    const uint16_t obj1 = rgb888_to_panel(GBC_PALETTES[base + 8 + i]);
     palette->bg_rgb565[i] = bg;
     palette->obj0_rgb565[i] = obj0;
     palette->obj1_rgb565[i] = obj1;
@@ -5615,9 +7509,9 @@ static void palette_apply_bootstrap(PaletteState *palette,
   palette->combo_override = combo_selected;
 
   for(size_t i = 0; i < 4; ++i) {
-    const uint16_t bg = rgb888_to_rgb565(colours[i]);
-    const uint16_t obj0 = rgb888_to_rgb565(colours[4 + i]);
-    const uint16_t obj1 = rgb888_to_rgb565(colours[8 + i]);
+    const uint16_t bg = rgb888_to_panel(colours[i]);
+    const uint16_t obj0 = rgb888_to_panel(colours[4 + i]);
+    const uint16_t obj1 = rgb888_to_panel(colours[8 + i]);
     palette->bg_rgb565[i] = bg;
     palette->obj0_rgb565[i] = obj0;
     palette->obj1_rgb565[i] = obj1;
@@ -6017,12 +7911,79 @@ void gb_error(struct gb_s *gb, const enum gb_error_e gb_err, const uint16_t val)
 }
 
 #if ENABLE_LCD
+/**
+ * Hands completed source lines to renderTask in bands so the top of the
+ * frame reaches the panel while the core is still drawing the bottom.
+ */
+static inline void render_band_notify(struct priv_t *priv, const uint_fast8_t line) {
+  const uint8_t band_lines = priv->render_band_lines;
+  if(band_lines == 0 || priv->frame_queue == nullptr) {
+    return;
+  }
+  const unsigned int ready = static_cast<unsigned int>(line) + 1;
+  if(ready < priv->render_band_next_line || ready >= LCD_HEIGHT) {
+    return;
+  }
+  // Interlaced fields only draw every other line, so advance to the next band
+  // boundary rather than expecting an exact multiple.
+  priv->render_band_next_line = static_cast<uint8_t>(((ready / band_lines) + 1) * band_lines);
+
+  FrameRenderMessage message;
+  message.fb_index = priv->write_fb_index;
+  message.ready_lines = static_cast<uint8_t>(ready);
+  message.flags = 0;
+  message.sequence = priv->present_sequence;
+  // Never stall the core: a dropped band is covered by the next one.
+  xQueueSend(priv->frame_queue, &message, 0);
+}
+
+// Record which columns of `line` differ from the previous frame, which lives
+// in the other framebuffer, so the presenter can flush a narrower window.
+static inline void record_row_span(struct priv_t *priv,
+                                   const uint_fast8_t line,
+                                   const uint16_t *row,
+                                   uint32_t hash) {
+  RowSpan &span = priv->framebuffer_row_span[priv->write_fb_index][line];
+  span.first = 0;
+  span.last = LCD_WIDTH - 1;
+  if(priv->single_buffer_mode) {
+    return;
+  }
+  const uint8_t other = priv->write_fb_index ^ 1;
+  const uint16_t *previous_fb = priv->framebuffers[other];
+  if(previous_fb == nullptr) {
+    return;
+  }
+  if(priv->framebuffer_row_hash[other][line] == hash) {
+    span.first = 1;
+    span.last = 0;
+    return;
+  }
+  const uint16_t *previous = previous_fb + (line * LCD_WIDTH);
+  unsigned int first = 0;
+  while(first < LCD_WIDTH && row[first] == previous[first]) {
+    first++;
+  }
+  if(first == LCD_WIDTH) {
+    span.first = 1;
+    span.last = 0;
+    return;
+  }
+  unsigned int last = LCD_WIDTH - 1;
+  while(last > first && row[last] == previous[last]) {
+    last--;
+  }
+  span.first = static_cast<uint8_t>(first);
+  span.last = static_cast<uint8_t>(last);
+}
+
 /**
  * Draws scanline into framebuffer - OPTIMIZED with RGB565 LUT
  */
 void lcd_draw_line(struct gb_s *gb, const uint8_t pixels[160],
 		   const uint_fast8_t line)
 {
+  TRACE_SCOPE(TRACE_PROBE_LCD_DRAW_LINE);
   struct priv_t *priv = (priv_t*)gb->direct.priv;
 
   uint16_t *active_fb = priv->framebuffers[priv->write_fb_index];
@@ -6034,6 +7995,8 @@ void lcd_draw_line(struct gb_s *gb, const uint8_t pixels[160],
     return;
   }
 
+  priv->framebuffer_field_mask[priv->write_fb_index] |= static_cast<uint8_t>(1u << (line & 1u));
+
   uint32_t *row_hash = priv->framebuffer_row_hash[priv->write_fb_index];
   uint8_t *row_dirty = priv->framebuffer_row_dirty[priv->write_fb_index];
   uint32_t previous_hash = 0;
@@ -6048,10 +8011,10 @@ void lcd_draw_line(struct gb_s *gb, const uint8_t pixels[160],
     uint32_t *cgb_line = gb->display.cgb_line;
     
     for(unsigned int x = 0; x < LCD_WIDTH; x += 4) {
-      uint16_t c0 = rgb888_to_rgb565(cgb_line[x]);
-      uint16_t c1 = rgb888_to_rgb565(cgb_line[x+1]);
-      uint16_t c2 = rgb888_to_rgb565(cgb_line[x+2]);
-      uint16_t c3 = rgb888_to_rgb565(cgb_line[x+3]);
+      uint16_t c0 = rgb888_to_panel(cgb_line[x]);
+      uint16_t c1 = rgb888_to_panel(cgb_line[x+1]);
+      uint16_t c2 = rgb888_to_panel(cgb_line[x+2]);
+      uint16_t c3 = rgb888_to_panel(cgb_line[x+3]);
       dst[x] = c0;
       dst[x+1] = c1;
       dst[x+2] = c2;
@@ -6070,6 +8033,8 @@ void lcd_draw_line(struct gb_s *gb, const uint8_t pixels[160],
     if(row_dirty != nullptr && row_dirty[line] != 0 && priv->current_frame_dirty_rows < LCD_HEIGHT) {
       priv->current_frame_dirty_rows++;
     }
+    record_row_span(priv, line, dst, hash);
+    render_band_notify(priv, line);
     return;
   }
 
@@ -6097,6 +8062,8 @@ void lcd_draw_line(struct gb_s *gb, const uint8_t pixels[160],
     if(row_dirty != nullptr) {
       row_dirty[line] = (hash != previous_hash) ? 1 : 0;
     }
+    record_row_span(priv, line, dst, hash);
+    render_band_notify(priv, line);
     return;
   }
 #endif
@@ -6104,7 +8071,7 @@ void lcd_draw_line(struct gb_s *gb, const uint8_t pixels[160],
   // Simple DMG with LUT - unrolled loop
   const uint16_t *bg_lut = priv->palette.bg_rgb565;
   if(bg_lut == nullptr) {
-    bg_lut = DMG_DEFAULT_PALETTE_RGB565;
+    bg_lut = DMG_DEFAULT_PALETTE_PANEL;
   }
   for(unsigned int x = 0; x < LCD_WIDTH; x += 4) {
     uint16_t c0 = bg_lut[pixels[x] & LCD_COLOUR];
@@ -6130,13 +8097,25 @@ void lcd_draw_line(struct gb_s *gb, const uint8_t pixels[160],
   if(row_dirty != nullptr && row_dirty[line] != 0 && priv->current_frame_dirty_rows < LCD_HEIGHT) {
     priv->current_frame_dirty_rows++;
   }
+  record_row_span(priv, line, dst, hash);
+  render_band_notify(priv, line);
 }
 
 #if ENABLE_PROFILING
 static void profiler_add_render_sample(uint64_t duration_us,
                                        uint32_t rows_written,
-                                       uint32_t segments_flushed) {
+                                       uint32_t segments_flushed,
+                                       uint32_t pixels_written,
+                                       uint64_t dma_setup_us,
+                                       uint8_t field) {
+  if(field > FRAME_FIELD_FULL) {
+    field = FRAME_FIELD_FULL;
+  }
   portENTER_CRITICAL(&profiler_spinlock);
+  g_render_profiler.field_total_us[field] += duration_us;
+  g_render_profiler.field_frames[field]++;
+  g_render_profiler.dma_setup_total_us += dma_setup_us;
+  g_render_profiler.pixels_written += pixels_written;
   g_render_profiler.total_us += duration_us;
   if(duration_us > g_render_profiler.max_us) {
     g_render_profiler.max_us = duration_us;
@@ -6147,6 +8126,18 @@ static void profiler_add_render_sample(uint64_t duration_us,
   portEXIT_CRITICAL(&profiler_spinlock);
 }
 
+// Input-to-photon latency: from the keyboard poll that fed a frame until the
+// last of its rows has been pushed to the panel.
+static void profiler_add_latency_sample(uint64_t latency_us) {
+  portENTER_CRITICAL(&profiler_spinlock);
+  g_render_profiler.latency_total_us += latency_us;
+  if(latency_us > g_render_profiler.latency_max_us) {
+    g_render_profiler.latency_max_us = latency_us;
+  }
+  g_render_profiler.latency_samples++;
+  portEXIT_CRITICAL(&profiler_spinlock);
+}
+
 static RenderProfiler profiler_consume_render_stats() {
   RenderProfiler snapshot;
   portENTER_CRITICAL(&profiler_spinlock);
@@ -6228,6 +8219,23 @@ static void ensure_stretch_map() {
     stretch_col_weight[x] = weight;
   }
 
+  for(unsigned int c = 0; c < LCD_WIDTH; ++c) {
+    stretch_src_first[c] = DEST_W - 1;
+    stretch_src_last[c] = 0;
+  }
+  for(unsigned int x = 0; x < DEST_W; ++x) {
+    const unsigned int base = stretch_col_map[x];
+    const unsigned int end = (stretch_col_weight[x] != 0 && base + 1 < LCD_WIDTH) ? base + 1 : base;
+    for(unsigned int c = base; c <= end; ++c) {
+      if(x < stretch_src_first[c]) {
+        stretch_src_first[c] = static_cast<uint8_t>(x);
+      }
+      if(x > stretch_src_last[c]) {
+        stretch_src_last[c] = static_cast<uint8_t>(x);
+      }
+    }
+  }
+
   stretch_col_map_initialised = true;
 }
 
@@ -6244,21 +8252,324 @@ static void mark_last_display_frame(const uint16_t *fb) {
     }
   }
 
-  if(priv.single_buffer_mode && priv.framebuffers[0] != nullptr) {
-    g_last_display_fb_index = 0;
-    g_last_display_frame_valid = true;
-    g_last_display_frame_timestamp_us = micros64();
+  if(priv.single_buffer_mode && priv.framebuffers[0] != nullptr) {
+    g_last_display_fb_index = 0;
+    g_last_display_frame_valid = true;
+    g_last_display_frame_timestamp_us = micros64();
+  }
+}
+
+static void ensure_frame_row_map() {
+  if(frame_row_map_initialised) {
+    return;
+  }
+
+  constexpr float scale = static_cast<float>(LCD_HEIGHT) / static_cast<float>(DEST_H);
+  const float max_src = static_cast<float>(LCD_HEIGHT - 1);
+  for(unsigned int j = 0; j < DEST_H; j++) {
+    float src_y = (static_cast<float>(j) + 0.5f) * scale - 0.5f;
+    if(src_y < 0.0f) {
+      src_y = 0.0f;
+    } else if(src_y > max_src) {
+      src_y = max_src;
+    }
+
+    int y0 = static_cast<int>(floorf(src_y));
+    if(y0 < 0) {
+      y0 = 0;
+    }
+
+    float frac = src_y - static_cast<float>(y0);
+    if(y0 >= static_cast<int>(LCD_HEIGHT - 1)) {
+      y0 = LCD_HEIGHT - 1;
+      frac = 0.0f;
+    }
+
+    uint16_t weight = static_cast<uint16_t>(frac * 256.0f + 0.5f);
+    if(weight > 256) {
+      weight = 256;
+    }
+
+    frame_row_map[j] = static_cast<uint8_t>(y0);
+    frame_row_weight[j] = weight;
+    // Blended rows also read the following source line, so they only become
+    // presentable once that line has been drawn.
+    frame_row_last_src[j] = (weight != 0 && y0 + 1 < static_cast<int>(LCD_HEIGHT))
+                                ? static_cast<uint8_t>(y0 + 1)
+                                : static_cast<uint8_t>(y0);
+  }
+
+  // Each row is assigned to the field of the source line that dominates its
+  // blend, so an interlaced field refreshes roughly half the panel and every
+  // row is refreshed once per field pair.
+  frame_field_row_count[0] = 0;
+  frame_field_row_count[1] = 0;
+  for(unsigned int j = 0; j < DEST_H; j++) {
+    frame_all_rows[j] = static_cast<uint8_t>(j);
+    unsigned int dominant = frame_row_map[j];
+    if(frame_row_weight[j] >= 128 && dominant + 1 < LCD_HEIGHT) {
+      dominant++;
+    }
+    const unsigned int field = dominant & 1u;
+    frame_field_rows[field][frame_field_row_count[field]++] = static_cast<uint8_t>(j);
+  }
+  frame_row_map_initialised = true;
+}
+
+// Number of destination rows that can be composed once the first
+// `ready_lines` source lines of a frame have been drawn.
+static unsigned int frame_rows_ready(unsigned int ready_lines) {
+  if(ready_lines >= LCD_HEIGHT) {
+    return DEST_H;
+  }
+  unsigned int rows = 0;
+  while(rows < DEST_H && frame_row_last_src[rows] < ready_lines) {
+    rows++;
+  }
+  return rows;
+}
+
+#if ENABLE_PERF_HUD
+// Performance HUD. The emulator task publishes fps, emulation time, ROM hit
+// rate and audio fill, the render task adds its own pass time, and the render
+// task rasterises them into a small panel-format bitmap
+// that fit_frame_rows copies over the top-left corner of the rows it composes.
+// Each HUD row is hashed separately from the game pixels, so the overlay only
+// costs SPI time on rows where either one changed.
+static constexpr uint16_t PERF_HUD_X = 2;
+static constexpr uint16_t PERF_HUD_Y = 2;
+static constexpr uint16_t PERF_HUD_W = 86;
+static constexpr uint16_t PERF_HUD_LINE_H = 9;
+static constexpr uint16_t PERF_HUD_TEXT_LINES = 3;
+static constexpr uint16_t PERF_HUD_SPARK_Y = 2 + PERF_HUD_TEXT_LINES * PERF_HUD_LINE_H;
+static constexpr uint16_t PERF_HUD_SPARK_H = 16;
+static constexpr uint16_t PERF_HUD_H = PERF_HUD_SPARK_Y + PERF_HUD_SPARK_H + 2;
+static constexpr uint16_t PERF_HUD_SPARK_SAMPLES = PERF_HUD_W - 4;
+static_assert(PERF_HUD_X + PERF_HUD_W <= LCD_WIDTH, "HUD must fit the unstretched output row");
+static_assert(PERF_HUD_Y + PERF_HUD_H <= DEST_H, "HUD must fit the panel");
+static constexpr uint64_t PERF_HUD_TEXT_INTERVAL_US = 500000;
+static constexpr uint16_t PERF_HUD_BG_RGB565 = 0x2104;
+static constexpr uint16_t PERF_HUD_FG_RGB565 = 0xFFFF;
+static constexpr uint16_t PERF_HUD_WARN_RGB565 = 0xFFE0;
+static constexpr uint16_t PERF_HUD_OK_RGB565 = 0x07E0;
+static constexpr uint16_t PERF_HUD_LATE_RGB565 = 0xF800;
+static constexpr uint16_t PERF_HUD_GRID_RGB565 = 0x6B4D;
+
+struct PerfHudStats {
+  uint32_t sequence;       // bumped on every published frame
+  uint32_t text_sequence;  // bumped when the text figures are refreshed
+  float fps;
+  uint32_t emu_us;
+  uint32_t render_us;
+  float rom_hit_rate;
+  float audio_fill;
+  uint8_t level;
+  uint8_t spark_head;
+  uint16_t spark_us[PERF_HUD_SPARK_SAMPLES];
+};
+
+struct PerfHudWindow {
+  uint64_t start_us;
+  uint32_t frames;
+  uint64_t emu_total_us;
+  size_t last_rom_hits;
+  size_t last_rom_misses;
+};
+
+// Written by the emulator task under perf_hud_spinlock.
+static PerfHudStats g_perf_hud_shared = {};
+static PerfHudWindow g_perf_hud_window = {};
+// Render task only.
+static PerfHudStats g_perf_hud_shown = {};
+static bool g_perf_hud_drawn = false;
+static uint32_t g_perf_hud_drawn_text = 0;
+static uint16_t g_perf_hud_pixels[PERF_HUD_H * PERF_HUD_W];
+static uint32_t g_perf_hud_row_hash[PERF_HUD_H];
+// Hash of the HUD pixels each destination row shows on the panel; 0 = none.
+static uint32_t g_perf_hud_panel_hash[DEST_H];
+static M5Canvas g_perf_hud_canvas(&M5Cardputer.Display);
+static bool g_perf_hud_canvas_ready = false;
+
+static void perf_hud_record_frame(uint64_t frame_us, uint64_t emu_us, uint64_t now) {
+  PerfHudWindow &window = g_perf_hud_window;
+  if(!g_perf_hud_visible.load(std::memory_order_relaxed)) {
+    window.start_us = 0;
+    return;
+  }
+  if(window.start_us == 0) {
+    window = {};
+    window.start_us = now;
+    window.last_rom_hits = priv.rom_cache.cache_hits;
+    window.last_rom_misses = priv.rom_cache.cache_misses;
+  }
+  window.frames++;
+  window.emu_total_us += emu_us;
+
+  const uint16_t spark = frame_us > UINT16_MAX ? UINT16_MAX : static_cast<uint16_t>(frame_us);
+  const uint64_t elapsed_us = now - window.start_us;
+  const bool refresh_text = elapsed_us >= PERF_HUD_TEXT_INTERVAL_US;
+  float fps = 0.0f;
+  uint32_t emu_avg = 0;
+  float rom_hit_rate = 0.0f;
+  float audio_fill = 0.0f;
+  if(refresh_text) {
+    fps = static_cast<float>(window.frames) * 1e6f / static_cast<float>(elapsed_us);
+    emu_avg = static_cast<uint32_t>(window.emu_total_us / window.frames);
+    const size_t rom_hits = priv.rom_cache.cache_hits;
+    const size_t rom_misses = priv.rom_cache.cache_misses;
+    const size_t delta_hits = rom_hits - window.last_rom_hits;
+    const size_t rom_total = delta_hits + (rom_misses - window.last_rom_misses);
+    rom_hit_rate = rom_total ? static_cast<float>(delta_hits) * 100.0f / static_cast<float>(rom_total) : 100.0f;
+#if ENABLE_SOUND
+    audio_fill = g_audio_sync.active ? static_cast<float>(g_audio_sync.fill_avg)
+                                     : static_cast<float>(audio_queue_count);
+#endif
+    window.start_us = now;
+    window.frames = 0;
+    window.emu_total_us = 0;
+    window.last_rom_hits = rom_hits;
+    window.last_rom_misses = rom_misses;
+  }
+
+  PerfHudStats &shared = g_perf_hud_shared;
+  portENTER_CRITICAL(&perf_hud_spinlock);
+  shared.spark_us[shared.spark_head] = spark;
+  shared.spark_head = static_cast<uint8_t>((shared.spark_head + 1) % PERF_HUD_SPARK_SAMPLES);
+  shared.sequence++;
+  if(refresh_text) {
+    shared.render_us = g_perf_hud_render_frames
+                           ? static_cast<uint32_t>(g_perf_hud_render_total_us / g_perf_hud_render_frames)
+                           : 0;
+    g_perf_hud_render_total_us = 0;
+    g_perf_hud_render_frames = 0;
+    shared.fps = fps;
+    shared.emu_us = emu_avg;
+    shared.rom_hit_rate = rom_hit_rate;
+    shared.audio_fill = audio_fill;
+    shared.level = g_frame_controller.level;
+    shared.text_sequence++;
+  }
+  portEXIT_CRITICAL(&perf_hud_spinlock);
+}
+
+static void perf_hud_add_render_sample(uint64_t duration_us) {
+  portENTER_CRITICAL(&perf_hud_spinlock);
+  g_perf_hud_render_total_us += duration_us;
+  g_perf_hud_render_frames++;
+  portEXIT_CRITICAL(&perf_hud_spinlock);
+}
+
+static void perf_hud_draw_text(const PerfHudStats &stats) {
+  M5Canvas &canvas = g_perf_hud_canvas;
+  canvas.fillSprite(PERF_HUD_BG_RGB565);
+  canvas.setTextFont(1);
+  canvas.setTextSize(1);
+  canvas.setTextColor(stats.level == FRAME_LEVEL_FULL ? PERF_HUD_FG_RGB565 : PERF_HUD_WARN_RGB565,
+                      PERF_HUD_BG_RGB565);
+  canvas.setCursor(2, 2);
+  canvas.printf("%4.1ffps L%u", static_cast<double>(stats.fps), static_cast<unsigned>(stats.level));
+  canvas.setTextColor(PERF_HUD_FG_RGB565, PERF_HUD_BG_RGB565);
+  canvas.setCursor(2, 2 + PERF_HUD_LINE_H);
+  canvas.printf("E%-5u R%u", static_cast<unsigned>(stats.emu_us), static_cast<unsigned>(stats.render_us));
+  canvas.setCursor(2, 2 + 2 * PERF_HUD_LINE_H);
+  canvas.printf("ROM%3.0f%% A%.1f", static_cast<double>(stats.rom_hit_rate), static_cast<double>(stats.audio_fill));
+
+  for(uint16_t y = 0; y < PERF_HUD_SPARK_Y; ++y) {
+    uint16_t *row = g_perf_hud_pixels + (y * PERF_HUD_W);
+    for(uint16_t x = 0; x < PERF_HUD_W; ++x) {
+      row[x] = panel_pixel_from_rgb565(canvas.readPixel(x, y));
+    }
+  }
+}
+
+// Frame times as bars, oldest on the left; full height is two frame budgets
+// and the grid line marks one.
+static void perf_hud_draw_sparkline(const PerfHudStats &stats) {
+  const uint16_t bg = panel_pixel_from_rgb565(PERF_HUD_BG_RGB565);
+  const uint16_t ok = panel_pixel_from_rgb565(PERF_HUD_OK_RGB565);
+  const uint16_t late = panel_pixel_from_rgb565(PERF_HUD_LATE_RGB565);
+  const uint16_t grid = panel_pixel_from_rgb565(PERF_HUD_GRID_RGB565);
+  const uint32_t budget_us = static_cast<uint32_t>(FRAME_BUDGET_US);
+  const uint16_t grid_y = PERF_HUD_SPARK_Y + PERF_HUD_SPARK_H / 2;
+
+  for(uint16_t y = PERF_HUD_SPARK_Y; y < PERF_HUD_H; ++y) {
+    uint16_t *row = g_perf_hud_pixels + (y * PERF_HUD_W);
+    for(uint16_t x = 0; x < PERF_HUD_W; ++x) {
+      row[x] = (y == grid_y && x >= 2 && x < 2 + PERF_HUD_SPARK_SAMPLES) ? grid : bg;
+    }
+  }
+  for(uint16_t i = 0; i < PERF_HUD_SPARK_SAMPLES; ++i) {
+    const uint16_t frame_us = stats.spark_us[(stats.spark_head + i) % PERF_HUD_SPARK_SAMPLES];
+    uint32_t height = (static_cast<uint32_t>(frame_us) * PERF_HUD_SPARK_H + budget_us) / (2 * budget_us);
+    if(height > PERF_HUD_SPARK_H) {
+      height = PERF_HUD_SPARK_H;
+    }
+    const uint16_t colour = frame_us > budget_us ? late : ok;
+    for(uint32_t h = 0; h < height; ++h) {
+      g_perf_hud_pixels[(PERF_HUD_SPARK_Y + PERF_HUD_SPARK_H - 1 - h) * PERF_HUD_W + 2 + i] = colour;
+    }
+  }
+}
+
+// Called by the render task as each frame begins. Refreshes the bitmap when
+// new figures were published and returns whether the HUD is shown.
+static bool perf_hud_prepare() {
+  if(!g_perf_hud_visible.load(std::memory_order_relaxed)) {
+    g_perf_hud_drawn = false;
+    return false;
+  }
+  if(!g_perf_hud_canvas_ready) {
+    g_perf_hud_canvas.setColorDepth(16);
+    if(g_perf_hud_canvas.createSprite(PERF_HUD_W, PERF_HUD_SPARK_Y) == nullptr) {
+      Serial.println("Perf HUD: canvas allocation failed");
+      g_perf_hud_visible.store(false, std::memory_order_relaxed);
+      return false;
+    }
+    g_perf_hud_canvas_ready = true;
+  }
+
+  portENTER_CRITICAL(&perf_hud_spinlock);
+  const bool changed = !g_perf_hud_drawn || g_perf_hud_shared.sequence != g_perf_hud_shown.sequence;
+  if(changed) {
+    g_perf_hud_shown = g_perf_hud_shared;
+  }
+  portEXIT_CRITICAL(&perf_hud_spinlock);
+  if(!changed) {
+    return true;
+  }
+
+  if(!g_perf_hud_drawn || g_perf_hud_shown.text_sequence != g_perf_hud_drawn_text) {
+    perf_hud_draw_text(g_perf_hud_shown);
+    g_perf_hud_drawn_text = g_perf_hud_shown.text_sequence;
   }
+  perf_hud_draw_sparkline(g_perf_hud_shown);
+  for(uint16_t y = 0; y < PERF_HUD_H; ++y) {
+    const uint16_t *row = g_perf_hud_pixels + (y * PERF_HUD_W);
+    uint32_t hash = 2166136261u;
+    for(uint16_t x = 0; x < PERF_HUD_W; ++x) {
+      hash = framebuffer_hash_step(hash, row[x]);
+    }
+    g_perf_hud_row_hash[y] = hash != 0 ? hash : 1;
+  }
+  g_perf_hud_drawn = true;
+  return true;
 }
 
-// Draw a frame to the display while scaling it to fit.
-// This is needed as the Cardputer's display has a height of 135px,
-// while the GameBoy's has a height of 144px.
-void fit_frame(const uint16_t *fb, const uint32_t *row_hash, uint8_t *row_dirty) {
-  if(fb == nullptr) {
-    return;
+static inline uint32_t perf_hud_row_hash(const FramePresentState &state, unsigned int row) {
+  if(!state.hud_visible || row < PERF_HUD_Y || row >= PERF_HUD_Y + PERF_HUD_H) {
+    return 0;
   }
+  return g_perf_hud_row_hash[row - PERF_HUD_Y];
+}
+#endif
 
+static void fit_frame_begin(FramePresentState &state,
+                            const uint16_t *fb,
+                            const uint32_t *row_hash,
+                            uint8_t *row_dirty,
+                            const RowSpan *row_span,
+                            uint64_t input_us,
+                            uint8_t field_mask) {
   const bool stretch = g_settings.stretch_display;
 
   if(stretch != last_stretch_mode) {
@@ -6270,50 +8581,69 @@ void fit_frame(const uint16_t *fb, const uint32_t *row_hash, uint8_t *row_dirty)
   if(stretch) {
     ensure_stretch_map();
   }
-
-#if ENABLE_PROFILING
-  uint64_t render_start = micros64();
-  uint32_t rows_written = 0;
-  uint32_t segments_flushed = 0;
+  ensure_frame_row_map();
+
+  if(state.active) {
+    // The previous frame was abandoned part-way, so the panel no longer
+    // matches any single framebuffer.
+    display_span_base_fb = nullptr;
+  }
+
+  state = {};
+  state.fb = fb;
+  state.row_hash = row_hash;
+  state.row_dirty = row_dirty;
+  state.input_us = input_us;
+  state.stretch = stretch;
+  state.cache_was_valid = display_cache_valid;
+  state.active = true;
+  state.row_span = row_span;
+#if ENABLE_PERF_HUD
+  state.hud_visible = perf_hud_prepare();
 #endif
-
-  if(!frame_row_map_initialised) {
-    constexpr float scale = static_cast<float>(LCD_HEIGHT) / static_cast<float>(DEST_H);
-    const float max_src = static_cast<float>(LCD_HEIGHT - 1);
-    for(unsigned int j = 0; j < DEST_H; j++) {
-      float src_y = (static_cast<float>(j) + 0.5f) * scale - 0.5f;
-      if(src_y < 0.0f) {
-        src_y = 0.0f;
-      } else if(src_y > max_src) {
-        src_y = max_src;
-      }
-
-      int y0 = static_cast<int>(floorf(src_y));
-      if(y0 < 0) {
-        y0 = 0;
-      }
-
-      float frac = src_y - static_cast<float>(y0);
-      if(y0 >= static_cast<int>(LCD_HEIGHT - 1)) {
-        y0 = LCD_HEIGHT - 1;
-        frac = 0.0f;
-      }
-
-      uint16_t weight = static_cast<uint16_t>(frac * 256.0f + 0.5f);
-      if(weight > 256) {
-        weight = 256;
-      }
-
-      frame_row_map[j] = static_cast<uint8_t>(y0);
-      frame_row_weight[j] = weight;
-    }
-    frame_row_map_initialised = true;
+  // Spans are relative to the other framebuffer, which must be exactly what
+  // the panel shows for them to bound what needs resending. A single-field
+  // frame leaves the other parity's spans stale, so only full frames qualify.
+  state.use_spans = (row_span != nullptr) &&
+                    state.cache_was_valid &&
+                    (field_mask == FRAME_FIELD_MASK_ALL) &&
+                    (display_span_base_fb != nullptr) &&
+                    (display_span_base_fb != fb);
+
+  // While adaptive interlace is active only one parity of source lines was
+  // drawn this frame, so only the rows belonging to that field are walked.
+  state.field = FRAME_FIELD_FULL;
+  state.row_list = frame_all_rows;
+  state.row_list_count = DEST_H;
+  if(state.cache_was_valid && (field_mask == 0x01 || field_mask == 0x02)) {
+    state.field = (field_mask == 0x01) ? FRAME_FIELD_EVEN : FRAME_FIELD_ODD;
+    state.row_list = frame_field_rows[state.field];
+    state.row_list_count = frame_field_row_count[state.field];
+  }
+}
+
+// Compose and flush destination rows [state.next_row, row_end). Rows must only
+// be requested once every source line they depend on has been drawn.
+static void fit_frame_rows(FramePresentState &state, unsigned int row_end) {
+  TRACE_SCOPE(TRACE_PROBE_FIT_FRAME);
+  if(row_end > DEST_H) {
+    row_end = DEST_H;
+  }
+  if(state.fb == nullptr || state.next_row >= row_end) {
+    return;
   }
 
+  const uint64_t render_start = micros64();
+  const uint16_t *fb = state.fb;
+  const uint32_t *row_hash = state.row_hash;
+  const uint8_t *row_dirty = state.row_dirty;
+  const bool stretch = state.stretch;
+  const bool cache_was_valid = state.cache_was_valid;
+
   const uint16_t output_width = stretch ? DEST_W : LCD_WIDTH;
   const int32_t x_offset = stretch ? 0 : DISPLAY_CENTER(0);
   const size_t row_bytes = output_width * sizeof(uint16_t);
-  const bool cache_was_valid = display_cache_valid;
+  bool write_open = false;
 
   auto needs_update = [&](unsigned int src_y0, uint16_t weight) -> bool {
     if(row_dirty == nullptr || !cache_was_valid) {
@@ -6335,7 +8665,9 @@ void fit_frame(const uint16_t *fb, const uint32_t *row_hash, uint8_t *row_dirty)
     return dirty0 || (row_dirty[src_y0 + 1] != 0);
   };
 
-  auto blend_pixel = [](uint16_t c0, uint16_t c1, uint16_t w0, uint16_t w1) -> uint16_t {
+  auto blend_pixel = [](uint16_t p0, uint16_t p1, uint16_t w0, uint16_t w1) -> uint16_t {
+    const uint16_t c0 = panel_pixel_to_rgb565(p0);
+    const uint16_t c1 = panel_pixel_to_rgb565(p1);
     const uint32_t r0 = (c0 >> 11) & 0x1F;
     const uint32_t g0 = (c0 >> 5) & 0x3F;
     const uint32_t b0 = c0 & 0x1F;
@@ -6347,9 +8679,9 @@ void fit_frame(const uint16_t *fb, const uint32_t *row_hash, uint8_t *row_dirty)
     const uint32_t g = (g0 * w0 + g1 * w1 + 128) >> 8;
     const uint32_t b = (b0 * w0 + b1 * w1 + 128) >> 8;
 
-    return static_cast<uint16_t>(((r & 0x1F) << 11) |
-                                 ((g & 0x3F) << 5) |
-                                 (b & 0x1F));
+    return panel_pixel_from_rgb565(static_cast<uint16_t>(((r & 0x1F) << 11) |
+                                                         ((g & 0x3F) << 5) |
+                                                         (b & 0x1F)));
   };
 
   auto compose_row = [&](uint16_t *dst,
@@ -6417,184 +8749,366 @@ void fit_frame(const uint16_t *fb, const uint32_t *row_hash, uint8_t *row_dirty)
     return hash;
   };
 
+  // Rows whose source lines are unchanged and whose cached hash still matches
+  // what is on the panel can be skipped without composing them.
+  auto can_skip_row = [&](unsigned int j, unsigned int src_y0, uint16_t weight) -> bool {
+    if(stretch || !cache_was_valid || row_hash == nullptr) {
+      return false;
+    }
+    uint32_t expected_hash = 0;
+    if(weight == 0) {
+      expected_hash = row_hash[src_y0];
+    } else if(weight == 256 && src_y0 + 1 < LCD_HEIGHT) {
+      expected_hash = row_hash[src_y0 + 1];
+    } else {
+      return false;
+    }
+    return !needs_update(src_y0, weight) && swap_row_hash[j] == expected_hash;
+  };
+
+  // The performance HUD is copied over a row after it is composed, so row
+  // hashes keep describing game pixels only; the HUD's own row hash says
+  // whether its columns still need sending.
+  auto hud_stale = [&](unsigned int j) -> bool {
+#if ENABLE_PERF_HUD
+    return perf_hud_row_hash(state, j) != g_perf_hud_panel_hash[j];
+#else
+    (void)j;
+    return false;
+#endif
+  };
+
+  auto overlay_hud = [&](uint16_t *dst, unsigned int j) -> bool {
+#if ENABLE_PERF_HUD
+    const uint32_t hud_hash = perf_hud_row_hash(state, j);
+    if(hud_hash != 0) {
+      memcpy(dst + PERF_HUD_X,
+             g_perf_hud_pixels + ((j - PERF_HUD_Y) * PERF_HUD_W),
+             PERF_HUD_W * sizeof(uint16_t));
+    }
+    const bool changed = hud_hash != g_perf_hud_panel_hash[j];
+    g_perf_hud_panel_hash[j] = hud_hash;
+    return changed;
+#else
+    (void)dst;
+    (void)j;
+    return false;
+#endif
+  };
+
+  auto include_hud_span = [&](bool row_changed, uint16_t &x0, uint16_t &x1) {
+#if ENABLE_PERF_HUD
+    const uint16_t hud_x1 = PERF_HUD_X + PERF_HUD_W - 1;
+    if(!row_changed) {
+      x0 = PERF_HUD_X;
+      x1 = hud_x1;
+      return;
+    }
+    x0 = x0 < PERF_HUD_X ? x0 : PERF_HUD_X;
+    x1 = x1 > hud_x1 ? x1 : hud_x1;
+#else
+    (void)row_changed;
+    (void)x0;
+    (void)x1;
+#endif
+  };
+
   uint16_t *const line_buffer = stretch_line_buffer;
 
   const bool use_full_cache = swap_fb_enabled && swap_fb_psram_backed && swap_fb != nullptr && row_hash != nullptr;
 
-  if(!use_full_cache) {
-    unsigned int segment_rows = 0;
-    unsigned int segment_start = 0;
-    bool any_change = false;
+  // Destination columns of row j that differ from what the panel shows,
+  // derived from the per-line spans lcd_draw_line recorded. Falls back to the
+  // full row whenever the spans cannot be trusted.
+  auto dest_span = [&](unsigned int src_y0, uint16_t weight, uint16_t &x0, uint16_t &x1) {
+    x0 = 0;
+    x1 = output_width - 1;
+    if(!state.use_spans || src_y0 >= LCD_HEIGHT) {
+      return;
+    }
+    RowSpan span = state.row_span[src_y0];
+    if(weight != 0 && src_y0 + 1 < LCD_HEIGHT) {
+      const RowSpan next = state.row_span[src_y0 + 1];
+      if(weight >= 256) {
+        span = next;
+      } else if(next.first <= next.last) {
+        if(span.first > span.last) {
+          span = next;
+        } else {
+          span.first = span.first < next.first ? span.first : next.first;
+          span.last = span.last > next.last ? span.last : next.last;
+        }
+      }
+    }
+    if(span.first > span.last) {
+      // The row hash changed without a recorded span; don't guess.
+      return;
+    }
+    if(stretch) {
+      x0 = stretch_src_first[span.first];
+      x1 = stretch_src_last[span.last];
+    } else {
+      x0 = span.first;
+      x1 = span.last;
+    }
+  };
+
+  // Pending dirty rectangle: rows [rect_start, rect_start + rect_rows),
+  // columns [rect_x0, rect_x1].
+  unsigned int rect_start = 0;
+  unsigned int rect_rows = 0;
+  uint16_t rect_x0 = 0;
+  uint16_t rect_x1 = 0;
+
+  // Grow the pending rectangle by one row only when a single larger transfer
+  // costs less than paying the window setup again for a separate one.
+  auto should_merge = [&](uint16_t x0, uint16_t x1, uint32_t max_pixels) -> bool {
+    const uint16_t merged_x0 = rect_x0 < x0 ? rect_x0 : x0;
+    const uint16_t merged_x1 = rect_x1 > x1 ? rect_x1 : x1;
+    const uint32_t merged_width = static_cast<uint32_t>(merged_x1 - merged_x0 + 1);
+    const uint32_t merged_pixels = merged_width * (rect_rows + 1);
+    const uint32_t merged_cost = DIRTY_RECT_SETUP_COST_PIXELS + merged_pixels;
+    const uint32_t separate_cost = (2 * DIRTY_RECT_SETUP_COST_PIXELS) +
+                                   static_cast<uint32_t>(rect_x1 - rect_x0 + 1) * rect_rows +
+                                   static_cast<uint32_t>(x1 - x0 + 1);
+    if(merged_cost > separate_cost) {
+      return false;
+    }
+    return merged_width == output_width || merged_pixels <= max_pixels;
+  };
+
+  auto extend_rect = [&](unsigned int j, uint16_t x0, uint16_t x1) {
+    if(rect_rows == 0) {
+      rect_start = j;
+      rect_x0 = x0;
+      rect_x1 = x1;
+    } else {
+      rect_x0 = rect_x0 < x0 ? rect_x0 : x0;
+      rect_x1 = rect_x1 > x1 ? rect_x1 : x1;
+    }
+    rect_rows++;
+  };
+
+  auto push_rect = [&](const uint16_t *pixels, uint16_t width, bool swap) {
+    const uint64_t dma_start = micros64();
+    M5Cardputer.Display.setAddrWindow(x_offset + rect_x0, rect_start, width, rect_rows);
+    M5Cardputer.Display.writePixelsDMA(pixels, width * rect_rows, swap);
+    state.dma_setup_us += micros64() - dma_start;
+    state.rows_written += rect_rows;
+    state.segments_flushed++;
+    state.pixels_written += static_cast<uint32_t>(width) * rect_rows;
+  };
 
-    auto flush_segment = [&](unsigned int count) {
-      if(count == 0) {
+  if(!use_full_cache) {
+    // Rows are staged full width; narrow rectangles are compacted in place.
+    auto flush_segment = [&]() {
+      if(rect_rows == 0) {
         return;
       }
-      if(!any_change) {
+      if(!write_open) {
         M5Cardputer.Display.startWrite();
-        any_change = true;
+        write_open = true;
       }
       if(M5Cardputer.Display.dmaBusy()) {
         M5Cardputer.Display.waitDMA();
       }
-      M5Cardputer.Display.setAddrWindow(x_offset, segment_start, output_width, count);
-      M5Cardputer.Display.writePixelsDMA(fallback_segment_buffer,
-                                         output_width * count,
-                                         true);
+      const uint16_t width = rect_x1 - rect_x0 + 1;
+      if(width != output_width) {
+        for(unsigned int r = 0; r < rect_rows; ++r) {
+          memmove(fallback_segment_buffer + (r * width),
+                  fallback_segment_buffer + (r * output_width) + rect_x0,
+                  width * sizeof(uint16_t));
+        }
+      }
+      push_rect(fallback_segment_buffer, width, PANEL_WRITE_SWAP);
       M5Cardputer.Display.waitDMA();
-#if ENABLE_PROFILING
-      rows_written += count;
-      segments_flushed++;
-#endif
-      segment_rows = 0;
+      rect_rows = 0;
     };
 
-    for(unsigned int j = 0; j < DEST_H; j++) {
+    while(state.row_cursor < state.row_list_count && state.row_list[state.row_cursor] < row_end) {
+      const unsigned int j = state.row_list[state.row_cursor++];
       const unsigned int src_y0 = frame_row_map[j];
       const uint16_t weight = frame_row_weight[j];
-      const bool dirty_hint = needs_update(src_y0, weight);
-
-      if(!stretch && display_cache_valid && row_hash != nullptr) {
-        uint32_t expected_hash = 0;
-        bool can_skip = false;
-        if(weight == 0) {
-          expected_hash = row_hash[src_y0];
-          can_skip = true;
-        } else if(weight == 256 && src_y0 + 1 < LCD_HEIGHT) {
-          expected_hash = row_hash[src_y0 + 1];
-          can_skip = true;
-        }
 
-        if(can_skip && !dirty_hint && swap_row_hash[j] == expected_hash) {
-          flush_segment(segment_rows);
-          continue;
-        }
+      if(rect_rows != 0 && j != rect_start + rect_rows) {
+        flush_segment();
+      }
+      if(can_skip_row(j, src_y0, weight) && !hud_stale(j)) {
+        flush_segment();
+        continue;
       }
 
       const uint32_t dest_hash = compose_row(line_buffer, src_y0, weight, true);
-      const bool row_changed = (!display_cache_valid) || (swap_row_hash[j] != dest_hash);
+      const bool hud_changed = overlay_hud(line_buffer, j);
+      const bool row_changed = (!cache_was_valid) || (swap_row_hash[j] != dest_hash);
 
-      if(row_changed) {
+      if(row_changed || hud_changed) {
         swap_row_hash[j] = dest_hash;
-        if(segment_rows == 0) {
-          segment_start = j;
+        uint16_t x0 = 0;
+        uint16_t x1 = 0;
+        if(row_changed) {
+          dest_span(src_y0, weight, x0, x1);
+        }
+        if(hud_changed) {
+          include_hud_span(row_changed, x0, x1);
         }
-        memcpy(fallback_segment_buffer + (segment_rows * output_width), line_buffer, row_bytes);
-        segment_rows++;
-        if(segment_rows == FALLBACK_SEGMENT_ROWS) {
-          flush_segment(segment_rows);
+        if(rect_rows != 0 && !should_merge(x0, x1, UINT32_MAX)) {
+          flush_segment();
+        }
+        memcpy(fallback_segment_buffer + (rect_rows * output_width), line_buffer, row_bytes);
+        extend_rect(j, x0, x1);
+        if(rect_rows == FALLBACK_SEGMENT_ROWS) {
+          flush_segment();
         }
       } else {
-        flush_segment(segment_rows);
+        flush_segment();
       }
     }
 
-    flush_segment(segment_rows);
-
-    if(any_change) {
-      M5Cardputer.Display.waitDMA();
-      M5Cardputer.Display.endWrite();
-      display_cache_valid = true;
-    }
-
-  if(row_dirty != nullptr) {
-    memset(row_dirty, 0, LCD_HEIGHT * sizeof(uint8_t));
-  }
-
-#if ENABLE_PROFILING
-  profiler_add_render_sample(micros64() - render_start, rows_written, segments_flushed);
-#endif
-
-  mark_last_display_frame(fb);
-  render_status_message_overlay();
-  return;
-  }
+    flush_segment();
+  } else {
+    // swap_fb mirrors the panel, so full-width and single-row rectangles are
+    // sent straight from it; narrow multi-row ones are packed into the
+    // segment buffer first.
+    const uint32_t staging_pixels = FALLBACK_SEGMENT_ROWS * DEST_W;
 
-  unsigned int segment_start = 0;
-  unsigned int segment_count = 0;
-  bool any_change = false;
+    auto flush_segment = [&]() {
+      if(rect_rows == 0) {
+        return;
+      }
+      if(!write_open) {
+        M5Cardputer.Display.startWrite();
+        write_open = true;
+      }
+      if(M5Cardputer.Display.dmaBusy()) {
+        M5Cardputer.Display.waitDMA();
+      }
+      const uint16_t width = rect_x1 - rect_x0 + 1;
+      const uint16_t *first_row = swap_fb + (rect_start * output_width) + rect_x0;
+      if(width == output_width || rect_rows == 1) {
+        push_rect(first_row, width, PANEL_WRITE_SWAP && swap_fb_dma_capable);
+      } else {
+        for(unsigned int r = 0; r < rect_rows; ++r) {
+          memcpy(fallback_segment_buffer + (r * width),
+                 first_row + (r * output_width),
+                 width * sizeof(uint16_t));
+        }
+        push_rect(fallback_segment_buffer, width, PANEL_WRITE_SWAP);
+      }
+      rect_rows = 0;
+    };
 
-  auto flush_segment = [&](unsigned int start, unsigned int count) {
-    if(count == 0) {
-      return;
-    }
-    if(!any_change) {
-      M5Cardputer.Display.startWrite();
-      any_change = true;
-    }
-    if(M5Cardputer.Display.dmaBusy()) {
-      M5Cardputer.Display.waitDMA();
-    }
-    M5Cardputer.Display.setAddrWindow(x_offset, start, output_width, count);
-    M5Cardputer.Display.writePixelsDMA(swap_fb + (start * output_width),
-                                       output_width * count,
-                                       swap_fb_dma_capable);
-#if ENABLE_PROFILING
-    rows_written += count;
-    segments_flushed++;
-#endif
-  };
+    while(state.row_cursor < state.row_list_count && state.row_list[state.row_cursor] < row_end) {
+      const unsigned int j = state.row_list[state.row_cursor++];
+      const unsigned int src_y0 = frame_row_map[j];
+      const uint16_t weight = frame_row_weight[j];
+      uint16_t *cached_row = swap_fb + (j * output_width);
 
-  for(unsigned int j = 0; j < DEST_H; j++) {
-    const unsigned int src_y0 = frame_row_map[j];
-    const uint16_t weight = frame_row_weight[j];
-    uint16_t *cached_row = swap_fb + (j * output_width);
-    const bool dirty_hint = needs_update(src_y0, weight);
-
-    if(!stretch && display_cache_valid && row_hash != nullptr) {
-      uint32_t expected_hash = 0;
-      bool can_skip = false;
-      if(weight == 0) {
-        expected_hash = row_hash[src_y0];
-        can_skip = true;
-      } else if(weight == 256 && src_y0 + 1 < LCD_HEIGHT) {
-        expected_hash = row_hash[src_y0 + 1];
-        can_skip = true;
-      }
-
-      if(can_skip && !dirty_hint && swap_row_hash[j] == expected_hash) {
-        if(segment_count != 0) {
-          flush_segment(segment_start, segment_count);
-          segment_count = 0;
-        }
+      if(rect_rows != 0 && j != rect_start + rect_rows) {
+        flush_segment();
+      }
+      if(can_skip_row(j, src_y0, weight) && !hud_stale(j)) {
+        flush_segment();
         continue;
       }
-    }
 
-    const uint32_t dest_hash = compose_row(cached_row, src_y0, weight, true);
+      const uint32_t dest_hash = compose_row(cached_row, src_y0, weight, true);
+      const bool hud_changed = overlay_hud(cached_row, j);
+      const bool row_changed = !cache_was_valid || swap_row_hash[j] != dest_hash;
 
-    if(!display_cache_valid || swap_row_hash[j] != dest_hash) {
-      swap_row_hash[j] = dest_hash;
-      if(segment_count == 0) {
-        segment_start = j;
+      if(row_changed || hud_changed) {
+        swap_row_hash[j] = dest_hash;
+        uint16_t x0 = 0;
+        uint16_t x1 = 0;
+        if(row_changed) {
+          dest_span(src_y0, weight, x0, x1);
+        }
+        if(hud_changed) {
+          include_hud_span(row_changed, x0, x1);
+        }
+        if(rect_rows != 0 && !should_merge(x0, x1, staging_pixels)) {
+          flush_segment();
+        }
+        extend_rect(j, x0, x1);
+      } else {
+        flush_segment();
       }
-      segment_count++;
-    } else if(segment_count != 0) {
-      flush_segment(segment_start, segment_count);
-      segment_count = 0;
     }
-  }
 
-  if(segment_count != 0) {
-    flush_segment(segment_start, segment_count);
+    flush_segment();
   }
 
-  if(any_change) {
+  if(write_open) {
     M5Cardputer.Display.waitDMA();
     M5Cardputer.Display.endWrite();
+    state.any_change = true;
+  }
+
+  state.next_row = static_cast<uint16_t>(row_end);
+  state.render_us += micros64() - render_start;
+}
+
+// Flush whatever rows are still pending and retire the frame.
+static void fit_frame_finish(FramePresentState &state) {
+  if(!state.active) {
+    return;
+  }
+
+  fit_frame_rows(state, DEST_H);
+
+  if(state.any_change) {
     display_cache_valid = true;
   }
+  // Interlaced fields leave half the rows behind, so only a full frame can
+  // serve as the reference for the next frame's spans.
+  display_span_base_fb = (display_cache_valid && state.field == FRAME_FIELD_FULL) ? state.fb : nullptr;
 
-  if(row_dirty != nullptr) {
-    memset(row_dirty, 0, LCD_HEIGHT * sizeof(uint8_t));
+  if(state.row_dirty != nullptr) {
+    memset(state.row_dirty, 0, LCD_HEIGHT * sizeof(uint8_t));
   }
 
+#if ENABLE_TELEMETRY
+  telemetry_note_render(state.render_us);
+#endif
+#if ENABLE_FRAME_HISTOGRAMS
+  frame_hist_add_shared(g_render_hist, state.render_us);
+#endif
+#if ENABLE_PERF_HUD
+  perf_hud_add_render_sample(state.render_us);
+#endif
 #if ENABLE_PROFILING
-  profiler_add_render_sample(micros64() - render_start, rows_written, segments_flushed);
+  profiler_add_render_sample(state.render_us,
+                             state.rows_written,
+                             state.segments_flushed,
+                             state.pixels_written,
+                             state.dma_setup_us,
+                             state.field);
+  if(state.any_change && state.input_us != 0) {
+    profiler_add_latency_sample(micros64() - state.input_us);
+  }
 #endif
 
-  mark_last_display_frame(fb);
+  mark_last_display_frame(state.fb);
   render_status_message_overlay();
+  state.active = false;
+}
+
+// Draw a frame to the display while scaling it to fit.
+// This is needed as the Cardputer's display has a height of 135px,
+// while the GameBoy's has a height of 144px.
+void fit_frame(const uint16_t *fb,
+               const uint32_t *row_hash,
+               uint8_t *row_dirty,
+               const RowSpan *row_span,
+               uint64_t input_us,
+               uint8_t field_mask) {
+  if(fb == nullptr) {
+    return;
+  }
+
+  FramePresentState state = {};
+  fit_frame_begin(state, fb, row_hash, row_dirty, row_span, input_us, field_mask);
+  fit_frame_finish(state);
 }
 
 // Draw a frame to the display without scaling.
@@ -6621,7 +9135,7 @@ void draw_frame(const uint16_t *fb) {
       M5Cardputer.Display.waitDMA();
     }
     M5Cardputer.Display.setAddrWindow(0, j, LCD_WIDTH, 1);
-    M5Cardputer.Display.writePixelsDMA(src_row, LCD_WIDTH, true);
+    M5Cardputer.Display.writePixelsDMA(src_row, LCD_WIDTH, PANEL_WRITE_SWAP);
   }
   M5Cardputer.Display.waitDMA();
   M5Cardputer.Display.endWrite();
@@ -6631,16 +9145,38 @@ void draw_frame(const uint16_t *fb) {
 
 static void renderTask(void *param) {
   (void)param;
-  uint8_t index = 0;
+  static FramePresentState present = {};
+  FrameRenderMessage message;
   while(true) {
     if(priv.frame_queue != nullptr &&
-       xQueueReceive(priv.frame_queue, &index, portMAX_DELAY) == pdTRUE) {
+       xQueueReceive(priv.frame_queue, &message, portMAX_DELAY) == pdTRUE) {
+      const uint8_t index = message.fb_index & 1;
+      const bool final_band = (message.flags & FRAME_RENDER_FLAG_FINAL) != 0;
       if(priv.framebuffers[index] != nullptr) {
-        fit_frame(priv.framebuffers[index],
-                  priv.framebuffer_row_hash[index],
-                  priv.framebuffer_row_dirty[index]);
+        // A band from a different frame means the previous one was abandoned
+        // (e.g. discarded by frame skip); start composing the new one afresh.
+        if(!present.active ||
+           present.fb != priv.framebuffers[index] ||
+           present.sequence != message.sequence) {
+          fit_frame_begin(present,
+                          priv.framebuffers[index],
+                          priv.framebuffer_row_hash[index],
+                          priv.framebuffer_row_dirty[index],
+                          priv.framebuffer_row_span[index],
+                          priv.framebuffer_input_us[index],
+                          priv.framebuffer_field_mask[index]);
+          present.sequence = message.sequence;
+        }
+        if(message.ready_lines > present.ready_lines) {
+          present.ready_lines = message.ready_lines;
+        }
+        if(final_band) {
+          fit_frame_finish(present);
+        } else {
+          fit_frame_rows(present, frame_rows_ready(present.ready_lines));
+        }
       }
-      if(priv.frame_buffer_free[index] != nullptr) {
+      if(final_band && priv.frame_buffer_free[index] != nullptr) {
         xSemaphoreGive(priv.frame_buffer_free[index]);
       }
     }
@@ -6652,10 +9188,12 @@ static void renderTask(void *param) {
 #if ENABLE_SOUND
 static void audioTask(void *param) {
   (void)param;
-  const TickType_t period = pdMS_TO_TICKS(4);
   while(true) {
+    audio_depth_apply_pending();
     audioPump();
-    vTaskDelay(period);
+    // Finer polling in audio-paced mode: the emulator is released as soon as
+    // a speaker buffer retires, so the poll interval shows up as frame jitter.
+    vTaskDelay(pdMS_TO_TICKS(g_audio_sync.paced ? 1 : 4));
   }
 }
 #endif
@@ -6671,9 +9209,179 @@ static void profiler_reset_main(uint64_t now) {
   g_main_profiler.accum_idle_us = 0;
   g_main_profiler.accum_requested_idle_us = 0;
   g_main_profiler.max_frame_us = 0;
+  g_main_profiler.accum_emu_shown_us = 0;
+  g_main_profiler.accum_emu_skipped_us = 0;
+  g_main_profiler.shown_frames = 0;
+  g_main_profiler.skipped_frames = 0;
+  g_main_profiler.pace_max_us = 0;
+  g_main_profiler.pace_hist = {};
+  memset(g_frame_controller.level_frames, 0, sizeof(g_frame_controller.level_frames));
   g_main_profiler.last_log_us = now;
 }
 
+static void profiler_record_pacing(uint64_t deviation_us) {
+  log_hist_add(g_main_profiler.pace_hist, deviation_us);
+  if(deviation_us > g_main_profiler.pace_max_us) {
+    g_main_profiler.pace_max_us = deviation_us;
+  }
+}
+
+#if (configUSE_TRACE_FACILITY == 1)
+// Per-task CPU share and stack headroom. Run-time counters are cumulative, so
+// the previous sample of each task is kept to report usage over the log window.
+static constexpr size_t PROFILER_MAX_TASKS = 24;
+static constexpr uint32_t PROFILER_STACK_LOW_BYTES = 512;
+static constexpr uint32_t PROFILER_STARVE_PERMILLE = 50;
+
+struct TaskRuntimeSample {
+  TaskHandle_t handle;
+  uint32_t runtime;
+};
+
+static TaskStatus_t g_task_status[PROFILER_MAX_TASKS];
+static TaskRuntimeSample g_task_prev[PROFILER_MAX_TASKS];
+static size_t g_task_prev_count = 0;
+static uint32_t g_task_prev_total = 0;
+
+static void profiler_log_tasks() {
+  uint32_t total_runtime = 0;
+  const UBaseType_t count = uxTaskGetSystemState(g_task_status, PROFILER_MAX_TASKS, &total_runtime);
+  if(count == 0) {
+    Serial.printf("[PROF] tasks unavailable (more than %u tasks)\n", static_cast<unsigned>(PROFILER_MAX_TASKS));
+    return;
+  }
+
+  const int emu_core = xPortGetCoreID();
+  const TaskHandle_t emu_task = xTaskGetCurrentTaskHandle();
+#if (configGENERATE_RUN_TIME_STATS == 1)
+  // Each core accumulates its own run time, so a core's capacity over the
+  // window equals the elapsed stats clock.
+  const uint32_t window = total_runtime - g_task_prev_total;
+  const bool have_window = g_task_prev_count != 0 && window != 0;
+#else
+  const uint32_t window = 0;
+  const bool have_window = false;
+#endif
+
+  uint32_t task_permille[PROFILER_MAX_TASKS];
+  uint32_t core_idle_permille[portNUM_PROCESSORS];
+  for(int core = 0; core < portNUM_PROCESSORS; ++core) {
+    core_idle_permille[core] = 1000;
+  }
+  for(UBaseType_t i = 0; i < count; ++i) {
+    const TaskStatus_t &task = g_task_status[i];
+    uint32_t delta = 0;
+    if(have_window) {
+      for(size_t p = 0; p < g_task_prev_count; ++p) {
+        if(g_task_prev[p].handle == task.xHandle) {
+          delta = task.ulRunTimeCounter - g_task_prev[p].runtime;
+          break;
+        }
+      }
+    }
+    task_permille[i] = have_window
+                           ? static_cast<uint32_t>(std::min<uint64_t>(
+                                 1000, static_cast<uint64_t>(delta) * 1000 / window))
+                           : 0;
+    for(int core = 0; core < portNUM_PROCESSORS; ++core) {
+      if(task.xHandle == xTaskGetIdleTaskHandleForCPU(core)) {
+        core_idle_permille[core] = task_permille[i];
+      }
+    }
+  }
+
+  char line[768];
+  size_t len = 0;
+  auto append = [&](const char *fmt, ...) {
+    if(len >= sizeof(line)) {
+      return;
+    }
+    va_list args;
+    va_start(args, fmt);
+    const int written = vsnprintf(line + len, sizeof(line) - len, fmt, args);
+    va_end(args);
+    if(written > 0) {
+      len = std::min(sizeof(line), len + static_cast<size_t>(written));
+    }
+  };
+
+  if(have_window) {
+    append("[PROF] tasks busy(c0=%u.%u%% c1=%u.%u%%)",
+           static_cast<unsigned>((1000 - core_idle_permille[0]) / 10),
+           static_cast<unsigned>((1000 - core_idle_permille[0]) % 10),
+           static_cast<unsigned>((1000 - core_idle_permille[1]) / 10),
+           static_cast<unsigned>((1000 - core_idle_permille[1]) % 10));
+  } else {
+    append("[PROF] tasks busy(n/a)");
+  }
+
+  char starving[160];
+  size_t starving_len = 0;
+  starving[0] = '\0';
+  char low_stack[160];
+  size_t low_stack_len = 0;
+  low_stack[0] = '\0';
+  for(UBaseType_t i = 0; i < count; ++i) {
+    const TaskStatus_t &task = g_task_status[i];
+    const BaseType_t affinity = xTaskGetAffinity(task.xHandle);
+    const uint32_t stack_free = static_cast<uint32_t>(task.usStackHighWaterMark) * sizeof(StackType_t);
+    const bool is_idle = task.xHandle == xTaskGetIdleTaskHandleForCPU(0) ||
+                         task.xHandle == xTaskGetIdleTaskHandleForCPU(1);
+    if(affinity == tskNO_AFFINITY) {
+      append(" %s(c- p%u %u.%u%% hw=%u)", task.pcTaskName,
+             static_cast<unsigned>(task.uxCurrentPriority),
+             static_cast<unsigned>(task_permille[i] / 10),
+             static_cast<unsigned>(task_permille[i] % 10),
+             static_cast<unsigned>(stack_free));
+    } else {
+      append(" %s(c%d p%u %u.%u%% hw=%u)", task.pcTaskName, static_cast<int>(affinity),
+             static_cast<unsigned>(task.uxCurrentPriority),
+             static_cast<unsigned>(task_permille[i] / 10),
+             static_cast<unsigned>(task_permille[i] % 10),
+             static_cast<unsigned>(stack_free));
+    }
+    // Anything other than the emulator loop that can run on the emulator core
+    // and takes a noticeable share of it steals frame time.
+    const bool shares_emu_core = affinity == tskNO_AFFINITY || affinity == emu_core;
+    if(have_window && shares_emu_core && !is_idle && task.xHandle != emu_task &&
+       task_permille[i] >= PROFILER_STARVE_PERMILLE && starving_len < sizeof(starving)) {
+      const int written = snprintf(starving + starving_len, sizeof(starving) - starving_len, "%s%s",
+                                   starving_len ? "," : "", task.pcTaskName);
+      if(written > 0) {
+        starving_len = std::min(sizeof(starving), starving_len + static_cast<size_t>(written));
+      }
+    }
+    if(!is_idle && stack_free < PROFILER_STACK_LOW_BYTES && low_stack_len < sizeof(low_stack)) {
+      const int written = snprintf(low_stack + low_stack_len, sizeof(low_stack) - low_stack_len, "%s%s",
+                                   low_stack_len ? "," : "", task.pcTaskName);
+      if(written > 0) {
+        low_stack_len = std::min(sizeof(low_stack), low_stack_len + static_cast<size_t>(written));
+      }
+    }
+  }
+  if(starving_len) {
+    append(" STARVE(c%d over=%u)=%s", emu_core,
+           static_cast<unsigned>(g_main_profiler.over_budget_frames), starving);
+  }
+  if(low_stack_len) {
+    append(" LOWSTACK(<%u)=%s", static_cast<unsigned>(PROFILER_STACK_LOW_BYTES), low_stack);
+  }
+#if (configGENERATE_RUN_TIME_STATS != 1)
+  append(" (run-time stats disabled in sdkconfig)");
+#endif
+  Serial.printf("%s\n", line);
+
+  g_task_prev_count = count;
+  g_task_prev_total = total_runtime;
+  for(UBaseType_t i = 0; i < count; ++i) {
+    g_task_prev[i].handle = g_task_status[i].xHandle;
+    g_task_prev[i].runtime = g_task_status[i].ulRunTimeCounter;
+  }
+}
+#else
+static void profiler_log_tasks() {}
+#endif
+
 static void profiler_log(uint64_t now) {
   if(g_main_profiler.frames == 0) {
     g_main_profiler.last_log_us = now;
@@ -6691,6 +9399,14 @@ static void profiler_log(uint64_t now) {
   const double avg_frame = static_cast<double>(g_main_profiler.accum_frame_us) / frames;
   const double avg_poll = static_cast<double>(g_main_profiler.accum_poll_us) / frames;
   const double avg_emu = static_cast<double>(g_main_profiler.accum_emu_us) / frames;
+  const double avg_emu_shown = g_main_profiler.shown_frames
+                                   ? static_cast<double>(g_main_profiler.accum_emu_shown_us) /
+                                         static_cast<double>(g_main_profiler.shown_frames)
+                                   : 0.0;
+  const double avg_emu_skipped = g_main_profiler.skipped_frames
+                                     ? static_cast<double>(g_main_profiler.accum_emu_skipped_us) /
+                                           static_cast<double>(g_main_profiler.skipped_frames)
+                                     : 0.0;
   const double avg_dispatch = static_cast<double>(g_main_profiler.accum_dispatch_us) / frames;
   const double avg_idle = static_cast<double>(g_main_profiler.accum_idle_us) / frames;
   const double avg_idle_requested = static_cast<double>(g_main_profiler.accum_requested_idle_us) / frames;
@@ -6700,7 +9416,21 @@ static void profiler_log(uint64_t now) {
   const double avg_render = render_stats.frames ? static_cast<double>(render_stats.total_us) / render_frames : 0.0;
   const double avg_render_rows = render_stats.frames ? static_cast<double>(render_stats.rows_written) / render_frames : 0.0;
   const double avg_render_segments = render_stats.frames ? static_cast<double>(render_stats.segments_flushed) / render_frames : 0.0;
+  const double avg_render_pixels = render_stats.frames ? static_cast<double>(render_stats.pixels_written) / render_frames : 0.0;
+  const double avg_dma_setup = render_stats.frames ? static_cast<double>(render_stats.dma_setup_total_us) / render_frames : 0.0;
   const double max_render = static_cast<double>(render_stats.max_us);
+  const double avg_latency = render_stats.latency_samples
+                                 ? static_cast<double>(render_stats.latency_total_us) /
+                                       static_cast<double>(render_stats.latency_samples)
+                                 : 0.0;
+  const double max_latency = static_cast<double>(render_stats.latency_max_us);
+  double avg_field_render[3] = {0.0, 0.0, 0.0};
+  for(unsigned int field = 0; field < 3; field++) {
+    if(render_stats.field_frames[field] != 0) {
+      avg_field_render[field] = static_cast<double>(render_stats.field_total_us[field]) /
+                                static_cast<double>(render_stats.field_frames[field]);
+    }
+  }
 
   const size_t rom_hits = priv.rom_cache.cache_hits;
   const size_t rom_misses = priv.rom_cache.cache_misses;
@@ -6756,19 +9486,46 @@ static void profiler_log(uint64_t now) {
 
 #if ENABLE_SOUND
   const size_t audio_backlog = audio_queue_count;
+  const bool audio_sync_paced = g_audio_sync.active && g_audio_sync.paced;
+  const double audio_sync_fill_avg = g_audio_sync.fill_avg;
+  const double audio_sync_ratio = g_audio_sync.ratio;
+  const uint32_t audio_sync_underruns = g_audio_sync.underruns;
+  const uint32_t audio_sync_overruns = g_audio_sync.overruns;
+  const uint32_t audio_sync_stalls = g_audio_sync.stalls;
+  const double audio_latency_ms = audio_output_latency_ms();
+  const uint32_t audio_depth_level = g_audio_depth.applied.load(std::memory_order_relaxed);
+  const uint32_t audio_depth_slow_underruns = g_audio_depth.slow_underruns;
+  uint32_t apu_events_dropped = 0;
+  uint32_t apu_events_peak = 0;
+  audio_event_stats(&apu_events_dropped, &apu_events_peak);
 #else
   const size_t audio_backlog = 0;
+  const bool audio_sync_paced = false;
+  const double audio_sync_fill_avg = 0.0;
+  const double audio_sync_ratio = 1.0;
+  const uint32_t audio_sync_underruns = 0;
+  const uint32_t audio_sync_overruns = 0;
+  const uint32_t audio_sync_stalls = 0;
+  const double audio_latency_ms = 0.0;
+  const uint32_t audio_depth_level = 0;
+  const uint32_t audio_depth_slow_underruns = 0;
+  const uint32_t apu_events_dropped = 0;
+  const uint32_t apu_events_peak = 0;
 #endif
 
   const int cgb_double_speed = gb.cgb.speed_double ? 1 : 0;
 
   Serial.printf(
-    "[PROF] fps=%.2f frame(avg=%.1f max=%llu) poll=%.1f emu=%.1f handoff=%.1f idle=%.1f/%.1f render=%.1f/%.1f (rows=%.1f seg=%.1f) over=%u/%u queue=%u rom=%.1f%% (H=%u M=%u S=%u) romLoad(avg=%.1f us max=%.1f us posix=%.0f%% err=%u/%u fb=%u) audioQ=%u swapFb=%d cgb2x=%d\n",
+    "[PROF] fps=%.2f frame(avg=%.1f max=%llu) poll=%.1f emu=%.1f (shown=%.1f/%u skip=%.1f/%u) handoff=%.1f idle=%.1f/%.1f render=%.1f/%.1f (rows=%.1f seg=%.1f px=%.0f dma=%.1f %s) field(e=%.1f/%u o=%.1f/%u p=%.1f/%u) lat=%.1f/%.1f band=%u over=%u/%u ctl=L%u(F%u I%u S%u IS%u pred=%.0f jit=%.0f) pace(p50=%u p99=%u max=%llu resync=%u drift=%.1fms) sync=%s(fill=%.2f ratio=%.4f under=%u drop=%u stall=%u delay=%.1fms depth=L%u slow=%u) queue=%u rom=%.1f%% (H=%u M=%u S=%u) romLoad(avg=%.1f us max=%.1f us posix=%.0f%% err=%u/%u fb=%u) audioQ=%u apuEv=%u/%u swapFb=%d cgb2x=%d\n",
     fps,
     avg_frame,
     static_cast<unsigned long long>(g_main_profiler.max_frame_us),
     avg_poll,
     avg_emu,
+    avg_emu_shown,
+    static_cast<unsigned>(g_main_profiler.shown_frames),
+    avg_emu_skipped,
+    static_cast<unsigned>(g_main_profiler.skipped_frames),
     avg_dispatch,
     avg_idle,
     avg_idle_requested,
@@ -6776,8 +9533,41 @@ static void profiler_log(uint64_t now) {
     max_render,
     avg_render_rows,
     avg_render_segments,
+    avg_render_pixels,
+    avg_dma_setup,
+    PANEL_WRITE_SWAP ? "swap" : "native",
+    avg_field_render[FRAME_FIELD_EVEN],
+    static_cast<unsigned>(render_stats.field_frames[FRAME_FIELD_EVEN]),
+    avg_field_render[FRAME_FIELD_ODD],
+    static_cast<unsigned>(render_stats.field_frames[FRAME_FIELD_ODD]),
+    avg_field_render[FRAME_FIELD_FULL],
+    static_cast<unsigned>(render_stats.field_frames[FRAME_FIELD_FULL]),
+    avg_latency,
+    max_latency,
+    static_cast<unsigned>(priv.render_band_lines),
     g_main_profiler.over_budget_frames,
     g_main_profiler.frames,
+    static_cast<unsigned>(g_frame_controller.level),
+    static_cast<unsigned>(g_frame_controller.level_frames[FRAME_LEVEL_FULL]),
+    static_cast<unsigned>(g_frame_controller.level_frames[FRAME_LEVEL_INTERLACE]),
+    static_cast<unsigned>(g_frame_controller.level_frames[FRAME_LEVEL_SKIP]),
+    static_cast<unsigned>(g_frame_controller.level_frames[FRAME_LEVEL_INTERLACE_SKIP]),
+    static_cast<double>(frame_controller_level_cost(g_frame_controller, g_frame_controller.level)),
+    static_cast<double>(g_frame_controller.jitter_us),
+    static_cast<unsigned>(log_hist_percentile(g_main_profiler.pace_hist, 500)),
+    static_cast<unsigned>(log_hist_percentile(g_main_profiler.pace_hist, 990)),
+    static_cast<unsigned long long>(g_main_profiler.pace_max_us),
+    static_cast<unsigned>(g_frame_pacer.resyncs),
+    static_cast<double>(g_frame_pacer.dropped_us) / 1000.0,
+    audio_sync_paced ? "audio" : "video",
+    audio_sync_fill_avg,
+    audio_sync_ratio,
+    static_cast<unsigned>(audio_sync_underruns),
+    static_cast<unsigned>(audio_sync_overruns),
+    static_cast<unsigned>(audio_sync_stalls),
+    audio_latency_ms,
+    static_cast<unsigned>(audio_depth_level),
+    static_cast<unsigned>(audio_depth_slow_underruns),
     static_cast<unsigned>(queue_depth),
     rom_hit_rate,
     static_cast<unsigned>(delta_hits),
@@ -6790,8 +9580,14 @@ static void profiler_log(uint64_t now) {
     static_cast<unsigned>(rom_posix_disable),
     static_cast<unsigned>(rom_fallback_loads),
     static_cast<unsigned>(audio_backlog),
+    static_cast<unsigned>(apu_events_peak),
+    static_cast<unsigned>(apu_events_dropped),
     static_cast<int>(swap_fb_enabled),
     cgb_double_speed);
+#if ENABLE_FRAME_HISTOGRAMS
+  frame_hist_log(now);
+#endif
+  profiler_log_tasks();
 
   profiler_reset_main(now);
 }
@@ -6803,6 +9599,7 @@ static void profiler_record_frame(uint64_t frame_us,
                                   uint64_t idle_us,
                                   uint64_t requested_idle_us,
                                   bool over_budget,
+                                  bool frame_skipped,
                                   uint64_t now) {
   g_main_profiler.frames++;
   g_main_profiler.accum_frame_us += frame_us;
@@ -6817,6 +9614,13 @@ static void profiler_record_frame(uint64_t frame_us,
   if(over_budget) {
     g_main_profiler.over_budget_frames++;
   }
+  if(frame_skipped) {
+    g_main_profiler.accum_emu_skipped_us += emu_us;
+    g_main_profiler.skipped_frames++;
+  } else {
+    g_main_profiler.accum_emu_shown_us += emu_us;
+    g_main_profiler.shown_frames++;
+  }
 
   if(g_main_profiler.last_log_us == 0) {
     g_main_profiler.last_log_us = now;
@@ -6908,29 +9712,114 @@ static String format_binding_label(uint8_t key) {
   return String(buffer);
 }
 
-static const char* frame_skip_mode_label(uint8_t mode_value) {
-  FrameSkipMode mode = static_cast<FrameSkipMode>(mode_value);
-  switch(mode) {
-    case FRAME_SKIP_MODE_AUTO:
-      return "Auto";
-    case FRAME_SKIP_MODE_FORCED:
-      return "Forced";
-    case FRAME_SKIP_MODE_DISABLED:
-      return "Off";
+static const char* frame_skip_mode_label(uint8_t mode_value) {
+  FrameSkipMode mode = static_cast<FrameSkipMode>(mode_value);
+  switch(mode) {
+    case FRAME_SKIP_MODE_AUTO:
+      return "Auto";
+    case FRAME_SKIP_MODE_FORCED:
+      return "Forced";
+    case FRAME_SKIP_MODE_DISABLED:
+      return "Off";
+    default:
+      return "Auto";
+  }
+}
+
+static void adjust_frame_skip_mode(int delta) {
+  if(delta == 0) {
+    return;
+  }
+
+  int mode = static_cast<int>(g_settings.frame_skip_mode);
+  const int count = static_cast<int>(FRAME_SKIP_MODE_COUNT);
+  mode = (mode + (delta % count) + count) % count;
+  g_settings.frame_skip_mode = static_cast<uint8_t>(mode);
+}
+
+static const char* pacing_mode_label(uint8_t mode_value) {
+  return mode_value == PACING_MODE_AUDIO ? "Audio" : "Video";
+}
+
+static void adjust_pacing_mode(int delta) {
+  if(delta == 0) {
+    return;
+  }
+
+  int mode = static_cast<int>(g_settings.pacing_mode);
+  const int count = static_cast<int>(PACING_MODE_COUNT);
+  mode = (mode + (delta % count) + count) % count;
+  g_settings.pacing_mode = static_cast<uint8_t>(mode);
+}
+
+static String audio_depth_label(uint8_t level) {
+#if ENABLE_SOUND
+  return String(static_cast<int>(audio_depth_latency_ms(level) + 0.5f)) + " ms (L" + String(level) + ")";
+#else
+  return "L" + String(level);
+#endif
+}
+
+static void adjust_audio_depth(int delta) {
+  const int limit = g_psram_available ? AUDIO_DEPTH_LEVEL_COUNT - 1 : AUDIO_DEPTH_MAX_LEVEL_NO_PSRAM;
+  int level = static_cast<int>(g_settings.audio_depth) + delta;
+  if(level < 0) {
+    level = limit;
+  } else if(level > limit) {
+    level = 0;
+  }
+  g_settings.audio_depth = static_cast<uint8_t>(level);
+}
+
+static const char* audio_quality_label(uint8_t mode) {
+  switch(mode) {
+    case AUDIO_QUALITY_MODE_NATIVE:
+      return "Native";
+    case AUDIO_QUALITY_MODE_HIGH:
+      return "High";
+    default:
+      return "Fast";
+  }
+}
+
+static void adjust_audio_quality(int delta) {
+  int mode = static_cast<int>(g_settings.audio_quality);
+  const int count = static_cast<int>(AUDIO_QUALITY_MODE_COUNT);
+  mode = (mode + (delta % count) + count) % count;
+  g_settings.audio_quality = static_cast<uint8_t>(mode);
+}
+
+static const char* render_band_label(uint8_t band_lines) {
+  switch(band_lines) {
+    case RENDER_BAND_LINES_SMALL:
+      return "8 lines";
+    case RENDER_BAND_LINES_LARGE:
+      return "16 lines";
     default:
-      return "Auto";
+      return "Off";
   }
 }
 
-static void adjust_frame_skip_mode(int delta) {
+static void adjust_render_band_lines(int delta) {
   if(delta == 0) {
     return;
   }
 
-  int mode = static_cast<int>(g_settings.frame_skip_mode);
-  const int count = static_cast<int>(FRAME_SKIP_MODE_COUNT);
-  mode = (mode + (delta % count) + count) % count;
-  g_settings.frame_skip_mode = static_cast<uint8_t>(mode);
+  static constexpr uint8_t kBandChoices[] = {
+    0,
+    RENDER_BAND_LINES_SMALL,
+    RENDER_BAND_LINES_LARGE
+  };
+  constexpr int count = static_cast<int>(sizeof(kBandChoices) / sizeof(kBandChoices[0]));
+  int index = 0;
+  for(int i = 0; i < count; ++i) {
+    if(kBandChoices[i] == g_settings.render_band_lines) {
+      index = i;
+      break;
+    }
+  }
+  index = (index + (delta % count) + count) % count;
+  g_settings.render_band_lines = kBandChoices[index];
 }
 
 static void show_keymap_menu() {
@@ -7132,13 +10021,17 @@ static void show_options_menu() {
     OPTION_CACHE = 3,
     OPTION_VOLUME = 4,
     OPTION_FRAME_SKIP = 5,
+    OPTION_PACING = 6,
+    OPTION_AUDIO_DEPTH = 7,
+    OPTION_AUDIO_QUALITY = 8,
+    OPTION_RENDER_BANDS = 9,
 #if ENABLE_BLUETOOTH_CONTROLLERS
-    OPTION_BLUETOOTH = 6,
-    OPTION_KEYMAP = 7,
-    OPTION_DONE = 8,
+    OPTION_BLUETOOTH = 10,
+    OPTION_KEYMAP = 11,
+    OPTION_DONE = 12,
 #else
-    OPTION_KEYMAP = 6,
-    OPTION_DONE = 7,
+    OPTION_KEYMAP = 10,
+    OPTION_DONE = 11,
 #endif
     OPTION_COUNT
   };
@@ -7178,6 +10071,18 @@ static void show_options_menu() {
   draw_option(OPTION_FRAME_SKIP,
       "Frame skip",
       String(frame_skip_mode_label(g_settings.frame_skip_mode)));
+  draw_option(OPTION_PACING,
+      "Pacing",
+      String(pacing_mode_label(g_settings.pacing_mode)));
+  draw_option(OPTION_AUDIO_DEPTH,
+      "Audio latency",
+      audio_depth_label(g_settings.audio_depth));
+  draw_option(OPTION_AUDIO_QUALITY,
+      "Audio quality",
+      String(audio_quality_label(g_settings.audio_quality)));
+  draw_option(OPTION_RENDER_BANDS,
+      "Render bands",
+      String(render_band_label(g_settings.render_band_lines)));
 #if ENABLE_BLUETOOTH_CONTROLLERS
   draw_option(OPTION_BLUETOOTH,
       "Bluetooth devices",
@@ -7254,6 +10159,26 @@ static void show_options_menu() {
           redraw = true;
           break;
 #endif
+        case OPTION_PACING:
+          adjust_pacing_mode(1);
+          settings_changed = true;
+          redraw = true;
+          break;
+        case OPTION_AUDIO_DEPTH:
+          adjust_audio_depth(1);
+          settings_changed = true;
+          redraw = true;
+          break;
+        case OPTION_AUDIO_QUALITY:
+          adjust_audio_quality(1);
+          settings_changed = true;
+          redraw = true;
+          break;
+        case OPTION_RENDER_BANDS:
+          adjust_render_band_lines(1);
+          settings_changed = true;
+          redraw = true;
+          break;
         case OPTION_KEYMAP:
           wait_for_keyboard_release();
           show_keymap_menu();
@@ -7283,6 +10208,22 @@ static void show_options_menu() {
         adjust_frame_skip_mode(-1);
         settings_changed = true;
         redraw = true;
+      } else if(selection == OPTION_PACING) {
+        adjust_pacing_mode(-1);
+        settings_changed = true;
+        redraw = true;
+      } else if(selection == OPTION_AUDIO_DEPTH) {
+        adjust_audio_depth(-1);
+        settings_changed = true;
+        redraw = true;
+      } else if(selection == OPTION_AUDIO_QUALITY) {
+        adjust_audio_quality(-1);
+        settings_changed = true;
+        redraw = true;
+      } else if(selection == OPTION_RENDER_BANDS) {
+        adjust_render_band_lines(-1);
+        settings_changed = true;
+        redraw = true;
       }
     };
 
@@ -7644,6 +10585,7 @@ static void show_home_menu() {
   M5Cardputer.Display.clearDisplay();
 }
 
+#if !ENABLE_NATIVE_BENCH
 static void show_boot_splash() {
   M5Cardputer.Display.clearDisplay();
   M5Cardputer.Display.fillScreen(0x0000);
@@ -7717,6 +10659,7 @@ static void show_boot_splash() {
 
   M5Cardputer.Display.clearDisplay();
 }
+#endif
 
 static bool has_rom_extension(const String &file_name) {
   int dot_index = file_name.lastIndexOf('.');
@@ -8456,6 +11399,8 @@ static size_t audio_queue_tail = 0;
 static size_t audio_next_fill = 0;
 static bool audio_initialised = false;
 static bool audio_engine_initialised = false;
+// Stereo frames held by the speaker driver's DMA descriptors.
+static uint32_t audio_dma_frames = 0;
 
 static int16_t *audio_alloc_dma_buffer(size_t bytes) {
   const uint32_t caps_order[] = {
@@ -8495,12 +11440,41 @@ static uint32_t audio_select_sample_rate() {
   return 16384u;
 }
 
+// Time stamp for APU register writes: the PPU's position inside the frame
+// gb_run_frame is emulating, at scanline resolution. Frames begin as LY
+// enters VBlank, which is where gb_run_frame returns.
+static uint32_t audio_frame_cycle() {
+  static constexpr uint32_t LINE_CYCLES = 456;
+  static constexpr uint32_t FRAME_LINES = 154;
+  if(gb.hram_io == nullptr) {
+    return 0;
+  }
+  const uint32_t ly = gb.hram_io[IO_LY];
+  return ((ly + FRAME_LINES - LCD_HEIGHT) % FRAME_LINES) * LINE_CYCLES;
+}
+
+// Runs on whichever thread calls audio_callback, so the resampler is never
+// reconfigured in the middle of a render.
+static void audio_quality_apply_pending() {
+  const audio_quality mode = static_cast<audio_quality>(g_settings.audio_quality);
+  if(mode == audio_get_quality()) {
+    return;
+  }
+  audio_set_quality(mode);
+  Serial.printf("Audio quality: %s (synth %u Hz -> %u Hz)\n",
+                audio_quality_label(g_settings.audio_quality),
+                static_cast<unsigned>(audio_get_synth_rate()),
+                static_cast<unsigned>(audio_get_sample_rate()));
+}
+
 static void audioCoreInit(uint32_t sample_rate) {
   audio_set_sample_rate(sample_rate);
   if(!audio_engine_initialised) {
     audio_init();
+    audio_set_cycle_source(&audio_frame_cycle);
     audio_engine_initialised = true;
   }
+  audio_quality_apply_pending();
 }
 
 static void audioTeardown() {
@@ -8548,6 +11522,93 @@ static void apply_speaker_volume() {
   M5Cardputer.Speaker.setAllChannelVolume(volume);
 }
 
+static uint8_t audio_depth_max_level() {
+  return g_psram_available ? AUDIO_DEPTH_LEVEL_COUNT - 1 : AUDIO_DEPTH_MAX_LEVEL_NO_PSRAM;
+}
+
+// DMA descriptor length is capped at one frame buffer and must be even.
+static size_t audio_depth_dma_len(uint8_t level, size_t buffer_samples) {
+  size_t dma_len = AUDIO_DEPTH_LEVELS[level].dma_buf_len;
+  if(buffer_samples != 0 && dma_len > buffer_samples) {
+    dma_len = buffer_samples;
+  }
+  return dma_len & ~static_cast<size_t>(1);
+}
+
+// Expected output latency at `level`: its DMA descriptors plus one queued
+// frame buffer. Before audio starts this uses the rate audioSetup would pick.
+static float audio_depth_latency_ms(uint8_t level) {
+  if(level >= AUDIO_DEPTH_LEVEL_COUNT) {
+    level = AUDIO_DEPTH_LEVEL_COUNT - 1;
+  }
+  const uint32_t sample_rate = audio_initialised ? audio_get_sample_rate() : audio_select_sample_rate();
+  if(sample_rate == 0) {
+    return 0.0f;
+  }
+  const float frame_frames = static_cast<float>(sample_rate) / static_cast<float>(VERTICAL_SYNC);
+  const size_t buffer_samples = static_cast<size_t>(frame_frames) * 2;
+  const float dma_frames = static_cast<float>(audio_depth_dma_len(level, buffer_samples) *
+                                              AUDIO_DEPTH_LEVELS[level].dma_buf_count);
+  return (dma_frames + frame_frames) * 1000.0f / static_cast<float>(sample_rate);
+}
+
+static void audio_depth_note_queue() {
+  if(audio_queue_count != 0) {
+    g_audio_depth.dry = false;
+    return;
+  }
+  if(g_audio_depth.primed && !g_audio_depth.dry) {
+    g_audio_depth.dry = true;
+    g_audio_depth.underruns.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+// audioTask side: restart the speaker with the requested DMA layout. Queued
+// buffers are dropped, so the switch costs one short gap.
+static void audio_depth_apply_pending() {
+  const uint8_t applied = g_audio_depth.applied.load(std::memory_order_relaxed);
+  const uint8_t level = g_audio_depth.requested.load(std::memory_order_acquire);
+  if(level == applied || !audio_initialised) {
+    return;
+  }
+
+  auto cfg = M5Cardputer.Speaker.config();
+  const auto previous = cfg;
+  cfg.dma_buf_len = audio_depth_dma_len(level, audio_samples_per_buffer());
+  cfg.dma_buf_count = AUDIO_DEPTH_LEVELS[level].dma_buf_count;
+  M5Cardputer.Speaker.end();
+  M5Cardputer.Speaker.config(cfg);
+  uint8_t result = level;
+  bool ok = M5Cardputer.Speaker.begin();
+  if(!ok) {
+    Serial.printf("Audio depth L%u: Speaker.begin failed; staying at L%u\n",
+                  static_cast<unsigned>(level),
+                  static_cast<unsigned>(applied));
+    result = applied;
+    M5Cardputer.Speaker.end();
+    M5Cardputer.Speaker.config(previous);
+    ok = M5Cardputer.Speaker.begin();
+  }
+  if(!ok) {
+    Serial.println("Audio depth: speaker restart failed; disabling audio");
+    audioTeardown();
+    return;
+  }
+
+  for(size_t i = 0; i < AUDIO_BUFFER_COUNT; ++i) {
+    audio_buffer_state[i] = 0;
+  }
+  audio_queue_head = audio_queue_tail = audio_queue_count = 0;
+  audio_next_fill = 0;
+  audio_dma_frames = static_cast<uint32_t>(M5Cardputer.Speaker.config().dma_buf_len *
+                                           M5Cardputer.Speaker.config().dma_buf_count);
+  apply_speaker_volume();
+  g_audio_depth.primed = false;
+  g_audio_depth.dry = false;
+  g_audio_depth.requested.store(result, std::memory_order_relaxed);
+  g_audio_depth.applied.store(result, std::memory_order_release);
+}
+
 static void audioSetup() {
   audioTeardown();
 
@@ -8563,21 +11624,12 @@ static void audioSetup() {
   Serial.printf("audioSetup: requested sample rate %u Hz (psram=%s)\n",
                 (unsigned)requested_rate,
                 g_psram_available ? "yes" : "no");
-  size_t dma_len = audio_samples_per_buffer();
-  if(dma_len > 1024) {
-    dma_len = 1024;
-  }
-  if(!g_psram_available) {
-    if(dma_len > 512) {
-      dma_len = 512;
-    }
-    cfg.dma_buf_count = 4;
-  }
-  dma_len &= ~1u; // must be even
-  cfg.dma_buf_len = dma_len;
-  if(g_psram_available) {
-    cfg.dma_buf_count = 12;
+  uint8_t depth = g_settings.audio_depth;
+  if(depth > audio_depth_max_level()) {
+    depth = audio_depth_max_level();
   }
+  cfg.dma_buf_len = audio_depth_dma_len(depth, audio_samples_per_buffer());
+  cfg.dma_buf_count = AUDIO_DEPTH_LEVELS[depth].dma_buf_count;
   cfg.task_priority = tskIDLE_PRIORITY + 4;
   cfg.task_pinned_core = 0;
   cfg.use_dac = false;
@@ -8588,101 +11640,738 @@ static void audioSetup() {
   if(cfg.pin_data_out < 0) {
     cfg.pin_data_out = 42;
   }
-  if(cfg.pin_bck < 0) {
-    cfg.pin_bck = 41;
+  if(cfg.pin_bck < 0) {
+    cfg.pin_bck = 41;
+  }
+  if(cfg.pin_ws < 0) {
+    cfg.pin_ws = 43;
+  }
+  if(cfg.pin_mck < 0) {
+    cfg.pin_mck = -1;
+  }
+
+  Serial.printf("audioSetup: using I2S data_out=%d bck=%d ws=%d mck=%d (adv=%s)\n",
+                cfg.pin_data_out,
+                cfg.pin_bck,
+                cfg.pin_ws,
+                cfg.pin_mck,
+                g_is_cardputer_adv ? "yes" : "no");
+
+  M5Cardputer.Speaker.end();
+  M5Cardputer.Speaker.config(cfg);
+  audio_initialised = M5Cardputer.Speaker.begin();
+  Serial.printf("Speaker.begin (stereo) data_out=%d bck=%d ws=%d mck=%d -> %s\n",
+                cfg.pin_data_out,
+                cfg.pin_bck,
+                cfg.pin_ws,
+                cfg.pin_mck,
+                audio_initialised ? "OK" : "FAIL");
+
+  if(!audio_initialised) {
+  cfg.pin_data_out = base_cfg.pin_data_out >= 0 ? base_cfg.pin_data_out : 42;
+    cfg.stereo = false;
+    M5Cardputer.Speaker.end();
+    M5Cardputer.Speaker.config(cfg);
+    audio_initialised = M5Cardputer.Speaker.begin();
+    Serial.printf("Speaker.begin retry mono data_out=%d bck=%d ws=%d mck=%d -> %s\n",
+                  cfg.pin_data_out,
+                  cfg.pin_bck,
+                  cfg.pin_ws,
+                  cfg.pin_mck,
+                  audio_initialised ? "OK" : "FAIL");
+  }
+
+  if(!audio_initialised) {
+    Serial.println("Speaker.begin() failed; restoring default config and disabling audio");
+    M5Cardputer.Speaker.config(base_cfg);
+    audioTeardown();
+    return;
+  }
+
+  const uint32_t actual_sample_rate = M5Cardputer.Speaker.config().sample_rate;
+  if(actual_sample_rate != audio_get_sample_rate()) {
+    Serial.printf("audioSetup: speaker adjusted sample rate %u -> %u\n",
+                  (unsigned)audio_get_sample_rate(),
+                  (unsigned)actual_sample_rate);
+    audio_set_sample_rate(actual_sample_rate);
+  }
+
+  const size_t interleaved_samples = audio_samples_per_buffer();
+  const size_t buffer_bytes = interleaved_samples * sizeof(int16_t);
+  bool buffer_ok = true;
+  Serial.printf("Audio memory (before alloc): internal DMA=%u bytes, psram DMA=%u bytes\n",
+                (unsigned)heap_caps_get_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA | MALLOC_CAP_8BIT),
+                (unsigned)heap_caps_get_free_size(MALLOC_CAP_SPIRAM | MALLOC_CAP_DMA | MALLOC_CAP_8BIT));
+  for(size_t i = 0; i < AUDIO_BUFFER_COUNT; ++i) {
+    audio_buffers[i] = audio_alloc_dma_buffer(buffer_bytes);
+    if(audio_buffers[i] == nullptr) {
+      buffer_ok = false;
+      break;
+    }
+    memset(audio_buffers[i], 0, buffer_bytes);
+    audio_buffer_state[i] = 0;
+  }
+
+  if(!buffer_ok) {
+    Serial.println("Audio buffer allocation failed; disabling audio");
+    audioTeardown();
+    return;
+  }
+
+  M5Cardputer.Speaker.setVolume(255);
+  M5Cardputer.Speaker.setAllChannelVolume(255);
+  audio_dma_frames = static_cast<uint32_t>(M5Cardputer.Speaker.config().dma_buf_len *
+                                           M5Cardputer.Speaker.config().dma_buf_count);
+  g_audio_depth.requested.store(depth, std::memory_order_relaxed);
+  g_audio_depth.applied.store(depth, std::memory_order_release);
+  g_audio_depth.primed = false;
+  g_audio_depth.dry = false;
+
+  Serial.printf("audioSetup: init=%d sample_rate=%u stereo=%d dma_len=%u dma_count=%u frames=%u depth=L%u\n",
+                (int)audio_initialised,
+                (unsigned)M5Cardputer.Speaker.config().sample_rate,
+                (int)M5Cardputer.Speaker.config().stereo,
+                (unsigned)M5Cardputer.Speaker.config().dma_buf_len,
+                (unsigned)M5Cardputer.Speaker.config().dma_buf_count,
+                (unsigned)audio_samples_per_frame(),
+                (unsigned)depth);
+
+  audio_release_finished();
+  audioPump();
+  apply_speaker_volume();
+}
+
+// Ring target, in speaker buffers (one video frame of audio each), sampled
+// when a frame's audio is produced. The emulator blocks once the ring holds
+// AUDIO_SYNC_BLOCK_BUFFERS; the resampling correction keeps the fill centred
+// below that so the wait stays short and regular instead of alternating
+// between long stalls and back-to-back frames. Video pacing produces on its
+// own clock with frame-time jitter, so it keeps a deeper reserve.
+static constexpr float AUDIO_SYNC_TARGET_BUFFERS = 1.0f;
+static constexpr float AUDIO_SYNC_VIDEO_TARGET_BUFFERS = 2.0f;
+static constexpr float AUDIO_SYNC_BLOCK_BUFFERS = 1.5f;
+static constexpr uint32_t AUDIO_SYNC_RING_BUFFERS = 4;
+static constexpr float AUDIO_SYNC_MAX_CORRECTION = 0.005f;
+static constexpr float AUDIO_SYNC_FILL_ALPHA = 0.0625f;
+static constexpr uint32_t AUDIO_SYNC_STALL_TIMEOUT_MS = 50;
+
+static inline uint32_t audio_sync_fill() {
+  return g_audio_sync.write_pos.load(std::memory_order_acquire) -
+         g_audio_sync.read_pos.load(std::memory_order_acquire);
+}
+
+static void audio_sync_configure(bool enable, bool paced) {
+  g_audio_sync.active = false;
+  g_audio_sync.paced = false;
+  if(!enable) {
+    return;
+  }
+
+  const uint32_t buffer_samples = audio_samples_per_buffer();
+  // Headroom for the resampler stretching a frame past one buffer, rounded
+  // up to a power of two so the free-running counters wrap cleanly at 2^32
+  // and index with a mask.
+  const uint32_t wanted = buffer_samples * AUDIO_SYNC_RING_BUFFERS + 64;
+  const uint32_t capacity = 1u << (32u - static_cast<uint32_t>(__builtin_clz(wanted - 1u)));
+  if(g_audio_sync.ring == nullptr || g_audio_sync.capacity != capacity) {
+    if(g_audio_sync.ring != nullptr) {
+      heap_caps_free(g_audio_sync.ring);
+    }
+    if(g_audio_sync.scratch != nullptr) {
+      heap_caps_free(g_audio_sync.scratch);
+    }
+    g_audio_sync.ring = reinterpret_cast<int16_t *>(
+        heap_caps_malloc(capacity * sizeof(int16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+    g_audio_sync.scratch = reinterpret_cast<int16_t *>(
+        heap_caps_malloc(buffer_samples * sizeof(int16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+    g_audio_sync.capacity = capacity;
+    g_audio_sync.mask = capacity - 1;
+  }
+  if(g_audio_sync.ring == nullptr || g_audio_sync.scratch == nullptr) {
+    Serial.println("Audio ring allocation failed; rendering audio on the audio task");
+    return;
+  }
+
+  g_audio_sync.write_pos.store(0, std::memory_order_relaxed);
+  g_audio_sync.read_pos.store(0, std::memory_order_relaxed);
+  g_audio_sync.emu_task = xTaskGetCurrentTaskHandle();
+  g_audio_sync.target_buffers = paced ? AUDIO_SYNC_TARGET_BUFFERS : AUDIO_SYNC_VIDEO_TARGET_BUFFERS;
+  g_audio_sync.fill_avg = g_audio_sync.target_buffers;
+  g_audio_sync.ratio = 1.0f;
+  g_audio_sync.frac = 0.0f;
+  g_audio_sync.underruns = 0;
+  g_audio_sync.overruns = 0;
+  g_audio_sync.stalls = 0;
+  g_audio_sync.starving = false;
+  g_audio_sync.paced = paced;
+  g_audio_sync.active = true;
+  Serial.printf("Audio ring enabled: ring=%u samples target=%.1f buffers pacing=%s\n",
+                static_cast<unsigned>(capacity),
+                static_cast<double>(g_audio_sync.target_buffers),
+                paced ? "audio" : "video");
+}
+
+#if ENABLE_AUDIO_CAPTURE
+// WAV capture of the emulator's audio. audio_sync_produce_frame renders each
+// frame straight into a capture block, so recording adds no copy to the
+// audio path. Full blocks are queued to audioCaptureTask, which appends them
+// to a preallocated file with sector-aligned writes. The main loop never
+// waits on the card: when every block is still queued for writing, the frame
+// is left out of the file and counted as dropped.
+static constexpr const char *RECORDINGS_DIR = "/recordings";
+static constexpr size_t AUDIO_CAPTURE_SECTOR = 512;
+static constexpr size_t AUDIO_CAPTURE_BLOCK_BYTES = 16384;
+static constexpr uint8_t AUDIO_CAPTURE_BLOCKS_PSRAM = 8;
+static constexpr uint8_t AUDIO_CAPTURE_BLOCKS_INTERNAL = 3;
+static constexpr uint8_t AUDIO_CAPTURE_STOP = 0xFF;
+// The file grows in steps of this much (~24 s at 44.1 kHz) so the FAT
+// allocation happens once per step rather than on every write.
+static constexpr uint32_t AUDIO_CAPTURE_PREALLOC_BYTES = 4u * 1024u * 1024u;
+// How often the writer rewrites the header, so a capture cut short by a
+// reset or power loss still opens.
+static constexpr uint32_t AUDIO_CAPTURE_HEADER_SYNC_MS = 5000;
+static constexpr uint32_t AUDIO_CAPTURE_TASK_STACK_SIZE = 4096;
+
+// One sector: RIFF and fmt chunks, then a JUNK chunk that pads the data
+// chunk's samples onto the next sector.
+struct WavCaptureHeader {
+  char riff_id[4];
+  uint32_t riff_size;
+  char wave_id[4];
+  char fmt_id[4];
+  uint32_t fmt_size;
+  uint16_t format;
+  uint16_t channels;
+  uint32_t sample_rate;
+  uint32_t byte_rate;
+  uint16_t block_align;
+  uint16_t bits_per_sample;
+  char junk_id[4];
+  uint32_t junk_size;
+  uint8_t junk[AUDIO_CAPTURE_SECTOR - 52];
+  char data_id[4];
+  uint32_t data_size;
+} __attribute__((packed));
+
+static_assert(sizeof(WavCaptureHeader) == AUDIO_CAPTURE_SECTOR, "WAV header must fill one sector");
+
+struct AudioCaptureBlock {
+  uint8_t index;                    // AUDIO_CAPTURE_STOP ends the capture
+  uint32_t bytes;
+};
+
+enum class AudioCaptureMode : uint8_t {
+  Idle = 0,
+  Recording,
+  Finishing                         // writer task still closing the file
+};
+
+struct AudioCaptureState {
+  std::atomic<uint8_t> mode;
+  std::atomic<bool> write_failed;
+  std::atomic<bool> finished;       // writer done; main loop reports it
+  char path[MAX_PATH_LEN];
+  uint8_t *blocks[AUDIO_CAPTURE_BLOCKS_PSRAM];
+  uint8_t block_count;
+  QueueHandle_t free_blocks;
+  QueueHandle_t full_blocks;
+  TaskHandle_t task;
+  uint32_t sample_rate;
+  int current;                      // main loop: block being filled, -1 if none
+  uint32_t used;
+  uint32_t frames;
+  uint32_t dropped_frames;
+  uint32_t drop_runs;
+  bool dropping;
+  File file;                        // writer task only while a capture runs
+  uint32_t data_bytes;
+  uint32_t file_bytes;              // preallocated length
+  uint32_t writes;
+  uint32_t max_write_us;
+  uint32_t min_free_blocks;
+  bool file_ok;
+};
+
+static AudioCaptureState g_audio_capture = {};
+
+static bool audio_capture_write_header(uint32_t riff_size) {
+  AudioCaptureState &cap = g_audio_capture;
+  WavCaptureHeader header = {};
+  memcpy(header.riff_id, "RIFF", 4);
+  header.riff_size = riff_size;
+  memcpy(header.wave_id, "WAVE", 4);
+  memcpy(header.fmt_id, "fmt ", 4);
+  header.fmt_size = 16;
+  header.format = 1;
+  header.channels = 2;
+  header.sample_rate = cap.sample_rate;
+  header.byte_rate = cap.sample_rate * 4;
+  header.block_align = 4;
+  header.bits_per_sample = 16;
+  memcpy(header.junk_id, "JUNK", 4);
+  header.junk_size = sizeof(header.junk);
+  memcpy(header.data_id, "data", 4);
+  header.data_size = cap.data_bytes;
+  return cap.file.seek(0) &&
+         cap.file.write(reinterpret_cast<const uint8_t *>(&header), sizeof(header)) == sizeof(header);
+}
+
+// Extends the file so at least `bytes` of data plus a chunk header fit.
+static bool audio_capture_reserve(uint32_t bytes) {
+  AudioCaptureState &cap = g_audio_capture;
+  const uint32_t data_end = AUDIO_CAPTURE_SECTOR + cap.data_bytes;
+  if(data_end + bytes + 8 <= cap.file_bytes) {
+    return true;
+  }
+  const uint32_t target = cap.file_bytes + AUDIO_CAPTURE_PREALLOC_BYTES;
+  const uint8_t zero = 0;
+  if(!cap.file.seek(target - 1) || cap.file.write(&zero, 1) != 1) {
+    return false;
+  }
+  cap.file_bytes = target;
+  return cap.file.seek(data_end);
+}
+
+// Writer side: the trailing preallocated space becomes a JUNK chunk so the
+// file stays a valid RIFF without truncating it.
+static bool audio_capture_close_file() {
+  AudioCaptureState &cap = g_audio_capture;
+  bool ok = cap.file_ok;
+  if(ok) {
+    const uint32_t data_end = AUDIO_CAPTURE_SECTOR + cap.data_bytes;
+    const uint32_t tail[2] = {0x4B4E554Au, cap.file_bytes - data_end - 8};  // "JUNK"
+    ok = cap.file.seek(data_end) &&
+         cap.file.write(reinterpret_cast<const uint8_t *>(tail), sizeof(tail)) == sizeof(tail) &&
+         audio_capture_write_header(cap.file_bytes - 8);
+  }
+  cap.file.close();
+  return ok;
+}
+
+static void audio_capture_release() {
+  AudioCaptureState &cap = g_audio_capture;
+  // block_count is kept for the final report.
+  for(uint8_t i = 0; i < AUDIO_CAPTURE_BLOCKS_PSRAM; ++i) {
+    if(cap.blocks[i] != nullptr) {
+      heap_caps_free(cap.blocks[i]);
+      cap.blocks[i] = nullptr;
+    }
+  }
+  if(cap.free_blocks != nullptr) {
+    vQueueDelete(cap.free_blocks);
+    cap.free_blocks = nullptr;
+  }
+  if(cap.full_blocks != nullptr) {
+    vQueueDelete(cap.full_blocks);
+    cap.full_blocks = nullptr;
+  }
+}
+
+static void audioCaptureTask(void *param) {
+  (void)param;
+  AudioCaptureState &cap = g_audio_capture;
+  uint32_t last_sync_ms = millis();
+  AudioCaptureBlock block;
+  while(xQueueReceive(cap.full_blocks, &block, portMAX_DELAY) == pdTRUE) {
+    if(block.index == AUDIO_CAPTURE_STOP) {
+      break;
+    }
+    if(cap.file_ok) {
+      const uint32_t start_us = micros();
+      cap.file_ok = audio_capture_reserve(block.bytes) &&
+                    cap.file.write(cap.blocks[block.index], block.bytes) == block.bytes;
+      const uint32_t elapsed_us = micros() - start_us;
+      if(elapsed_us > cap.max_write_us) {
+        cap.max_write_us = elapsed_us;
+      }
+      if(cap.file_ok) {
+        cap.data_bytes += block.bytes;
+        cap.writes++;
+      } else {
+        cap.write_failed.store(true, std::memory_order_relaxed);
+      }
+    }
+    const uint32_t now_ms = millis();
+    if(cap.file_ok && now_ms - last_sync_ms >= AUDIO_CAPTURE_HEADER_SYNC_MS) {
+      last_sync_ms = now_ms;
+      cap.file_ok = audio_capture_write_header(AUDIO_CAPTURE_SECTOR + cap.data_bytes - 8) &&
+                    cap.file.seek(AUDIO_CAPTURE_SECTOR + cap.data_bytes);
+      cap.file.flush();
+    }
+    xQueueSend(cap.free_blocks, &block.index, 0);
+  }
+
+  cap.file_ok = audio_capture_close_file();
+  audio_capture_release();
+  cap.task = nullptr;
+  cap.finished.store(true, std::memory_order_release);
+  cap.mode.store(static_cast<uint8_t>(AudioCaptureMode::Idle), std::memory_order_release);
+  vTaskDelete(nullptr);
+}
+
+static bool build_audio_capture_path(char *out, size_t out_len) {
+  char identifier[64];
+  build_screenshot_identifier(&priv, identifier, sizeof(identifier));
+  char timestamp[32];
+  format_screenshot_timestamp(timestamp, sizeof(timestamp));
+  for(uint32_t index = 0; index < 1000; ++index) {
+    const int written = index == 0
+        ? snprintf(out, out_len, "%s/%s_%s.wav", RECORDINGS_DIR, identifier, timestamp)
+        : snprintf(out, out_len, "%s/%s_%s_%02u.wav", RECORDINGS_DIR, identifier, timestamp,
+                   static_cast<unsigned>(index));
+    if(written > 0 && static_cast<size_t>(written) < out_len && !SD.exists(out)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Main loop side: reports a capture the writer task has finished closing.
+static void audio_capture_poll() {
+  AudioCaptureState &cap = g_audio_capture;
+  if(cap.write_failed.load(std::memory_order_relaxed) &&
+     cap.mode.load(std::memory_order_relaxed) == static_cast<uint8_t>(AudioCaptureMode::Recording)) {
+    Serial.println("WAV capture: SD write failed; stopping");
+    audio_capture_toggle();
+  }
+  if(!cap.finished.exchange(false, std::memory_order_acquire)) {
+    return;
+  }
+  const float seconds = cap.sample_rate != 0
+      ? static_cast<float>(cap.data_bytes / 4) / static_cast<float>(cap.sample_rate) : 0.0f;
+  const uint32_t frame_ms = static_cast<uint32_t>(1000.0f / static_cast<float>(VERTICAL_SYNC) + 0.5f);
+  Serial.printf("WAV capture: %s %s %.1f s (%lu frames), dropped %lu frames (~%lu ms) in %lu runs, "
+                "%lu writes max=%lu us, min free blocks=%lu/%u\n",
+                cap.file_ok ? "saved" : "FAILED",
+                cap.path,
+                static_cast<double>(seconds),
+                static_cast<unsigned long>(cap.frames),
+                static_cast<unsigned long>(cap.dropped_frames),
+                static_cast<unsigned long>(cap.dropped_frames * frame_ms),
+                static_cast<unsigned long>(cap.drop_runs),
+                static_cast<unsigned long>(cap.writes),
+                static_cast<unsigned long>(cap.max_write_us),
+                static_cast<unsigned long>(cap.min_free_blocks),
+                static_cast<unsigned>(cap.block_count));
+  char message[64];
+  if(!cap.file_ok) {
+    snprintf(message, sizeof(message), "Recording failed: SD write");
+  } else if(cap.dropped_frames != 0) {
+    snprintf(message, sizeof(message), "Recording saved (%lu frames dropped)",
+             static_cast<unsigned long>(cap.dropped_frames));
+  } else {
+    snprintf(message, sizeof(message), "Recording saved (%.0f s)", static_cast<double>(seconds));
+  }
+  show_status_message(message,
+                      cap.file_ok ? (cap.dropped_frames != 0 ? StatusMessageKind::Info : StatusMessageKind::Success)
+                                  : StatusMessageKind::Error);
+}
+
+static void audio_capture_start() {
+  AudioCaptureState &cap = g_audio_capture;
+  audio_capture_poll();
+  if(!g_audio_sync.active) {
+    show_status_message("Recording needs audio on", StatusMessageKind::Error);
+    return;
+  }
+  if(!ensure_sd_card(false) || (!SD.exists(RECORDINGS_DIR) && !SD.mkdir(RECORDINGS_DIR))) {
+    show_status_message("Recording failed: SD required", StatusMessageKind::Error);
+    return;
+  }
+  if(!build_audio_capture_path(cap.path, sizeof(cap.path))) {
+    show_status_message("Recording failed: name", StatusMessageKind::Error);
+    return;
+  }
+
+  const bool psram = g_psram_available;
+  const uint8_t wanted = psram ? AUDIO_CAPTURE_BLOCKS_PSRAM : AUDIO_CAPTURE_BLOCKS_INTERNAL;
+  const uint32_t caps = psram ? (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT) : (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  cap.block_count = 0;
+  while(cap.block_count < wanted) {
+    uint8_t *block = static_cast<uint8_t *>(heap_caps_malloc(AUDIO_CAPTURE_BLOCK_BYTES, caps));
+    if(block == nullptr) {
+      break;
+    }
+    cap.blocks[cap.block_count++] = block;
+  }
+  cap.free_blocks = xQueueCreate(AUDIO_CAPTURE_BLOCKS_PSRAM, sizeof(uint8_t));
+  cap.full_blocks = xQueueCreate(AUDIO_CAPTURE_BLOCKS_PSRAM + 1, sizeof(AudioCaptureBlock));
+  if(cap.block_count < 2 || cap.free_blocks == nullptr || cap.full_blocks == nullptr) {
+    audio_capture_release();
+    show_status_message("Recording failed: memory", StatusMessageKind::Error);
+    return;
   }
-  if(cfg.pin_ws < 0) {
-    cfg.pin_ws = 43;
+  for(uint8_t i = 1; i < cap.block_count; ++i) {
+    xQueueSend(cap.free_blocks, &i, 0);
+  }
+
+  // The renderer produces audio_samples_per_frame() frames per video frame;
+  // the header carries that exact rate so the file plays at game speed.
+  cap.sample_rate = static_cast<uint32_t>(audio_samples_per_frame() * VERTICAL_SYNC + 0.5);
+  cap.data_bytes = 0;
+  cap.file_bytes = 0;
+  cap.file = SD.open(cap.path, FILE_WRITE);
+  cap.file_ok = cap.file && audio_capture_write_header(AUDIO_CAPTURE_SECTOR - 8) &&
+                audio_capture_reserve(AUDIO_CAPTURE_BLOCK_BYTES);
+  if(!cap.file_ok) {
+    cap.file.close();
+    SD.remove(cap.path);
+    audio_capture_release();
+    Serial.printf("WAV capture: cannot create %s\n", cap.path);
+    show_status_message("Recording failed: SD write", StatusMessageKind::Error);
+    return;
   }
-  if(cfg.pin_mck < 0) {
-    cfg.pin_mck = -1;
+
+  cap.current = 0;
+  cap.used = 0;
+  cap.frames = 0;
+  cap.dropped_frames = 0;
+  cap.drop_runs = 0;
+  cap.dropping = false;
+  cap.writes = 0;
+  cap.max_write_us = 0;
+  cap.min_free_blocks = cap.block_count - 1;
+  cap.write_failed.store(false, std::memory_order_relaxed);
+  cap.finished.store(false, std::memory_order_relaxed);
+  cap.mode.store(static_cast<uint8_t>(AudioCaptureMode::Recording), std::memory_order_release);
+  if(xTaskCreatePinnedToCore(audioCaptureTask,
+                             "AudioCapture",
+                             AUDIO_CAPTURE_TASK_STACK_SIZE,
+                             nullptr,
+                             tskIDLE_PRIORITY + 2,
+                             &cap.task,
+                             0) != pdPASS) {
+    cap.task = nullptr;
+    cap.mode.store(static_cast<uint8_t>(AudioCaptureMode::Idle), std::memory_order_relaxed);
+    cap.file.close();
+    SD.remove(cap.path);
+    audio_capture_release();
+    Serial.println("WAV capture: task creation failed");
+    show_status_message("Recording failed: task", StatusMessageKind::Error);
+    return;
   }
 
-  Serial.printf("audioSetup: using I2S data_out=%d bck=%d ws=%d mck=%d (adv=%s)\n",
-                cfg.pin_data_out,
-                cfg.pin_bck,
-                cfg.pin_ws,
-                cfg.pin_mck,
-                g_is_cardputer_adv ? "yes" : "no");
+  Serial.printf("WAV capture: recording %s (%lu Hz stereo, %u x %u byte blocks in %s)\n",
+                cap.path,
+                static_cast<unsigned long>(cap.sample_rate),
+                static_cast<unsigned>(cap.block_count),
+                static_cast<unsigned>(AUDIO_CAPTURE_BLOCK_BYTES),
+                psram ? "PSRAM" : "internal RAM");
+  show_status_message("Recording audio", StatusMessageKind::Info);
+}
 
-  M5Cardputer.Speaker.end();
-  M5Cardputer.Speaker.config(cfg);
-  audio_initialised = M5Cardputer.Speaker.begin();
-  Serial.printf("Speaker.begin (stereo) data_out=%d bck=%d ws=%d mck=%d -> %s\n",
-                cfg.pin_data_out,
-                cfg.pin_bck,
-                cfg.pin_ws,
-                cfg.pin_mck,
-                audio_initialised ? "OK" : "FAIL");
+// Hands the partly filled block and the stop marker to the writer task.
+static void audio_capture_stop() {
+  AudioCaptureState &cap = g_audio_capture;
+  if(cap.current >= 0 && cap.used > 0) {
+    const AudioCaptureBlock block = {static_cast<uint8_t>(cap.current), cap.used};
+    xQueueSend(cap.full_blocks, &block, 0);
+  }
+  cap.current = -1;
+  cap.mode.store(static_cast<uint8_t>(AudioCaptureMode::Finishing), std::memory_order_release);
+  const AudioCaptureBlock stop = {AUDIO_CAPTURE_STOP, 0};
+  xQueueSend(cap.full_blocks, &stop, 0);
+  show_status_message("Saving recording...", StatusMessageKind::Info);
+}
 
-  if(!audio_initialised) {
-  cfg.pin_data_out = base_cfg.pin_data_out >= 0 ? base_cfg.pin_data_out : 42;
-    cfg.stereo = false;
-    M5Cardputer.Speaker.end();
-    M5Cardputer.Speaker.config(cfg);
-    audio_initialised = M5Cardputer.Speaker.begin();
-    Serial.printf("Speaker.begin retry mono data_out=%d bck=%d ws=%d mck=%d -> %s\n",
-                  cfg.pin_data_out,
-                  cfg.pin_bck,
-                  cfg.pin_ws,
-                  cfg.pin_mck,
-                  audio_initialised ? "OK" : "FAIL");
+static void audio_capture_toggle() {
+  switch(static_cast<AudioCaptureMode>(g_audio_capture.mode.load(std::memory_order_acquire))) {
+    case AudioCaptureMode::Idle:
+      audio_capture_start();
+      break;
+    case AudioCaptureMode::Recording:
+      audio_capture_stop();
+      break;
+    case AudioCaptureMode::Finishing:
+      show_status_message("Recording still saving", StatusMessageKind::Info);
+      break;
   }
+}
 
-  if(!audio_initialised) {
-    Serial.println("Speaker.begin() failed; restoring default config and disabling audio");
-    M5Cardputer.Speaker.config(base_cfg);
-    audioTeardown();
+// Main loop: where the next `bytes` of rendered audio should go, or nullptr
+// when not recording or when no block is free (the frame is then dropped
+// from the file). When the current block is full, its whole sectors go to
+// the writer and the sub-sector tail moves to the start of the next block.
+static int16_t *audio_capture_frame_target(uint32_t bytes) {
+  AudioCaptureState &cap = g_audio_capture;
+  if(cap.mode.load(std::memory_order_relaxed) != static_cast<uint8_t>(AudioCaptureMode::Recording) ||
+     bytes > AUDIO_CAPTURE_BLOCK_BYTES - AUDIO_CAPTURE_SECTOR) {
+    return nullptr;
+  }
+  if(cap.used + bytes <= AUDIO_CAPTURE_BLOCK_BYTES) {
+    return reinterpret_cast<int16_t *>(cap.blocks[cap.current] + cap.used);
+  }
+
+  uint8_t next = 0;
+  if(xQueueReceive(cap.free_blocks, &next, 0) != pdTRUE) {
+    cap.dropped_frames++;
+    if(!cap.dropping) {
+      cap.dropping = true;
+      cap.drop_runs++;
+      Serial.println("WAV capture: SD behind, dropping audio");
+    }
+    return nullptr;
+  }
+  cap.dropping = false;
+  const uint32_t waiting = static_cast<uint32_t>(uxQueueMessagesWaiting(cap.free_blocks));
+  if(waiting < cap.min_free_blocks) {
+    cap.min_free_blocks = waiting;
+  }
+
+  const uint32_t aligned = cap.used & ~static_cast<uint32_t>(AUDIO_CAPTURE_SECTOR - 1);
+  const uint32_t carry = cap.used - aligned;
+  memcpy(cap.blocks[next], cap.blocks[cap.current] + aligned, carry);
+  const AudioCaptureBlock full = {static_cast<uint8_t>(cap.current), aligned};
+  xQueueSend(cap.full_blocks, &full, 0);
+  cap.current = next;
+  cap.used = carry;
+  return reinterpret_cast<int16_t *>(cap.blocks[cap.current] + cap.used);
+}
+
+static inline void audio_capture_commit(uint32_t bytes) {
+  g_audio_capture.used += bytes;
+  g_audio_capture.frames++;
+}
+#endif
+
+// Main loop side: render one frame of audio at the nominal rate, then
+// linearly resample it to the corrected length and append it to the ring.
+static void audio_sync_produce_frame() {
+  const uint32_t buffer_samples = audio_samples_per_buffer();
+  const uint32_t in_frames = buffer_samples / 2;
+  if(in_frames == 0) {
     return;
   }
+  audio_quality_apply_pending();
+  const uint32_t buffer_bytes = buffer_samples * sizeof(int16_t);
+  int16_t *rendered = g_audio_sync.scratch;
+#if ENABLE_AUDIO_CAPTURE
+  int16_t *capture = audio_capture_frame_target(buffer_bytes);
+  if(capture != nullptr) {
+    rendered = capture;
+  }
+#endif
+  audio_callback(nullptr, reinterpret_cast<uint8_t *>(rendered), static_cast<int>(buffer_bytes));
+#if ENABLE_AUDIO_CAPTURE
+  if(capture != nullptr) {
+    audio_capture_commit(buffer_bytes);
+  }
+#endif
 
-  const uint32_t actual_sample_rate = M5Cardputer.Speaker.config().sample_rate;
-  if(actual_sample_rate != audio_get_sample_rate()) {
-    Serial.printf("audioSetup: speaker adjusted sample rate %u -> %u\n",
-                  (unsigned)audio_get_sample_rate(),
-                  (unsigned)actual_sample_rate);
-    audio_set_sample_rate(actual_sample_rate);
+  const uint32_t fill = audio_sync_fill();
+  const float fill_buffers = static_cast<float>(fill) / static_cast<float>(buffer_samples);
+  g_audio_sync.fill_avg += (fill_buffers - g_audio_sync.fill_avg) * AUDIO_SYNC_FILL_ALPHA;
+  const float target = g_audio_sync.target_buffers;
+  float error = (target - g_audio_sync.fill_avg) / target;
+  if(error > 1.0f) {
+    error = 1.0f;
+  } else if(error < -1.0f) {
+    error = -1.0f;
+  }
+  g_audio_sync.ratio = 1.0f + AUDIO_SYNC_MAX_CORRECTION * error;
+
+  // The exact rate/VERTICAL_SYNC length also removes the rounding in
+  // audio_samples_per_frame().
+  const float exact_frames = static_cast<float>(audio_get_sample_rate()) /
+                             static_cast<float>(VERTICAL_SYNC);
+  g_audio_sync.frac += exact_frames * g_audio_sync.ratio;
+  uint32_t out_frames = static_cast<uint32_t>(g_audio_sync.frac);
+  g_audio_sync.frac -= static_cast<float>(out_frames);
+
+  const uint32_t space = g_audio_sync.capacity - fill;
+  if(out_frames * 2 > space) {
+    g_audio_sync.overruns++;
+    out_frames = space / 2;
+  }
+  if(out_frames == 0) {
+    return;
   }
 
-  const size_t interleaved_samples = audio_samples_per_buffer();
-  const size_t buffer_bytes = interleaved_samples * sizeof(int16_t);
-  bool buffer_ok = true;
-  Serial.printf("Audio memory (before alloc): internal DMA=%u bytes, psram DMA=%u bytes\n",
-                (unsigned)heap_caps_get_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA | MALLOC_CAP_8BIT),
-                (unsigned)heap_caps_get_free_size(MALLOC_CAP_SPIRAM | MALLOC_CAP_DMA | MALLOC_CAP_8BIT));
-  for(size_t i = 0; i < AUDIO_BUFFER_COUNT; ++i) {
-    audio_buffers[i] = audio_alloc_dma_buffer(buffer_bytes);
-    if(audio_buffers[i] == nullptr) {
-      buffer_ok = false;
-      break;
+  const int16_t *in = rendered;
+  int16_t *ring = g_audio_sync.ring;
+  const uint32_t mask = g_audio_sync.mask;
+  uint32_t pos = g_audio_sync.write_pos.load(std::memory_order_relaxed);
+  const uint32_t step = (in_frames << 16) / out_frames;
+  uint32_t src = 0;
+  for(uint32_t i = 0; i < out_frames; ++i, src += step) {
+    const uint32_t idx = src >> 16;
+    const uint32_t next = (idx + 1 < in_frames) ? idx + 1 : idx;
+    const int32_t t = static_cast<int32_t>(src & 0xFFFF);
+    for(uint32_t ch = 0; ch < 2; ++ch) {
+      const int32_t a = in[idx * 2 + ch];
+      const int32_t b = in[next * 2 + ch];
+      ring[(pos + ch) & mask] = static_cast<int16_t>(a + (((b - a) * t) >> 16));
+    }
+    pos += 2;
+  }
+  g_audio_sync.write_pos.store(pos, std::memory_order_release);
+}
+
+// audioTask side: move one speaker buffer out of the ring. When the speaker
+// is about to run dry a short buffer is padded by holding the last sample.
+static bool audio_sync_take_buffer(int16_t *dst, size_t count, bool speaker_idle) {
+  const uint32_t fill = audio_sync_fill();
+  if(fill < count) {
+    if(!speaker_idle || fill == 0) {
+      return false;
     }
-    memset(audio_buffers[i], 0, buffer_bytes);
-    audio_buffer_state[i] = 0;
+    if(!g_audio_sync.starving) {
+      g_audio_sync.underruns++;
+      g_audio_sync.starving = true;
+    }
+  } else {
+    g_audio_sync.starving = false;
   }
 
-  if(!buffer_ok) {
-    Serial.println("Audio buffer allocation failed; disabling audio");
-    audioTeardown();
-    return;
+  const uint32_t mask = g_audio_sync.mask;
+  const uint32_t take = fill < count ? (fill & ~1u) : static_cast<uint32_t>(count);
+  uint32_t pos = g_audio_sync.read_pos.load(std::memory_order_relaxed);
+  for(uint32_t i = 0; i < take; ++i) {
+    dst[i] = g_audio_sync.ring[(pos + i) & mask];
   }
+  for(uint32_t i = take; i < count; ++i) {
+    dst[i] = (i >= 2) ? dst[i - 2] : 0;
+  }
+  g_audio_sync.read_pos.store(pos + take, std::memory_order_release);
 
-  M5Cardputer.Speaker.setVolume(255);
-  M5Cardputer.Speaker.setAllChannelVolume(255);
+  if(g_audio_sync.paced && g_audio_sync.emu_task != nullptr) {
+    xTaskNotifyGive(g_audio_sync.emu_task);
+  }
+  return true;
+}
 
-  Serial.printf("audioSetup: init=%d sample_rate=%u stereo=%d dma_len=%u dma_count=%u frames=%u\n",
-                (int)audio_initialised,
-                (unsigned)M5Cardputer.Speaker.config().sample_rate,
-                (int)M5Cardputer.Speaker.config().stereo,
-                (unsigned)M5Cardputer.Speaker.config().dma_buf_len,
-                (unsigned)M5Cardputer.Speaker.config().dma_buf_count,
-                (unsigned)audio_samples_per_frame());
+// Audio queued between the emulator and the DAC: ring fill, buffers handed
+// to the speaker driver and its DMA descriptors.
+static float audio_output_latency_ms() {
+  const uint32_t sample_rate = audio_get_sample_rate();
+  if(!audio_initialised || sample_rate == 0) {
+    return 0.0f;
+  }
+  uint32_t frames = static_cast<uint32_t>(audio_queue_count) * audio_samples_per_frame() + audio_dma_frames;
+  if(g_audio_sync.active) {
+    frames += audio_sync_fill() / 2;
+  }
+  return static_cast<float>(frames) * 1000.0f / static_cast<float>(sample_rate);
+}
 
-  audio_release_finished();
-  audioPump();
-  apply_speaker_volume();
+// Main loop side: yield until audioTask has drained the ring below the
+// blocking threshold. Returns the time spent waiting.
+static uint64_t audio_sync_wait() {
+  const uint64_t wait_start = micros64();
+  const uint32_t threshold =
+      static_cast<uint32_t>(AUDIO_SYNC_BLOCK_BUFFERS * static_cast<float>(audio_samples_per_buffer()));
+  while(audio_sync_fill() >= threshold) {
+    if(ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(AUDIO_SYNC_STALL_TIMEOUT_MS)) == 0) {
+      // The speaker stopped consuming; don't hang the emulator on it.
+      g_audio_sync.stalls++;
+      break;
+    }
+  }
+  return micros64() - wait_start;
 }
 
 static void audioPump() {
+  TRACE_SCOPE(TRACE_PROBE_AUDIO_PUMP);
   if(!audio_initialised) {
     static bool warned = false;
     if(!warned) {
@@ -8693,6 +12382,11 @@ static void audioPump() {
   }
 
   audio_release_finished();
+  audio_depth_note_queue();
+#if ENABLE_FRAME_HISTOGRAMS
+  // Depth left in the speaker queue before refilling; 0 means it ran dry.
+  frame_hist_add_shared(g_audio_queue_hist, static_cast<uint32_t>(audio_queue_count));
+#endif
 
   while(audio_queue_count < AUDIO_TARGET_QUEUE) {
     const int buffer_index = audio_acquire_buffer();
@@ -8712,9 +12406,17 @@ static void audioPump() {
     }
 
     const uint32_t sample_rate = audio_get_sample_rate();
-    audio_callback(nullptr,
-                   reinterpret_cast<uint8_t *>(samples),
-                   interleaved_samples * sizeof(int16_t));
+    if(g_audio_sync.active) {
+      if(!audio_sync_take_buffer(samples, interleaved_samples, audio_queue_count == 0)) {
+        audio_buffer_state[buffer_index] = 0;
+        break;
+      }
+    } else {
+      audio_quality_apply_pending();
+      audio_callback(nullptr,
+                     reinterpret_cast<uint8_t *>(samples),
+                     interleaved_samples * sizeof(int16_t));
+    }
 
     bool queued = M5Cardputer.Speaker.playRaw(samples,
                                               interleaved_samples,
@@ -8740,13 +12442,371 @@ static void audioPump() {
     }
 
     audio_queue_push((size_t)buffer_index);
+    g_audio_depth.primed = true;
+  }
+}
+
+// Audio latency tuner. Playback starts at the stored depth (the shallowest
+// level on a fresh install) and steps one level deeper whenever the speaker
+// queue runs dry while the emulator is keeping up; an underrun that follows a
+// late frame is the emulator's fault and deeper buffering would not fix it.
+// A level that underran is not retried until it has been clean for
+// AUDIO_DEPTH_FORGET_MS, and stepping back down needs a long clean stretch, so
+// the depth settles instead of oscillating but still decays after a transient
+// problem. A level that holds only marks the settings dirty; the file is
+// written at the next pause or settings save, never from a running frame.
+static constexpr uint32_t AUDIO_DEPTH_PAUSE_GAP_MS = 250;    // longer tick gaps are pauses
+static constexpr uint32_t AUDIO_DEPTH_SETTLE_MS = 1500;      // ignore start-up and restart gaps
+static constexpr uint32_t AUDIO_DEPTH_SLOW_GRACE_MS = 1000;  // underruns this soon after a late frame
+static constexpr uint32_t AUDIO_DEPTH_STABLE_MS = 120000;    // clean playback before stepping down
+static constexpr uint32_t AUDIO_DEPTH_FORGET_MS = 600000;    // failed levels become eligible again
+static constexpr uint32_t AUDIO_DEPTH_PERSIST_MS = 10000;    // a level must hold this long to be saved
+
+static void audio_depth_tuner_reset(uint32_t now_ms) {
+  g_audio_depth.seen_underruns = g_audio_depth.underruns.load(std::memory_order_relaxed);
+  g_audio_depth.last_tick_ms = now_ms;
+  g_audio_depth.level_since_ms = now_ms;
+  g_audio_depth.stable_since_ms = now_ms;
+  g_audio_depth.failed_levels = 0;
+  g_audio_depth.last_failure_ms = now_ms;
+  g_audio_depth.last_slow_ms = now_ms - AUDIO_DEPTH_SLOW_GRACE_MS;
+  g_audio_depth.slow_underruns = 0;
+  g_audio_depth.persist_pending = false;
+}
+
+// `emu_slow` is set when this frame missed its budget (or hit the step
+// watchdog), i.e. the ring may run dry however deep the speaker buffers are.
+static void audio_depth_tune(uint32_t now_ms, bool emu_slow) {
+  AudioDepthState &depth = g_audio_depth;
+  if(!audio_initialised || audio_task_handle == nullptr) {
+    return;
+  }
+
+  const uint32_t gap_ms = now_ms - depth.last_tick_ms;
+  depth.last_tick_ms = now_ms;
+  if(emu_slow) {
+    depth.last_slow_ms = now_ms;
+  }
+  const uint8_t level = depth.requested.load(std::memory_order_relaxed);
+  if(level != depth.applied.load(std::memory_order_acquire)) {
+    return;  // audioTask has not switched yet
+  }
+
+  const uint32_t underruns = depth.underruns.load(std::memory_order_relaxed);
+  uint32_t fresh = underruns - depth.seen_underruns;
+  depth.seen_underruns = underruns;
+  if(gap_ms > AUDIO_DEPTH_PAUSE_GAP_MS) {
+    // Menus and file I/O stop the emulator; the speaker draining meanwhile
+    // says nothing about the buffering, and paused time is not clean time.
+    fresh = 0;
+    depth.level_since_ms += gap_ms;
+    depth.stable_since_ms += gap_ms;
+    depth.last_failure_ms += gap_ms;
+    // The pause already cost a gap, so a pending save goes here too.
+    if(!depth.persist_pending) {
+      save_settings_if_dirty();
+    }
+  }
+  if(now_ms - depth.level_since_ms < AUDIO_DEPTH_SETTLE_MS) {
+    fresh = 0;
+  }
+  if(fresh != 0 && now_ms - depth.last_slow_ms < AUDIO_DEPTH_SLOW_GRACE_MS) {
+    depth.slow_underruns += fresh;
+    fresh = 0;
+  }
+  if(depth.failed_levels != 0 && now_ms - depth.last_failure_ms >= AUDIO_DEPTH_FORGET_MS) {
+    depth.failed_levels = 0;
+  }
+
+  uint8_t next = level;
+  if(fresh != 0) {
+    depth.failed_levels |= 1u << level;
+    depth.last_failure_ms = now_ms;
+    depth.stable_since_ms = now_ms;
+    if(level < audio_depth_max_level()) {
+      next = level + 1;
+      depth.steps_up++;
+    }
+  } else if(level > 0 && now_ms - depth.stable_since_ms >= AUDIO_DEPTH_STABLE_MS) {
+    depth.stable_since_ms = now_ms;
+    if((depth.failed_levels & (1u << (level - 1))) == 0) {
+      next = level - 1;
+      depth.steps_down++;
+    }
+  }
+
+  if(next != level) {
+    Serial.printf("Audio depth: L%u -> L%u (%s, ~%.0f ms)\n",
+                  static_cast<unsigned>(level),
+                  static_cast<unsigned>(next),
+                  next > level ? "underrun" : "stable",
+                  static_cast<double>(audio_depth_latency_ms(next)));
+    depth.level_since_ms = now_ms;
+    depth.persist_pending = true;
+    g_settings.audio_depth = next;
+    depth.requested.store(next, std::memory_order_release);
+    return;
+  }
+
+  if(depth.persist_pending && now_ms - depth.level_since_ms >= AUDIO_DEPTH_PERSIST_MS) {
+    depth.persist_pending = false;
+    g_settings_dirty = true;
+  }
+}
+#endif
+
+#if ENABLE_AUDIO_ONLY
+// Audio-only mode. Entering it waits for renderTask to finish the frame in
+// flight, suspends it, and turns the backlight and panel off. The main loop
+// then detaches the scanline callback on every frame, as frame skip does, so
+// the core runs the CPU, timers and APU but generates no pixels; pacing and
+// audio carry on unchanged. A governor steps the CPU clock down one level
+// when the emulator's busy time per frame, scaled to the slower clock, would
+// still leave headroom in the frame budget. It steps back up when audio
+// underruns or frames come close to the budget, and a level that failed is
+// not retried until the mode is entered again. Leaving restores 240 MHz
+// before the display pipeline comes back.
+static constexpr uint32_t AUDIO_ONLY_CPU_MHZ[] = {240, 160, 80};
+static constexpr uint8_t AUDIO_ONLY_CPU_LEVELS = sizeof(AUDIO_ONLY_CPU_MHZ) / sizeof(AUDIO_ONLY_CPU_MHZ[0]);
+static_assert(AUDIO_ONLY_CPU_LEVELS == 3, "audio_only_exit() reports three clock levels");
+static constexpr uint32_t AUDIO_ONLY_WINDOW_FRAMES = 120;     // frames per governor decision
+static constexpr float AUDIO_ONLY_STEP_DOWN_LOAD = 0.60f;     // predicted busy share of the budget
+static constexpr float AUDIO_ONLY_STEP_UP_LOAD = 0.85f;
+static constexpr float AUDIO_ONLY_PAUSE_FRAMES = 4.0f;        // longer frames are pauses, not load
+static constexpr uint32_t AUDIO_ONLY_REPORT_MS = 10000;
+static constexpr uint8_t AUDIO_ONLY_FALLBACK_BRIGHTNESS = 128;
+
+struct AudioOnlyState {
+  bool toggle_requested;            // set by the hotkey, applied at the frame boundary
+  bool active;
+  uint8_t level;                    // AUDIO_ONLY_CPU_MHZ index
+  uint8_t failed_levels;            // bit per level that could not hold audio
+  uint8_t brightness;
+  uint32_t entered_ms;
+  uint32_t level_since_ms;
+  uint32_t level_ms[AUDIO_ONLY_CPU_LEVELS];
+  uint32_t steps_down;
+  uint32_t steps_up;
+  uint32_t window_frames;           // governor window
+  uint64_t window_busy_us;
+  uint32_t window_glitches;         // underrun count when the window began
+  uint32_t report_ms;               // periodic report window
+  uint64_t report_busy_us;
+  uint64_t report_wall_us;
+  uint64_t total_busy_us;
+  uint64_t total_wall_us;
+  uint32_t ring_underruns;          // audio counters on entry
+  uint32_t ring_overruns;
+  uint32_t ring_stalls;
+  uint32_t speaker_underruns;
+};
+
+static AudioOnlyState g_audio_only = {};
+
+static void audio_only_request_toggle() {
+  g_audio_only.toggle_requested = true;
+}
+
+// Underruns anywhere between the ring and the speaker; the governor treats
+// any new one as the clock being too low.
+static uint32_t audio_only_glitches() {
+  return g_audio_sync.underruns + g_audio_sync.stalls +
+         g_audio_depth.underruns.load(std::memory_order_relaxed);
+}
+
+static float audio_only_idle_percent(uint64_t busy_us, uint64_t wall_us) {
+  if(wall_us == 0 || busy_us >= wall_us) {
+    return 0.0f;
+  }
+  return 100.0f * static_cast<float>(wall_us - busy_us) / static_cast<float>(wall_us);
+}
+
+static void audio_only_window_reset() {
+  g_audio_only.window_frames = 0;
+  g_audio_only.window_busy_us = 0;
+  g_audio_only.window_glitches = audio_only_glitches();
+}
+
+static void audio_only_set_level(uint8_t level, uint32_t now_ms) {
+  AudioOnlyState &mode = g_audio_only;
+  mode.level_ms[mode.level] += now_ms - mode.level_since_ms;
+  mode.level_since_ms = now_ms;
+  mode.level = level;
+  set_cpu_frequency(AUDIO_ONLY_CPU_MHZ[level]);
+  audio_only_window_reset();
+}
+
+static void audio_only_enter(uint32_t now_ms) {
+  AudioOnlyState &mode = g_audio_only;
+  if(input_movie_forces_full_render()) {
+    Serial.println("Audio-only: unavailable while a movie runs");
+    show_status_message("Stop the movie first", StatusMessageKind::Error);
+    return;
+  }
+  if(!audio_initialised) {
+    show_status_message("Audio-only needs audio on", StatusMessageKind::Error);
+    return;
+  }
+
+  // The main loop already holds the write buffer; once renderTask returns
+  // the other one it is idle, blocked on the empty frame queue.
+  if(!priv.single_buffer_mode && priv.frame_queue != nullptr) {
+    SemaphoreHandle_t presented = priv.frame_buffer_free[priv.write_fb_index ^ 1];
+    if(presented != nullptr) {
+      xSemaphoreTake(presented, portMAX_DELAY);
+      xSemaphoreGive(presented);
+    }
+  }
+  if(render_task_handle != nullptr) {
+    vTaskSuspend(render_task_handle);
+  }
+  mode.brightness = M5Cardputer.Display.getBrightness();
+  M5Cardputer.Display.setBrightness(0);
+  M5Cardputer.Display.sleep();
+
+  mode.active = true;
+  mode.entered_ms = now_ms;
+  mode.level = 0;
+  mode.level_since_ms = now_ms;
+  mode.failed_levels = 0;
+  memset(mode.level_ms, 0, sizeof(mode.level_ms));
+  mode.steps_down = 0;
+  mode.steps_up = 0;
+  mode.report_ms = now_ms;
+  mode.report_busy_us = 0;
+  mode.report_wall_us = 0;
+  mode.total_busy_us = 0;
+  mode.total_wall_us = 0;
+  mode.ring_underruns = g_audio_sync.underruns;
+  mode.ring_overruns = g_audio_sync.overruns;
+  mode.ring_stalls = g_audio_sync.stalls;
+  mode.speaker_underruns = g_audio_depth.underruns.load(std::memory_order_relaxed);
+  audio_only_set_level(0, now_ms);
+  Serial.println("Audio-only: on (display off, render task suspended)");
+}
+
+static void audio_only_exit(uint32_t now_ms) {
+  AudioOnlyState &mode = g_audio_only;
+  audio_only_set_level(0, now_ms);
+  mode.active = false;
+
+  M5Cardputer.Display.wakeup();
+  M5Cardputer.Display.setBrightness(mode.brightness != 0 ? mode.brightness : AUDIO_ONLY_FALLBACK_BRIGHTNESS);
+  if(render_task_handle != nullptr) {
+    vTaskResume(render_task_handle);
+  }
+
+  const uint32_t ring_underruns = g_audio_sync.underruns - mode.ring_underruns;
+  const uint32_t ring_overruns = g_audio_sync.overruns - mode.ring_overruns;
+  const uint32_t ring_stalls = g_audio_sync.stalls - mode.ring_stalls;
+  const uint32_t speaker_underruns =
+      g_audio_depth.underruns.load(std::memory_order_relaxed) - mode.speaker_underruns;
+  Serial.printf("Audio-only: off after %.1f s, idle=%.1f%%, %lu/%lu/%lu MHz for %.1f/%.1f/%.1f s "
+                "(down=%lu up=%lu), ring under=%lu drop=%lu stall=%lu, speaker under=%lu\n",
+                static_cast<double>(now_ms - mode.entered_ms) / 1000.0,
+                static_cast<double>(audio_only_idle_percent(mode.total_busy_us, mode.total_wall_us)),
+                static_cast<unsigned long>(AUDIO_ONLY_CPU_MHZ[0]),
+                static_cast<unsigned long>(AUDIO_ONLY_CPU_MHZ[1]),
+                static_cast<unsigned long>(AUDIO_ONLY_CPU_MHZ[2]),
+                static_cast<double>(mode.level_ms[0]) / 1000.0,
+                static_cast<double>(mode.level_ms[1]) / 1000.0,
+                static_cast<double>(mode.level_ms[2]) / 1000.0,
+                static_cast<unsigned long>(mode.steps_down),
+                static_cast<unsigned long>(mode.steps_up),
+                static_cast<unsigned long>(ring_underruns),
+                static_cast<unsigned long>(ring_overruns),
+                static_cast<unsigned long>(ring_stalls),
+                static_cast<unsigned long>(speaker_underruns));
+  char message[48];
+  snprintf(message, sizeof(message), "Audio-only off (%lu underruns)",
+           static_cast<unsigned long>(ring_underruns + ring_stalls + speaker_underruns));
+  show_status_message(message, StatusMessageKind::Info);
+}
+
+// Main loop, after the frame was handed off: applies a pending toggle. A
+// movie needs every frame drawn, so starting one ends the mode.
+static void audio_only_poll(uint32_t now_ms) {
+  AudioOnlyState &mode = g_audio_only;
+  const bool toggle = mode.toggle_requested;
+  mode.toggle_requested = false;
+  if(mode.active && (toggle || input_movie_forces_full_render())) {
+    audio_only_exit(now_ms);
+  } else if(toggle) {
+    audio_only_enter(now_ms);
+  }
+}
+
+// Main loop, end of each iteration: the frame's busy time is everything but
+// the pacing wait.
+static void audio_only_record_frame(bool frame_completed, uint64_t frame_us, uint64_t idle_us, uint32_t now_ms) {
+  AudioOnlyState &mode = g_audio_only;
+  if(!mode.active) {
+    return;
+  }
+  const uint64_t busy_us = frame_us > idle_us ? frame_us - idle_us : 0;
+  mode.report_busy_us += busy_us;
+  mode.report_wall_us += frame_us;
+  mode.total_busy_us += busy_us;
+  mode.total_wall_us += frame_us;
+
+  if(now_ms - mode.report_ms >= AUDIO_ONLY_REPORT_MS) {
+    Serial.printf("Audio-only: %lu MHz idle=%.1f%% ring under=%lu drop=%lu stall=%lu speaker under=%lu\n",
+                  static_cast<unsigned long>(AUDIO_ONLY_CPU_MHZ[mode.level]),
+                  static_cast<double>(audio_only_idle_percent(mode.report_busy_us, mode.report_wall_us)),
+                  static_cast<unsigned long>(g_audio_sync.underruns - mode.ring_underruns),
+                  static_cast<unsigned long>(g_audio_sync.overruns - mode.ring_overruns),
+                  static_cast<unsigned long>(g_audio_sync.stalls - mode.ring_stalls),
+                  static_cast<unsigned long>(g_audio_depth.underruns.load(std::memory_order_relaxed) -
+                                             mode.speaker_underruns));
+    mode.report_ms = now_ms;
+    mode.report_busy_us = 0;
+    mode.report_wall_us = 0;
+  }
+
+  if(!frame_completed || static_cast<float>(frame_us) > AUDIO_ONLY_PAUSE_FRAMES * FRAME_BUDGET_US) {
+    return;
   }
+  mode.window_busy_us += busy_us;
+  if(++mode.window_frames < AUDIO_ONLY_WINDOW_FRAMES) {
+    return;
+  }
+
+  const float load = static_cast<float>(mode.window_busy_us) / static_cast<float>(mode.window_frames) /
+                     FRAME_BUDGET_US;
+  const bool glitched = audio_only_glitches() != mode.window_glitches;
+  uint8_t next = mode.level;
+  if(glitched || load > AUDIO_ONLY_STEP_UP_LOAD) {
+    mode.failed_levels |= 1u << mode.level;
+    if(mode.level > 0) {
+      next = mode.level - 1;
+      mode.steps_up++;
+    }
+  } else if(mode.level + 1 < AUDIO_ONLY_CPU_LEVELS && (mode.failed_levels & (1u << (mode.level + 1))) == 0) {
+    const float predicted = load * static_cast<float>(AUDIO_ONLY_CPU_MHZ[mode.level]) /
+                            static_cast<float>(AUDIO_ONLY_CPU_MHZ[mode.level + 1]);
+    if(predicted < AUDIO_ONLY_STEP_DOWN_LOAD) {
+      next = mode.level + 1;
+      mode.steps_down++;
+    }
+  }
+
+  if(next == mode.level) {
+    audio_only_window_reset();
+    return;
+  }
+  Serial.printf("Audio-only: %lu -> %lu MHz (load=%.0f%%%s)\n",
+                static_cast<unsigned long>(AUDIO_ONLY_CPU_MHZ[mode.level]),
+                static_cast<unsigned long>(AUDIO_ONLY_CPU_MHZ[next]),
+                static_cast<double>(load * 100.0f),
+                glitched ? ", underrun" : "");
+  audio_only_set_level(next, now_ms);
 }
 #endif
 
 static bool gb_run_frame_watchdog(struct gb_s *gb,
                                   uint32_t max_steps,
                                   uint32_t *steps_executed) {
+  TRACE_SCOPE(TRACE_PROBE_RUN_FRAME);
   if(steps_executed != nullptr) {
     *steps_executed = 0;
   }
@@ -8827,7 +12887,9 @@ void setup() {
   M5Cardputer.Display.setRotation(1);
   M5Cardputer.Display.initDMA();
   set_font_size(80);
+#if !ENABLE_NATIVE_BENCH
   show_boot_splash();
+#endif
   set_font_size(80);
 
   const size_t embedded_rom_count = kEmbeddedRomCount;
@@ -8853,7 +12915,12 @@ void setup() {
     apply_settings_constraints();
   }
 
+#if ENABLE_NATIVE_BENCH
+  // Benchmarks measure throughput, so nothing may wait on the speaker.
+  g_settings.pacing_mode = static_cast<uint8_t>(PACING_MODE_VIDEO);
+#else
   show_home_menu();
+#endif
   Serial.printf("setup stack avail (after home menu): %u bytes\n",
                 (unsigned)(uxTaskGetStackHighWaterMark(nullptr) * sizeof(StackType_t)));
 
@@ -8975,7 +13042,11 @@ void setup() {
         }
       }
 
+#if ENABLE_NATIVE_BENCH
+      char* selected_file = strdup(native_bench_rom_path());
+#else
       char* selected_file = file_picker();
+#endif
       if(selected_file == NULL) {
         if(g_file_picker_cancelled) {
           g_file_picker_cancelled = false;
@@ -9324,6 +13395,7 @@ void setup() {
   // Interlacing disabled to avoid double-buffer artifacts
   gb.direct.interlace = 0;
   g_interlace_state = {};
+  g_frame_controller = {};
 #endif
 
 #if ENABLE_LCD
@@ -9336,10 +13408,16 @@ void setup() {
   priv.framebuffers[1] = nullptr;
   priv.current_frame_dirty_rows = 0;
   priv.last_frame_dirty_rows = 0;
+  priv.render_band_lines = 0;
+  priv.render_band_next_line = 0;
+  priv.present_sequence = 0;
+  memset(priv.framebuffer_input_us, 0, sizeof(priv.framebuffer_input_us));
+  memset(priv.framebuffer_field_mask, 0, sizeof(priv.framebuffer_field_mask));
   priv.palette_snapshot_valid = false;
   priv.palette_snapshot_cgb = false;
   memset(priv.framebuffer_row_hash, 0, sizeof(priv.framebuffer_row_hash));
   memset(priv.framebuffer_row_dirty, 0, sizeof(priv.framebuffer_row_dirty));
+  memset(priv.framebuffer_row_span, 0, sizeof(priv.framebuffer_row_span));
   const size_t fb_bytes = LCD_HEIGHT * LCD_WIDTH * sizeof(uint16_t);
   static constexpr uint32_t FB_CAPS_FAST[] = {
     MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA | MALLOC_CAP_8BIT,
@@ -9551,7 +13629,7 @@ void setup() {
     }
   } else {
     if(priv.frame_queue == nullptr) {
-      priv.frame_queue = xQueueCreate(2, sizeof(uint8_t));
+      priv.frame_queue = xQueueCreate(FRAME_QUEUE_LENGTH, sizeof(FrameRenderMessage));
     }
     if(priv.frame_buffer_free[0] == nullptr) {
       priv.frame_buffer_free[0] = xSemaphoreCreateBinary();
@@ -9586,6 +13664,12 @@ void setup() {
       if(priv.frame_buffer_free[priv.write_fb_index] != nullptr) {
         xSemaphoreTake(priv.frame_buffer_free[priv.write_fb_index], portMAX_DELAY);
       }
+      priv.render_band_lines = g_settings.render_band_lines;
+      priv.render_band_next_line = priv.render_band_lines;
+      if(priv.render_band_lines != 0) {
+        Serial.printf("Band rendering enabled (%u-line bands)\n",
+                      static_cast<unsigned>(priv.render_band_lines));
+      }
       if(render_task_handle == nullptr) {
         BaseType_t render_created = xTaskCreatePinnedToCore(renderTask,
                                                             "RenderTask",
@@ -9639,21 +13723,80 @@ void setup() {
     memset(swap_row_hash, 0, sizeof(swap_row_hash));
   }
   
-  // Target game speed.
-  const double target_speed_us = 1000000.0 / VERTICAL_SYNC;
-  
+  // Game speed is paced against an absolute VERTICAL_SYNC schedule, or by the
+  // speaker's consumption rate in audio pacing mode.
+#if ENABLE_SOUND
+  audio_sync_configure(audio_initialised && audio_task_handle != nullptr,
+                       g_settings.pacing_mode == PACING_MODE_AUDIO);
+  const bool audio_paced = g_audio_sync.active && g_audio_sync.paced;
+  audio_depth_tuner_reset(millis());
+#else
+  const bool audio_paced = false;
+#endif
+  frame_pacer_init(g_frame_pacer, micros64());
+#if ENABLE_TRACE_PROBES
+  trace_init();
+#endif
+#if ENABLE_TELEMETRY
+  telemetry_start();
+  static uint32_t telemetry_iteration = 0;
+#endif
+
   static uint32_t frame_counter = 0;
   static bool logged_first_frame = false;
   static uint32_t watchdog_strikes = 0;
   while(1) {
     const uint64_t frame_start = micros64();
+    const uint64_t pace_deviation_us = g_frame_pacer.scheduled ? frame_start - g_frame_pacer.deadline_us : 0;
+    (void)pace_deviation_us;
+#if ENABLE_PROFILING
+    if(g_frame_pacer.scheduled) {
+      profiler_record_pacing(pace_deviation_us);
+    }
+#endif
+    g_frame_pacer.scheduled = false;
 
     poll_keyboard();
     const uint64_t after_poll = micros64();
+#if ENABLE_LCD
+    priv.framebuffer_input_us[priv.write_fb_index] = frame_start;
+#endif
+
+#if ENABLE_AUDIO_ONLY
+    const bool audio_only = g_audio_only.active;
+#else
+    const bool audio_only = false;
+#endif
+    // Same test lcd_draw_line applies per line: frames frame skip will
+    // discard never need their pixels generated. In audio-only mode no frame
+    // is presented, and renderTask is not there to take bands, so the
+    // callback is always detached.
+#if ENABLE_LCD
+    const bool frame_suppressed = audio_only || (gb.direct.frame_skip && gb.display.frame_skip_count == 0);
+    const bool detach_lines = audio_only || (ENABLE_RENDER_SUPPRESSION && frame_suppressed);
+#else
+    const bool frame_suppressed = false;
+#endif
+#if ENABLE_LCD
+    if(detach_lines) {
+      gb.display.lcd_draw_line = nullptr;
+    }
+#endif
 
     uint32_t cpu_steps = 0;
     const bool frame_completed = gb_run_frame_watchdog(&gb, GB_FRAME_STEP_BUDGET, &cpu_steps);
     const uint64_t after_emu = micros64();
+#if ENABLE_SOUND
+    if(frame_completed) {
+      audio_frame_end();
+    }
+#endif
+
+#if ENABLE_LCD
+    if(detach_lines) {
+      gb.display.lcd_draw_line = &lcd_draw_line;
+    }
+#endif
 
   const uint8_t ime = gb.gb_ime ? 1 : 0;
   const uint8_t halt_flag = gb.gb_halt ? 1 : 0;
@@ -9767,16 +13910,24 @@ void setup() {
 
 #if ENABLE_LCD
     if(frame_completed) {
-      const bool frame_visible = (!gb.direct.frame_skip) || (gb.display.frame_skip_count != 0);
+      input_movie_frame_completed(priv.framebuffer_row_hash[priv.write_fb_index]);
+      const bool frame_visible = !audio_only && ((!gb.direct.frame_skip) || (gb.display.frame_skip_count != 0));
       if(frame_visible) {
         if(priv.single_buffer_mode || priv.frame_queue == nullptr) {
           fit_frame(priv.framebuffers[priv.write_fb_index],
                     priv.framebuffer_row_hash[priv.write_fb_index],
-                    priv.framebuffer_row_dirty[priv.write_fb_index]);
+                    priv.framebuffer_row_dirty[priv.write_fb_index],
+                    priv.framebuffer_row_span[priv.write_fb_index],
+                    frame_start,
+                    priv.framebuffer_field_mask[priv.write_fb_index]);
         } else {
-          const uint8_t render_index = priv.write_fb_index;
+          FrameRenderMessage message;
+          message.fb_index = priv.write_fb_index;
+          message.ready_lines = LCD_HEIGHT;
+          message.flags = FRAME_RENDER_FLAG_FINAL;
+          message.sequence = priv.present_sequence;
           if(priv.frame_queue != nullptr) {
-            xQueueSend(priv.frame_queue, &render_index, portMAX_DELAY);
+            xQueueSend(priv.frame_queue, &message, portMAX_DELAY);
           }
           priv.write_fb_index ^= 1;
           if(priv.frame_buffer_free[priv.write_fb_index] != nullptr) {
@@ -9784,59 +13935,48 @@ void setup() {
           }
         }
       }
+      priv.present_sequence++;
+      priv.render_band_next_line = priv.render_band_lines;
+      priv.framebuffer_field_mask[priv.write_fb_index] = 0;
     }
 #endif
 
     const uint64_t after_dispatch = micros64();
-    const uint64_t active_duration = after_dispatch - frame_start;
 
-    int64_t delay_us = static_cast<int64_t>(target_speed_us - static_cast<double>(active_duration));
-    if(!frame_completed) {
-      delay_us = 0;
-    }
+    // Frames the watchdog cut short resume immediately and keep their slot.
+    uint64_t deadline = 0;
     bool over_budget = !frame_completed;
-    if(delay_us <= 0) {
-      over_budget = true;
-    }
-#if ENABLE_PROFILING
-    uint64_t requested_delay_us = 0;
+    if(frame_completed && audio_paced) {
+#if ENABLE_SOUND
+      // Over budget here means the ring was close to running dry.
+      over_budget = audio_sync_fill() < audio_samples_per_buffer();
+      audio_sync_produce_frame();
 #endif
-    if(delay_us > 0) {
-#if ENABLE_PROFILING
-      requested_delay_us = static_cast<uint64_t>(delay_us);
+    } else if(frame_completed) {
+#if !ENABLE_NATIVE_BENCH
+      deadline = frame_pacer_advance(g_frame_pacer, after_dispatch);
+      over_budget = deadline <= after_dispatch;
 #endif
-    } else {
-      delay_us = 0;
-    }
-
-    uint64_t idle_us = 0;
-    uint64_t frame_end = after_dispatch;
-    if(delay_us > 0) {
-      int64_t remaining_delay = delay_us;
-      const uint64_t idle_start = micros64();
-      if(remaining_delay >= 1000) {
-        const uint32_t delay_ms = static_cast<uint32_t>(remaining_delay / 1000);
-        const TickType_t delay_ticks = pdMS_TO_TICKS(delay_ms);
-        if(delay_ticks > 0) {
-          vTaskDelay(delay_ticks);
-          remaining_delay -= static_cast<int64_t>(delay_ticks) * portTICK_PERIOD_MS * 1000;
-          if(remaining_delay < 0) {
-            remaining_delay = 0;
-          }
-        }
-      }
-      if(remaining_delay > 0) {
-        esp_rom_delay_us(static_cast<uint32_t>(remaining_delay));
+#if ENABLE_SOUND
+      if(g_audio_sync.active) {
+        audio_sync_produce_frame();
       }
-      frame_end = micros64();
-      idle_us = frame_end - idle_start;
-    } else {
-      frame_end = micros64();
+#endif
     }
-
-    const uint64_t frame_us = frame_end - frame_start;
+#if ENABLE_PROFILING
+    const uint64_t requested_delay_us = (over_budget || deadline == 0) ? 0 : deadline - after_dispatch;
+#endif
 
     const uint32_t now_ms = millis();
+#if ENABLE_SOUND
+    audio_depth_tune(now_ms, !frame_completed || (after_dispatch - frame_start) > FRAME_BUDGET_US);
+#endif
+#if ENABLE_AUDIO_CAPTURE
+    audio_capture_poll();
+#endif
+#if ENABLE_AUDIO_ONLY
+    audio_only_poll(now_ms);
+#endif
 
     if(priv.cart_save_path_valid && priv.cart_ram_dirty && priv.cart_ram != nullptr &&
        priv.cart_ram_size > 0 && g_sd_mounted) {
@@ -9896,8 +14036,45 @@ void setup() {
 
     process_cache_recovery();
 
-    apply_frame_skip_policy(&gb, over_budget, frame_completed, interlace_was_active);
+    FrameCostSample cost_sample;
+    cost_sample.active_us = after_dispatch - frame_start;
+    cost_sample.handoff_us = after_dispatch - after_emu;
+    cost_sample.skipped = frame_suppressed;
+    cost_sample.interlaced = interlace_was_active;
+    // Audio-only frames draw nothing and may run on a slower clock, so they
+    // would only mislead the frame cost model.
+    if(!audio_only) {
+      apply_frame_skip_policy(&gb, cost_sample, frame_completed, interlace_was_active);
+    }
+#if ENABLE_FRAME_TRACE
+    if(frame_completed) {
+      Serial.printf("[FT] %c %llu %llu %u\n",
+                    frame_suppressed ? 'S' : (interlace_was_active ? 'I' : 'F'),
+                    static_cast<unsigned long long>(cost_sample.active_us),
+                    static_cast<unsigned long long>(cost_sample.handoff_us),
+                    static_cast<unsigned>(g_frame_controller.level));
+    }
+#endif
+
+    // Wait last so save flushes and bookkeeping above come out of the idle
+    // time instead of pushing the next frame start back.
+    uint64_t idle_us = 0;
+    if(frame_completed && audio_paced) {
+#if ENABLE_SOUND
+      idle_us = audio_sync_wait();
+#endif
+    } else if(deadline != 0) {
+      idle_us = frame_pacer_wait(g_frame_pacer, deadline);
+    }
+    const uint64_t frame_end = micros64();
+    const uint64_t frame_us = frame_end - frame_start;
 
+#if ENABLE_FRAME_HISTOGRAMS
+    frame_hist_record(frame_us, after_emu - after_poll, frame_end);
+#endif
+#if ENABLE_PERF_HUD
+    perf_hud_record_frame(frame_us, after_emu - after_poll, frame_end);
+#endif
 #if ENABLE_PROFILING
     profiler_record_frame(frame_us,
                           after_poll - frame_start,
@@ -9906,7 +14083,63 @@ void setup() {
                           idle_us,
                           requested_delay_us,
                           over_budget,
+                          frame_suppressed,
                           frame_end);
+#endif
+#if ENABLE_AUDIO_ONLY
+    audio_only_record_frame(frame_completed, frame_us, idle_us, millis());
+#endif
+
+#if ENABLE_TELEMETRY
+    {
+      TelemetryFrameRecord record;
+      record.frame = telemetry_iteration++;
+      record.start_us = static_cast<uint32_t>(frame_start);
+      record.frame_us = telemetry_clamp16(frame_us);
+      record.poll_us = telemetry_clamp16(after_poll - frame_start);
+      record.emu_us = telemetry_clamp16(after_emu - after_poll);
+      record.handoff_us = telemetry_clamp16(after_dispatch - after_emu);
+      record.idle_us = telemetry_clamp16(idle_us);
+      record.pace_dev_us = telemetry_clamp16(pace_deviation_us);
+      const size_t rom_misses = priv.rom_cache.cache_misses;
+      record.rom_misses = telemetry_clamp16(rom_misses - g_telemetry.last_rom_misses);
+      g_telemetry.last_rom_misses = rom_misses;
+#if ENABLE_SOUND
+      record.audio_fill = g_audio_sync.active ? telemetry_clamp16(audio_sync_fill() / 2) : 0;
+      record.audio_queue = static_cast<uint8_t>(audio_queue_count);
+#else
+      record.audio_fill = 0;
+      record.audio_queue = 0;
+#endif
+      record.dirty_rows = static_cast<uint8_t>(priv.last_frame_dirty_rows);
+      record.flags = (frame_completed ? TELEMETRY_FLAG_COMPLETED : 0) |
+                     (frame_suppressed ? TELEMETRY_FLAG_SUPPRESSED : 0) |
+                     (interlace_was_active ? TELEMETRY_FLAG_INTERLACED : 0) |
+                     (over_budget ? TELEMETRY_FLAG_OVER_BUDGET : 0) |
+                     (audio_paced ? TELEMETRY_FLAG_AUDIO_PACED : 0);
+      record.level = g_frame_controller.level;
+      telemetry_submit(record);
+    }
+#endif
+
+#if ENABLE_NATIVE_BENCH
+    if(native_bench_frame(frame_completed,
+                          after_poll - frame_start,
+                          after_emu - after_poll,
+                          after_dispatch - after_emu,
+                          frame_us)) {
+#if ENABLE_LCD
+      while(priv.frame_queue != nullptr && uxQueueMessagesWaiting(priv.frame_queue) > 0) {
+        vTaskDelay(1);
+      }
+#endif
+#if ENABLE_PROFILING
+      profiler_log(frame_end);
+#elif ENABLE_FRAME_HISTOGRAMS
+      frame_hist_log(frame_end);
+#endif
+      native_bench_finish();
+    }
 #endif
   }
 }
@@ -34,42 +34,97 @@
 #endif
 
 static uint32_t g_audio_sample_rate = AUDIO_DEFAULT_SAMPLE_RATE;
+/* Rate the channels are synthesised at: the output rate in
+ * AUDIO_QUALITY_DIRECT, otherwise a division of the DMG clock that the
+ * polyphase resampler converts to the output rate. */
+static uint32_t g_synth_rate = AUDIO_DEFAULT_SAMPLE_RATE;
+static enum audio_quality g_audio_quality = AUDIO_QUALITY_DIRECT;
 static uint32_t g_freq_inc_ref = AUDIO_DEFAULT_SAMPLE_RATE * 16u;
 static uint32_t g_freq_inc_scale = 16u;
 static uint32_t g_audio_samples = 0;
 static uint32_t g_audio_nsamples = 0;
 static bool g_audio_params_ready = false;
 
+/*
+ * The mixer and bass equaliser run in integer arithmetic by default: channel
+ * outputs are summed into 32-bit accumulators, filtered with Q2.30
+ * coefficients and a 64-bit multiply-accumulate, and saturated to Q15 on the
+ * final store. Build with -DMINIGB_APU_FLOAT_EQ=1 to use the original
+ * single-precision filter instead, or =2 for the same filter in double
+ * precision, e.g. to compare output against it (native/apu_bench --compare).
+ */
+#ifndef MINIGB_APU_FLOAT_EQ
+#define MINIGB_APU_FLOAT_EQ 0
+#endif
+
+/* Coefficient format: 2 integer bits cover the low shelf's |a1| < 2. */
+#define EQ_COEF_SHIFT		30
+#define EQ_COEF_ONE		((int64_t)1 << EQ_COEF_SHIFT)
+#define EQ_COEF_MASK		(EQ_COEF_ONE - 1)
+/* Bound on the filter state so five Q2.30 products cannot overflow 64 bits. */
+#define EQ_STATE_LIMIT		((int32_t)1 << 24)
+
+/* Stereo frames mixed per pass; keeps the accumulator block small. */
+#define AUDIO_MIX_BLOCK_FRAMES	64
+
+#if MINIGB_APU_FLOAT_EQ
+#if MINIGB_APU_FLOAT_EQ == 2
+typedef double eq_float_t;
+#else
+typedef float eq_float_t;
+#endif
+
 typedef struct {
-	float b0;
-	float b1;
-	float b2;
-	float a1;
-	float a2;
-	float x1;
-	float x2;
-	float y1;
-	float y2;
+	eq_float_t b0;
+	eq_float_t b1;
+	eq_float_t b2;
+	eq_float_t a1;
+	eq_float_t a2;
+	eq_float_t x1;
+	eq_float_t x2;
+	eq_float_t y1;
+	eq_float_t y2;
 } biquad_filter_t;
+#else
+typedef struct {
+	int32_t b0;
+	int32_t b1;
+	int32_t b2;
+	int32_t a1;
+	int32_t a2;
+	int32_t x1;
+	int32_t x2;
+	int32_t y1;
+	int32_t y2;
+	/* Fractions dropped by the last two output shifts. */
+	int32_t e1;
+	int32_t e2;
+} biquad_filter_t;
+#endif
 
 static biquad_filter_t g_bass_filter_left = {0};
 static biquad_filter_t g_bass_filter_right = {0};
 static bool g_eq_enabled = true;
 static bool g_eq_configured = false;
-static const float g_eq_post_gain = 0.92f;
+static const double g_eq_post_gain = 0.92;
+static int32_t g_mix_block[AUDIO_MIX_BLOCK_FRAMES * 2];
 
 static void biquad_reset(biquad_filter_t *f);
 static void audio_configure_equaliser(void);
 static void audio_ensure_params(void);
 static void audio_reset_filters(void);
+static void rs_configure(void);
 
 static void biquad_reset(biquad_filter_t *f)
 {
 	if(f == NULL) {
 		return;
 	}
-	f->x1 = f->x2 = 0.0f;
-	f->y1 = f->y2 = 0.0f;
+	f->x1 = f->x2 = 0;
+	f->y1 = f->y2 = 0;
+#if !MINIGB_APU_FLOAT_EQ
+	f->e1 = f->e2 = 0;
+#endif
 }
 
 static void audio_reset_filters(void)
@@ -79,11 +134,30 @@ static void audio_reset_filters(void)
 	g_eq_configured = false;
 }
 
+#if !MINIGB_APU_FLOAT_EQ
+static int32_t biquad_coef_to_fixed(double coef)
+{
+	const double scaled = coef * (double)EQ_COEF_ONE;
+	if(scaled >= (double)INT32_MAX) {
+		return INT32_MAX;
+	}
+	if(scaled <= (double)INT32_MIN) {
+		return INT32_MIN;
+	}
+	return (int32_t)lrint(scaled);
+}
+#endif
+
+/*
+ * Configures a low shelf; post_gain is folded into the feed-forward
+ * coefficients so the per-sample path needs no extra multiply.
+ */
 static void biquad_configure_low_shelf(biquad_filter_t *f,
 									   double sample_rate,
 									   double cutoff_hz,
 									   double gain_db,
-									   double slope)
+									   double slope,
+									   double post_gain)
 {
 	if(f == NULL || sample_rate <= 0.0) {
 		return;
@@ -119,37 +193,90 @@ static void biquad_configure_low_shelf(biquad_filter_t *f,
 	}
 
 	const double inv_a0 = 1.0 / a0;
-	f->b0 = (float)(b0 * inv_a0);
-	f->b1 = (float)(b1 * inv_a0);
-	f->b2 = (float)(b2 * inv_a0);
-	f->a1 = (float)(a1 * inv_a0);
-	f->a2 = (float)(a2 * inv_a0);
+	const double gain = post_gain * inv_a0;
+#if MINIGB_APU_FLOAT_EQ
+	f->b0 = (eq_float_t)(b0 * gain);
+	f->b1 = (eq_float_t)(b1 * gain);
+	f->b2 = (eq_float_t)(b2 * gain);
+	f->a1 = (eq_float_t)(a1 * inv_a0);
+	f->a2 = (eq_float_t)(a2 * inv_a0);
+#else
+	f->b0 = biquad_coef_to_fixed(b0 * gain);
+	f->b1 = biquad_coef_to_fixed(b1 * gain);
+	f->b2 = biquad_coef_to_fixed(b2 * gain);
+	f->a1 = biquad_coef_to_fixed(a1 * inv_a0);
+	f->a2 = biquad_coef_to_fixed(a2 * inv_a0);
+#endif
 
 	biquad_reset(f);
 }
 
-static inline float biquad_process(biquad_filter_t *f, float x)
+static inline int16_t clamp_to_i16(int32_t value)
+{
+	if(value > INT16_MAX) {
+		return INT16_MAX;
+	}
+	if(value < INT16_MIN) {
+		return INT16_MIN;
+	}
+	return (int16_t)value;
+}
+
+#if MINIGB_APU_FLOAT_EQ
+static inline int16_t biquad_process(biquad_filter_t *f, int32_t in)
 {
-	const float y = f->b0 * x + f->b1 * f->x1 + f->b2 * f->x2
+	const eq_float_t x = (eq_float_t)in;
+	const eq_float_t y = f->b0 * x + f->b1 * f->x1 + f->b2 * f->x2
 					- f->a1 * f->y1 - f->a2 * f->y2;
 	f->x2 = f->x1;
 	f->x1 = x;
 	f->y2 = f->y1;
 	f->y1 = y;
-	return y;
-}
-
-static inline int16_t clamp_to_i16(float value)
-
-{
-	if(value > (float)INT16_MAX) {
+	if(y > (eq_float_t)INT16_MAX) {
 		return INT16_MAX;
 	}
-	if(value < (float)INT16_MIN) {
+	if(y < (eq_float_t)INT16_MIN) {
 		return INT16_MIN;
 	}
-	return (int16_t)lrintf(value);
+	return (int16_t)lrint(y);
+}
+#else
+/*
+ * Direct form I with second-order error feedback: the bits truncated from
+ * the accumulator are fed back as 2*e[n-1] - e[n-2], cancelling the
+ * quantisation noise that the shelf's near-unity poles would otherwise
+ * amplify at low frequencies. The state holds the unsaturated output;
+ * only the store saturates.
+ */
+static inline int16_t biquad_process(biquad_filter_t *f, int32_t x)
+{
+	int64_t acc = 2 * (int64_t)f->e1 - f->e2;
+	acc += (int64_t)f->b0 * x;
+	acc += (int64_t)f->b1 * f->x1;
+	acc += (int64_t)f->b2 * f->x2;
+	acc -= (int64_t)f->a1 * f->y1;
+	acc -= (int64_t)f->a2 * f->y2;
+
+	const int64_t y = acc >> EQ_COEF_SHIFT;
+	f->e2 = f->e1;
+	f->e1 = (int32_t)(acc & EQ_COEF_MASK);
+
+	int32_t y32;
+	if(y > EQ_STATE_LIMIT) {
+		y32 = EQ_STATE_LIMIT;
+	} else if(y < -EQ_STATE_LIMIT) {
+		y32 = -EQ_STATE_LIMIT;
+	} else {
+		y32 = (int32_t)y;
+	}
+
+	f->x2 = f->x1;
+	f->x1 = x;
+	f->y2 = f->y1;
+	f->y1 = y32;
+	return clamp_to_i16(y32);
 }
+#endif
 
 static void audio_configure_equaliser(void)
 {
@@ -159,7 +286,7 @@ static void audio_configure_equaliser(void)
 	}
 
 	audio_ensure_params();
-	const double sample_rate = (double)g_audio_sample_rate;
+	const double sample_rate = (double)g_synth_rate;
 	if(sample_rate <= 0.0) {
 		audio_reset_filters();
 		return;
@@ -173,12 +300,14 @@ static void audio_configure_equaliser(void)
 				   sample_rate,
 				   bass_cutoff_hz,
 				   bass_gain_db,
-				   slope);
+				   slope,
+				   g_eq_post_gain);
 	biquad_configure_low_shelf(&g_bass_filter_right,
 				   sample_rate,
 				   bass_cutoff_hz,
 				   bass_gain_db,
-				   slope);
+				   slope,
+				   g_eq_post_gain);
 
 	g_eq_configured = true;
 }
@@ -190,8 +319,20 @@ static void audio_recompute_timing(void)
 	else if(g_audio_sample_rate < 8000u)
 		g_audio_sample_rate = 8000u;
 
-	g_freq_inc_ref = g_audio_sample_rate * 16u;
-	g_freq_inc_scale = (g_freq_inc_ref + (g_audio_sample_rate / 2u)) / g_audio_sample_rate;
+	switch(g_audio_quality) {
+	case AUDIO_QUALITY_NATIVE:
+		g_synth_rate = DMG_CLOCK_FREQ_U / 128u;
+		break;
+	case AUDIO_QUALITY_HIGH:
+		g_synth_rate = DMG_CLOCK_FREQ_U / 64u;
+		break;
+	default:
+		g_synth_rate = g_audio_sample_rate;
+		break;
+	}
+
+	g_freq_inc_ref = g_synth_rate * 16u;
+	g_freq_inc_scale = (g_freq_inc_ref + (g_synth_rate / 2u)) / g_synth_rate;
 	if(g_freq_inc_scale == 0)
 		g_freq_inc_scale = 1;
 
@@ -205,6 +346,7 @@ static void audio_recompute_timing(void)
 	g_eq_configured = false;
 	if(g_eq_enabled)
 		audio_configure_equaliser();
+	rs_configure();
 }
 
 static void audio_ensure_params(void)
@@ -227,6 +369,23 @@ void audio_set_sample_rate(uint32_t sample_rate)
 	audio_recompute_timing();
 }
 
+void audio_set_quality(enum audio_quality quality)
+{
+	g_audio_quality = quality < AUDIO_QUALITY_COUNT ? quality : AUDIO_QUALITY_DIRECT;
+	audio_recompute_timing();
+}
+
+enum audio_quality audio_get_quality(void)
+{
+	return g_audio_quality;
+}
+
+uint32_t audio_get_synth_rate(void)
+{
+	audio_ensure_params();
+	return g_synth_rate;
+}
+
 uint32_t audio_samples_per_frame(void)
 {
 	audio_ensure_params();
@@ -244,6 +403,138 @@ uint32_t audio_samples_per_buffer(void)
  */
 static uint8_t audio_mem[AUDIO_MEM_SIZE];
 
+/*
+ * audio_write runs on the emulator thread while audio_callback renders on
+ * the audio task, so the two sides share no channel state. The emulator
+ * side keeps its own copy of the registers for audio_read and posts each
+ * write, stamped with the cycle offset inside the current video frame,
+ * to a single-producer/single-consumer ring. The renderer applies the
+ * writes at the matching sample offset of the buffer it is producing.
+ * audio_frame_end closes each emulated frame with a marker.
+ */
+#define AUDIO_EVENT_QUEUE_SIZE		1024u
+#define AUDIO_EVENT_QUEUE_MASK		(AUDIO_EVENT_QUEUE_SIZE - 1u)
+#define AUDIO_EVENT_FRAME_END		0x0000
+/* Whole frames the renderer may trail the emulator before it applies the
+ * oldest writes immediately instead of on their samples. */
+#define AUDIO_EVENT_MAX_LAG_FRAMES	3u
+
+struct audio_event {
+	uint32_t cycle;
+	uint16_t addr;
+	uint8_t val;
+};
+
+static struct audio_event g_event_queue[AUDIO_EVENT_QUEUE_SIZE];
+/* Written only by the producer (emulator thread). */
+static uint32_t g_event_head = 0;
+static uint32_t g_event_frames_pushed = 0;
+static uint32_t g_event_dropped = 0;
+/* Written only by the consumer (renderer). */
+static uint32_t g_event_tail = 0;
+static uint32_t g_event_frames_popped = 0;
+static uint32_t g_event_peak = 0;
+/* Set once part of the current emulated frame has been rendered; its
+ * remaining writes are then late and apply at the render cursor. */
+static bool g_event_frame_open = false;
+
+/* Emulator-side register file read back by audio_read. */
+static uint8_t g_reg_shadow[AUDIO_MEM_SIZE];
+
+/*
+ * NR52 channel status. The renderer publishes its channel bits together
+ * with the queue tail they reflect, (tail << 4) | bits, after each buffer.
+ * Writes still queued behind that tail are not in the bits yet, so the
+ * emulator side remembers the queue slot of each channel trigger and of
+ * the last power-off it pushed, and audio_read applies those that are still
+ * pending on top of the published bits. Slots compare modulo 2^28.
+ */
+#define CHAN_STATUS_TAIL_SHIFT	4
+#define CHAN_STATUS_SLOT_MASK	(UINT32_MAX >> CHAN_STATUS_TAIL_SHIFT)
+#define CHAN_STATUS_POWER_OFF	4	/* Pending-slot index after the channels. */
+static uint32_t g_chan_status = 0;
+/* Written only by the producer (emulator thread). */
+static uint8_t g_status_pending = 0;
+static uint32_t g_status_slot[CHAN_STATUS_POWER_OFF + 1];
+static audio_cycle_source_t g_cycle_source = NULL;
+static audio_write_hook_t g_write_hook = NULL;
+
+static inline uint32_t event_load_acquire(const uint32_t *p)
+{
+	return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static inline void event_store_release(uint32_t *p, const uint32_t v)
+{
+	__atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+static bool audio_event_push(const uint32_t cycle, const uint16_t addr,
+		const uint8_t val)
+{
+	const uint32_t head = g_event_head;
+
+	if(head - event_load_acquire(&g_event_tail) >= AUDIO_EVENT_QUEUE_SIZE) {
+		event_store_release(&g_event_dropped, g_event_dropped + 1);
+		return false;
+	}
+
+	struct audio_event *ev = &g_event_queue[head & AUDIO_EVENT_QUEUE_MASK];
+	ev->cycle = cycle;
+	ev->addr = addr;
+	ev->val = val;
+	event_store_release(&g_event_head, head + 1);
+	return true;
+}
+
+static inline const struct audio_event *audio_event_peek(void)
+{
+	const uint32_t tail = g_event_tail;
+
+	if(tail == event_load_acquire(&g_event_head))
+		return NULL;
+	return &g_event_queue[tail & AUDIO_EVENT_QUEUE_MASK];
+}
+
+static inline void audio_event_pop(void)
+{
+	event_store_release(&g_event_tail, g_event_tail + 1);
+}
+
+/* Renderer side: publishes the channel bits applied up to the queue tail. */
+static void chan_status_publish(void)
+{
+	event_store_release(&g_chan_status,
+		(g_event_tail << CHAN_STATUS_TAIL_SHIFT) |
+		(audio_mem[0xFF26 - AUDIO_ADDR_COMPENSATION] & 0x0F));
+}
+
+/* Emulator side: records a trigger (or, for CHAN_STATUS_POWER_OFF, a
+ * power-off) pushed into queue slot "slot". */
+static void chan_status_note(const uint_fast8_t index, const uint32_t slot)
+{
+	if(index == CHAN_STATUS_POWER_OFF)
+		g_status_pending = 0;
+	g_status_pending |= (uint8_t)(1u << index);
+	g_status_slot[index] = slot;
+}
+
+/* Emulator side: drops notes the renderer has consumed and returns the
+ * last published status word. */
+static uint32_t chan_status_expire(void)
+{
+	const uint32_t published = event_load_acquire(&g_chan_status);
+	const uint32_t tail = published >> CHAN_STATUS_TAIL_SHIFT;
+
+	for(uint_fast8_t i = 0; i <= CHAN_STATUS_POWER_OFF; ++i) {
+		if((g_status_pending & (1u << i)) &&
+				((g_status_slot[i] - tail) & CHAN_STATUS_SLOT_MASK) >=
+				AUDIO_EVENT_QUEUE_SIZE)
+			g_status_pending &= (uint8_t)~(1u << i);
+	}
+	return published;
+}
+
 struct chan_len_ctr {
 	uint8_t load;
 	unsigned enabled : 1;
@@ -283,6 +574,10 @@ static struct chan {
 
 	int_fast16_t val;
 
+	/* Levels last written to the blip buffers (square and noise). */
+	int32_t blip_left;
+	int32_t blip_right;
+
 	struct chan_len_ctr    len;
 	struct chan_vol_env    env;
 	struct chan_freq_sweep sweep;
@@ -293,18 +588,159 @@ static struct chan {
 			uint8_t duty_counter;
 		} square;
 		struct {
-			uint16_t lfsr_reg;
+			/* LFSR history (bit n = output n+1 steps back) when
+			 * the current sequence was entered, and the steps
+			 * taken since, saturating at 16. */
+			uint16_t lfsr_anchor;
+			uint8_t  lfsr_steps;
 			uint8_t  lfsr_wide;
 			uint8_t  lfsr_div;
+			/* Position in the 7- or 15-bit output sequence. */
+			uint16_t lfsr_pos;
 		} noise;
-		struct {
-			uint8_t sample;
-		} wave;
 	};
 } chans[4];
 
 static int32_t vol_l, vol_r;
 
+/*
+ * Square and noise channels are synthesised with a blip buffer: every
+ * change in a channel's output level is written as a delta, spread over
+ * BLIP_TAPS samples by a windowed-sinc impulse picked for the sub-sample
+ * position of the edge, and the buffer is integrated once per mix block.
+ * Work therefore scales with the number of edges, and tones near or above
+ * Nyquist no longer fold back as point-sampled aliases. The kernel delays
+ * these channels by BLIP_TAPS/2 - 1 samples relative to the wave channel.
+ *
+ * A channel whose edges would outnumber the output samples (high-rate noise,
+ * square waves far above Nyquist) is instead averaged over each sample and
+ * written as one unfiltered step at the kernel's centre tap, which keeps the
+ * same delay and costs two adds per sample however fast the timer runs.
+ * Build with -DMINIGB_APU_BLIP_AVERAGE=0 to put every edge through the
+ * kernel, e.g. to compare against it (native/apu_bench --compare edges).
+ */
+#ifndef MINIGB_APU_BLIP_AVERAGE
+#define MINIGB_APU_BLIP_AVERAGE 1
+#endif
+
+#define BLIP_TAPS		16
+#define BLIP_PHASE_BITS		6
+#define BLIP_PHASES		(1u << BLIP_PHASE_BITS)
+#define BLIP_KERNEL_BITS	12
+/* Pass band as a fraction of Nyquist; the short kernel rolls off above it. */
+#define BLIP_CUTOFF		0.85
+
+static int16_t g_blip_kernel[BLIP_PHASES][BLIP_TAPS];
+static bool g_blip_kernel_ready = false;
+static int32_t g_blip_left[AUDIO_MIX_BLOCK_FRAMES + BLIP_TAPS];
+static int32_t g_blip_right[AUDIO_MIX_BLOCK_FRAMES + BLIP_TAPS];
+static int32_t g_blip_sum_left = 0;
+static int32_t g_blip_sum_right = 0;
+
+static void blip_build_kernel(void)
+{
+	const double centre = (double)(BLIP_TAPS / 2 - 1);
+
+	for(uint_fast8_t p = 0; p < BLIP_PHASES; ++p) {
+		double taps[BLIP_TAPS];
+		double total = 0.0;
+
+		for(uint_fast8_t k = 0; k < BLIP_TAPS; ++k) {
+			const double x = (double)k - centre - (double)p / BLIP_PHASES;
+			const double arg = M_PI * BLIP_CUTOFF * x;
+			const double sinc = fabs(arg) < 1e-9 ? 1.0 : sin(arg) / arg;
+			/* Blackman window spanning the kernel, centred on the edge. */
+			const double w = (x + BLIP_TAPS / 2.0) / BLIP_TAPS;
+			const double window = 0.42 - 0.5 * cos(2.0 * M_PI * w) +
+				0.08 * cos(4.0 * M_PI * w);
+			taps[k] = sinc * (window > 0.0 ? window : 0.0);
+			total += taps[k];
+		}
+
+		/* Each row must sum exactly to unity so the integrator cannot drift. */
+		int32_t sum = 0;
+		uint_fast8_t peak = 0;
+		for(uint_fast8_t k = 0; k < BLIP_TAPS; ++k) {
+			g_blip_kernel[p][k] = (int16_t)lrint(taps[k] / total *
+				(double)(1 << BLIP_KERNEL_BITS));
+			sum += g_blip_kernel[p][k];
+			if(g_blip_kernel[p][k] > g_blip_kernel[p][peak])
+				peak = k;
+		}
+		g_blip_kernel[p][peak] += (int16_t)((1 << BLIP_KERNEL_BITS) - sum);
+	}
+
+	g_blip_kernel_ready = true;
+}
+
+static void blip_reset(void)
+{
+	if(!g_blip_kernel_ready)
+		blip_build_kernel();
+	memset(g_blip_left, 0, sizeof(g_blip_left));
+	memset(g_blip_right, 0, sizeof(g_blip_right));
+	g_blip_sum_left = g_blip_sum_right = 0;
+}
+
+/* Position of an edge within its output sample, in 1/BLIP_PHASES steps.
+ * "excess" is how far the frequency counter overshot when the edge fired;
+ * "recip" is BLIP_PHASES * 2^32 / freq_inc. */
+static inline uint_fast8_t blip_phase(const uint32_t freq_inc,
+		const uint32_t excess, const uint32_t recip)
+{
+	const uint32_t phase = (uint32_t)(((uint64_t)(freq_inc - excess) * recip) >> 32);
+	return phase < BLIP_PHASES ? (uint_fast8_t)phase : BLIP_PHASES - 1;
+}
+
+static inline uint32_t blip_recip(const uint32_t freq_inc)
+{
+	return (uint32_t)(((uint64_t)BLIP_PHASES << 32) / freq_inc);
+}
+
+static void blip_add_delta(const uint_fast16_t frame, const uint_fast8_t phase,
+		const int32_t delta_l, const int32_t delta_r)
+{
+	const int16_t *kernel = g_blip_kernel[phase];
+	int32_t *left = g_blip_left + frame;
+	int32_t *right = g_blip_right + frame;
+
+	for(uint_fast8_t k = 0; k < BLIP_TAPS; ++k) {
+		left[k] += delta_l * kernel[k];
+		right[k] += delta_r * kernel[k];
+	}
+}
+
+/* A step that takes effect at the kernel's centre tap of "frame", without
+ * band-limiting; for levels already averaged over the sample. */
+static inline void blip_add_step(const uint_fast16_t frame,
+		const int32_t delta_l, const int32_t delta_r)
+{
+	g_blip_left[frame + BLIP_TAPS / 2 - 1] += delta_l * (1 << BLIP_KERNEL_BITS);
+	g_blip_right[frame + BLIP_TAPS / 2 - 1] += delta_r * (1 << BLIP_KERNEL_BITS);
+}
+
+/* Integrates the first "frames" entries into the mix and carries the
+ * kernel tails over to the next block. */
+static void blip_read(int32_t *mix, const uint_fast16_t frames)
+{
+	int32_t sum_l = g_blip_sum_left;
+	int32_t sum_r = g_blip_sum_right;
+
+	for(uint_fast16_t f = 0; f < frames; ++f) {
+		sum_l += g_blip_left[f];
+		sum_r += g_blip_right[f];
+		mix[f * 2 + 0] += sum_l >> BLIP_KERNEL_BITS;
+		mix[f * 2 + 1] += sum_r >> BLIP_KERNEL_BITS;
+	}
+
+	g_blip_sum_left = sum_l;
+	g_blip_sum_right = sum_r;
+	memmove(g_blip_left, g_blip_left + frames, BLIP_TAPS * sizeof(int32_t));
+	memmove(g_blip_right, g_blip_right + frames, BLIP_TAPS * sizeof(int32_t));
+	memset(g_blip_left + BLIP_TAPS, 0, frames * sizeof(int32_t));
+	memset(g_blip_right + BLIP_TAPS, 0, frames * sizeof(int32_t));
+}
+
 static void set_note_freq(struct chan *c, const uint32_t freq)
 {
 	/* Lowest expected value of freq is 64. */
@@ -353,21 +789,6 @@ static void update_len(struct chan *c)
 	}
 }
 
-static bool update_freq(struct chan *c, uint32_t *pos)
-{
-	uint32_t inc = c->freq_inc - *pos;
-	c->freq_counter += inc;
-
-	if (c->freq_counter > g_freq_inc_ref) {
-		*pos		= c->freq_inc - (c->freq_counter - g_freq_inc_ref);
-		c->freq_counter = 0;
-		return true;
-	} else {
-		*pos = c->freq_inc;
-		return false;
-	}
-}
-
 static void update_sweep(struct chan *c)
 {
 	c->sweep.counter += c->sweep.inc;
@@ -393,74 +814,189 @@ static void update_sweep(struct chan *c)
 	}
 }
 
-static void update_square(int16_t* samples, const bool ch2)
+/* Moves a channel's blip output to "level" (before panning) at the given
+ * frame and sub-sample phase. */
+static inline void chan_blip_level(struct chan *c, const uint_fast16_t frame,
+		const uint_fast8_t phase, const int32_t level)
+{
+	const int32_t left = level * c->on_left * vol_l;
+	const int32_t right = level * c->on_right * vol_r;
+
+	if (left == c->blip_left && right == c->blip_right)
+		return;
+
+	blip_add_delta(frame, phase, left - c->blip_left, right - c->blip_right);
+	c->blip_left = left;
+	c->blip_right = right;
+}
+
+static inline int32_t chan_blip_output(const struct chan *c)
+{
+	return c->muted ? 0 : (int32_t)c->val * c->volume / 4;
+}
+
+/* The timer steps more often than this many times per output sample
+ * (about one edge per sample for square waves and noise) before a channel
+ * switches to per-sample averaging. */
+#define SQUARE_DENSE_STEPS	4u
+#define NOISE_DENSE_STEPS	2u
+
+/* 2^48 / freq_inc, for chan_blip_average. */
+static inline uint32_t blip_average_recip(const uint32_t freq_inc)
+{
+	return (uint32_t)((1ull << 48) / freq_inc);
+}
+
+/* Output level averaged over a sample in which the channel was high for
+ * "high" of its freq_inc timer units; "recip" is blip_average_recip(). */
+static inline int32_t chan_blip_average(const struct chan *c,
+		const uint32_t high, const uint32_t recip)
+{
+	const int32_t lo = VOL_INIT_MIN / MAX_CHAN_VOLUME;
+	const int32_t hi = VOL_INIT_MAX / MAX_CHAN_VOLUME;
+	const uint32_t frac = (uint32_t)(((uint64_t)high * recip) >> 32);
+
+	if (c->muted)
+		return 0;
+	/* frac is at most 1 << 16, so the product fits in 32 bits. */
+	return (lo + (((hi - lo) * (int32_t)frac) >> 16)) * c->volume / 4;
+}
+
+/* Like chan_blip_level, for a level averaged over the whole sample. */
+static inline void chan_blip_average_level(struct chan *c,
+		const uint_fast16_t frame, const int32_t level)
+{
+	const int32_t left = level * c->on_left * vol_l;
+	const int32_t right = level * c->on_right * vol_r;
+
+	if (left == c->blip_left && right == c->blip_right)
+		return;
+
+	blip_add_step(frame, left - c->blip_left, right - c->blip_right);
+	c->blip_left = left;
+	c->blip_right = right;
+}
+
+/* Timer units of the sample remaining at the current level before the
+ * first step. */
+static inline uint32_t chan_first_span(const struct chan *c)
+{
+	return c->freq_counter < g_freq_inc_ref ? g_freq_inc_ref - c->freq_counter : 0;
+}
+
+static void update_square(const uint_fast16_t frames, const bool ch2)
 {
 	uint32_t freq;
 	struct chan* c = chans + ch2;
-	audio_ensure_params();
-	const uint_fast16_t limit = g_audio_nsamples;
 
-	if (!c->powered || !c->enabled)
+	if (!c->powered || !c->enabled) {
+		chan_blip_level(c, 0, 0, 0);
 		return;
+	}
 
 	freq = DMG_CLOCK_FREQ_U / ((2048 - c->freq) << 5);
 	set_note_freq(c, freq);
 	c->freq_inc *= 8;
 
-	for (uint_fast16_t i = 0; i < limit; i += 2) {
+	uint32_t recip_inc = c->freq_inc;
+	uint32_t recip = blip_recip(recip_inc);
+	uint32_t average_recip = blip_average_recip(recip_inc);
+
+	for (uint_fast16_t f = 0; f < frames; ++f) {
 		update_len(c);
 
-		if (!c->enabled)
-			continue;
+		if (!c->enabled) {
+			chan_blip_level(c, f, 0, 0);
+			return;
+		}
 
 		update_env(c);
-		if (!ch2)
+		if (!ch2) {
 			update_sweep(c);
+			if (!c->enabled) {
+				chan_blip_level(c, f, 0, 0);
+				return;
+			}
+			if (c->freq_inc != recip_inc) {
+				recip_inc = c->freq_inc;
+				recip = blip_recip(recip_inc);
+				average_recip = blip_average_recip(recip_inc);
+			}
+		}
 
-		uint32_t pos = 0;
-		uint32_t prev_pos = 0;
-		int32_t sample = 0;
-
-		while (update_freq(c, &pos)) {
-			c->square.duty_counter = (c->square.duty_counter + 1) & 7;
-			sample += ((pos - prev_pos) / c->freq_inc) * c->val;
+		if (MINIGB_APU_BLIP_AVERAGE &&
+				c->freq_inc > SQUARE_DENSE_STEPS * g_freq_inc_ref) {
+			uint32_t high = c->val > 0 ? chan_first_span(c) : 0;
+			c->freq_counter += c->freq_inc;
+			while (c->freq_counter > g_freq_inc_ref) {
+				c->freq_counter -= g_freq_inc_ref;
+				c->square.duty_counter = (c->square.duty_counter + 1) & 7;
+				if (c->square.duty & (1 << c->square.duty_counter))
+					high += MIN(c->freq_counter, g_freq_inc_ref);
+			}
 			c->val = (c->square.duty & (1 << c->square.duty_counter)) ?
 				VOL_INIT_MAX / MAX_CHAN_VOLUME :
 				VOL_INIT_MIN / MAX_CHAN_VOLUME;
-			prev_pos = pos;
-		}
-
-		if (c->muted)
+			chan_blip_average_level(c, f,
+				chan_blip_average(c, high, average_recip));
 			continue;
+		}
 
-		sample += c->val;
-		sample *= c->volume;
-		sample /= 4;
+		/* Envelope and sweep steps land on the sample boundary. */
+		chan_blip_level(c, f, 0, chan_blip_output(c));
 
-		samples[i + 0] += sample * c->on_left * vol_l;
-		samples[i + 1] += sample * c->on_right * vol_r;
+		c->freq_counter += c->freq_inc;
+		while (c->freq_counter > g_freq_inc_ref) {
+			c->freq_counter -= g_freq_inc_ref;
+			c->square.duty_counter = (c->square.duty_counter + 1) & 7;
+			const int_fast16_t val =
+				(c->square.duty & (1 << c->square.duty_counter)) ?
+				VOL_INIT_MAX / MAX_CHAN_VOLUME :
+				VOL_INIT_MIN / MAX_CHAN_VOLUME;
+			if (val == c->val)
+				continue;
+			c->val = val;
+			chan_blip_level(c, f,
+				blip_phase(c->freq_inc, c->freq_counter, recip),
+				chan_blip_output(c));
+		}
 	}
 }
 
-static uint8_t wave_sample(const unsigned int pos, const unsigned int volume)
-{
-	uint8_t sample;
+/*
+ * Wave channel output for each wave RAM position at each NR32 output level
+ * (row 0, mute, is unused). Entries are rebuilt when wave RAM is written, so
+ * update_wave only indexes the table.
+ */
+static int16_t g_wave_table[4][32];
 
-	sample =  audio_mem[(0xFF30 + pos / 2) - AUDIO_ADDR_COMPENSATION];
-	if (pos & 1) {
-		sample &= 0xF;
-	} else {
-		sample >>= 4;
+static void wave_table_update(const uint_fast8_t byte)
+{
+	/* First element is unused. */
+	static const int16_t div[] = { INT16_MAX, 1, 2, 4 };
+	const uint8_t packed = audio_mem[0xFF30 + byte - AUDIO_ADDR_COMPENSATION];
+	const uint8_t nibbles[2] = { (uint8_t)(packed >> 4), (uint8_t)(packed & 0xF) };
+
+	for (uint_fast8_t volume = 1; volume < 4; ++volume) {
+		for (uint_fast8_t n = 0; n < 2; ++n) {
+			int32_t sample = ((int)(nibbles[n] >> (volume - 1)) - 8) *
+				(int)(INT16_MAX/64);
+			sample = sample / div[volume];
+			g_wave_table[volume][byte * 2 + n] = (int16_t)(sample / 4);
+		}
 	}
-	return volume ? (sample >> (volume - 1)) : 0;
 }
 
-static void update_wave(int16_t *samples)
+static void wave_table_rebuild(void)
+{
+	for (uint_fast8_t byte = 0; byte < 16; ++byte)
+		wave_table_update(byte);
+}
+
+static void update_wave(int32_t *samples, const uint_fast16_t limit)
 {
 	uint32_t freq;
 	struct chan *c = chans + 2;
-	audio_ensure_params();
-	const uint_fast16_t limit = g_audio_nsamples;
 
 	if (!c->powered || !c->enabled)
 		return;
@@ -476,49 +1012,173 @@ static void update_wave(int16_t *samples)
 		if (!c->enabled)
 			continue;
 
-		uint32_t pos      = 0;
-		uint32_t prev_pos = 0;
-		int32_t sample   = 0;
+		/* Advance by every position stepped this sample; the
+		 * output holds the last one. */
+		const uint32_t counter = c->freq_counter + c->freq_inc;
+		if (counter > g_freq_inc_ref) {
+			const uint32_t steps = (counter - 1) / g_freq_inc_ref;
+			c->val = (c->val + steps) & 31;
+			c->freq_counter = counter - steps * g_freq_inc_ref;
+		} else {
+			c->freq_counter = counter;
+		}
 
-		c->wave.sample = wave_sample(c->val, c->volume);
+		if (c->volume == 0 || c->muted)
+			continue;
 
-		while (update_freq(c, &pos)) {
-			c->val = (c->val + 1) & 31;
-			sample += ((pos - prev_pos) / c->freq_inc) *
-				((int)c->wave.sample - 8) * (INT16_MAX/64);
-			c->wave.sample = wave_sample(c->val, c->volume);
-			prev_pos  = pos;
-		}
+		const int32_t sample = g_wave_table[c->volume][c->val];
+		samples[i + 0] += sample * c->on_left * vol_l;
+		samples[i + 1] += sample * c->on_right * vol_r;
+	}
+}
 
-		sample += ((int)c->wave.sample - 8) * (int)(INT16_MAX/64);
+/*
+ * Noise LFSR output sequences. Each output is the XNOR of two outputs
+ * tap+1 and tap+2 steps back, so the last 7 (narrow) or 15 (wide) outputs
+ * are the whole state and the channel cycles through a fixed sequence of
+ * 127 or 32767 bits. Position 0 follows a trigger; position "period" is
+ * the all-ones state that locks the output high. The full 16-bit history
+ * only matters when NR43 switches width, where it picks the position in
+ * the other sequence.
+ */
+#define NOISE_PERIOD_NARROW	127u
+#define NOISE_PERIOD_WIDE	32767u
+#define NOISE_TRIGGER_HISTORY	0xFFFEu
 
-		if (c->volume == 0)
-			continue;
+static uint32_t g_noise_seq_narrow[(NOISE_PERIOD_NARROW + 31) / 32];
+static uint32_t g_noise_seq_wide[(NOISE_PERIOD_WIDE + 31) / 32];
+static uint8_t g_noise_pos_narrow[NOISE_PERIOD_NARROW + 1];
+static bool g_noise_tables_ready = false;
 
-		{
-			/* First element is unused. */
-			int16_t div[] = { INT16_MAX, 1, 2, 4 };
-			sample = sample / (div[c->volume]);
-		}
+static inline uint_fast8_t noise_tap(const bool wide)
+{
+	return wide ? 13 : 5;
+}
 
-		if (c->muted)
-			continue;
+static inline uint32_t noise_period(const bool wide)
+{
+	return wide ? NOISE_PERIOD_WIDE : NOISE_PERIOD_NARROW;
+}
 
-		sample /= 4;
+static inline const uint32_t *noise_seq(const bool wide)
+{
+	return wide ? g_noise_seq_wide : g_noise_seq_narrow;
+}
 
-		samples[i + 0] += sample * c->on_left * vol_l;
-		samples[i + 1] += sample * c->on_right * vol_r;
+static inline uint_fast8_t noise_seq_bit(const uint32_t *seq, const uint32_t pos)
+{
+	return (seq[pos >> 5] >> (pos & 31)) & 1;
+}
+
+/* Ones among the "count" outputs from "pos" on, wrapping at "period". */
+static uint32_t noise_seq_ones(const uint32_t *seq, const uint32_t period,
+		uint32_t pos, uint32_t count)
+{
+	uint32_t ones = 0;
+
+	while (count > 0) {
+		uint32_t take = 32 - (pos & 31);
+		if (take > period - pos)
+			take = period - pos;
+		if (take > count)
+			take = count;
+		uint32_t bits = seq[pos >> 5] >> (pos & 31);
+		if (take < 32)
+			bits &= (1u << take) - 1;
+		ones += (uint32_t)__builtin_popcount(bits);
+		pos += take;
+		if (pos == period)
+			pos = 0;
+		count -= take;
+	}
+	return ones;
+}
+
+static void noise_build_sequence(const bool wide)
+{
+	const uint_fast8_t tap = noise_tap(wide);
+	const uint32_t mask = (1u << (tap + 2)) - 1;
+	uint32_t *seq = wide ? g_noise_seq_wide : g_noise_seq_narrow;
+	uint32_t history = NOISE_TRIGGER_HISTORY & mask;
+
+	memset(seq, 0, (wide ? sizeof(g_noise_seq_wide) : sizeof(g_noise_seq_narrow)));
+	for (uint32_t pos = 0; pos < noise_period(wide); ++pos) {
+		if (!wide)
+			g_noise_pos_narrow[history] = (uint8_t)pos;
+		const uint32_t bit = !(((history >> (tap + 1)) ^ (history >> tap)) & 1);
+		seq[pos >> 5] |= bit << (pos & 31);
+		history = ((history << 1) | bit) & mask;
+	}
+	if (!wide)
+		g_noise_pos_narrow[mask] = NOISE_PERIOD_NARROW;
+}
+
+static void noise_build_tables(void)
+{
+	if (g_noise_tables_ready)
+		return;
+	noise_build_sequence(false);
+	noise_build_sequence(true);
+	g_noise_tables_ready = true;
+}
+
+/* Position in a sequence whose preceding outputs match "history". */
+static uint32_t noise_find_pos(const bool wide, uint32_t history)
+{
+	const uint_fast8_t tap = noise_tap(wide);
+	const uint32_t mask = (1u << (tap + 2)) - 1;
+
+	history &= mask;
+	if (!wide)
+		return g_noise_pos_narrow[history];
+	if (history == mask)
+		return NOISE_PERIOD_WIDE;
+
+	/* Width switches without a retrigger are rare; scan for the state. */
+	uint32_t window = NOISE_TRIGGER_HISTORY & mask;
+	for (uint32_t pos = 0; pos < NOISE_PERIOD_WIDE; ++pos) {
+		if (window == history)
+			return pos;
+		window = ((window << 1) | noise_seq_bit(g_noise_seq_wide, pos)) & mask;
 	}
+	return 0;
+}
+
+/* The last 16 outputs of the noise channel, newest in bit 0. */
+static uint16_t noise_history(const struct chan *c)
+{
+	const bool wide = c->noise.lfsr_wide;
+	const uint32_t period = noise_period(wide);
+	const uint32_t pos = c->noise.lfsr_pos;
+	const uint_fast8_t steps = c->noise.lfsr_steps;
+	uint32_t history = (uint32_t)c->noise.lfsr_anchor << steps;
+
+	for (uint_fast8_t n = 0; n < steps; ++n) {
+		const uint32_t bit = pos >= period ? 1 :
+			noise_seq_bit(noise_seq(wide), (pos + period - 1 - n) % period);
+		history |= bit << n;
+	}
+	return (uint16_t)history;
+}
+
+static void noise_set_width(struct chan *c, const bool wide)
+{
+	if (wide == c->noise.lfsr_wide)
+		return;
+	c->noise.lfsr_anchor = noise_history(c);
+	c->noise.lfsr_steps = 0;
+	c->noise.lfsr_wide = wide;
+	c->noise.lfsr_pos = (uint16_t)noise_find_pos(wide, c->noise.lfsr_anchor);
 }
 
-static void update_noise(int16_t *samples)
+static void update_noise(const uint_fast16_t frames)
 {
 	struct chan *c = chans + 3;
-	audio_ensure_params();
-	const uint_fast16_t limit = g_audio_nsamples;
 
-	if (!c->powered)
+	if (!c->powered) {
+		chan_blip_level(c, 0, 0, 0);
 		return;
+	}
 
 	{
 		const uint32_t lfsr_div_lut[] = {
@@ -533,48 +1193,307 @@ static void update_noise(int16_t *samples)
 	if (c->freq >= 14)
 		c->enabled = 0;
 
-	for (uint_fast16_t i = 0; i < limit; i += 2) {
+	const uint32_t recip = blip_recip(c->freq_inc);
+	const uint32_t average_recip = blip_average_recip(c->freq_inc);
+	const bool dense = MINIGB_APU_BLIP_AVERAGE &&
+		c->freq_inc > NOISE_DENSE_STEPS * g_freq_inc_ref;
+	const uint32_t dense_steps = c->freq_inc / g_freq_inc_ref;
+	const uint32_t *seq = noise_seq(c->noise.lfsr_wide);
+	const uint32_t period = noise_period(c->noise.lfsr_wide);
+	uint32_t pos = c->noise.lfsr_pos;
+	uint32_t steps = 0;
+
+	for (uint_fast16_t f = 0; f < frames; ++f) {
 		update_len(c);
 
-		if (!c->enabled)
-			continue;
+		if (!c->enabled) {
+			chan_blip_level(c, f, 0, 0);
+			break;
+		}
 
 		update_env(c);
 
-		uint32_t pos      = 0;
-		uint32_t prev_pos = 0;
-		int32_t sample    = 0;
+		if (dense) {
+			/* Every step but the last holds its level for a whole
+			 * g_freq_inc_ref; the last one holds it for what is left
+			 * of the sample. */
+			uint32_t high = c->val > 0 ? chan_first_span(c) : 0;
+			uint32_t n = dense_steps;
+			c->freq_counter += c->freq_inc - n * g_freq_inc_ref;
+			if (c->freq_counter > g_freq_inc_ref) {
+				c->freq_counter -= g_freq_inc_ref;
+				n++;
+			} else if (c->freq_counter == 0) {
+				/* The timer steps when it passes the reference,
+				 * not when it reaches it. */
+				c->freq_counter = g_freq_inc_ref;
+				n--;
+			}
+			steps += n;
+			uint_fast8_t bit = 1;
+			if (pos < period) {
+				high += g_freq_inc_ref * noise_seq_ones(seq, period, pos, n - 1);
+				pos = (pos + n - 1) % period;
+				bit = noise_seq_bit(seq, pos);
+				if (++pos == period)
+					pos = 0;
+			} else {
+				high += g_freq_inc_ref * (n - 1);
+			}
+			if (bit)
+				high += c->freq_counter;
+			c->val = bit ? VOL_INIT_MAX / MAX_CHAN_VOLUME :
+				VOL_INIT_MIN / MAX_CHAN_VOLUME;
+			chan_blip_average_level(c, f,
+				chan_blip_average(c, high, average_recip));
+			continue;
+		}
+
+		chan_blip_level(c, f, 0, chan_blip_output(c));
 
-		while (update_freq(c, &pos)) {
-			c->noise.lfsr_reg = (c->noise.lfsr_reg << 1) |
-				(c->val >= VOL_INIT_MAX/MAX_CHAN_VOLUME);
+		c->freq_counter += c->freq_inc;
+		while (c->freq_counter > g_freq_inc_ref) {
+			c->freq_counter -= g_freq_inc_ref;
+			steps++;
 
-			if (c->noise.lfsr_wide) {
-				c->val = !(((c->noise.lfsr_reg >> 14) & 1) ^
-						((c->noise.lfsr_reg >> 13) & 1)) ?
-					VOL_INIT_MAX / MAX_CHAN_VOLUME :
-					VOL_INIT_MIN / MAX_CHAN_VOLUME;
-			} else {
-				c->val = !(((c->noise.lfsr_reg >> 6) & 1) ^
-						((c->noise.lfsr_reg >> 5) & 1)) ?
-					VOL_INIT_MAX / MAX_CHAN_VOLUME :
-					VOL_INIT_MIN / MAX_CHAN_VOLUME;
+			uint_fast8_t bit = 1;
+			if (pos < period) {
+				bit = noise_seq_bit(seq, pos);
+				if (++pos == period)
+					pos = 0;
 			}
 
-			sample += ((pos - prev_pos) / c->freq_inc) * c->val;
-			prev_pos = pos;
+			const int_fast16_t val = bit ?
+				VOL_INIT_MAX / MAX_CHAN_VOLUME :
+				VOL_INIT_MIN / MAX_CHAN_VOLUME;
+			if (val == c->val)
+				continue;
+			c->val = val;
+			chan_blip_level(c, f,
+				blip_phase(c->freq_inc, c->freq_counter, recip),
+				chan_blip_output(c));
 		}
+	}
 
-		if (c->muted)
-			continue;
+	c->noise.lfsr_pos = (uint16_t)pos;
+	if (steps > 16u - c->noise.lfsr_steps)
+		steps = 16u - c->noise.lfsr_steps;
+	c->noise.lfsr_steps += (uint8_t)steps;
+}
 
-		sample += c->val;
-		sample *= c->volume;
-		sample /= 4;
+static void audio_apply_write(const uint16_t addr, const uint8_t val);
+static void audio_events_apply_now(const bool one_frame);
 
-		samples[i + 0] += sample * c->on_left * vol_l;
-		samples[i + 1] += sample * c->on_right * vol_r;
+/* Renders "frames" stereo frames into out in blocks of at most
+ * AUDIO_MIX_BLOCK_FRAMES. */
+static void audio_render(int16_t *out, uint_fast16_t frames)
+{
+	while(frames > 0) {
+		const uint_fast16_t block = frames < AUDIO_MIX_BLOCK_FRAMES ?
+			frames : AUDIO_MIX_BLOCK_FRAMES;
+		int32_t *mix = g_mix_block;
+		memset(mix, 0, block * 2 * sizeof(mix[0]));
+
+		update_square(block, 0);
+		update_square(block, 1);
+		update_noise(block);
+		blip_read(mix, block);
+		update_wave(mix, block * 2);
+
+		if(g_eq_configured) {
+			for(uint_fast16_t i = 0; i < block * 2; i += 2) {
+				out[i + 0] = biquad_process(&g_bass_filter_left, mix[i + 0]);
+				out[i + 1] = biquad_process(&g_bass_filter_right, mix[i + 1]);
+			}
+		} else {
+			for(uint_fast16_t i = 0; i < block * 2; i += 2) {
+				out[i + 0] = clamp_to_i16(mix[i + 0]);
+				out[i + 1] = clamp_to_i16(mix[i + 1]);
+			}
+		}
+
+		out += block * 2;
+		frames -= block;
+	}
+}
+
+/*
+ * Polyphase resampler used outside AUDIO_QUALITY_DIRECT. The channels are
+ * synthesised at g_synth_rate (a division of the DMG clock, so the channel
+ * timers step an integral number of cycles per sample) and a windowed-sinc
+ * FIR converts the result to the speaker rate. Row p of the kernel holds the
+ * taps for an output falling p/RS_PHASES of the way between two input
+ * frames; the nearest row is used. The kernel spans g_rs_taps input frames:
+ * the requested output taps, widened by the decimation ratio so the cut-off
+ * tracks the output Nyquist rate. scripts/apu_resampler_response.py plots
+ * the resulting response.
+ */
+#define RS_PHASE_BITS		7
+#define RS_PHASES		(1u << RS_PHASE_BITS)
+#define RS_MAX_TAPS		32
+#define RS_KERNEL_BITS		14
+/* Pass band as a fraction of the lower of the two Nyquist rates. */
+#define RS_CUTOFF		0.90
+/* Input frames per callback: one video frame at 65536 Hz, plus margin. */
+#define RS_MAX_INPUT		1152
+
+static int16_t g_rs_kernel[RS_PHASES + 1][RS_MAX_TAPS];
+static uint_fast8_t g_rs_taps = 0;
+static int16_t g_rs_in[(RS_MAX_TAPS + RS_MAX_INPUT) * 2];
+static uint32_t g_rs_fill = 0;	/* Input frames held in g_rs_in. */
+static uint32_t g_rs_frac = 0;	/* Next output's offset past g_rs_in[0], in 1/g_audio_sample_rate. */
+static uint32_t g_rs_max_output = 0;
+static uint32_t g_rs_kernel_in_rate = 0;	/* Rates the kernel was built for. */
+static uint32_t g_rs_kernel_out_rate = 0;
+static uint_fast8_t g_rs_kernel_taps = 0;
+
+static uint_fast8_t rs_output_taps(void)
+{
+	return g_audio_quality == AUDIO_QUALITY_HIGH ? 16 : 8;
+}
+
+static void rs_configure(void)
+{
+	g_rs_taps = 0;
+	if(g_audio_quality == AUDIO_QUALITY_DIRECT)
+		return;
+
+	const double ratio = (double)g_synth_rate / (double)g_audio_sample_rate;
+	uint32_t taps = (uint32_t)ceil(rs_output_taps() * (ratio > 1.0 ? ratio : 1.0));
+	taps = (taps + 1u) & ~1u;
+	if(taps > RS_MAX_TAPS)
+		taps = RS_MAX_TAPS;
+	g_rs_taps = (uint_fast8_t)taps;
+
+	/* Start with a kernel's worth of silence so latency is constant. */
+	memset(g_rs_in, 0, sizeof(g_rs_in));
+	g_rs_fill = taps - 1u;
+	g_rs_frac = 0;
+	g_rs_max_output = (uint32_t)(((uint64_t)(RS_MAX_INPUT - 1u) *
+		g_audio_sample_rate) / g_synth_rate);
+
+	if(g_rs_kernel_in_rate == g_synth_rate &&
+			g_rs_kernel_out_rate == g_audio_sample_rate &&
+			g_rs_kernel_taps == taps)
+		return;
+	g_rs_kernel_in_rate = g_synth_rate;
+	g_rs_kernel_out_rate = g_audio_sample_rate;
+	g_rs_kernel_taps = (uint_fast8_t)taps;
+
+	/* Cut-off in cycles per input frame. */
+	const double fc = 0.5 * RS_CUTOFF * (ratio > 1.0 ? 1.0 / ratio : 1.0);
+	const double centre = (double)(taps / 2 - 1);
+
+	for(uint_fast16_t p = 0; p <= RS_PHASES; ++p) {
+		double h[RS_MAX_TAPS];
+		double total = 0.0;
+
+		for(uint_fast8_t k = 0; k < taps; ++k) {
+			const double x = centre + (double)p / RS_PHASES - (double)k;
+			const double arg = 2.0 * M_PI * fc * x;
+			const double sinc = fabs(arg) < 1e-9 ? 1.0 : sin(arg) / arg;
+			const double w = (x + taps / 2.0) / taps;
+			const double window = 0.42 - 0.5 * cos(2.0 * M_PI * w) +
+				0.08 * cos(4.0 * M_PI * w);
+			h[k] = sinc * (window > 0.0 ? window : 0.0);
+			total += h[k];
+		}
+
+		/* Unity DC gain per row, so phase changes cannot add a ripple. */
+		int32_t sum = 0;
+		uint_fast8_t peak = 0;
+		for(uint_fast8_t k = 0; k < taps; ++k) {
+			g_rs_kernel[p][k] = (int16_t)lrint(h[k] / total *
+				(double)(1 << RS_KERNEL_BITS));
+			sum += g_rs_kernel[p][k];
+			if(g_rs_kernel[p][k] > g_rs_kernel[p][peak])
+				peak = k;
+		}
+		g_rs_kernel[p][peak] += (int16_t)((1 << RS_KERNEL_BITS) - sum);
+	}
+}
+
+static void audio_render_events(int16_t *samples, const uint_fast16_t frames);
+
+/* Renders enough synthesis-rate frames for "frames" output frames and
+ * filters them down to the output rate. */
+static void rs_process(int16_t *out, const uint_fast16_t frames)
+{
+	const uint32_t out_rate = g_audio_sample_rate;
+	const uint32_t in_rate = g_synth_rate;
+	const uint_fast8_t taps = g_rs_taps;
+	if(frames == 0)
+		return;
+	const uint64_t span = (uint64_t)g_rs_frac + (uint64_t)(frames - 1u) * in_rate;
+	const uint32_t last = (uint32_t)(span / out_rate);
+	uint32_t need = last + taps > g_rs_fill ? last + taps - g_rs_fill : 0;
+
+	audio_render_events(g_rs_in + g_rs_fill * 2, (uint_fast16_t)need);
+	g_rs_fill += need;
+
+	uint32_t base = 0;
+	uint32_t frac = g_rs_frac;
+	for(uint_fast16_t f = 0; f < frames; ++f) {
+		const uint32_t phase = (uint32_t)(((uint64_t)frac * RS_PHASES +
+			out_rate / 2u) / out_rate);
+		const int16_t *kernel = g_rs_kernel[phase];
+		const int16_t *in = g_rs_in + base * 2;
+		int32_t acc_l = 0;
+		int32_t acc_r = 0;
+
+		for(uint_fast8_t k = 0; k < taps; ++k) {
+			acc_l += in[k * 2 + 0] * kernel[k];
+			acc_r += in[k * 2 + 1] * kernel[k];
+		}
+		out[f * 2 + 0] = clamp_to_i16((acc_l + (1 << (RS_KERNEL_BITS - 1))) >> RS_KERNEL_BITS);
+		out[f * 2 + 1] = clamp_to_i16((acc_r + (1 << (RS_KERNEL_BITS - 1))) >> RS_KERNEL_BITS);
+
+		frac += in_rate;
+		while(frac >= out_rate) {
+			frac -= out_rate;
+			base++;
+		}
+	}
+
+	g_rs_fill -= base;
+	memmove(g_rs_in, g_rs_in + base * 2, g_rs_fill * 2 * sizeof(int16_t));
+	g_rs_frac = frac;
+}
+
+/* Renders "frames" frames at the synthesis rate, applying each queued
+ * register write at its time-stamped position within the video frame. */
+static void audio_render_events(int16_t *samples, const uint_fast16_t frames)
+{
+	uint_fast16_t cursor = 0;
+	bool frame_closed = false;
+	const struct audio_event *ev;
+
+	while((ev = audio_event_peek()) != NULL) {
+		if(ev->addr == AUDIO_EVENT_FRAME_END) {
+			audio_event_pop();
+			g_event_frames_popped++;
+			frame_closed = true;
+			break;
+		}
+
+		uint_fast16_t at = cursor;
+		if(!g_event_frame_open) {
+			at = (uint_fast16_t)(((uint64_t)ev->cycle * frames) /
+				(uint32_t)SCREEN_REFRESH_CYCLES);
+			if(at < cursor)
+				at = cursor;
+			else if(at > frames)
+				at = frames;
+		}
+
+		audio_render(samples + cursor * 2, at - cursor);
+		cursor = at;
+		audio_apply_write(ev->addr, ev->val);
+		audio_event_pop();
 	}
+
+	audio_render(samples + cursor * 2, frames - cursor);
+	g_event_frame_open = !frame_closed;
 }
 
 /**
@@ -588,13 +1507,15 @@ void audio_callback(void *userdata, uint8_t *stream, int len)
 	/* Appease unused variable warning. */
 	(void)userdata;
 	audio_ensure_params();
+	uint_fast16_t limit = g_audio_nsamples;
 
-	memset(stream, 0, len);
+	if(!g_blip_kernel_ready)
+		blip_reset();
 
-	update_square(samples, 0);
-	update_square(samples, 1);
-	update_wave(samples);
-	update_noise(samples);
+	if(total_samples < limit)
+		limit = total_samples & ~(uint_fast16_t)1;
+	if(g_rs_taps != 0 && limit / 2 > g_rs_max_output)
+		limit = (uint_fast16_t)(g_rs_max_output * 2u);
 
 	if(g_eq_enabled) {
 		if(!g_eq_configured)
@@ -603,25 +1524,25 @@ void audio_callback(void *userdata, uint8_t *stream, int len)
 		audio_reset_filters();
 	}
 
-	if(g_eq_configured) {
-		for(uint_fast16_t i = 0; (i + 1) < total_samples; i += 2) {
-			float left = (float)samples[i + 0];
-			float right = (float)samples[i + 1];
+	{
+		const uint32_t depth = event_load_acquire(&g_event_head) - g_event_tail;
+		if(depth > event_load_acquire(&g_event_peak))
+			event_store_release(&g_event_peak, depth);
+	}
 
-			left = biquad_process(&g_bass_filter_left, left) * g_eq_post_gain;
-			right = biquad_process(&g_bass_filter_right, right) * g_eq_post_gain;
+	/* Emulation ran ahead: fold the oldest frames' writes in at once. */
+	while(event_load_acquire(&g_event_frames_pushed) - g_event_frames_popped >
+			AUDIO_EVENT_MAX_LAG_FRAMES)
+		audio_events_apply_now(true);
 
-			samples[i + 0] = clamp_to_i16(left);
-			samples[i + 1] = clamp_to_i16(right);
-		}
-	} else {
-		for(uint_fast16_t i = 0; (i + 1) < total_samples; i += 2) {
-			const float left = (float)samples[i + 0];
-			const float right = (float)samples[i + 1];
-			samples[i + 0] = clamp_to_i16(left);
-			samples[i + 1] = clamp_to_i16(right);
-		}
-	}
+	if(g_rs_taps != 0)
+		rs_process(samples, limit / 2);
+	else
+		audio_render_events(samples, limit / 2);
+	chan_status_publish();
+
+	if((uint_fast16_t)total_samples > limit)
+		memset(samples + limit, 0, (total_samples - limit) * sizeof(int16_t));
 }
 
 static void chan_trigger(uint_fast8_t i)
@@ -641,8 +1562,8 @@ static void chan_trigger(uint_fast8_t i)
 		c->env.up   = val & 0x08 ? 1 : 0;
 		uint64_t base = (uint64_t)g_freq_inc_ref;
 		c->env.inc  = c->env.step ?
-			(uint32_t)((base * 64u) / ((uint64_t)c->env.step * g_audio_sample_rate)) :
-			(uint32_t)((base * 8u) / g_audio_sample_rate);
+			(uint32_t)((base * 64u) / ((uint64_t)c->env.step * g_synth_rate)) :
+			(uint32_t)((base * 8u) / g_synth_rate);
 		c->env.counter = 0;
 	}
 
@@ -656,7 +1577,7 @@ static void chan_trigger(uint_fast8_t i)
 		c->sweep.shift = (val & 0x07);
 		c->sweep.inc   = c->sweep.rate ?
 			(uint32_t)(((uint64_t)128 * g_freq_inc_ref) /
-				((uint64_t)c->sweep.rate * g_audio_sample_rate)) : 0;
+				((uint64_t)c->sweep.rate * g_synth_rate)) : 0;
 		c->sweep.counter = g_freq_inc_ref;
 	}
 
@@ -666,12 +1587,14 @@ static void chan_trigger(uint_fast8_t i)
 		len_max = 256;
 		c->val = 0;
 	} else if (i == 3) { // noise
-		c->noise.lfsr_reg = 0xFFFF;
+		c->noise.lfsr_anchor = NOISE_TRIGGER_HISTORY;
+		c->noise.lfsr_steps = 0;
+		c->noise.lfsr_pos = 0;
 		c->val = VOL_INIT_MIN / MAX_CHAN_VOLUME;
 	}
 
 	c->len.inc = (uint32_t)(((uint64_t)256 * g_freq_inc_ref) /
-		((uint64_t)g_audio_sample_rate * (len_max - c->len.load)));
+		((uint64_t)g_synth_rate * (len_max - c->len.load)));
 	c->len.counter = 0;
 }
 
@@ -694,17 +1617,22 @@ uint8_t audio_read(const uint16_t addr)
 		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
 	};
 
-	return audio_mem[addr - AUDIO_ADDR_COMPENSATION] |
-		ortab[addr - AUDIO_ADDR_COMPENSATION];
+	uint8_t val = g_reg_shadow[addr - AUDIO_ADDR_COMPENSATION];
+
+	if(addr == 0xFF26) {
+		uint8_t status = (uint8_t)(chan_status_expire() & 0x0F);
+		if(g_status_pending & (1u << CHAN_STATUS_POWER_OFF))
+			status = 0;
+		val = (val & 0x80) | status | (g_status_pending & 0x0F);
+	}
+
+	return val | ortab[addr - AUDIO_ADDR_COMPENSATION];
 }
 
 /**
- * Write audio register.
- * \param addr	Address of audio register. Must be 0xFF10 <= addr <= 0xFF3F.
- *				This is not checked in this function.
- * \param val	Byte to write at address.
+ * Apply a queued register write to the renderer's state.
  */
-void audio_write(const uint16_t addr, const uint8_t val)
+static void audio_apply_write(const uint16_t addr, const uint8_t val)
 {
 	audio_ensure_params();
 	/* Find sound channel corresponding to register address. */
@@ -734,6 +1662,11 @@ void audio_write(const uint16_t addr, const uint8_t val)
 	audio_mem[addr - AUDIO_ADDR_COMPENSATION] = val;
 	i = (addr - AUDIO_ADDR_COMPENSATION) / 5;
 
+	if (addr >= 0xFF30) {
+		wave_table_update(addr - 0xFF30);
+		return;
+	}
+
 	switch (addr) {
 	case 0xFF12:
 	case 0xFF17:
@@ -764,14 +1697,18 @@ void audio_write(const uint16_t addr, const uint8_t val)
 		break;
 
 	case 0xFF11:
-	case 0xFF16:
-	case 0xFF20: {
+	case 0xFF16: {
 		const uint8_t duty_lookup[] = { 0x10, 0x30, 0x3C, 0xCF };
 		chans[i].len.load = val & 0x3f;
 		chans[i].square.duty = duty_lookup[val >> 6];
 		break;
 	}
 
+	case 0xFF20:
+		/* NR41 has no duty bits; the noise LFSR shares that storage. */
+		chans[i].len.load = val & 0x3f;
+		break;
+
 	case 0xFF1B:
 		chans[i].len.load = val;
 		break;
@@ -803,7 +1740,7 @@ void audio_write(const uint16_t addr, const uint8_t val)
 
 	case 0xFF22:
 		chans[3].freq = val >> 4;
-		chans[3].noise.lfsr_wide = !(val & 0x08);
+		noise_set_width(&chans[3], !(val & 0x08));
 		chans[3].noise.lfsr_div = val & 0x07;
 		break;
 
@@ -823,12 +1760,121 @@ void audio_write(const uint16_t addr, const uint8_t val)
 	}
 }
 
+/**
+ * Write audio register.
+ * \param addr	Address of audio register. Must be 0xFF10 <= addr <= 0xFF3F.
+ *				This is not checked in this function.
+ * \param val	Byte to write at address.
+ */
+void audio_write(const uint16_t addr, const uint8_t val)
+{
+	uint8_t *reg = g_reg_shadow;
+	int_fast8_t status_note = -1;
+
+	if(g_write_hook != NULL)
+		g_write_hook(g_cycle_source != NULL ? g_cycle_source() : 0, addr, val);
+
+	if(addr == 0xFF26) {
+		reg[addr - AUDIO_ADDR_COMPENSATION] = val & 0x80;
+		if((val & 0x80) == 0) {
+			memset(reg, 0x00, 0xFF26 - AUDIO_ADDR_COMPENSATION);
+			status_note = CHAN_STATUS_POWER_OFF;
+		}
+	} else {
+		/* Ignore register writes if APU powered off. */
+		if(reg[0xFF26 - AUDIO_ADDR_COMPENSATION] == 0x00)
+			return;
+
+		reg[addr - AUDIO_ADDR_COMPENSATION] = val;
+
+		/* Report a triggered channel as on before the renderer gets to it. */
+		if((val & 0x80) && (addr == 0xFF14 || addr == 0xFF19 ||
+				addr == 0xFF1E || addr == 0xFF23))
+			status_note = (int_fast8_t)((addr - AUDIO_ADDR_COMPENSATION) / 5);
+	}
+
+	const uint32_t cycle = g_cycle_source != NULL ? g_cycle_source() : 0;
+	const uint32_t slot = g_event_head;
+	if(audio_event_push(cycle, addr, val) && status_note >= 0)
+		chan_status_note((uint_fast8_t)status_note, slot);
+}
+
+void audio_frame_end(void)
+{
+	if(g_write_hook != NULL)
+		g_write_hook(0, AUDIO_EVENT_FRAME_END, 0);
+	if(audio_event_push(0, AUDIO_EVENT_FRAME_END, 0))
+		event_store_release(&g_event_frames_pushed, g_event_frames_pushed + 1);
+	/* Keeps consumed notes from aliasing once slots wrap at 2^28. */
+	chan_status_expire();
+}
+
+void audio_set_cycle_source(audio_cycle_source_t source)
+{
+	g_cycle_source = source;
+}
+
+void audio_set_write_hook(audio_write_hook_t hook)
+{
+	g_write_hook = hook;
+}
+
+void audio_event_stats(uint32_t *dropped, uint32_t *peak_depth)
+{
+	if(dropped != NULL)
+		*dropped = event_load_acquire(&g_event_dropped);
+	if(peak_depth != NULL)
+		*peak_depth = __atomic_exchange_n(&g_event_peak, 0, __ATOMIC_ACQ_REL);
+}
+
+/* Applies queued writes without rendering, up to the end of the oldest
+ * queued frame ("one_frame") or until the queue is empty. */
+static void audio_events_apply_now(const bool one_frame)
+{
+	const struct audio_event *ev;
+
+	while((ev = audio_event_peek()) != NULL) {
+		const uint16_t addr = ev->addr;
+		const uint8_t val = ev->val;
+		audio_event_pop();
+
+		if(addr == AUDIO_EVENT_FRAME_END) {
+			g_event_frames_popped++;
+			g_event_frame_open = false;
+			if(one_frame)
+				return;
+			continue;
+		}
+		audio_apply_write(addr, val);
+	}
+}
+
 void audio_init(void)
 {
+	/* The register defaults below are not part of a write log. */
+	const audio_write_hook_t hook = g_write_hook;
+	g_write_hook = NULL;
+
 	audio_ensure_params();
+	/* Start from power-off, so calling this again replays identically. */
+	memset(audio_mem, 0, sizeof(audio_mem));
+	audio_reset_filters();
 	/* Initialise channels and samples. */
 	memset(chans, 0, sizeof(chans));
 	chans[0].val = chans[1].val = -1;
+	blip_reset();
+	rs_configure();
+	noise_build_tables();
+	chans[3].noise.lfsr_pos = (uint16_t)noise_find_pos(false, 0);
+	wave_table_rebuild();
+
+	/* Runs before the renderer starts, so it may reset both queue ends. */
+	g_event_head = g_event_tail = 0;
+	g_event_frames_pushed = g_event_frames_popped = 0;
+	g_event_frame_open = false;
+	memcpy(g_reg_shadow, audio_mem, sizeof(g_reg_shadow));
+	g_status_pending = 0;
+	chan_status_publish();
 
 	/* Initialise IO registers. */
 	{
@@ -852,4 +1898,8 @@ void audio_init(void)
 		for(uint_fast8_t i = 0; i < sizeof(wave_init); ++i)
 			audio_write(0xFF30 + i, wave_init[i]);
 	}
+
+	audio_events_apply_now(false);
+	chan_status_publish();
+	g_write_hook = hook;
 }
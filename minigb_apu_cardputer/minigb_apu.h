@@ -26,6 +26,28 @@ uint32_t audio_get_sample_rate(void);
 /** Override the active sample rate (Hz) at runtime. */
 void audio_set_sample_rate(uint32_t sample_rate);
 
+/**
+ * How the channels are synthesised. DIRECT renders them at the output rate.
+ * NATIVE and HIGH render at 32768 Hz and 65536 Hz (DMG clock / 128 and / 64)
+ * and resample to the output rate with an 8- or 16-tap polyphase FIR; both
+ * cost more CPU per second of audio than DIRECT.
+ */
+enum audio_quality {
+	AUDIO_QUALITY_DIRECT = 0,
+	AUDIO_QUALITY_NATIVE = 1,
+	AUDIO_QUALITY_HIGH = 2,
+	AUDIO_QUALITY_COUNT
+};
+
+/** Select the synthesis mode. Resets the resampler state. */
+void audio_set_quality(enum audio_quality quality);
+
+/** Query the active synthesis mode. */
+enum audio_quality audio_get_quality(void);
+
+/** Rate (Hz) the channels are synthesised at before resampling. */
+uint32_t audio_get_synth_rate(void);
+
 /** Number of stereo frames generated for each video frame. */
 uint32_t audio_samples_per_frame(void);
 
@@ -53,6 +75,41 @@ void audio_write(const uint16_t addr, const uint8_t val);
  */
 void audio_init(void);
 
+/**
+ * Source of the cycle offset (0 to SCREEN_REFRESH_CYCLES) inside the video
+ * frame being emulated, used to time-stamp register writes.
+ */
+typedef uint32_t (*audio_cycle_source_t)(void);
+
+/**
+ * Set the function audio_write calls to time-stamp each write. Without one,
+ * writes apply at the start of the next rendered buffer.
+ */
+void audio_set_cycle_source(audio_cycle_source_t source);
+
+/**
+ * Observer for register-write logs: called with the write's cycle offset for
+ * every audio_write (before any filtering), and with addr 0 from
+ * audio_frame_end. Replaying the same calls after audio_init reproduces the
+ * output exactly.
+ */
+typedef void (*audio_write_hook_t)(uint32_t cycle, uint16_t addr, uint8_t val);
+
+/** Install (or clear, with NULL) the register-write hook. */
+void audio_set_write_hook(audio_write_hook_t hook);
+
+/**
+ * Mark the end of an emulated frame. Call from the thread that calls
+ * audio_write, once per completed frame.
+ */
+void audio_frame_end(void);
+
+/**
+ * Register writes dropped because the write queue was full (running total)
+ * and the deepest queue seen by the renderer since the last call.
+ */
+void audio_event_stats(uint32_t *dropped, uint32_t *peak_depth);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,820 @@
+// Host benchmark and golden-output check for minigb_apu (`pio run -e apu_bench`).
+//
+//   apu_bench [--rate HZ]... [--quality fast|native|high|all]... [--runs N]
+//             [--seconds N] [--write-golden DIR | --check-golden DIR |
+//             --compare VARIANT [--max-error LSB]] [--dump-pcm DIR] input...
+//   apu_bench --sweep [--rate HZ]... [--quality fast|native|high|all]...
+//             [--runs N] [--seconds N] [--compare VARIANT]
+//   apu_bench --stress-queue [--seconds N]
+//
+// Each input is a register-write log recorded with the native benchmark
+// driver (`program --apu-log game.apulog rom.gb`), or `synthetic:SEED` for
+// seeded random register traffic. The log is replayed through audio_write /
+// audio_frame_end, rendering one audio_callback buffer per frame as the
+// firmware does. For every input, rate (default 44100 and 16384 Hz) and
+// synthesis mode (--quality, default fast; `all` runs the three, so their
+// CPU cost can be compared) it prints the best CPU time of --runs replays
+// per second of rendered audio, and one FNV-1a hash per second of output.
+// --write-golden stores those hashes; --check-golden compares against them
+// and names the first second that differs. The goldens for synthetic:1 to
+// synthetic:4 are kept in golden/ and checked by scripts/apu_golden_check.sh.
+// --dump-pcm writes the raw s16le stereo output for listening or diffing.
+//
+// --compare replays each input through the current APU and through a
+// variant build of it (apu_variant_*.c), prints the largest sample
+// difference and the render cost per stereo frame of both, and fails when
+// the difference exceeds the variant's bound: `--compare double-eq` and
+// `--compare float-eq` check the fixed-point equaliser against the
+// MINIGB_APU_FLOAT_EQ=2 and =1 reference filters, `--compare edges` measures
+// the per-sample averaging of dense square and noise edges against writing
+// each edge through the blip kernel, and `--compare pre046` requires the
+// table-driven wave and noise channels, in that edge-by-edge build, to
+// reproduce the per-sample renderer exactly.
+//
+// --sweep renders steady tones on the square, wave and noise channels across
+// their range (SWEEP_TONES) and prints the render cost per second of audio
+// and, for pitched tones, the share of inharmonic (aliased) energy. With
+// --compare the variant is measured alongside, e.g. `--compare pre042` for
+// the point-sampled renderer the blip buffer replaced.
+//
+// --stress-queue runs the two-thread test of the register-write queue in
+// apu_queue_stress.c and exits non-zero if it finds a lost, reordered or
+// torn event, or an NR52 read that misses a queued trigger or power-off.
+
+#include "apu_log.h"
+#include "apu_variant.h"
+#include "minigb_apu_cardputer/minigb_apu.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Options {
+  std::vector<uint32_t> rates;
+  std::vector<audio_quality> qualities;
+  audio_quality quality = AUDIO_QUALITY_DIRECT;  // the one being run
+  uint32_t runs = 3;
+  double seconds = 0.0;  // 0: whole log (synthetic inputs default to 60 s)
+  std::string write_golden;
+  std::string check_golden;
+  std::string dump_pcm;
+  const apu_variant *compare = nullptr;
+  int max_error = -1;  // LSB; -1: the compared variant's default bound
+  bool sweep = false;
+  bool stress_queue = false;
+};
+
+struct Input {
+  std::string name;  // file stem, used for golden and dump file names
+  std::vector<ApuLogRecord> records;
+};
+
+struct RunResult {
+  uint64_t render_ns = 0;  // audio_callback only
+  uint64_t total_ns = 0;   // writes, frame ends and callbacks
+  uint64_t frames = 0;     // stereo frames rendered
+  std::vector<uint64_t> hashes;
+  std::vector<int16_t> pcm;
+};
+
+constexpr uint64_t FNV_OFFSET = 1469598103934665603ull;
+constexpr uint64_t FNV_PRIME = 1099511628211ull;
+constexpr double SYNTHETIC_SECONDS = 60.0;
+constexpr double SWEEP_SECONDS = 4.0;
+constexpr double STRESS_SECONDS = 4.0;
+
+// The minigb_apu.c linked into this program.
+const apu_variant CURRENT_APU = {
+    "current",
+    audio_set_quality,
+    audio_set_sample_rate,
+    audio_init,
+    audio_set_cycle_source,
+    audio_frame_end,
+    audio_write,
+    audio_read,
+    audio_callback,
+    audio_samples_per_buffer,
+};
+
+struct CompareTarget {
+  const apu_variant *apu;
+  int max_error;  // default bound on |current - variant|, in LSB; -1: none
+  // Build compared against the variant instead of the current APU, when
+  // the two differ by a later change the variant predates.
+  const apu_variant *baseline;
+};
+
+// The fixed-point equaliser stays within 1 LSB of the double-precision
+// filter, 2 after the resampler in the native-rate modes. The float filter
+// loses precision on the shelf's near-unity poles as the synthesis rate
+// rises and drifts up to about 40 LSB from both at 65536 Hz.
+const CompareTarget COMPARE_TARGETS[] = {
+    {&apu_variant_double_eq, 2, nullptr},
+    {&apu_variant_float_eq, 48, nullptr},
+    // Render differently by design; compared by --sweep.
+    {&apu_variant_edges, -1, nullptr},
+    {&apu_variant_pre042, -1, nullptr},
+    // The wave and noise tables must reproduce the per-sample renderer,
+    // which wrote every edge through the blip kernel.
+    {&apu_variant_pre046, 0, &apu_variant_edges},
+};
+
+const CompareTarget *find_compare_target(const char *name) {
+  for(const CompareTarget &target : COMPARE_TARGETS) {
+    if(strcmp(target.apu->name, name) == 0) {
+      return &target;
+    }
+  }
+  return nullptr;
+}
+
+const char *quality_name(audio_quality quality) {
+  switch(quality) {
+    case AUDIO_QUALITY_NATIVE:
+      return "native";
+    case AUDIO_QUALITY_HIGH:
+      return "high";
+    default:
+      return "fast";
+  }
+}
+
+std::string stem_of(const std::string &path) {
+  const size_t slash = path.find_last_of('/');
+  std::string stem = slash == std::string::npos ? path : path.substr(slash + 1);
+  const size_t dot = stem.find_last_of('.');
+  return dot == std::string::npos || dot == 0 ? stem : stem.substr(0, dot);
+}
+
+bool load_log(const std::string &path, Input &input) {
+  FILE *in = fopen(path.c_str(), "rb");
+  if(in == nullptr) {
+    fprintf(stderr, "cannot open '%s'\n", path.c_str());
+    return false;
+  }
+  ApuLogHeader header = {};
+  if(fread(&header, sizeof(header), 1, in) != 1 || header.magic != APU_LOG_MAGIC ||
+     header.version != APU_LOG_VERSION) {
+    fprintf(stderr, "'%s' is not an APU log (version %u)\n", path.c_str(), APU_LOG_VERSION);
+    fclose(in);
+    return false;
+  }
+  ApuLogRecord record;
+  while(fread(&record, sizeof(record), 1, in) == 1) {
+    input.records.push_back(record);
+  }
+  fclose(in);
+  input.name = stem_of(path);
+  return true;
+}
+
+// Random writes to every channel, including wave RAM rewrites, noise width
+// switches and panning changes, at random points in each frame.
+void make_synthetic(uint32_t seed, uint32_t frames, Input &input) {
+  uint32_t state = seed != 0 ? seed : 1;
+  auto next = [&state]() {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  };
+  auto write = [&input](uint32_t cycle, uint16_t addr, uint32_t value) {
+    input.records.push_back({cycle, addr, static_cast<uint8_t>(value), 0});
+  };
+
+  write(0, 0xFF26, 0x80);
+  write(0, 0xFF24, 0x77);
+  write(0, 0xFF25, 0xFF);
+  for(uint32_t frame = 0; frame < frames; ++frame) {
+    const uint32_t writes = next() % 6;
+    for(uint32_t w = 0; w < writes; ++w) {
+      const uint32_t cycle = next() % static_cast<uint32_t>(SCREEN_REFRESH_CYCLES);
+      const uint32_t ch = next() % 4;
+      const uint16_t base = static_cast<uint16_t>(0xFF10 + ch * 5);
+      switch(next() % 10) {
+        case 0:
+          for(uint16_t k = 0; k < 16; ++k) {
+            write(cycle, 0xFF30 + k, next());
+          }
+          break;
+        case 1:
+          write(cycle, 0xFF30 + next() % 16, next());
+          break;
+        case 2:
+          write(cycle, 0xFF22, next());
+          break;
+        case 3:
+          write(cycle, 0xFF1C, (next() & 3) << 5);
+          break;
+        case 4:
+          write(cycle, 0xFF25, next());
+          break;
+        case 5:
+          write(cycle, 0xFF24, next() & 0x77);
+          break;
+        default:
+          if(ch == 2) {
+            write(cycle, 0xFF1A, 0x80);
+            write(cycle, 0xFF1C, (next() & 3) << 5);
+          } else {
+            write(cycle, base + 2, next());
+          }
+          write(cycle, ch == 3 ? 0xFF22 : base + 3, next());
+          write(cycle, base + 1, next());
+          write(cycle, base + 4, (next() & 1 ? 0x80 : 0) | (next() & 0x47));
+          break;
+      }
+    }
+    write(0, APU_LOG_FRAME_END, 0);
+  }
+  input.name = "synthetic-" + std::to_string(seed);
+}
+
+enum class SweepChannel { Square, Wave, Noise };
+
+// One steady tone for --sweep: a frequency register value for the square
+// and wave channels, or an NR43 value for noise.
+struct SweepTone {
+  SweepChannel channel;
+  uint16_t param;
+};
+
+// Channel 1 from 66 Hz to 8.7 kHz in octaves and the wave channel from 66 Hz
+// to 13 kHz in two-octave steps, then at its 65536 Hz limit; odd periods
+// keep the pitches off exact divisors of the output rates. The noise settings run from a slow clock to
+// the fastest, 15-bit, then 7-bit.
+const SweepTone SWEEP_TONES[] = {
+    {SweepChannel::Square, 2048 - 1997}, {SweepChannel::Square, 2048 - 997}, {SweepChannel::Square, 2048 - 499},
+    {SweepChannel::Square, 2048 - 251},  {SweepChannel::Square, 2048 - 127}, {SweepChannel::Square, 2048 - 61},
+    {SweepChannel::Square, 2048 - 31},   {SweepChannel::Square, 2048 - 15},  {SweepChannel::Wave, 2048 - 997},
+    {SweepChannel::Wave, 2048 - 251},    {SweepChannel::Wave, 2048 - 61},    {SweepChannel::Wave, 2048 - 15},
+    {SweepChannel::Wave, 2048 - 5},      {SweepChannel::Wave, 2048 - 1},     {SweepChannel::Noise, 0x77},
+    {SweepChannel::Noise, 0x40},         {SweepChannel::Noise, 0x10},        {SweepChannel::Noise, 0x00},
+    {SweepChannel::Noise, 0x08},
+};
+
+const char *sweep_channel_name(SweepChannel channel) {
+  switch(channel) {
+    case SweepChannel::Square:
+      return "square";
+    case SweepChannel::Wave:
+      return "wave";
+    default:
+      return "noise";
+  }
+}
+
+// Fundamental in Hz; 0 for noise. The channels truncate their pitch to
+// whole hertz.
+double sweep_tone_hz(const SweepTone &tone) {
+  switch(tone.channel) {
+    case SweepChannel::Square:
+      return 131072 / (2048 - tone.param);
+    case SweepChannel::Wave:
+      return 65536 / (2048 - tone.param);
+    default:
+      return 0.0;
+  }
+}
+
+// Starts the tone at full volume on both outputs, with no envelope, sweep
+// or length, then lets it run. The wave channel plays one sine period.
+void make_tone(const SweepTone &tone, uint32_t frames, Input &input) {
+  auto write = [&input](uint16_t addr, uint32_t value) {
+    input.records.push_back({0, addr, static_cast<uint8_t>(value), 0});
+  };
+
+  write(0xFF26, 0x80);
+  write(0xFF24, 0x77);
+  switch(tone.channel) {
+    case SweepChannel::Square:
+      write(0xFF25, 0x11);
+      write(0xFF10, 0x00);
+      write(0xFF11, 0x80);
+      write(0xFF12, 0xF0);
+      write(0xFF13, tone.param & 0xFF);
+      write(0xFF14, 0x80 | (tone.param >> 8));
+      break;
+    case SweepChannel::Wave:
+      write(0xFF25, 0x44);
+      write(0xFF1A, 0x00);
+      for(uint16_t k = 0; k < 16; ++k) {
+        const long hi = lrint(7.5 + 7.5 * sin(2.0 * M_PI * (2 * k) / 32.0));
+        const long lo = lrint(7.5 + 7.5 * sin(2.0 * M_PI * (2 * k + 1) / 32.0));
+        write(0xFF30 + k, static_cast<uint32_t>((hi << 4) | lo));
+      }
+      write(0xFF1A, 0x80);
+      write(0xFF1C, 0x20);
+      write(0xFF1D, tone.param & 0xFF);
+      write(0xFF1E, 0x80 | (tone.param >> 8));
+      break;
+    case SweepChannel::Noise:
+      write(0xFF25, 0x88);
+      write(0xFF21, 0xF0);
+      write(0xFF22, tone.param);
+      write(0xFF23, 0x80);
+      break;
+  }
+  for(uint32_t frame = 0; frame < frames; ++frame) {
+    write(APU_LOG_FRAME_END, 0);
+  }
+  input.name = sweep_channel_name(tone.channel);
+}
+
+void fft(std::vector<std::complex<double>> &x) {
+  const size_t n = x.size();
+  for(size_t i = 1, j = 0; i < n; ++i) {
+    size_t bit = n >> 1;
+    for(; j & bit; bit >>= 1) {
+      j ^= bit;
+    }
+    j ^= bit;
+    if(i < j) {
+      std::swap(x[i], x[j]);
+    }
+  }
+  for(size_t len = 2; len <= n; len <<= 1) {
+    const std::complex<double> step = std::polar(1.0, -2.0 * M_PI / len);
+    for(size_t i = 0; i < n; i += len) {
+      std::complex<double> w = 1.0;
+      for(size_t k = 0; k < len / 2; ++k) {
+        const std::complex<double> odd = x[i + k + len / 2] * w;
+        x[i + k + len / 2] = x[i + k] - odd;
+        x[i + k] += odd;
+        w *= step;
+      }
+    }
+  }
+}
+
+// Share of the left channel's energy away from the harmonics of `hz`, in
+// dB: the aliased (inharmonic) part of a steady tone. Taken from a
+// Blackman-Harris windowed FFT over the largest power-of-two span after the
+// first quarter, which is skipped while the equaliser settles. Bins within
+// the window's main lobe (4 bins) of DC or of a harmonic count as harmonic,
+// so the exact pitch the channel's frequency counter produces does not
+// matter.
+double inharmonic_db(const std::vector<int16_t> &pcm, uint32_t rate, double hz) {
+  constexpr double LOBE_BINS = 4.0;
+  const size_t frames = pcm.size() / 2;
+  const size_t skip = frames / 4;
+  size_t n = 1;
+  while(n * 2 <= frames - skip) {
+    n *= 2;
+  }
+  double mean = 0.0;
+  for(size_t i = 0; i < n; ++i) {
+    mean += pcm[(skip + i) * 2];
+  }
+  mean /= static_cast<double>(n);
+  std::vector<std::complex<double>> spectrum(n);
+  for(size_t i = 0; i < n; ++i) {
+    const double t = 2.0 * M_PI * i / n;
+    const double window = 0.35875 - 0.48829 * cos(t) + 0.14128 * cos(2 * t) - 0.01168 * cos(3 * t);
+    spectrum[i] = (pcm[(skip + i) * 2] - mean) * window;
+  }
+  fft(spectrum);
+
+  const double harmonic_bins = hz * n / rate;
+  double total = 0.0;
+  double inharmonic = 0.0;
+  for(size_t bin = static_cast<size_t>(LOBE_BINS) + 1; bin <= n / 2; ++bin) {
+    const double power = std::norm(spectrum[bin]);
+    const double k = std::max(1.0, std::round(bin / harmonic_bins));
+    total += power;
+    if(std::fabs(bin - k * harmonic_bins) > LOBE_BINS) {
+      inharmonic += power;
+    }
+  }
+  return total > 0.0 ? 10.0 * log10(std::max(inharmonic, total * 1e-15) / total) : 0.0;
+}
+
+uint32_t g_replay_cycle = 0;
+
+uint32_t replay_cycle() { return g_replay_cycle; }
+
+uint64_t elapsed_ns(std::chrono::steady_clock::time_point since) {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - since).count());
+}
+
+// keep_output hashes the output; keep_pcm also stores it.
+RunResult replay(const apu_variant &apu, const Input &input, uint32_t rate, const Options &options,
+                 bool keep_output, bool keep_pcm) {
+  if(apu.set_quality != nullptr) {
+    apu.set_quality(options.quality);
+  }
+  apu.set_sample_rate(rate);
+  apu.init();
+  if(apu.set_cycle_source != nullptr) {
+    apu.set_cycle_source(&replay_cycle);
+  }
+
+  const uint32_t buffer_samples = apu.samples_per_buffer();
+  std::vector<int16_t> buffer(buffer_samples);
+  const uint64_t frame_limit =
+      options.seconds > 0.0 ? static_cast<uint64_t>(options.seconds * VERTICAL_SYNC + 0.5) : UINT64_MAX;
+
+  RunResult result;
+  uint64_t hash = FNV_OFFSET;
+  uint64_t second_frames = 0;
+  uint64_t video_frames = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for(const ApuLogRecord &record : input.records) {
+    if(record.addr != APU_LOG_FRAME_END) {
+      g_replay_cycle = record.cycle;
+      apu.write(record.addr, record.value);
+      continue;
+    }
+    if(apu.frame_end != nullptr) {
+      apu.frame_end();
+    }
+    const auto render_start = std::chrono::steady_clock::now();
+    apu.callback(nullptr, reinterpret_cast<uint8_t *>(buffer.data()),
+                   static_cast<int>(buffer_samples * sizeof(int16_t)));
+    result.render_ns += elapsed_ns(render_start);
+    if(!keep_output) {
+      result.frames += buffer_samples / 2;
+    } else {
+      for(uint32_t i = 0; i < buffer_samples; i += 2) {
+        for(uint32_t ch = 0; ch < 2; ++ch) {
+          const uint16_t sample = static_cast<uint16_t>(buffer[i + ch]);
+          hash = (hash ^ (sample & 0xFF)) * FNV_PRIME;
+          hash = (hash ^ (sample >> 8)) * FNV_PRIME;
+        }
+        result.frames++;
+        if(++second_frames == rate) {
+          result.hashes.push_back(hash);
+          hash = FNV_OFFSET;
+          second_frames = 0;
+        }
+      }
+      if(keep_pcm) {
+        result.pcm.insert(result.pcm.end(), buffer.begin(), buffer.end());
+      }
+    }
+    if(++video_frames >= frame_limit) {
+      break;
+    }
+  }
+  // A trailing partial second is not hashed, so a run cut short by
+  // --seconds still lines up with a golden taken over the whole log.
+  result.total_ns = elapsed_ns(start);
+  return result;
+}
+
+std::string golden_path(const std::string &dir, const Input &input, uint32_t rate, const Options &options) {
+  return dir + "/" + input.name + "." + std::to_string(rate) + "." + quality_name(options.quality) + ".golden";
+}
+
+bool write_golden(const std::string &path, const RunResult &result) {
+  FILE *out = fopen(path.c_str(), "w");
+  if(out == nullptr) {
+    return false;
+  }
+  fprintf(out, "# apu_bench golden v1: second fnv1a64\n");
+  for(size_t i = 0; i < result.hashes.size(); ++i) {
+    fprintf(out, "%zu %016llx\n", i, static_cast<unsigned long long>(result.hashes[i]));
+  }
+  return fclose(out) == 0;
+}
+
+// Returns a short verdict; sets `ok` false on any difference.
+// With --seconds, only the rendered prefix of the golden is compared.
+std::string check_golden(const std::string &path, const RunResult &result, bool prefix_only, bool &ok) {
+  FILE *in = fopen(path.c_str(), "r");
+  if(in == nullptr) {
+    ok = false;
+    return "golden=missing";
+  }
+  std::vector<uint64_t> expected;
+  char line[128];
+  while(fgets(line, sizeof(line), in) != nullptr) {
+    unsigned long long second = 0;
+    unsigned long long hash = 0;
+    if(line[0] != '#' && sscanf(line, "%llu %llx", &second, &hash) == 2) {
+      expected.push_back(hash);
+    }
+  }
+  fclose(in);
+
+  size_t mismatched = 0;
+  size_t first = SIZE_MAX;
+  const size_t common = std::min(expected.size(), result.hashes.size());
+  for(size_t i = 0; i < common; ++i) {
+    if(expected[i] != result.hashes[i]) {
+      mismatched++;
+      first = std::min(first, i);
+    }
+  }
+  if(mismatched == 0 && (expected.size() == result.hashes.size() || (prefix_only && common == result.hashes.size()))) {
+    return "golden=ok";
+  }
+  ok = false;
+  char verdict[96];
+  if(mismatched == 0) {
+    snprintf(verdict, sizeof(verdict), "golden=LENGTH %zu s vs %zu s", result.hashes.size(), expected.size());
+  } else {
+    snprintf(verdict, sizeof(verdict), "golden=MISMATCH %zu/%zu s, first at %zu s", mismatched, common, first);
+  }
+  return verdict;
+}
+
+bool dump_pcm(const std::string &dir, const Input &input, uint32_t rate, const Options &options,
+              const RunResult &result) {
+  const std::string path =
+      dir + "/" + input.name + "." + std::to_string(rate) + "." + quality_name(options.quality) + ".raw";
+  FILE *out = fopen(path.c_str(), "wb");
+  if(out == nullptr) {
+    return false;
+  }
+  fwrite(result.pcm.data(), sizeof(int16_t), result.pcm.size(), out);
+  return fclose(out) == 0;
+}
+
+// Best render time of --runs replays, in ns per stereo frame.
+double render_ns_per_frame(const apu_variant &apu, const Input &input, uint32_t rate, const Options &options,
+                           const RunResult &first) {
+  uint64_t best = first.render_ns;
+  for(uint32_t run = 1; run < options.runs; ++run) {
+    best = std::min(best, replay(apu, input, rate, options, false, false).render_ns);
+  }
+  return first.frames > 0 ? static_cast<double>(best) / first.frames : 0.0;
+}
+
+// --compare: replays the input through the current APU and a variant build,
+// reports the largest sample difference and both render costs, and fails if
+// the difference exceeds the bound.
+bool compare_input(const Input &input, uint32_t rate, const Options &options) {
+  const apu_variant &other = *options.compare;
+  const CompareTarget *target = find_compare_target(other.name);
+  const int bound = options.max_error >= 0 ? options.max_error : target->max_error;
+  if(other.set_quality == nullptr && options.quality != AUDIO_QUALITY_DIRECT) {
+    printf("[APU] %s rate=%u quality=%s vs %s: skipped, %s only renders in fast\n",
+           input.name.c_str(),
+           rate,
+           quality_name(options.quality),
+           other.name,
+           other.name);
+    return true;
+  }
+
+  const apu_variant &base = target->baseline != nullptr ? *target->baseline : CURRENT_APU;
+  const RunResult ours = replay(base, input, rate, options, true, true);
+  const RunResult theirs = replay(other, input, rate, options, true, true);
+  int max_error = 0;
+  size_t differing = 0;
+  size_t max_at = 0;
+  const size_t common = std::min(ours.pcm.size(), theirs.pcm.size());
+  for(size_t i = 0; i < common; ++i) {
+    const int error = std::abs(static_cast<int>(ours.pcm[i]) - static_cast<int>(theirs.pcm[i]));
+    if(error != 0) {
+      differing++;
+    }
+    if(error > max_error) {
+      max_error = error;
+      max_at = i;
+    }
+  }
+  const bool ok = ours.pcm.size() == theirs.pcm.size() && (bound < 0 || max_error <= bound);
+
+  const double ours_ns = render_ns_per_frame(base, input, rate, options, ours);
+  const double theirs_ns = render_ns_per_frame(other, input, rate, options, theirs);
+  char bound_text[16] = "none";
+  if(bound >= 0) {
+    snprintf(bound_text, sizeof(bound_text), "%d", bound);
+  }
+  printf("[APU] %s rate=%u quality=%s %s vs %s: max_err=%d LSB (at %.3f s, bound %s) differing=%.2f%% "
+         "render=%.1f vs %.1f ns/frame (%+.0f%%) %s\n",
+         input.name.c_str(),
+         rate,
+         quality_name(options.quality),
+         base.name,
+         other.name,
+         max_error,
+         static_cast<double>(max_at / 2) / rate,
+         bound_text,
+         common > 0 ? 100.0 * differing / common : 0.0,
+         ours_ns,
+         theirs_ns,
+         theirs_ns > 0.0 ? 100.0 * (ours_ns - theirs_ns) / theirs_ns : 0.0,
+         ok ? "ok" : (ours.pcm.size() != theirs.pcm.size() ? "LENGTH MISMATCH" : "FAIL"));
+  return ok;
+}
+
+// --sweep: renders each SWEEP_TONES entry with the current APU, and with
+// --compare's variant if given, and prints the render cost per second of
+// audio and, for pitched tones below Nyquist, the inharmonic energy.
+void sweep(const Options &options) {
+  const double seconds = options.seconds > 0.0 ? options.seconds : SWEEP_SECONDS;
+  const uint32_t frames = static_cast<uint32_t>(seconds * VERTICAL_SYNC + 0.5);
+  std::vector<const apu_variant *> variants = {&CURRENT_APU};
+  if(options.compare != nullptr) {
+    variants.push_back(options.compare);
+  }
+
+  Options run = options;
+  for(uint32_t rate : options.rates) {
+    for(audio_quality quality : options.qualities) {
+      run.quality = quality;
+      for(const SweepTone &tone : SWEEP_TONES) {
+        Input input;
+        make_tone(tone, frames, input);
+        const double hz = sweep_tone_hz(tone);
+        char label[32];
+        if(tone.channel == SweepChannel::Noise) {
+          snprintf(label, sizeof(label), "NR43=%02x", tone.param);
+        } else {
+          snprintf(label, sizeof(label), "%.1f Hz", hz);
+        }
+
+        std::string line;
+        for(const apu_variant *apu : variants) {
+          // A variant without synthesis modes would render fast instead.
+          if(apu->set_quality == nullptr && quality != AUDIO_QUALITY_DIRECT) {
+            continue;
+          }
+          const RunResult result = replay(*apu, input, rate, run, true, true);
+          const double ns_per_frame = render_ns_per_frame(*apu, input, rate, run, result);
+          char part[96];
+          int used = snprintf(part, sizeof(part), "%s %s=%.1f us/s", line.empty() ? "" : " |", apu->name,
+                              ns_per_frame * rate / 1000.0);
+          if(hz > 0.0 && hz < rate / 2.0) {
+            snprintf(part + used, sizeof(part) - used, " inharmonic=%.1f dB", inharmonic_db(result.pcm, rate, hz));
+          }
+          line += part;
+        }
+        printf("[SWEEP] %s %s rate=%u quality=%s%s\n",
+               input.name.c_str(),
+               label,
+               rate,
+               quality_name(quality),
+               line.c_str());
+      }
+    }
+  }
+}
+
+// Replays one input through the current APU --runs times and prints its
+// best render cost, writing or checking goldens and dumping PCM as asked.
+bool bench_input(const Input &input, uint32_t rate, const Options &options) {
+  // The first run supplies the hashes; later runs only time the replay
+  // and must reproduce its output.
+  RunResult best = replay(CURRENT_APU, input, rate, options, true, !options.dump_pcm.empty());
+  bool ok = true;
+  std::string verdict;
+  for(uint32_t run = 1; run < options.runs; ++run) {
+    const RunResult timed = replay(CURRENT_APU, input, rate, options, false, false);
+    best.render_ns = std::min(best.render_ns, timed.render_ns);
+    best.total_ns = std::min(best.total_ns, timed.total_ns);
+  }
+  if(options.runs > 1) {
+    const RunResult again = replay(CURRENT_APU, input, rate, options, true, false);
+    if(again.hashes != best.hashes) {
+      ok = false;
+      verdict = "NONDETERMINISTIC ";
+    }
+  }
+  if(!options.write_golden.empty()) {
+    const std::string path = golden_path(options.write_golden, input, rate, options);
+    verdict += write_golden(path, best) ? "golden=written" : "golden=WRITE FAILED";
+  } else if(!options.check_golden.empty()) {
+    verdict += check_golden(golden_path(options.check_golden, input, rate, options), best, options.seconds > 0.0, ok);
+  }
+  if(!options.dump_pcm.empty() && !dump_pcm(options.dump_pcm, input, rate, options, best)) {
+    verdict += " pcm=WRITE FAILED";
+  }
+
+  const double rendered_s = static_cast<double>(best.frames) / rate;
+  printf("[APU] %s rate=%u quality=%s seconds=%.1f render=%.1f us/s total=%.1f us/s (%.0fx real time) %s\n",
+         input.name.c_str(),
+         rate,
+         quality_name(options.quality),
+         rendered_s,
+         rendered_s > 0.0 ? best.render_ns / 1000.0 / rendered_s : 0.0,
+         rendered_s > 0.0 ? best.total_ns / 1000.0 / rendered_s : 0.0,
+         best.total_ns > 0 ? rendered_s * 1e9 / best.total_ns : 0.0,
+         verdict.c_str());
+  return ok;
+}
+
+int usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [--rate HZ]... [--quality fast|native|high|all]... [--runs N] [--seconds N]\n"
+          "          [--write-golden DIR | --check-golden DIR | --compare VARIANT [--max-error LSB]]\n"
+          "          [--dump-pcm DIR] input...\n"
+          "       %s --sweep [--rate HZ]... [--quality fast|native|high|all]... [--runs N]\n"
+          "          [--seconds N] [--compare VARIANT]\n"
+          "       %s --stress-queue [--seconds N]\n"
+          "input is an APU log from `program --apu-log` or synthetic:SEED\n"
+          "VARIANT is one of:",
+          argv0,
+          argv0,
+          argv0);
+  for(const CompareTarget &target : COMPARE_TARGETS) {
+    fprintf(stderr, " %s", target.apu->name);
+  }
+  fprintf(stderr, "\n");
+  return 2;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  std::vector<std::string> inputs;
+  for(int i = 1; i < argc; ++i) {
+    const bool has_value = i + 1 < argc;
+    if(strcmp(argv[i], "--rate") == 0 && has_value) {
+      options.rates.push_back(static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10)));
+    } else if(strcmp(argv[i], "--quality") == 0 && has_value) {
+      const char *name = argv[++i];
+      if(strcmp(name, "fast") == 0) {
+        options.qualities.push_back(AUDIO_QUALITY_DIRECT);
+      } else if(strcmp(name, "native") == 0) {
+        options.qualities.push_back(AUDIO_QUALITY_NATIVE);
+      } else if(strcmp(name, "high") == 0) {
+        options.qualities.push_back(AUDIO_QUALITY_HIGH);
+      } else if(strcmp(name, "all") == 0) {
+        options.qualities.insert(options.qualities.end(),
+                                 {AUDIO_QUALITY_DIRECT, AUDIO_QUALITY_NATIVE, AUDIO_QUALITY_HIGH});
+      } else {
+        return usage(argv[0]);
+      }
+    } else if(strcmp(argv[i], "--runs") == 0 && has_value) {
+      options.runs = std::max(1ul, strtoul(argv[++i], nullptr, 10));
+    } else if(strcmp(argv[i], "--seconds") == 0 && has_value) {
+      options.seconds = strtod(argv[++i], nullptr);
+    } else if(strcmp(argv[i], "--write-golden") == 0 && has_value) {
+      options.write_golden = argv[++i];
+    } else if(strcmp(argv[i], "--check-golden") == 0 && has_value) {
+      options.check_golden = argv[++i];
+    } else if(strcmp(argv[i], "--compare") == 0 && has_value) {
+      const CompareTarget *target = find_compare_target(argv[++i]);
+      if(target == nullptr) {
+        return usage(argv[0]);
+      }
+      options.compare = target->apu;
+    } else if(strcmp(argv[i], "--sweep") == 0) {
+      options.sweep = true;
+    } else if(strcmp(argv[i], "--stress-queue") == 0) {
+      options.stress_queue = true;
+    } else if(strcmp(argv[i], "--max-error") == 0 && has_value) {
+      options.max_error = atoi(argv[++i]);
+    } else if(strcmp(argv[i], "--dump-pcm") == 0 && has_value) {
+      options.dump_pcm = argv[++i];
+    } else if(argv[i][0] == '-') {
+      return usage(argv[0]);
+    } else {
+      inputs.push_back(argv[i]);
+    }
+  }
+  const int golden_modes = !options.write_golden.empty() + !options.check_golden.empty() + (options.compare != nullptr);
+  if(options.stress_queue) {
+    return apu_queue_stress(options.seconds > 0.0 ? options.seconds : STRESS_SECONDS) ? 0 : 1;
+  }
+  if((inputs.empty() && !options.sweep) || golden_modes > 1) {
+    return usage(argv[0]);
+  }
+  if(options.rates.empty()) {
+    options.rates = {44100, 16384};
+  }
+  if(options.qualities.empty()) {
+    options.qualities = {AUDIO_QUALITY_DIRECT};
+  }
+  if(options.sweep) {
+    sweep(options);
+    return 0;
+  }
+
+  bool all_ok = true;
+  for(const std::string &name : inputs) {
+    Input input;
+    if(name.compare(0, 10, "synthetic:") == 0) {
+      const double seconds = options.seconds > 0.0 ? options.seconds : SYNTHETIC_SECONDS;
+      make_synthetic(static_cast<uint32_t>(strtoul(name.c_str() + 10, nullptr, 10)),
+                     static_cast<uint32_t>(seconds * VERTICAL_SYNC + 0.5), input);
+    } else if(!load_log(name, input)) {
+      all_ok = false;
+      continue;
+    }
+
+    for(uint32_t rate : options.rates) {
+      for(audio_quality quality : options.qualities) {
+        Options run = options;
+        run.quality = quality;
+        all_ok = (options.compare != nullptr ? compare_input(input, rate, run) : bench_input(input, rate, run)) && all_ok;
+      }
+    }
+  }
+  return all_ok ? 0 : 1;
+}
@@ -0,0 +1,250 @@
+/*
+ * Two-thread stress test of the APU register-write queue (`apu_bench
+ * --stress-queue`). minigb_apu.c is built here once more, so the test can
+ * reach the queue directly as well as through the public API.
+ *
+ * Queue phase: a producer thread pushes numbered events as fast as the ring
+ * takes them while a consumer thread pops them, checking that every event
+ * arrives once, in order and intact.
+ *
+ * NR52 phase: the emulator side triggers random channels, closes frames and
+ * power-cycles the APU, reading NR52 after every step, while a renderer
+ * thread runs audio_callback continuously. The notes have no length
+ * counter, so NR52 must show exactly the channels triggered since the last
+ * power-off, however far behind the renderer is. Before that, a trigger
+ * queued a frame ahead of the rendered one must read as on; after it, the
+ * renderer drains the queue and lets a short note run out, and NR52 must
+ * drop the channel, so consumed triggers do not stick.
+ */
+#define APU_VARIANT		stress
+#define APU_VARIANT_NAME	"stress"
+#define APU_VARIANT_SOURCE	"minigb_apu_cardputer/minigb_apu.c"
+
+#include "apu_variant_build.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <time.h>
+
+static volatile bool g_stress_stop = false;
+
+static uint64_t stress_now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* Event n carries cycle n and an address and value derived from it, so a
+ * torn or stale slot shows up as a mismatch. */
+static inline uint16_t stress_addr(const uint32_t n)
+{
+	return (uint16_t)(0xFF10 + (n * 7u) % 0x30u);
+}
+
+static inline uint8_t stress_val(const uint32_t n)
+{
+	return (uint8_t)(n ^ (n >> 8) ^ (n >> 16));
+}
+
+struct queue_stats {
+	uint64_t events;
+	uint64_t errors;
+	uint64_t full;
+};
+
+static void *queue_consumer(void *arg)
+{
+	struct queue_stats *stats = arg;
+	uint32_t expected = 0;
+
+	for(;;) {
+		const struct audio_event *ev = audio_event_peek();
+		if(ev == NULL) {
+			if(__atomic_load_n(&g_stress_stop, __ATOMIC_ACQUIRE) &&
+					audio_event_peek() == NULL)
+				break;
+			sched_yield();
+			continue;
+		}
+		if(ev->cycle != expected || ev->addr != stress_addr(expected) ||
+				ev->val != stress_val(expected))
+			stats->errors++;
+		audio_event_pop();
+		expected++;
+		stats->events++;
+	}
+	return NULL;
+}
+
+static bool queue_phase(const double seconds)
+{
+	struct queue_stats stats = {0, 0, 0};
+	pthread_t consumer;
+	uint64_t pushed = 0;
+
+	audio_init();
+	g_event_dropped = 0;
+	g_stress_stop = false;
+	pthread_create(&consumer, NULL, queue_consumer, &stats);
+
+	const uint64_t end = stress_now_ns() + (uint64_t)(seconds * 1e9);
+	for(uint32_t n = 0; (n & 0xFFFu) != 0 || stress_now_ns() < end; ++n) {
+		while(!audio_event_push(n, stress_addr(n), stress_val(n))) {
+			stats.full++;
+			sched_yield();
+		}
+		pushed++;
+	}
+	__atomic_store_n(&g_stress_stop, true, __ATOMIC_RELEASE);
+	pthread_join(consumer, NULL);
+	g_event_dropped = 0;
+
+	const bool ok = stats.errors == 0 && stats.events == pushed;
+	printf("[STRESS] queue: %llu events pushed, %llu popped, %llu out of order or torn, "
+	       "ring full %llu times %s\n",
+	       (unsigned long long)pushed,
+	       (unsigned long long)stats.events,
+	       (unsigned long long)stats.errors,
+	       (unsigned long long)stats.full,
+	       ok ? "ok" : "FAIL");
+	return ok;
+}
+
+static uint32_t g_stress_cycle = 0;
+
+static uint32_t stress_cycle(void)
+{
+	return g_stress_cycle;
+}
+
+static void *render_loop(void *arg)
+{
+	uint64_t *buffers = arg;
+	int16_t buffer[2048];
+	const int len = (int)(audio_samples_per_buffer() * sizeof(int16_t));
+
+	while(!__atomic_load_n(&g_stress_stop, __ATOMIC_ACQUIRE)) {
+		audio_callback(NULL, (uint8_t *)buffer, len);
+		(*buffers)++;
+	}
+	return NULL;
+}
+
+static const uint16_t g_trigger_reg[4] = { 0xFF14, 0xFF19, 0xFF1E, 0xFF23 };
+static const uint16_t g_dac_reg[4] = { 0xFF12, 0xFF17, 0xFF1A, 0xFF21 };
+
+/* Turns the channel's DAC on and triggers it without a length counter, so
+ * only a power-off ends the note. */
+static void stress_trigger(const uint_fast8_t ch, const uint32_t bits)
+{
+	audio_write(g_dac_reg[ch], 0xF0 | (bits & 0x08));
+	audio_write(g_trigger_reg[ch], 0x80 | ((bits >> 4) & 0x07));
+}
+
+static bool nr52_phase(const double seconds)
+{
+	int16_t buffer[2048];
+	uint64_t buffers = 0;
+	uint64_t reads = 0;
+	uint64_t missing = 0;
+	uint64_t extra = 0;
+	uint64_t power_offs = 0;
+	uint32_t state = 1;
+	uint8_t expected = 0;
+	pthread_t renderer;
+
+	audio_set_sample_rate(44100);
+	audio_init();
+	audio_set_cycle_source(&stress_cycle);
+	const int len = (int)(audio_samples_per_buffer() * sizeof(int16_t));
+
+	/* The emulator a frame ahead: the renderer publishes NR52 for the frame
+	 * it rendered while the trigger still waits in the next one. */
+	audio_write(0xFF26, 0x80);
+	audio_frame_end();
+	stress_trigger(1, 0);
+	audio_callback(NULL, (uint8_t *)buffer, len);
+	const bool ahead_ok = (audio_read(0xFF26) & 0x02) != 0;
+
+	audio_write(0xFF26, 0x00);
+	audio_write(0xFF26, 0x80);
+	g_stress_stop = false;
+	pthread_create(&renderer, NULL, render_loop, &buffers);
+
+	const uint64_t end = stress_now_ns() + (uint64_t)(seconds * 1e9);
+	for(uint32_t n = 0; (n & 0xFFu) != 0 || stress_now_ns() < end; ++n) {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		g_stress_cycle = state % (uint32_t)SCREEN_REFRESH_CYCLES;
+
+		if(state % 64 == 0) {
+			audio_write(0xFF26, 0x00);
+			audio_write(0xFF26, 0x80);
+			expected = 0;
+			power_offs++;
+		} else if(state % 8 == 0) {
+			audio_frame_end();
+		} else {
+			const uint_fast8_t ch = (state >> 8) & 3;
+			stress_trigger(ch, state >> 12);
+			expected |= (uint8_t)(1u << ch);
+		}
+
+		const uint8_t status = audio_read(0xFF26) & 0x0F;
+		reads++;
+		if(expected & ~status)
+			missing++;
+		if(status & ~expected)
+			extra++;
+
+		/* Keep the ring from filling, which would drop writes. */
+		while(g_event_head - event_load_acquire(&g_event_tail) >
+				AUDIO_EVENT_QUEUE_SIZE / 2)
+			sched_yield();
+	}
+	__atomic_store_n(&g_stress_stop, true, __ATOMIC_RELEASE);
+	pthread_join(renderer, NULL);
+
+	/* Drain the queue, then play a 1/256 s note on channel 1 to its end:
+	 * NR52 must drop it. */
+	audio_frame_end();
+	while(g_event_tail != g_event_head)
+		audio_callback(NULL, (uint8_t *)buffer, len);
+	audio_write(0xFF12, 0xF0);
+	audio_write(0xFF11, 0x3F);
+	audio_write(0xFF14, 0xC0);
+	const bool on_after_trigger = (audio_read(0xFF26) & 0x01) != 0;
+	for(int i = 0; i < 4; ++i) {
+		audio_frame_end();
+		audio_callback(NULL, (uint8_t *)buffer, len);
+	}
+	const bool off_after_note = (audio_read(0xFF26) & 0x01) == 0;
+	const bool note_ok = on_after_trigger && off_after_note;
+
+	uint32_t dropped = 0;
+	audio_event_stats(&dropped, NULL);
+	const bool ok = ahead_ok && missing == 0 && extra == 0 && dropped == 0 && note_ok;
+	printf("[STRESS] nr52: frame-ahead trigger %s; %llu reads, %llu missing a triggered channel, "
+	       "%llu showing a channel that should be off; %llu power-offs, %llu buffers rendered, "
+	       "%u writes dropped; short note %s %s\n",
+	       ahead_ok ? "on" : "OFF",
+	       (unsigned long long)reads,
+	       (unsigned long long)missing,
+	       (unsigned long long)extra,
+	       (unsigned long long)power_offs,
+	       (unsigned long long)buffers,
+	       (unsigned)dropped,
+	       note_ok ? "on then off" : "WRONG",
+	       ok ? "ok" : "FAIL");
+	return ok;
+}
+
+bool apu_queue_stress(const double seconds)
+{
+	const bool queue_ok = queue_phase(seconds / 2);
+	const bool nr52_ok = nr52_phase(seconds / 2);
+	return queue_ok && nr52_ok;
+}
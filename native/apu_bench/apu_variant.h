@@ -0,0 +1,51 @@
+// Entry points of one build of an APU source file. apu_bench links the
+// current minigb_apu.c as usual and builds further copies of it, or of an
+// earlier renderer kept under reference/, with their public symbols renamed
+// (see apu_variant_build.h), so one process can replay the same input
+// through several implementations and compare their output and cost.
+#pragma once
+
+#include "minigb_apu_cardputer/minigb_apu.h"
+
+#ifndef __cplusplus
+#include <stdbool.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct apu_variant {
+	const char *name;
+	/* NULL when the build predates synthesis modes (DIRECT only). */
+	void (*set_quality)(enum audio_quality quality);
+	void (*set_sample_rate)(uint32_t sample_rate);
+	void (*init)(void);
+	/* Both NULL when the build predates the write queue; its writes then
+	 * apply at the start of the next rendered buffer. */
+	void (*set_cycle_source)(audio_cycle_source_t source);
+	void (*frame_end)(void);
+	void (*write)(uint16_t addr, uint8_t val);
+	uint8_t (*read)(uint16_t addr);
+	void (*callback)(void *ptr, uint8_t *data, int len);
+	uint32_t (*samples_per_buffer)(void);
+};
+
+/* minigb_apu.c built with -DMINIGB_APU_FLOAT_EQ=1 and =2. */
+extern const struct apu_variant apu_variant_float_eq;
+extern const struct apu_variant apu_variant_double_eq;
+/* minigb_apu.c built with -DMINIGB_APU_BLIP_AVERAGE=0. */
+extern const struct apu_variant apu_variant_edges;
+/* reference/minigb_apu_pre042.c: point-sampled square and noise channels. */
+extern const struct apu_variant apu_variant_pre042;
+/* reference/minigb_apu_pre046.c: per-sample wave RAM unpacking and LFSR
+ * stepping. */
+extern const struct apu_variant apu_variant_pre046;
+
+/* apu_queue_stress.c: runs the two-thread queue and NR52 stress test for
+ * about "seconds" and returns whether it passed. */
+bool apu_queue_stress(double seconds);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,59 @@
+/*
+ * Builds one APU variant. A variant source defines APU_VARIANT (an
+ * identifier), APU_VARIANT_NAME (the name apu_bench prints),
+ * APU_VARIANT_SOURCE (the file to build, as an include path) and any
+ * configuration macros the source reads, then includes this header.
+ * The source's public functions are renamed to <APU_VARIANT>_audio_*, so
+ * they do not collide with the minigb_apu.c linked into apu_bench, and are
+ * exported as apu_variant_<APU_VARIANT>. Define APU_VARIANT_NO_QUALITY or
+ * APU_VARIANT_NO_QUEUE for sources that predate those entry points.
+ */
+#if !defined(APU_VARIANT) || !defined(APU_VARIANT_NAME) || !defined(APU_VARIANT_SOURCE)
+#error "define APU_VARIANT, APU_VARIANT_NAME and APU_VARIANT_SOURCE before including apu_variant_build.h"
+#endif
+
+#define APU_VARIANT_CAT2(a, b)	a##_##b
+#define APU_VARIANT_CAT(a, b)	APU_VARIANT_CAT2(a, b)
+#define APU_VARIANT_SYM(sym)	APU_VARIANT_CAT(APU_VARIANT, sym)
+
+#define audio_get_sample_rate		APU_VARIANT_SYM(audio_get_sample_rate)
+#define audio_set_sample_rate		APU_VARIANT_SYM(audio_set_sample_rate)
+#define audio_set_quality		APU_VARIANT_SYM(audio_set_quality)
+#define audio_get_quality		APU_VARIANT_SYM(audio_get_quality)
+#define audio_get_synth_rate		APU_VARIANT_SYM(audio_get_synth_rate)
+#define audio_samples_per_frame		APU_VARIANT_SYM(audio_samples_per_frame)
+#define audio_samples_per_buffer	APU_VARIANT_SYM(audio_samples_per_buffer)
+#define audio_callback			APU_VARIANT_SYM(audio_callback)
+#define audio_read			APU_VARIANT_SYM(audio_read)
+#define audio_write			APU_VARIANT_SYM(audio_write)
+#define audio_init			APU_VARIANT_SYM(audio_init)
+#define audio_set_cycle_source		APU_VARIANT_SYM(audio_set_cycle_source)
+#define audio_set_write_hook		APU_VARIANT_SYM(audio_set_write_hook)
+#define audio_frame_end			APU_VARIANT_SYM(audio_frame_end)
+#define audio_event_stats		APU_VARIANT_SYM(audio_event_stats)
+
+#include APU_VARIANT_SOURCE
+
+#include "apu_variant.h"
+
+const struct apu_variant APU_VARIANT_CAT(apu_variant, APU_VARIANT) = {
+	.name = APU_VARIANT_NAME,
+#ifdef APU_VARIANT_NO_QUALITY
+	.set_quality = NULL,
+#else
+	.set_quality = audio_set_quality,
+#endif
+	.set_sample_rate = audio_set_sample_rate,
+	.init = audio_init,
+#ifdef APU_VARIANT_NO_QUEUE
+	.set_cycle_source = NULL,
+	.frame_end = NULL,
+#else
+	.set_cycle_source = audio_set_cycle_source,
+	.frame_end = audio_frame_end,
+#endif
+	.write = audio_write,
+	.read = audio_read,
+	.callback = audio_callback,
+	.samples_per_buffer = audio_samples_per_buffer,
+};
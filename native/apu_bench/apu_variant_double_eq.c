@@ -0,0 +1,7 @@
+/* minigb_apu.c with the reference equaliser in double precision. */
+#define APU_VARIANT		double_eq
+#define APU_VARIANT_NAME	"double-eq"
+#define APU_VARIANT_SOURCE	"minigb_apu_cardputer/minigb_apu.c"
+#define MINIGB_APU_FLOAT_EQ	2
+
+#include "apu_variant_build.h"
@@ -0,0 +1,8 @@
+/* minigb_apu.c writing every square and noise edge through the blip kernel,
+ * however many fall in one output sample. */
+#define APU_VARIANT		edges
+#define APU_VARIANT_NAME	"edges"
+#define APU_VARIANT_SOURCE	"minigb_apu_cardputer/minigb_apu.c"
+#define MINIGB_APU_BLIP_AVERAGE	0
+
+#include "apu_variant_build.h"
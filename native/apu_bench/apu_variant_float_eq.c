@@ -0,0 +1,7 @@
+/* minigb_apu.c with the single-precision reference equaliser. */
+#define APU_VARIANT		float_eq
+#define APU_VARIANT_NAME	"float-eq"
+#define APU_VARIANT_SOURCE	"minigb_apu_cardputer/minigb_apu.c"
+#define MINIGB_APU_FLOAT_EQ	1
+
+#include "apu_variant_build.h"
@@ -0,0 +1,8 @@
+/* The point-sampled square and noise renderer that the blip buffer replaced. */
+#define APU_VARIANT		pre042
+#define APU_VARIANT_NAME	"pre042"
+#define APU_VARIANT_SOURCE	"reference/minigb_apu_pre042.c"
+#define APU_VARIANT_NO_QUALITY
+#define APU_VARIANT_NO_QUEUE
+
+#include "apu_variant_build.h"
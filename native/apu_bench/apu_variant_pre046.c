@@ -0,0 +1,7 @@
+/* The per-sample wave and noise renderer that the lookup tables replaced. */
+#define APU_VARIANT		pre046
+#define APU_VARIANT_NAME	"pre046"
+#define APU_VARIANT_SOURCE	"reference/minigb_apu_pre046.c"
+#define APU_VARIANT_NO_QUALITY
+
+#include "apu_variant_build.h"
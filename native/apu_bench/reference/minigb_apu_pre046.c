@@ -0,0 +1,1363 @@
+/*
+ * Reference copy of minigb_apu.c as of the register-write queue, before the
+ * wave and noise channels moved to precomputed tables: the wave channel
+ * unpacks a wave RAM nibble per sample and the noise channel steps its LFSR
+ * bit by bit. Besides the include paths, the only change from that version
+ * is the NR41 fix that came with the tables: NR41 used to go through the
+ * square channels' duty path and overwrite the low byte of the LFSR.
+ * Built by ../apu_variant_pre046.c for `apu_bench --compare pre046`, which
+ * requires identical output; do not change its output.
+ */
+
+/**
+ * minigb_apu is released under the terms listed within the LICENSE file.
+ *
+ * minigb_apu emulates the audio processing unit (APU) of the Game Boy. This
+ * project is based on MiniGBS by Alex Baines: https://github.com/baines/MiniGBS
+ */
+
+#include "glue.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "minigb_apu_cardputer/minigb_apu.h"
+
+#define DMG_CLOCK_FREQ_U	((unsigned)DMG_CLOCK_FREQ)
+
+#define AUDIO_MEM_SIZE		(0xFF3F - 0xFF10 + 1)
+#define AUDIO_ADDR_COMPENSATION	0xFF10
+
+#define MAX(a, b)		( a > b ? a : b )
+#define MIN(a, b)		( a <= b ? a : b )
+
+// Moderately increased from INT16_MAX/8 to INT16_MAX/6 (~1.33x volume boost)
+// Prevents clipping while improving audio quality
+#define VOL_INIT_MAX		(INT16_MAX/6)
+#define VOL_INIT_MIN		(INT16_MIN/6)
+
+#define MAX_CHAN_VOLUME		15
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static uint32_t g_audio_sample_rate = AUDIO_DEFAULT_SAMPLE_RATE;
+static uint32_t g_freq_inc_ref = AUDIO_DEFAULT_SAMPLE_RATE * 16u;
+static uint32_t g_freq_inc_scale = 16u;
+static uint32_t g_audio_samples = 0;
+static uint32_t g_audio_nsamples = 0;
+static bool g_audio_params_ready = false;
+
+/*
+ * The mixer and bass equaliser run in integer arithmetic by default: channel
+ * outputs are summed into 32-bit accumulators, filtered with Q2.30
+ * coefficients and a 64-bit multiply-accumulate, and saturated to Q15 on the
+ * final store. Build with -DMINIGB_APU_FLOAT_EQ=1 to use the original
+ * single-precision filter instead, e.g. to compare output against it.
+ */
+#ifndef MINIGB_APU_FLOAT_EQ
+#define MINIGB_APU_FLOAT_EQ 0
+#endif
+
+/* Coefficient format: 2 integer bits cover the low shelf's |a1| < 2. */
+#define EQ_COEF_SHIFT		30
+#define EQ_COEF_ONE		((int64_t)1 << EQ_COEF_SHIFT)
+#define EQ_COEF_MASK		(EQ_COEF_ONE - 1)
+/* Bound on the filter state so five Q2.30 products cannot overflow 64 bits. */
+#define EQ_STATE_LIMIT		((int32_t)1 << 24)
+
+/* Stereo frames mixed per pass; keeps the accumulator block small. */
+#define AUDIO_MIX_BLOCK_FRAMES	64
+
+#if MINIGB_APU_FLOAT_EQ
+typedef struct {
+	float b0;
+	float b1;
+	float b2;
+	float a1;
+	float a2;
+	float x1;
+	float x2;
+	float y1;
+	float y2;
+} biquad_filter_t;
+#else
+typedef struct {
+	int32_t b0;
+	int32_t b1;
+	int32_t b2;
+	int32_t a1;
+	int32_t a2;
+	int32_t x1;
+	int32_t x2;
+	int32_t y1;
+	int32_t y2;
+	/* Fractions dropped by the last two output shifts. */
+	int32_t e1;
+	int32_t e2;
+} biquad_filter_t;
+#endif
+
+static biquad_filter_t g_bass_filter_left = {0};
+static biquad_filter_t g_bass_filter_right = {0};
+static bool g_eq_enabled = true;
+static bool g_eq_configured = false;
+static const double g_eq_post_gain = 0.92;
+static int32_t g_mix_block[AUDIO_MIX_BLOCK_FRAMES * 2];
+
+static void biquad_reset(biquad_filter_t *f);
+static void audio_configure_equaliser(void);
+static void audio_ensure_params(void);
+static void audio_reset_filters(void);
+
+static void biquad_reset(biquad_filter_t *f)
+{
+	if(f == NULL) {
+		return;
+	}
+	f->x1 = f->x2 = 0;
+	f->y1 = f->y2 = 0;
+#if !MINIGB_APU_FLOAT_EQ
+	f->e1 = f->e2 = 0;
+#endif
+}
+
+static void audio_reset_filters(void)
+{
+	biquad_reset(&g_bass_filter_left);
+	biquad_reset(&g_bass_filter_right);
+	g_eq_configured = false;
+}
+
+#if !MINIGB_APU_FLOAT_EQ
+static int32_t biquad_coef_to_fixed(double coef)
+{
+	const double scaled = coef * (double)EQ_COEF_ONE;
+	if(scaled >= (double)INT32_MAX) {
+		return INT32_MAX;
+	}
+	if(scaled <= (double)INT32_MIN) {
+		return INT32_MIN;
+	}
+	return (int32_t)lrint(scaled);
+}
+#endif
+
+/*
+ * Configures a low shelf; post_gain is folded into the feed-forward
+ * coefficients so the per-sample path needs no extra multiply.
+ */
+static void biquad_configure_low_shelf(biquad_filter_t *f,
+									   double sample_rate,
+									   double cutoff_hz,
+									   double gain_db,
+									   double slope,
+									   double post_gain)
+{
+	if(f == NULL || sample_rate <= 0.0) {
+		return;
+	}
+
+	if(cutoff_hz < 20.0) {
+		cutoff_hz = 20.0;
+	}
+	if(cutoff_hz > sample_rate * 0.45) {
+		cutoff_hz = sample_rate * 0.45;
+	}
+
+	if(slope <= 0.0) {
+		slope = 0.707; // default moderate slope
+	}
+
+	const double A = pow(10.0, gain_db / 40.0);
+	const double w0 = 2.0 * M_PI * cutoff_hz / sample_rate;
+	const double cos_w0 = cos(w0);
+	const double sin_w0 = sin(w0);
+	const double alpha = sin_w0 / 2.0 * sqrt((A + 1.0 / A) * (1.0 / slope - 1.0) + 2.0);
+	const double beta = 2.0 * sqrt(A) * alpha;
+
+	double b0 =    A * ((A + 1.0) - (A - 1.0) * cos_w0 + beta);
+	double b1 =  2.0 * A * ((A - 1.0) - (A + 1.0) * cos_w0);
+	double b2 =    A * ((A + 1.0) - (A - 1.0) * cos_w0 - beta);
+	double a0 =        (A + 1.0) + (A - 1.0) * cos_w0 + beta;
+	double a1 =   -2.0 * ((A - 1.0) + (A + 1.0) * cos_w0);
+	double a2 =        (A + 1.0) + (A - 1.0) * cos_w0 - beta;
+
+	if(fabs(a0) < 1e-12) {
+		a0 = 1.0;
+	}
+
+	const double inv_a0 = 1.0 / a0;
+	const double gain = post_gain * inv_a0;
+#if MINIGB_APU_FLOAT_EQ
+	f->b0 = (float)(b0 * gain);
+	f->b1 = (float)(b1 * gain);
+	f->b2 = (float)(b2 * gain);
+	f->a1 = (float)(a1 * inv_a0);
+	f->a2 = (float)(a2 * inv_a0);
+#else
+	f->b0 = biquad_coef_to_fixed(b0 * gain);
+	f->b1 = biquad_coef_to_fixed(b1 * gain);
+	f->b2 = biquad_coef_to_fixed(b2 * gain);
+	f->a1 = biquad_coef_to_fixed(a1 * inv_a0);
+	f->a2 = biquad_coef_to_fixed(a2 * inv_a0);
+#endif
+
+	biquad_reset(f);
+}
+
+static inline int16_t clamp_to_i16(int32_t value)
+{
+	if(value > INT16_MAX) {
+		return INT16_MAX;
+	}
+	if(value < INT16_MIN) {
+		return INT16_MIN;
+	}
+	return (int16_t)value;
+}
+
+#if MINIGB_APU_FLOAT_EQ
+static inline int16_t biquad_process(biquad_filter_t *f, int32_t in)
+{
+	const float x = (float)in;
+	const float y = f->b0 * x + f->b1 * f->x1 + f->b2 * f->x2
+					- f->a1 * f->y1 - f->a2 * f->y2;
+	f->x2 = f->x1;
+	f->x1 = x;
+	f->y2 = f->y1;
+	f->y1 = y;
+	if(y > (float)INT16_MAX) {
+		return INT16_MAX;
+	}
+	if(y < (float)INT16_MIN) {
+		return INT16_MIN;
+	}
+	return (int16_t)lrintf(y);
+}
+#else
+/*
+ * Direct form I with second-order error feedback: the bits truncated from
+ * the accumulator are fed back as 2*e[n-1] - e[n-2], cancelling the
+ * quantisation noise that the shelf's near-unity poles would otherwise
+ * amplify at low frequencies. The state holds the unsaturated output;
+ * only the store saturates.
+ */
+static inline int16_t biquad_process(biquad_filter_t *f, int32_t x)
+{
+	int64_t acc = 2 * (int64_t)f->e1 - f->e2;
+	acc += (int64_t)f->b0 * x;
+	acc += (int64_t)f->b1 * f->x1;
+	acc += (int64_t)f->b2 * f->x2;
+	acc -= (int64_t)f->a1 * f->y1;
+	acc -= (int64_t)f->a2 * f->y2;
+
+	const int64_t y = acc >> EQ_COEF_SHIFT;
+	f->e2 = f->e1;
+	f->e1 = (int32_t)(acc & EQ_COEF_MASK);
+
+	int32_t y32;
+	if(y > EQ_STATE_LIMIT) {
+		y32 = EQ_STATE_LIMIT;
+	} else if(y < -EQ_STATE_LIMIT) {
+		y32 = -EQ_STATE_LIMIT;
+	} else {
+		y32 = (int32_t)y;
+	}
+
+	f->x2 = f->x1;
+	f->x1 = x;
+	f->y2 = f->y1;
+	f->y1 = y32;
+	return clamp_to_i16(y32);
+}
+#endif
+
+static void audio_configure_equaliser(void)
+{
+	if(!g_eq_enabled) {
+		audio_reset_filters();
+		return;
+	}
+
+	audio_ensure_params();
+	const double sample_rate = (double)g_audio_sample_rate;
+	if(sample_rate <= 0.0) {
+		audio_reset_filters();
+		return;
+	}
+
+	const double bass_cutoff_hz = 135.0; // tuned for Cardputer speaker
+	const double bass_gain_db = 7.0;     // gentle low shelf boost
+	const double slope = 0.75;          // smooth transition
+
+	biquad_configure_low_shelf(&g_bass_filter_left,
+				   sample_rate,
+				   bass_cutoff_hz,
+				   bass_gain_db,
+				   slope,
+				   g_eq_post_gain);
+	biquad_configure_low_shelf(&g_bass_filter_right,
+				   sample_rate,
+				   bass_cutoff_hz,
+				   bass_gain_db,
+				   slope,
+				   g_eq_post_gain);
+
+	g_eq_configured = true;
+}
+
+static void audio_recompute_timing(void)
+{
+	if(g_audio_sample_rate == 0)
+		g_audio_sample_rate = AUDIO_DEFAULT_SAMPLE_RATE;
+	else if(g_audio_sample_rate < 8000u)
+		g_audio_sample_rate = 8000u;
+
+	g_freq_inc_ref = g_audio_sample_rate * 16u;
+	g_freq_inc_scale = (g_freq_inc_ref + (g_audio_sample_rate / 2u)) / g_audio_sample_rate;
+	if(g_freq_inc_scale == 0)
+		g_freq_inc_scale = 1;
+
+	double samples_exact = (double)g_audio_sample_rate / VERTICAL_SYNC;
+	uint32_t frames = (uint32_t)(samples_exact + 0.5);
+	if(frames == 0)
+		frames = 1;
+	g_audio_samples = frames;
+	g_audio_nsamples = g_audio_samples * 2u;
+	g_audio_params_ready = true;
+	g_eq_configured = false;
+	if(g_eq_enabled)
+		audio_configure_equaliser();
+}
+
+static void audio_ensure_params(void)
+{
+	if(!g_audio_params_ready)
+	{
+		audio_recompute_timing();
+	}
+}
+
+uint32_t audio_get_sample_rate(void)
+{
+	audio_ensure_params();
+	return g_audio_sample_rate;
+}
+
+void audio_set_sample_rate(uint32_t sample_rate)
+{
+	g_audio_sample_rate = sample_rate;
+	audio_recompute_timing();
+}
+
+uint32_t audio_samples_per_frame(void)
+{
+	audio_ensure_params();
+	return g_audio_samples;
+}
+
+uint32_t audio_samples_per_buffer(void)
+{
+	audio_ensure_params();
+	return g_audio_nsamples;
+}
+
+/**
+ * Memory holding audio registers between 0xFF10 and 0xFF3F inclusive.
+ */
+static uint8_t audio_mem[AUDIO_MEM_SIZE];
+
+/*
+ * audio_write runs on the emulator thread while audio_callback renders on
+ * the audio task, so the two sides share no channel state. The emulator
+ * side keeps its own copy of the registers for audio_read and posts each
+ * write, stamped with the cycle offset inside the current video frame,
+ * to a single-producer/single-consumer ring. The renderer applies the
+ * writes at the matching sample offset of the buffer it is producing.
+ * audio_frame_end closes each emulated frame with a marker.
+ */
+#define AUDIO_EVENT_QUEUE_SIZE		1024u
+#define AUDIO_EVENT_QUEUE_MASK		(AUDIO_EVENT_QUEUE_SIZE - 1u)
+#define AUDIO_EVENT_FRAME_END		0x0000
+/* Whole frames the renderer may trail the emulator before it applies the
+ * oldest writes immediately instead of on their samples. */
+#define AUDIO_EVENT_MAX_LAG_FRAMES	3u
+
+struct audio_event {
+	uint32_t cycle;
+	uint16_t addr;
+	uint8_t val;
+};
+
+static struct audio_event g_event_queue[AUDIO_EVENT_QUEUE_SIZE];
+/* Written only by the producer (emulator thread). */
+static uint32_t g_event_head = 0;
+static uint32_t g_event_frames_pushed = 0;
+static uint32_t g_event_dropped = 0;
+/* Written only by the consumer (renderer). */
+static uint32_t g_event_tail = 0;
+static uint32_t g_event_frames_popped = 0;
+static uint32_t g_event_peak = 0;
+/* Set once part of the current emulated frame has been rendered; its
+ * remaining writes are then late and apply at the render cursor. */
+static bool g_event_frame_open = false;
+
+/* Emulator-side register file read back by audio_read. */
+static uint8_t g_reg_shadow[AUDIO_MEM_SIZE];
+/* NR52 channel status bits, published by the renderer. */
+static uint32_t g_chan_status = 0;
+static audio_cycle_source_t g_cycle_source = NULL;
+
+static inline uint32_t event_load_acquire(const uint32_t *p)
+{
+	return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static inline void event_store_release(uint32_t *p, const uint32_t v)
+{
+	__atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+static bool audio_event_push(const uint32_t cycle, const uint16_t addr,
+		const uint8_t val)
+{
+	const uint32_t head = g_event_head;
+
+	if(head - event_load_acquire(&g_event_tail) >= AUDIO_EVENT_QUEUE_SIZE) {
+		event_store_release(&g_event_dropped, g_event_dropped + 1);
+		return false;
+	}
+
+	struct audio_event *ev = &g_event_queue[head & AUDIO_EVENT_QUEUE_MASK];
+	ev->cycle = cycle;
+	ev->addr = addr;
+	ev->val = val;
+	event_store_release(&g_event_head, head + 1);
+	return true;
+}
+
+static inline const struct audio_event *audio_event_peek(void)
+{
+	const uint32_t tail = g_event_tail;
+
+	if(tail == event_load_acquire(&g_event_head))
+		return NULL;
+	return &g_event_queue[tail & AUDIO_EVENT_QUEUE_MASK];
+}
+
+static inline void audio_event_pop(void)
+{
+	event_store_release(&g_event_tail, g_event_tail + 1);
+}
+
+struct chan_len_ctr {
+	uint8_t load;
+	unsigned enabled : 1;
+	uint32_t counter;
+	uint32_t inc;
+};
+
+struct chan_vol_env {
+	uint8_t step;
+	unsigned up : 1;
+	uint32_t counter;
+	uint32_t inc;
+};
+
+struct chan_freq_sweep {
+	uint16_t freq;
+	uint8_t rate;
+	uint8_t shift;
+	unsigned up : 1;
+	uint32_t counter;
+	uint32_t inc;
+};
+
+static struct chan {
+	unsigned enabled : 1;
+	unsigned powered : 1;
+	unsigned on_left : 1;
+	unsigned on_right : 1;
+	unsigned muted : 1;
+
+	uint8_t volume;
+	uint8_t volume_init;
+
+	uint16_t freq;
+	uint32_t freq_counter;
+	uint32_t freq_inc;
+
+	int_fast16_t val;
+
+	/* Levels last written to the blip buffers (square and noise). */
+	int32_t blip_left;
+	int32_t blip_right;
+
+	struct chan_len_ctr    len;
+	struct chan_vol_env    env;
+	struct chan_freq_sweep sweep;
+
+	union {
+		struct {
+			uint8_t duty;
+			uint8_t duty_counter;
+		} square;
+		struct {
+			uint16_t lfsr_reg;
+			uint8_t  lfsr_wide;
+			uint8_t  lfsr_div;
+		} noise;
+		struct {
+			uint8_t sample;
+		} wave;
+	};
+} chans[4];
+
+static int32_t vol_l, vol_r;
+
+/*
+ * Square and noise channels are synthesised with a blip buffer: every
+ * change in a channel's output level is written as a delta, spread over
+ * BLIP_TAPS samples by a windowed-sinc impulse picked for the sub-sample
+ * position of the edge, and the buffer is integrated once per mix block.
+ * Work therefore scales with the number of edges, and tones near or above
+ * Nyquist no longer fold back as point-sampled aliases. The kernel delays
+ * these channels by BLIP_TAPS/2 - 1 samples relative to the wave channel.
+ */
+#define BLIP_TAPS		16
+#define BLIP_PHASE_BITS		6
+#define BLIP_PHASES		(1u << BLIP_PHASE_BITS)
+#define BLIP_KERNEL_BITS	12
+/* Pass band as a fraction of Nyquist; the short kernel rolls off above it. */
+#define BLIP_CUTOFF		0.85
+
+static int16_t g_blip_kernel[BLIP_PHASES][BLIP_TAPS];
+static bool g_blip_kernel_ready = false;
+static int32_t g_blip_left[AUDIO_MIX_BLOCK_FRAMES + BLIP_TAPS];
+static int32_t g_blip_right[AUDIO_MIX_BLOCK_FRAMES + BLIP_TAPS];
+static int32_t g_blip_sum_left = 0;
+static int32_t g_blip_sum_right = 0;
+
+static void blip_build_kernel(void)
+{
+	const double centre = (double)(BLIP_TAPS / 2 - 1);
+
+	for(uint_fast8_t p = 0; p < BLIP_PHASES; ++p) {
+		double taps[BLIP_TAPS];
+		double total = 0.0;
+
+		for(uint_fast8_t k = 0; k < BLIP_TAPS; ++k) {
+			const double x = (double)k - centre - (double)p / BLIP_PHASES;
+			const double arg = M_PI * BLIP_CUTOFF * x;
+			const double sinc = fabs(arg) < 1e-9 ? 1.0 : sin(arg) / arg;
+			/* Blackman window spanning the kernel, centred on the edge. */
+			const double w = (x + BLIP_TAPS / 2.0) / BLIP_TAPS;
+			const double window = 0.42 - 0.5 * cos(2.0 * M_PI * w) +
+				0.08 * cos(4.0 * M_PI * w);
+			taps[k] = sinc * (window > 0.0 ? window : 0.0);
+			total += taps[k];
+		}
+
+		/* Each row must sum exactly to unity so the integrator cannot drift. */
+		int32_t sum = 0;
+		uint_fast8_t peak = 0;
+		for(uint_fast8_t k = 0; k < BLIP_TAPS; ++k) {
+			g_blip_kernel[p][k] = (int16_t)lrint(taps[k] / total *
+				(double)(1 << BLIP_KERNEL_BITS));
+			sum += g_blip_kernel[p][k];
+			if(g_blip_kernel[p][k] > g_blip_kernel[p][peak])
+				peak = k;
+		}
+		g_blip_kernel[p][peak] += (int16_t)((1 << BLIP_KERNEL_BITS) - sum);
+	}
+
+	g_blip_kernel_ready = true;
+}
+
+static void blip_reset(void)
+{
+	if(!g_blip_kernel_ready)
+		blip_build_kernel();
+	memset(g_blip_left, 0, sizeof(g_blip_left));
+	memset(g_blip_right, 0, sizeof(g_blip_right));
+	g_blip_sum_left = g_blip_sum_right = 0;
+}
+
+/* Position of an edge within its output sample, in 1/BLIP_PHASES steps.
+ * "excess" is how far the frequency counter overshot when the edge fired;
+ * "recip" is BLIP_PHASES * 2^32 / freq_inc. */
+static inline uint_fast8_t blip_phase(const uint32_t freq_inc,
+		const uint32_t excess, const uint32_t recip)
+{
+	const uint32_t phase = (uint32_t)(((uint64_t)(freq_inc - excess) * recip) >> 32);
+	return phase < BLIP_PHASES ? (uint_fast8_t)phase : BLIP_PHASES - 1;
+}
+
+static inline uint32_t blip_recip(const uint32_t freq_inc)
+{
+	return (uint32_t)(((uint64_t)BLIP_PHASES << 32) / freq_inc);
+}
+
+static void blip_add_delta(const uint_fast16_t frame, const uint_fast8_t phase,
+		const int32_t delta_l, const int32_t delta_r)
+{
+	const int16_t *kernel = g_blip_kernel[phase];
+	int32_t *left = g_blip_left + frame;
+	int32_t *right = g_blip_right + frame;
+
+	for(uint_fast8_t k = 0; k < BLIP_TAPS; ++k) {
+		left[k] += delta_l * kernel[k];
+		right[k] += delta_r * kernel[k];
+	}
+}
+
+/* Integrates the first "frames" entries into the mix and carries the
+ * kernel tails over to the next block. */
+static void blip_read(int32_t *mix, const uint_fast16_t frames)
+{
+	int32_t sum_l = g_blip_sum_left;
+	int32_t sum_r = g_blip_sum_right;
+
+	for(uint_fast16_t f = 0; f < frames; ++f) {
+		sum_l += g_blip_left[f];
+		sum_r += g_blip_right[f];
+		mix[f * 2 + 0] += sum_l >> BLIP_KERNEL_BITS;
+		mix[f * 2 + 1] += sum_r >> BLIP_KERNEL_BITS;
+	}
+
+	g_blip_sum_left = sum_l;
+	g_blip_sum_right = sum_r;
+	memmove(g_blip_left, g_blip_left + frames, BLIP_TAPS * sizeof(int32_t));
+	memmove(g_blip_right, g_blip_right + frames, BLIP_TAPS * sizeof(int32_t));
+	memset(g_blip_left + BLIP_TAPS, 0, frames * sizeof(int32_t));
+	memset(g_blip_right + BLIP_TAPS, 0, frames * sizeof(int32_t));
+}
+
+static void set_note_freq(struct chan *c, const uint32_t freq)
+{
+	/* Lowest expected value of freq is 64. */
+	audio_ensure_params();
+	c->freq_inc = freq * g_freq_inc_scale;
+}
+
+static void chan_enable(const uint_fast8_t i, const bool enable)
+{
+	uint8_t val;
+
+	chans[i].enabled = enable;
+	val = (audio_mem[0xFF26 - AUDIO_ADDR_COMPENSATION] & 0x80) |
+		(chans[3].enabled << 3) | (chans[2].enabled << 2) |
+		(chans[1].enabled << 1) | (chans[0].enabled << 0);
+
+	audio_mem[0xFF26 - AUDIO_ADDR_COMPENSATION] = val;
+	//audio_mem[0xFF26 - AUDIO_ADDR_COMPENSATION] |= 0x80 | ((uint8_t)enable) << i;
+}
+
+static void update_env(struct chan *c)
+{
+	c->env.counter += c->env.inc;
+
+	while (c->env.counter > g_freq_inc_ref) {
+		if (c->env.step) {
+			c->volume += c->env.up ? 1 : -1;
+			if (c->volume == 0 || c->volume == MAX_CHAN_VOLUME) {
+				c->env.inc = 0;
+			}
+			c->volume = MAX(0, MIN(MAX_CHAN_VOLUME, c->volume));
+		}
+		c->env.counter -= g_freq_inc_ref;
+	}
+}
+
+static void update_len(struct chan *c)
+{
+	if (!c->len.enabled)
+		return;
+
+	c->len.counter += c->len.inc;
+	if (c->len.counter > g_freq_inc_ref) {
+		chan_enable(c - chans, 0);
+		c->len.counter = 0;
+	}
+}
+
+static bool update_freq(struct chan *c, uint32_t *pos)
+{
+	uint32_t inc = c->freq_inc - *pos;
+	c->freq_counter += inc;
+
+	if (c->freq_counter > g_freq_inc_ref) {
+		*pos		= c->freq_inc - (c->freq_counter - g_freq_inc_ref);
+		c->freq_counter = 0;
+		return true;
+	} else {
+		*pos = c->freq_inc;
+		return false;
+	}
+}
+
+static void update_sweep(struct chan *c)
+{
+	c->sweep.counter += c->sweep.inc;
+
+	while (c->sweep.counter > g_freq_inc_ref) {
+		if (c->sweep.shift) {
+			uint16_t inc = (c->sweep.freq >> c->sweep.shift);
+			if (!c->sweep.up)
+				inc *= -1;
+
+			c->freq += inc;
+			if (c->freq > 2047) {
+				c->enabled = 0;
+			} else {
+				set_note_freq(c,
+					DMG_CLOCK_FREQ_U / ((2048 - c->freq)<< 5));
+				c->freq_inc *= 8;
+			}
+		} else if (c->sweep.rate) {
+			c->enabled = 0;
+		}
+		c->sweep.counter -= g_freq_inc_ref;
+	}
+}
+
+/* Moves a channel's blip output to "level" (before panning) at the given
+ * frame and sub-sample phase. */
+static inline void chan_blip_level(struct chan *c, const uint_fast16_t frame,
+		const uint_fast8_t phase, const int32_t level)
+{
+	const int32_t left = level * c->on_left * vol_l;
+	const int32_t right = level * c->on_right * vol_r;
+
+	if (left == c->blip_left && right == c->blip_right)
+		return;
+
+	blip_add_delta(frame, phase, left - c->blip_left, right - c->blip_right);
+	c->blip_left = left;
+	c->blip_right = right;
+}
+
+static inline int32_t chan_blip_output(const struct chan *c)
+{
+	return c->muted ? 0 : (int32_t)c->val * c->volume / 4;
+}
+
+static void update_square(const uint_fast16_t frames, const bool ch2)
+{
+	uint32_t freq;
+	struct chan* c = chans + ch2;
+
+	if (!c->powered || !c->enabled) {
+		chan_blip_level(c, 0, 0, 0);
+		return;
+	}
+
+	freq = DMG_CLOCK_FREQ_U / ((2048 - c->freq) << 5);
+	set_note_freq(c, freq);
+	c->freq_inc *= 8;
+
+	uint32_t recip_inc = c->freq_inc;
+	uint32_t recip = blip_recip(recip_inc);
+
+	for (uint_fast16_t f = 0; f < frames; ++f) {
+		update_len(c);
+
+		if (!c->enabled) {
+			chan_blip_level(c, f, 0, 0);
+			return;
+		}
+
+		update_env(c);
+		if (!ch2) {
+			update_sweep(c);
+			if (!c->enabled) {
+				chan_blip_level(c, f, 0, 0);
+				return;
+			}
+			if (c->freq_inc != recip_inc) {
+				recip_inc = c->freq_inc;
+				recip = blip_recip(recip_inc);
+			}
+		}
+
+		/* Envelope and sweep steps land on the sample boundary. */
+		chan_blip_level(c, f, 0, chan_blip_output(c));
+
+		c->freq_counter += c->freq_inc;
+		while (c->freq_counter > g_freq_inc_ref) {
+			c->freq_counter -= g_freq_inc_ref;
+			c->square.duty_counter = (c->square.duty_counter + 1) & 7;
+			const int_fast16_t val =
+				(c->square.duty & (1 << c->square.duty_counter)) ?
+				VOL_INIT_MAX / MAX_CHAN_VOLUME :
+				VOL_INIT_MIN / MAX_CHAN_VOLUME;
+			if (val == c->val)
+				continue;
+			c->val = val;
+			chan_blip_level(c, f,
+				blip_phase(c->freq_inc, c->freq_counter, recip),
+				chan_blip_output(c));
+		}
+	}
+}
+
+static uint8_t wave_sample(const unsigned int pos, const unsigned int volume)
+{
+	uint8_t sample;
+
+	sample =  audio_mem[(0xFF30 + pos / 2) - AUDIO_ADDR_COMPENSATION];
+	if (pos & 1) {
+		sample &= 0xF;
+	} else {
+		sample >>= 4;
+	}
+	return volume ? (sample >> (volume - 1)) : 0;
+}
+
+static void update_wave(int32_t *samples, const uint_fast16_t limit)
+{
+	uint32_t freq;
+	struct chan *c = chans + 2;
+
+	if (!c->powered || !c->enabled)
+		return;
+
+	freq = (DMG_CLOCK_FREQ_U / 64) / (2048 - c->freq);
+	set_note_freq(c, freq);
+
+	c->freq_inc *= 32;
+
+	for (uint_fast16_t i = 0; i < limit; i += 2) {
+		update_len(c);
+
+		if (!c->enabled)
+			continue;
+
+		uint32_t pos      = 0;
+		uint32_t prev_pos = 0;
+		int32_t sample   = 0;
+
+		c->wave.sample = wave_sample(c->val, c->volume);
+
+		while (update_freq(c, &pos)) {
+			c->val = (c->val + 1) & 31;
+			sample += ((pos - prev_pos) / c->freq_inc) *
+				((int)c->wave.sample - 8) * (INT16_MAX/64);
+			c->wave.sample = wave_sample(c->val, c->volume);
+			prev_pos  = pos;
+		}
+
+		sample += ((int)c->wave.sample - 8) * (int)(INT16_MAX/64);
+
+		if (c->volume == 0)
+			continue;
+
+		{
+			/* First element is unused. */
+			int16_t div[] = { INT16_MAX, 1, 2, 4 };
+			sample = sample / (div[c->volume]);
+		}
+
+		if (c->muted)
+			continue;
+
+		sample /= 4;
+
+		samples[i + 0] += sample * c->on_left * vol_l;
+		samples[i + 1] += sample * c->on_right * vol_r;
+	}
+}
+
+static void update_noise(const uint_fast16_t frames)
+{
+	struct chan *c = chans + 3;
+
+	if (!c->powered) {
+		chan_blip_level(c, 0, 0, 0);
+		return;
+	}
+
+	{
+		const uint32_t lfsr_div_lut[] = {
+			8, 16, 32, 48, 64, 80, 96, 112
+		};
+		uint32_t freq;
+
+		freq = DMG_CLOCK_FREQ_U / (lfsr_div_lut[c->noise.lfsr_div] << c->freq);
+		set_note_freq(c, freq);
+	}
+
+	if (c->freq >= 14)
+		c->enabled = 0;
+
+	const uint32_t recip = blip_recip(c->freq_inc);
+	const uint_fast8_t tap = c->noise.lfsr_wide ? 13 : 5;
+
+	for (uint_fast16_t f = 0; f < frames; ++f) {
+		update_len(c);
+
+		if (!c->enabled) {
+			chan_blip_level(c, f, 0, 0);
+			return;
+		}
+
+		update_env(c);
+		chan_blip_level(c, f, 0, chan_blip_output(c));
+
+		c->freq_counter += c->freq_inc;
+		while (c->freq_counter > g_freq_inc_ref) {
+			c->freq_counter -= g_freq_inc_ref;
+			c->noise.lfsr_reg = (c->noise.lfsr_reg << 1) |
+				(c->val >= VOL_INIT_MAX/MAX_CHAN_VOLUME);
+
+			const int_fast16_t val =
+				!(((c->noise.lfsr_reg >> (tap + 1)) & 1) ^
+				  ((c->noise.lfsr_reg >> tap) & 1)) ?
+				VOL_INIT_MAX / MAX_CHAN_VOLUME :
+				VOL_INIT_MIN / MAX_CHAN_VOLUME;
+			if (val == c->val)
+				continue;
+			c->val = val;
+			chan_blip_level(c, f,
+				blip_phase(c->freq_inc, c->freq_counter, recip),
+				chan_blip_output(c));
+		}
+	}
+}
+
+static void audio_apply_write(const uint16_t addr, const uint8_t val);
+static void audio_events_apply_now(const bool one_frame);
+
+/* Renders "frames" stereo frames into out in blocks of at most
+ * AUDIO_MIX_BLOCK_FRAMES. */
+static void audio_render(int16_t *out, uint_fast16_t frames)
+{
+	while(frames > 0) {
+		const uint_fast16_t block = frames < AUDIO_MIX_BLOCK_FRAMES ?
+			frames : AUDIO_MIX_BLOCK_FRAMES;
+		int32_t *mix = g_mix_block;
+		memset(mix, 0, block * 2 * sizeof(mix[0]));
+
+		update_square(block, 0);
+		update_square(block, 1);
+		update_noise(block);
+		blip_read(mix, block);
+		update_wave(mix, block * 2);
+
+		if(g_eq_configured) {
+			for(uint_fast16_t i = 0; i < block * 2; i += 2) {
+				out[i + 0] = biquad_process(&g_bass_filter_left, mix[i + 0]);
+				out[i + 1] = biquad_process(&g_bass_filter_right, mix[i + 1]);
+			}
+		} else {
+			for(uint_fast16_t i = 0; i < block * 2; i += 2) {
+				out[i + 0] = clamp_to_i16(mix[i + 0]);
+				out[i + 1] = clamp_to_i16(mix[i + 1]);
+			}
+		}
+
+		out += block * 2;
+		frames -= block;
+	}
+}
+
+/**
+ * SDL2 style audio callback function.
+ */
+void audio_callback(void *userdata, uint8_t *stream, int len)
+{
+	int16_t *samples = (int16_t *)stream;
+	const uint_fast16_t total_samples = (uint_fast16_t)(len / (int)sizeof(int16_t));
+
+	/* Appease unused variable warning. */
+	(void)userdata;
+	audio_ensure_params();
+	uint_fast16_t limit = g_audio_nsamples;
+
+	if(!g_blip_kernel_ready)
+		blip_reset();
+
+	if(total_samples < limit)
+		limit = total_samples & ~(uint_fast16_t)1;
+
+	if(g_eq_enabled) {
+		if(!g_eq_configured)
+			audio_configure_equaliser();
+	} else if(g_eq_configured) {
+		audio_reset_filters();
+	}
+
+	{
+		const uint32_t depth = event_load_acquire(&g_event_head) - g_event_tail;
+		if(depth > event_load_acquire(&g_event_peak))
+			event_store_release(&g_event_peak, depth);
+	}
+
+	/* Emulation ran ahead: fold the oldest frames' writes in at once. */
+	while(event_load_acquire(&g_event_frames_pushed) - g_event_frames_popped >
+			AUDIO_EVENT_MAX_LAG_FRAMES)
+		audio_events_apply_now(true);
+
+	const uint_fast16_t frames = limit / 2;
+	uint_fast16_t cursor = 0;
+	bool frame_closed = false;
+	const struct audio_event *ev;
+
+	while((ev = audio_event_peek()) != NULL) {
+		if(ev->addr == AUDIO_EVENT_FRAME_END) {
+			audio_event_pop();
+			g_event_frames_popped++;
+			frame_closed = true;
+			break;
+		}
+
+		uint_fast16_t at = cursor;
+		if(!g_event_frame_open) {
+			at = (uint_fast16_t)(((uint64_t)ev->cycle * frames) /
+				(uint32_t)SCREEN_REFRESH_CYCLES);
+			if(at < cursor)
+				at = cursor;
+			else if(at > frames)
+				at = frames;
+		}
+
+		audio_render(samples + cursor * 2, at - cursor);
+		cursor = at;
+		audio_apply_write(ev->addr, ev->val);
+		audio_event_pop();
+	}
+
+	audio_render(samples + cursor * 2, frames - cursor);
+	g_event_frame_open = !frame_closed;
+	event_store_release(&g_chan_status,
+		audio_mem[0xFF26 - AUDIO_ADDR_COMPENSATION] & 0x0F);
+
+	if((uint_fast16_t)total_samples > limit)
+		memset(samples + limit, 0, (total_samples - limit) * sizeof(int16_t));
+}
+
+static void chan_trigger(uint_fast8_t i)
+{
+	struct chan *c = chans + i;
+	audio_ensure_params();
+
+	chan_enable(i, 1);
+	c->volume = c->volume_init;
+
+	// volume envelope
+	{
+		uint8_t val =
+			audio_mem[(0xFF12 + (i * 5)) - AUDIO_ADDR_COMPENSATION];
+
+		c->env.step = val & 0x07;
+		c->env.up   = val & 0x08 ? 1 : 0;
+		uint64_t base = (uint64_t)g_freq_inc_ref;
+		c->env.inc  = c->env.step ?
+			(uint32_t)((base * 64u) / ((uint64_t)c->env.step * g_audio_sample_rate)) :
+			(uint32_t)((base * 8u) / g_audio_sample_rate);
+		c->env.counter = 0;
+	}
+
+	// freq sweep
+	if (i == 0) {
+		uint8_t val = audio_mem[0xFF10 - AUDIO_ADDR_COMPENSATION];
+
+		c->sweep.freq  = c->freq;
+		c->sweep.rate  = (val >> 4) & 0x07;
+		c->sweep.up    = !(val & 0x08);
+		c->sweep.shift = (val & 0x07);
+		c->sweep.inc   = c->sweep.rate ?
+			(uint32_t)(((uint64_t)128 * g_freq_inc_ref) /
+				((uint64_t)c->sweep.rate * g_audio_sample_rate)) : 0;
+		c->sweep.counter = g_freq_inc_ref;
+	}
+
+	int len_max = 64;
+
+	if (i == 2) { // wave
+		len_max = 256;
+		c->val = 0;
+	} else if (i == 3) { // noise
+		c->noise.lfsr_reg = 0xFFFF;
+		c->val = VOL_INIT_MIN / MAX_CHAN_VOLUME;
+	}
+
+	c->len.inc = (uint32_t)(((uint64_t)256 * g_freq_inc_ref) /
+		((uint64_t)g_audio_sample_rate * (len_max - c->len.load)));
+	c->len.counter = 0;
+}
+
+/**
+ * Read audio register.
+ * \param addr	Address of audio register. Must be 0xFF10 <= addr <= 0xFF3F.
+ *				This is not checked in this function.
+ * \return	Byte at address.
+ */
+uint8_t audio_read(const uint16_t addr)
+{
+	static const uint8_t ortab[] = {
+		0x80, 0x3f, 0x00, 0xff, 0xbf,
+		0xff, 0x3f, 0x00, 0xff, 0xbf,
+		0x7f, 0xff, 0x9f, 0xff, 0xbf,
+		0xff, 0xff, 0x00, 0x00, 0xbf,
+		0x00, 0x00, 0x70,
+		0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+	};
+
+	uint8_t val = g_reg_shadow[addr - AUDIO_ADDR_COMPENSATION];
+
+	if(addr == 0xFF26)
+		val = (val & 0x80) | (uint8_t)(event_load_acquire(&g_chan_status) & 0x0F);
+
+	return val | ortab[addr - AUDIO_ADDR_COMPENSATION];
+}
+
+/**
+ * Apply a queued register write to the renderer's state.
+ */
+static void audio_apply_write(const uint16_t addr, const uint8_t val)
+{
+	audio_ensure_params();
+	/* Find sound channel corresponding to register address. */
+	uint_fast8_t i;
+
+	if(addr == 0xFF26)
+	{
+		audio_mem[addr - AUDIO_ADDR_COMPENSATION] = val & 0x80;
+		/* On APU power off, clear all registers apart from wave
+		 * RAM. */
+		if((val & 0x80) == 0)
+		{
+			memset(audio_mem, 0x00, 0xFF26 - AUDIO_ADDR_COMPENSATION);
+			chans[0].enabled = false;
+			chans[1].enabled = false;
+			chans[2].enabled = false;
+			chans[3].enabled = false;
+		}
+
+		return;
+	}
+
+	/* Ignore register writes if APU powered off. */
+	if(audio_mem[0xFF26 - AUDIO_ADDR_COMPENSATION] == 0x00)
+		return;
+
+	audio_mem[addr - AUDIO_ADDR_COMPENSATION] = val;
+	i = (addr - AUDIO_ADDR_COMPENSATION) / 5;
+
+	switch (addr) {
+	case 0xFF12:
+	case 0xFF17:
+	case 0xFF21: {
+		chans[i].volume_init = val >> 4;
+		chans[i].powered     = (val >> 3) != 0;
+
+		// "zombie mode" stuff, needed for Prehistorik Man and probably
+		// others
+		if (chans[i].powered && chans[i].enabled) {
+			if ((chans[i].env.step == 0 && chans[i].env.inc != 0)) {
+				if (val & 0x08) {
+					chans[i].volume++;
+				} else {
+					chans[i].volume += 2;
+				}
+			} else {
+				chans[i].volume = 16 - chans[i].volume;
+			}
+
+			chans[i].volume &= 0x0F;
+			chans[i].env.step = val & 0x07;
+		}
+	} break;
+
+	case 0xFF1C:
+		chans[i].volume = chans[i].volume_init = (val >> 5) & 0x03;
+		break;
+
+	case 0xFF11:
+	case 0xFF16: {
+		const uint8_t duty_lookup[] = { 0x10, 0x30, 0x3C, 0xCF };
+		chans[i].len.load = val & 0x3f;
+		chans[i].square.duty = duty_lookup[val >> 6];
+		break;
+	}
+
+	case 0xFF20:
+		/* NR41 has no duty bits; the noise LFSR shares that storage. */
+		chans[i].len.load = val & 0x3f;
+		break;
+
+	case 0xFF1B:
+		chans[i].len.load = val;
+		break;
+
+	case 0xFF13:
+	case 0xFF18:
+	case 0xFF1D:
+		chans[i].freq &= 0xFF00;
+		chans[i].freq |= val;
+		break;
+
+	case 0xFF1A:
+		chans[i].powered = (val & 0x80) != 0;
+		chan_enable(i, val & 0x80);
+		break;
+
+	case 0xFF14:
+	case 0xFF19:
+	case 0xFF1E:
+		chans[i].freq &= 0x00FF;
+		chans[i].freq |= ((val & 0x07) << 8);
+		/* Intentional fall-through. */
+	case 0xFF23:
+		chans[i].len.enabled = val & 0x40 ? 1 : 0;
+		if (val & 0x80)
+			chan_trigger(i);
+
+		break;
+
+	case 0xFF22:
+		chans[3].freq = val >> 4;
+		chans[3].noise.lfsr_wide = !(val & 0x08);
+		chans[3].noise.lfsr_div = val & 0x07;
+		break;
+
+	case 0xFF24:
+	{
+		vol_l = ((val >> 4) & 0x07);
+		vol_r = (val & 0x07);
+		break;
+	}
+
+	case 0xFF25:
+		for (uint_fast8_t j = 0; j < 4; j++) {
+			chans[j].on_left  = (val >> (4 + j)) & 1;
+			chans[j].on_right = (val >> j) & 1;
+		}
+		break;
+	}
+}
+
+/**
+ * Write audio register.
+ * \param addr	Address of audio register. Must be 0xFF10 <= addr <= 0xFF3F.
+ *				This is not checked in this function.
+ * \param val	Byte to write at address.
+ */
+void audio_write(const uint16_t addr, const uint8_t val)
+{
+	uint8_t *reg = g_reg_shadow;
+
+	if(addr == 0xFF26) {
+		reg[addr - AUDIO_ADDR_COMPENSATION] = val & 0x80;
+		if((val & 0x80) == 0) {
+			memset(reg, 0x00, 0xFF26 - AUDIO_ADDR_COMPENSATION);
+			event_store_release(&g_chan_status, 0);
+		}
+	} else {
+		/* Ignore register writes if APU powered off. */
+		if(reg[0xFF26 - AUDIO_ADDR_COMPENSATION] == 0x00)
+			return;
+
+		reg[addr - AUDIO_ADDR_COMPENSATION] = val;
+
+		/* Report a triggered channel as on before the renderer gets to it. */
+		if((val & 0x80) && (addr == 0xFF14 || addr == 0xFF19 ||
+				addr == 0xFF1E || addr == 0xFF23)) {
+			__atomic_fetch_or(&g_chan_status,
+				1u << ((addr - AUDIO_ADDR_COMPENSATION) / 5),
+				__ATOMIC_RELEASE);
+		}
+	}
+
+	const uint32_t cycle = g_cycle_source != NULL ? g_cycle_source() : 0;
+	audio_event_push(cycle, addr, val);
+}
+
+void audio_frame_end(void)
+{
+	if(audio_event_push(0, AUDIO_EVENT_FRAME_END, 0))
+		event_store_release(&g_event_frames_pushed, g_event_frames_pushed + 1);
+}
+
+void audio_set_cycle_source(audio_cycle_source_t source)
+{
+	g_cycle_source = source;
+}
+
+void audio_event_stats(uint32_t *dropped, uint32_t *peak_depth)
+{
+	if(dropped != NULL)
+		*dropped = event_load_acquire(&g_event_dropped);
+	if(peak_depth != NULL)
+		*peak_depth = __atomic_exchange_n(&g_event_peak, 0, __ATOMIC_ACQ_REL);
+}
+
+/* Applies queued writes without rendering, up to the end of the oldest
+ * queued frame ("one_frame") or until the queue is empty. */
+static void audio_events_apply_now(const bool one_frame)
+{
+	const struct audio_event *ev;
+
+	while((ev = audio_event_peek()) != NULL) {
+		const uint16_t addr = ev->addr;
+		const uint8_t val = ev->val;
+		audio_event_pop();
+
+		if(addr == AUDIO_EVENT_FRAME_END) {
+			g_event_frames_popped++;
+			g_event_frame_open = false;
+			if(one_frame)
+				return;
+			continue;
+		}
+		audio_apply_write(addr, val);
+	}
+}
+
+void audio_init(void)
+{
+	audio_ensure_params();
+	/* Initialise channels and samples. */
+	memset(chans, 0, sizeof(chans));
+	chans[0].val = chans[1].val = -1;
+	blip_reset();
+
+	/* Runs before the renderer starts, so it may reset both queue ends. */
+	g_event_head = g_event_tail = 0;
+	g_event_frames_pushed = g_event_frames_popped = 0;
+	g_event_frame_open = false;
+	memcpy(g_reg_shadow, audio_mem, sizeof(g_reg_shadow));
+	g_chan_status = audio_mem[0xFF26 - AUDIO_ADDR_COMPENSATION] & 0x0F;
+
+	/* Initialise IO registers. */
+	{
+		const uint8_t regs_init[] = { 0x80, 0xBF, 0xF3, 0xFF, 0x3F,
+					      0xFF, 0x3F, 0x00, 0xFF, 0x3F,
+					      0x7F, 0xFF, 0x9F, 0xFF, 0x3F,
+					      0xFF, 0xFF, 0x00, 0x00, 0x3F,
+					      0x77, 0xF3, 0xF1 };
+
+		for(uint_fast8_t i = 0; i < sizeof(regs_init); ++i)
+			audio_write(0xFF10 + i, regs_init[i]);
+	}
+
+	/* Initialise Wave Pattern RAM. */
+	{
+		const uint8_t wave_init[] = { 0xac, 0xdd, 0xda, 0x48,
+					      0x36, 0x02, 0xcf, 0x16,
+					      0x2c, 0x04, 0xe5, 0x2c,
+					      0xac, 0xdd, 0xda, 0x48 };
+
+		for(uint_fast8_t i = 0; i < sizeof(wave_init); ++i)
+			audio_write(0xFF30 + i, wave_init[i]);
+	}
+
+	audio_events_apply_now(false);
+}
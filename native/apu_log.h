@@ -0,0 +1,27 @@
+// Register-write log format shared by the native benchmark driver, which
+// records it (`program --apu-log FILE`), and native/apu_bench, which replays
+// it. Little-endian: one ApuLogHeader, then one ApuLogRecord per
+// audio_write or audio_frame_end call, in call order.
+#pragma once
+
+#include <cstdint>
+
+static constexpr uint32_t APU_LOG_MAGIC = 0x4C414247;  // "GBAL"
+static constexpr uint16_t APU_LOG_VERSION = 1;
+// Record address marking audio_frame_end().
+static constexpr uint16_t APU_LOG_FRAME_END = 0x0000;
+
+struct ApuLogHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t reserved;
+} __attribute__((packed));
+
+struct ApuLogRecord {
+  uint32_t cycle;  // offset within the video frame, 0 to SCREEN_REFRESH_CYCLES
+  uint16_t addr;
+  uint8_t value;
+  uint8_t reserved;
+} __attribute__((packed));
+
+static_assert(sizeof(ApuLogRecord) == 8, "APU log record layout changed");
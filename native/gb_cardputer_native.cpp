@@ -0,0 +1,18 @@
+// Host build of the firmware sketch for the PlatformIO `native` environment.
+// The prototypes below are the ones Arduino's sketch preprocessor generates
+// for the .ino; Peanut-GB comes first because they use its types. The tests
+// for `program --test` follow the sketch so they can reach its statics.
+
+#include <Arduino.h>
+
+#include "../peanutgb/peanut_gb.h"
+
+uint8_t gb_rom_read(struct gb_s *gb, const uint_fast32_t addr);
+uint8_t gb_cart_ram_read(struct gb_s *gb, const uint_fast32_t addr);
+void gb_cart_ram_write(struct gb_s *gb, const uint_fast32_t addr, const uint8_t val);
+void gb_error(struct gb_s *gb, const enum gb_error_e gb_err, const uint16_t val);
+void set_font_size(int size);
+static void profiler_track_rom_load(uint64_t duration_us, bool posix_attempted, bool posix_success, bool posix_disabled);
+
+#include "../gb_cardputer.ino"
+#include "sketch_tests.h"
@@ -0,0 +1,34 @@
+// Hooks between gb_cardputer.ino and the host benchmark driver
+// (native/native_main.cpp). Only compiled with ENABLE_NATIVE_BENCH.
+#pragma once
+
+#include <cstdint>
+
+// SD-relative path of the ROM named on the command line, e.g. "/roms/x.gb".
+const char *native_bench_rom_path();
+
+// Called once per main-loop iteration with its stage timings. Returns true
+// once the requested number of completed frames has been reached.
+bool native_bench_frame(bool completed, uint64_t poll_us, uint64_t emu_us, uint64_t dispatch_us, uint64_t frame_us);
+
+// Prints the summary, writes the optional frame dump and exits the process.
+[[noreturn]] void native_bench_finish();
+
+// Tests of firmware internals, run with `program --test NAME`. They live in
+// native/sketch_tests.h, which is compiled into the sketch's translation unit
+// so they can reach its static state.
+enum NativeTestResult { NATIVE_TEST_RUNNING, NATIVE_TEST_PASSED, NATIVE_TEST_FAILED };
+
+struct NativeTest {
+  const char *name;
+  // Runs the whole test before setup(); nullptr for tests that need the
+  // emulator running a ROM.
+  NativeTestResult (*run)();
+  // Called from the main loop after every completed frame until it returns
+  // a verdict.
+  NativeTestResult (*frame)(uint32_t frame);
+};
+
+// The tests compiled into this build, ending with an entry whose name is
+// nullptr.
+extern const NativeTest NATIVE_TESTS[];
@@ -0,0 +1,286 @@
+// Headless benchmark driver for the PlatformIO `native` environment.
+//
+//   program [--frames N] [--sd DIR] [--dump-frame out.ppm] [--apu-log out.apulog] rom.gb
+//   program --test NAME [--frames N] [--sd DIR] [rom.gb]
+//
+// Runs the firmware's setup()/main loop against the host shims with frame
+// pacing disabled, then prints throughput and per-stage latency for the
+// completed frames, followed by the firmware's own [PROF] report.
+// --apu-log records every APU register write for native/apu_bench.
+// --test runs one of the tests in native/sketch_tests.h and exits non-zero
+// if it fails; tests that drive the emulator need a ROM, and --frames then
+// bounds how long they may take.
+
+#include "native_bench.h"
+
+#include "apu_log.h"
+#include "minigb_apu_cardputer/minigb_apu.h"
+
+#include "M5Cardputer.h"
+#include "SD.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+void setup();
+
+namespace {
+
+struct BenchStage {
+  const char *name;
+  std::vector<uint32_t> samples;
+};
+
+struct BenchState {
+  uint32_t target_frames = 600;
+  const NativeTest *test = nullptr;
+  NativeTestResult test_result = NATIVE_TEST_RUNNING;
+  std::string rom_path;
+  std::string dump_path;
+  uint32_t iterations = 0;
+  uint32_t completed = 0;
+  std::chrono::steady_clock::time_point start;
+  BenchStage stages[4] = {{"frame", {}}, {"poll", {}}, {"emu", {}}, {"dispatch", {}}};
+};
+
+// Default bound on how long a test that drives the emulator may run.
+constexpr uint32_t NATIVE_TEST_MAX_FRAMES = 36000;
+
+BenchState g_bench;
+FILE *g_apu_log = nullptr;
+uint32_t g_apu_log_records = 0;
+
+void apu_log_write(uint32_t cycle, uint16_t addr, uint8_t val) {
+  const ApuLogRecord record = {cycle, addr, val, 0};
+  fwrite(&record, sizeof(record), 1, g_apu_log);
+  g_apu_log_records++;
+}
+
+bool apu_log_open(const char *path) {
+  g_apu_log = fopen(path, "wb");
+  if(g_apu_log == nullptr) {
+    fprintf(stderr, "cannot create APU log '%s'\n", path);
+    return false;
+  }
+  const ApuLogHeader header = {APU_LOG_MAGIC, APU_LOG_VERSION, 0};
+  fwrite(&header, sizeof(header), 1, g_apu_log);
+  audio_set_write_hook(&apu_log_write);
+  return true;
+}
+
+uint32_t clamp_us(uint64_t us) { return us > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(us); }
+
+void print_stage(BenchStage &stage) {
+  std::vector<uint32_t> &v = stage.samples;
+  if(v.empty()) {
+    return;
+  }
+  std::sort(v.begin(), v.end());
+  uint64_t total = 0;
+  for(uint32_t us : v) {
+    total += us;
+  }
+  auto pct = [&v](double p) { return v[static_cast<size_t>(p / 100.0 * static_cast<double>(v.size() - 1) + 0.5)]; };
+  printf("[BENCH] %-8s avg=%.1f p50=%u p90=%u p99=%u max=%u us\n",
+         stage.name,
+         static_cast<double>(total) / static_cast<double>(v.size()),
+         pct(50.0),
+         pct(90.0),
+         pct(99.0),
+         v.back());
+}
+
+bool write_ppm(const char *path) {
+  FILE *out = fopen(path, "wb");
+  if(out == nullptr) {
+    return false;
+  }
+  const int w = DisplayClass::PANEL_W;
+  const int h = DisplayClass::PANEL_H;
+  fprintf(out, "P6\n%d %d\n255\n", w, h);
+  const uint16_t *panel = M5Cardputer.Display.panel();
+  for(int i = 0; i < w * h; ++i) {
+    const uint16_t p = panel[i];
+    const uint8_t rgb[3] = {static_cast<uint8_t>(((p >> 11) & 0x1F) * 255 / 31),
+                            static_cast<uint8_t>(((p >> 5) & 0x3F) * 255 / 63),
+                            static_cast<uint8_t>((p & 0x1F) * 255 / 31)};
+    fwrite(rgb, 1, sizeof(rgb), out);
+  }
+  return fclose(out) == 0;
+}
+
+// Makes <sd>/roms/<name> refer to the ROM so the firmware opens it through
+// its normal SD path.
+bool stage_rom(const char *host_rom) {
+  const std::string root = native_sd_root();
+  const std::string roms = root + "/roms";
+  mkdir(root.c_str(), 0755);
+  mkdir(roms.c_str(), 0755);
+
+  const char *slash = strrchr(host_rom, '/');
+  const std::string name = slash != nullptr ? slash + 1 : host_rom;
+  g_bench.rom_path = "/roms/" + name;
+  const std::string link = roms + "/" + name;
+
+  char resolved[4096];
+  if(realpath(host_rom, resolved) == nullptr) {
+    fprintf(stderr, "cannot open ROM '%s'\n", host_rom);
+    return false;
+  }
+  char existing[4096];
+  if(realpath(link.c_str(), existing) != nullptr && strcmp(existing, resolved) == 0) {
+    return true;
+  }
+  unlink(link.c_str());
+  if(symlink(resolved, link.c_str()) != 0) {
+    fprintf(stderr, "cannot link ROM into '%s'\n", link.c_str());
+    return false;
+  }
+  return true;
+}
+
+const NativeTest *find_test(const char *name) {
+  for(const NativeTest *test = NATIVE_TESTS; test->name != nullptr; ++test) {
+    if(strcmp(test->name, name) == 0) {
+      return test;
+    }
+  }
+  return nullptr;
+}
+
+const char *test_verdict(NativeTestResult result) {
+  return result == NATIVE_TEST_PASSED ? "PASSED" : "FAILED";
+}
+
+int usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [--frames N] [--sd DIR] [--dump-frame out.ppm] [--apu-log out.apulog] rom.gb\n"
+          "       %s --test NAME [--frames N] [--sd DIR] [rom.gb]\n"
+          "NAME is one of:",
+          argv0,
+          argv0);
+  for(const NativeTest *test = NATIVE_TESTS; test->name != nullptr; ++test) {
+    fprintf(stderr, " %s", test->name);
+  }
+  if(NATIVE_TESTS[0].name == nullptr) {
+    fprintf(stderr, " (none in this build; use the native_test env)");
+  }
+  fprintf(stderr, "\n");
+  return 2;
+}
+
+}  // namespace
+
+const char *native_bench_rom_path() { return g_bench.rom_path.c_str(); }
+
+bool native_bench_frame(bool completed, uint64_t poll_us, uint64_t emu_us, uint64_t dispatch_us, uint64_t frame_us) {
+  if(g_bench.iterations++ == 0) {
+    g_bench.start = std::chrono::steady_clock::now();
+  }
+  if(!completed) {
+    return false;
+  }
+  g_bench.completed++;
+  if(g_bench.test != nullptr && g_bench.test_result == NATIVE_TEST_RUNNING) {
+    g_bench.test_result = g_bench.test->frame(g_bench.completed);
+    if(g_bench.test_result != NATIVE_TEST_RUNNING) {
+      return true;
+    }
+  }
+  g_bench.stages[0].samples.push_back(clamp_us(frame_us));
+  g_bench.stages[1].samples.push_back(clamp_us(poll_us));
+  g_bench.stages[2].samples.push_back(clamp_us(emu_us));
+  g_bench.stages[3].samples.push_back(clamp_us(dispatch_us));
+  return g_bench.completed >= g_bench.target_frames;
+}
+
+void native_bench_finish() {
+  const double wall_s =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - g_bench.start).count();
+  printf("[BENCH] frames=%u iterations=%u wall=%.3fs fps=%.1f (%.1fx real time)\n",
+         g_bench.completed,
+         g_bench.iterations,
+         wall_s,
+         wall_s > 0.0 ? g_bench.completed / wall_s : 0.0,
+         wall_s > 0.0 ? g_bench.completed / wall_s / 59.7275 : 0.0);
+  for(BenchStage &stage : g_bench.stages) {
+    print_stage(stage);
+  }
+  if(!g_bench.dump_path.empty()) {
+    if(write_ppm(g_bench.dump_path.c_str())) {
+      printf("[BENCH] wrote %s\n", g_bench.dump_path.c_str());
+    } else {
+      printf("[BENCH] failed to write %s\n", g_bench.dump_path.c_str());
+    }
+  }
+  if(g_apu_log != nullptr) {
+    audio_set_write_hook(nullptr);
+    const bool ok = fclose(g_apu_log) == 0;
+    g_apu_log = nullptr;
+    printf("[BENCH] APU log: %u records%s\n", g_apu_log_records, ok ? "" : " (write failed)");
+  }
+  if(g_bench.test != nullptr) {
+    if(g_bench.test_result == NATIVE_TEST_RUNNING) {
+      printf("[TEST] %s: no verdict after %u frames\n", g_bench.test->name, g_bench.completed);
+    }
+    printf("[TEST] %s %s\n", g_bench.test->name, test_verdict(g_bench.test_result));
+  }
+  fflush(stdout);
+  // Render/audio tasks are still running; leave without unwinding them.
+  _Exit(g_bench.test != nullptr && g_bench.test_result != NATIVE_TEST_PASSED ? 1 : 0);
+}
+
+int main(int argc, char **argv) {
+  const char *rom = nullptr;
+  const char *apu_log_path = nullptr;
+  bool frames_given = false;
+  for(int i = 1; i < argc; ++i) {
+    if(strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+      g_bench.target_frames = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+      frames_given = true;
+    } else if(strcmp(argv[i], "--test") == 0 && i + 1 < argc) {
+      g_bench.test = find_test(argv[++i]);
+      if(g_bench.test == nullptr) {
+        return usage(argv[0]);
+      }
+    } else if(strcmp(argv[i], "--sd") == 0 && i + 1 < argc) {
+      native_set_sd_root(argv[++i]);
+    } else if(strcmp(argv[i], "--dump-frame") == 0 && i + 1 < argc) {
+      g_bench.dump_path = argv[++i];
+    } else if(strcmp(argv[i], "--apu-log") == 0 && i + 1 < argc) {
+      apu_log_path = argv[++i];
+    } else if(argv[i][0] == '-' || rom != nullptr) {
+      return usage(argv[0]);
+    } else {
+      rom = argv[i];
+    }
+  }
+  if(g_bench.test != nullptr && g_bench.test->run != nullptr) {
+    const NativeTestResult result = g_bench.test->run();
+    printf("[TEST] %s %s\n", g_bench.test->name, test_verdict(result));
+    fflush(stdout);
+    _Exit(result == NATIVE_TEST_PASSED ? 0 : 1);
+  }
+  if(g_bench.test != nullptr && !frames_given) {
+    g_bench.target_frames = NATIVE_TEST_MAX_FRAMES;
+  }
+  if(rom == nullptr || g_bench.target_frames == 0) {
+    return usage(argv[0]);
+  }
+  if(!stage_rom(rom)) {
+    return 1;
+  }
+  if(apu_log_path != nullptr && !apu_log_open(apu_log_path)) {
+    return 1;
+  }
+
+  setup();
+  return 0;
+}
@@ -0,0 +1,925 @@
+// Host implementations behind native/shim: Arduino timing and Serial, the
+// FreeRTOS task/queue/semaphore API on std::thread, esp_timer, the heap,
+// the M5 display/speaker stand-ins and an SD card rooted in a host directory.
+
+#include "Arduino.h"
+#include "M5Cardputer.h"
+#include "SD.h"
+#include "esp32-hal-cpu.h"
+#include "esp_cpu.h"
+#include "esp_heap_caps.h"
+#include "esp_partition.h"
+#include "esp_pm.h"
+#include "esp_rom_sys.h"
+#include "esp_spi_flash.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <dirent.h>
+#include <mutex>
+#include <pthread.h>
+#include <random>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// --- Clock ------------------------------------------------------------------
+
+static const std::chrono::steady_clock::time_point g_boot_time = std::chrono::steady_clock::now();
+
+static uint64_t host_micros() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - g_boot_time).count());
+}
+
+static void host_sleep_us(uint64_t us) {
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+uint32_t millis() { return static_cast<uint32_t>(host_micros() / 1000); }
+uint32_t micros() { return static_cast<uint32_t>(host_micros()); }
+void delay(uint32_t ms) { host_sleep_us(static_cast<uint64_t>(ms) * 1000); }
+void delayMicroseconds(uint32_t us) { host_sleep_us(us); }
+void yield() { std::this_thread::yield(); }
+void esp_rom_delay_us(uint32_t us) { host_sleep_us(us); }
+int64_t esp_timer_get_time() { return static_cast<int64_t>(host_micros()); }
+
+static std::atomic<uint32_t> g_cycle_offset{0};
+
+static uint32_t host_cycles() {
+  const uint64_t ns = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - g_boot_time).count());
+  return static_cast<uint32_t>(ns * 240 / 1000);
+}
+
+uint32_t esp_cpu_get_cycle_count() { return host_cycles() + g_cycle_offset.load(std::memory_order_relaxed); }
+
+void native_set_cycle_count(uint32_t cycles) { g_cycle_offset.store(cycles - host_cycles(), std::memory_order_relaxed); }
+
+static std::mt19937 &host_rng() {
+  static std::mt19937 rng(12345);
+  return rng;
+}
+
+long random(long max) { return max > 0 ? static_cast<long>(host_rng()() % static_cast<unsigned long>(max)) : 0; }
+long random(long min, long max) { return max > min ? min + random(max - min) : min; }
+
+// --- Serial, ESP, CPU -------------------------------------------------------
+
+HardwareSerial Serial;
+EspClass ESP;
+
+size_t HardwareSerial::write(uint8_t c) { return fwrite(&c, 1, 1, stdout); }
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) { return fwrite(buffer, 1, size, stdout); }
+void HardwareSerial::flush() { fflush(stdout); }
+
+static constexpr uint32_t HOST_PSRAM_BYTES = 8u * 1024u * 1024u;
+
+bool psramInit() { return true; }
+bool psramFound() { return true; }
+uint32_t EspClass::getPsramSize() { return HOST_PSRAM_BYTES; }
+uint32_t EspClass::getFreePsram() { return HOST_PSRAM_BYTES; }
+uint32_t EspClass::getFreeHeap() { return 256u * 1024u; }
+uint32_t EspClass::getCpuFreqMHz() { return getCpuFrequencyMhz(); }
+void EspClass::restart() {
+  fflush(stdout);
+  _Exit(0);
+}
+
+static uint32_t g_cpu_mhz = 240;
+
+bool setCpuFrequencyMhz(uint32_t mhz) {
+  g_cpu_mhz = mhz;
+  return true;
+}
+uint32_t getCpuFrequencyMhz() { return g_cpu_mhz; }
+uint32_t getXtalFrequencyMhz() { return 40; }
+uint32_t getApbFrequency() { return 80000000; }
+
+esp_err_t esp_pm_configure(const void *config) {
+  (void)config;
+  return ESP_ERR_NOT_SUPPORTED;
+}
+
+const char *esp_err_to_name(esp_err_t code) {
+  switch(code) {
+    case ESP_OK:
+      return "ESP_OK";
+    case ESP_ERR_NO_MEM:
+      return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:
+      return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:
+      return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_NOT_FOUND:
+      return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED:
+      return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT:
+      return "ESP_ERR_TIMEOUT";
+    default:
+      return "ESP_FAIL";
+  }
+}
+
+// --- Heap and flash ---------------------------------------------------------
+
+void *heap_caps_malloc(size_t size, uint32_t caps) {
+  (void)caps;
+  return malloc(size);
+}
+void *heap_caps_calloc(size_t count, size_t size, uint32_t caps) {
+  (void)caps;
+  return calloc(count, size);
+}
+void *heap_caps_realloc(void *ptr, size_t size, uint32_t caps) {
+  (void)caps;
+  return realloc(ptr, size);
+}
+void *heap_caps_aligned_alloc(size_t alignment, size_t size, uint32_t caps) {
+  (void)caps;
+  void *ptr = nullptr;
+  return posix_memalign(&ptr, alignment < sizeof(void *) ? sizeof(void *) : alignment, size) == 0 ? ptr : nullptr;
+}
+void heap_caps_free(void *ptr) { free(ptr); }
+size_t heap_caps_get_free_size(uint32_t caps) { return (caps & MALLOC_CAP_SPIRAM) ? HOST_PSRAM_BYTES : 256u * 1024u; }
+size_t heap_caps_get_largest_free_block(uint32_t caps) { return heap_caps_get_free_size(caps); }
+size_t heap_caps_get_total_size(uint32_t caps) { return heap_caps_get_free_size(caps); }
+bool esp_ptr_external_ram(const void *ptr) {
+  (void)ptr;
+  return false;
+}
+bool esp_ptr_dma_capable(const void *ptr) {
+  (void)ptr;
+  return true;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type,
+                                                esp_partition_subtype_t subtype,
+                                                const char *label) {
+  (void)type;
+  (void)subtype;
+  (void)label;
+  return nullptr;
+}
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t offset, void *dst, size_t size) {
+  (void)partition;
+  (void)offset;
+  (void)dst;
+  (void)size;
+  return ESP_ERR_NOT_SUPPORTED;
+}
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t offset, const void *src, size_t size) {
+  (void)partition;
+  (void)offset;
+  (void)src;
+  (void)size;
+  return ESP_ERR_NOT_SUPPORTED;
+}
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size) {
+  (void)partition;
+  (void)offset;
+  (void)size;
+  return ESP_ERR_NOT_SUPPORTED;
+}
+esp_err_t esp_partition_mmap(const esp_partition_t *partition,
+                             size_t offset,
+                             size_t size,
+                             esp_partition_mmap_memory_t memory,
+                             const void **out_ptr,
+                             esp_partition_mmap_handle_t *out_handle) {
+  (void)partition;
+  (void)offset;
+  (void)size;
+  (void)memory;
+  (void)out_ptr;
+  (void)out_handle;
+  return ESP_ERR_NOT_SUPPORTED;
+}
+void esp_partition_munmap(esp_partition_mmap_handle_t handle) { (void)handle; }
+void spi_flash_munmap(spi_flash_mmap_handle_t handle) { (void)handle; }
+
+// --- FreeRTOS tasks ---------------------------------------------------------
+
+struct tskTaskControlBlock {
+  std::string name;
+  BaseType_t core = tskNO_AFFINITY;
+  UBaseType_t priority = 1;
+  uint32_t stack_depth = 0;
+  std::mutex mutex;
+  std::condition_variable cv;
+  uint32_t notify_count = 0;
+  bool suspended = false;
+};
+
+static thread_local TaskHandle_t t_current_task = nullptr;
+static thread_local int t_thread_id = 0;
+static std::atomic<int> g_next_thread_id{1};
+static std::atomic<UBaseType_t> g_task_count{0};
+
+static int current_thread_id() {
+  if(t_thread_id == 0) {
+    t_thread_id = g_next_thread_id.fetch_add(1);
+  }
+  return t_thread_id;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  if(t_current_task == nullptr) {
+    // Threads the shim did not start are the Arduino loop task on core 1.
+    TaskHandle_t task = new tskTaskControlBlock();
+    task->name = "loopTask";
+    task->core = 1;
+    task->stack_depth = 16384;
+    t_current_task = task;
+    g_task_count++;
+  }
+  return t_current_task;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function,
+                                   const char *name,
+                                   uint32_t stack_depth,
+                                   void *param,
+                                   UBaseType_t priority,
+                                   TaskHandle_t *out_handle,
+                                   BaseType_t core_id) {
+  TaskHandle_t task = new tskTaskControlBlock();
+  task->name = name != nullptr ? name : "";
+  task->core = core_id;
+  task->priority = priority;
+  task->stack_depth = stack_depth;
+  if(out_handle != nullptr) {
+    *out_handle = task;
+  }
+  g_task_count++;
+  std::thread([task, function, param]() {
+    t_current_task = task;
+    function(param);
+  }).detach();
+  return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  if(task == nullptr || task == t_current_task) {
+    g_task_count--;
+    pthread_exit(nullptr);
+  }
+  // Deleting another task is not supported on the host; it keeps running.
+}
+
+// vTaskSuspend on another task cannot stop its thread mid-instruction. The
+// suspension takes hold where the task next blocks or wakes in the shim: it
+// parks there until vTaskResume, so a suspended task never takes a queue
+// item, notification or delay wake-up.
+static bool task_suspended(TaskHandle_t task) {
+  std::lock_guard<std::mutex> lock(task->mutex);
+  return task->suspended;
+}
+
+static void park_if_suspended() {
+  TaskHandle_t task = t_current_task;
+  if(task == nullptr) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock(task->mutex);
+  task->cv.wait(lock, [task]() { return !task->suspended; });
+}
+
+void vTaskDelay(TickType_t ticks) {
+  park_if_suspended();
+  if(ticks == 0) {
+    std::this_thread::yield();
+    return;
+  }
+  host_sleep_us(static_cast<uint64_t>(ticks) * 1000);
+  park_if_suspended();
+}
+
+TickType_t xTaskGetTickCount() { return static_cast<TickType_t>(host_micros() / 1000); }
+
+void vTaskSuspend(TaskHandle_t task) {
+  if(task == nullptr) {
+    task = xTaskGetCurrentTaskHandle();
+  }
+  std::unique_lock<std::mutex> lock(task->mutex);
+  task->suspended = true;
+  if(task == t_current_task) {
+    task->cv.wait(lock, [task]() { return !task->suspended; });
+  }
+}
+
+eTaskState eTaskGetState(TaskHandle_t task) {
+  if(task == nullptr) {
+    return eInvalid;
+  }
+  if(task == t_current_task) {
+    return eRunning;
+  }
+  return task_suspended(task) ? eSuspended : eReady;
+}
+
+void vTaskResume(TaskHandle_t task) {
+  if(task == nullptr) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(task->mutex);
+  task->suspended = false;
+  task->cv.notify_all();
+}
+
+TaskHandle_t xTaskGetIdleTaskHandleForCPU(UBaseType_t cpu) {
+  static tskTaskControlBlock idle[portNUM_PROCESSORS];
+  if(cpu >= portNUM_PROCESSORS) {
+    return nullptr;
+  }
+  if(idle[cpu].name.empty()) {
+    idle[cpu].name = cpu == 0 ? "IDLE0" : "IDLE1";
+    idle[cpu].core = static_cast<BaseType_t>(cpu);
+    idle[cpu].priority = 0;
+  }
+  return &idle[cpu];
+}
+
+const char *pcTaskGetName(TaskHandle_t task) {
+  return (task != nullptr ? task : xTaskGetCurrentTaskHandle())->name.c_str();
+}
+
+BaseType_t xTaskGetAffinity(TaskHandle_t task) { return (task != nullptr ? task : xTaskGetCurrentTaskHandle())->core; }
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+  // Host stacks are megabytes; report half the requested depth as headroom.
+  return (task != nullptr ? task : xTaskGetCurrentTaskHandle())->stack_depth / 2;
+}
+
+UBaseType_t uxTaskGetNumberOfTasks() { return g_task_count.load(); }
+
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *status, UBaseType_t count, uint32_t *total_runtime) {
+  (void)status;
+  (void)count;
+  if(total_runtime != nullptr) {
+    *total_runtime = 0;
+  }
+  return 0;
+}
+
+BaseType_t xPortGetCoreID() {
+  const BaseType_t core = xTaskGetCurrentTaskHandle()->core;
+  return core == tskNO_AFFINITY ? 0 : core;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  if(task == nullptr) {
+    return pdFAIL;
+  }
+  std::lock_guard<std::mutex> lock(task->mutex);
+  task->notify_count++;
+  task->cv.notify_all();
+  return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higher_priority_woken) {
+  xTaskNotifyGive(task);
+  if(higher_priority_woken != nullptr) {
+    *higher_priority_woken = pdFALSE;
+  }
+}
+
+// Waits until `ready` holds or the FreeRTOS timeout expires.
+template <class Lock, class Predicate>
+static bool wait_ticks(std::condition_variable &cv, Lock &lock, TickType_t ticks, Predicate ready) {
+  if(ticks == portMAX_DELAY) {
+    cv.wait(lock, ready);
+    return true;
+  }
+  return cv.wait_for(lock, std::chrono::milliseconds(ticks), ready);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait) {
+  TaskHandle_t task = xTaskGetCurrentTaskHandle();
+  std::unique_lock<std::mutex> lock(task->mutex);
+  wait_ticks(task->cv, lock, ticks_to_wait, [task]() { return task->notify_count > 0; });
+  task->cv.wait(lock, [task]() { return !task->suspended; });
+  const uint32_t value = task->notify_count;
+  if(value > 0) {
+    task->notify_count = clear_on_exit ? 0 : value - 1;
+  }
+  return value;
+}
+
+// Critical sections are recursive spinlocks keyed by host thread; they guard
+// short sections just as on the target, so spinning is acceptable.
+void vPortEnterCritical(portMUX_TYPE *mux) {
+  const int self = current_thread_id();
+  if(__atomic_load_n(&mux->owner, __ATOMIC_ACQUIRE) == self) {
+    mux->count++;
+    return;
+  }
+  int expected = 0;
+  while(!__atomic_compare_exchange_n(&mux->owner, &expected, self, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+    expected = 0;
+    std::this_thread::yield();
+  }
+  mux->count = 1;
+}
+
+void vPortExitCritical(portMUX_TYPE *mux) {
+  if(--mux->count == 0) {
+    __atomic_store_n(&mux->owner, 0, __ATOMIC_RELEASE);
+  }
+}
+
+// --- Queues and semaphores --------------------------------------------------
+
+struct QueueDefinition {
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<std::vector<uint8_t>> items;
+  size_t length = 0;
+  size_t item_size = 0;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+  QueueHandle_t queue = new QueueDefinition();
+  queue->length = length;
+  queue->item_size = item_size;
+  return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) { delete queue; }
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait) {
+  std::unique_lock<std::mutex> lock(queue->mutex);
+  if(!wait_ticks(queue->cv, lock, ticks_to_wait, [queue]() { return queue->items.size() < queue->length; })) {
+    return pdFAIL;
+  }
+  const uint8_t *bytes = static_cast<const uint8_t *>(item);
+  queue->items.emplace_back(bytes, bytes + (bytes != nullptr ? queue->item_size : 0));
+  queue->cv.notify_all();
+  return pdPASS;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item, BaseType_t *higher_priority_woken) {
+  if(higher_priority_woken != nullptr) {
+    *higher_priority_woken = pdFALSE;
+  }
+  return xQueueSend(queue, item, 0);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks_to_wait) {
+  park_if_suspended();
+  std::unique_lock<std::mutex> lock(queue->mutex);
+  for(;;) {
+    if(!wait_ticks(queue->cv, lock, ticks_to_wait, [queue]() { return !queue->items.empty(); })) {
+      return pdFAIL;
+    }
+    if(t_current_task == nullptr || !task_suspended(t_current_task)) {
+      break;
+    }
+    // Suspended while blocked: leave the item and wait for vTaskResume.
+    lock.unlock();
+    park_if_suspended();
+    lock.lock();
+  }
+  if(item != nullptr && queue->item_size > 0) {
+    memcpy(item, queue->items.front().data(), queue->item_size);
+  }
+  queue->items.pop_front();
+  queue->cv.notify_all();
+  return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+  std::lock_guard<std::mutex> lock(queue->mutex);
+  return static_cast<UBaseType_t>(queue->items.size());
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+  std::lock_guard<std::mutex> lock(queue->mutex);
+  queue->items.clear();
+  queue->cv.notify_all();
+  return pdPASS;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() { return xQueueCreate(1, 0); }
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+  SemaphoreHandle_t semaphore = xQueueCreate(1, 0);
+  xQueueSend(semaphore, nullptr, 0);
+  return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count) {
+  SemaphoreHandle_t semaphore = xQueueCreate(max_count, 0);
+  for(UBaseType_t i = 0; i < initial_count; ++i) {
+    xQueueSend(semaphore, nullptr, 0);
+  }
+  return semaphore;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait) {
+  return xQueueReceive(semaphore, nullptr, ticks_to_wait);
+}
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) { return xQueueSend(semaphore, nullptr, 0); }
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t *higher_priority_woken) {
+  return xQueueSendFromISR(semaphore, nullptr, higher_priority_woken);
+}
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) { vQueueDelete(semaphore); }
+
+// --- esp_timer --------------------------------------------------------------
+
+// One host thread per timer, standing in for the esp_timer dispatch task.
+struct esp_timer {
+  esp_timer_cb_t callback = nullptr;
+  void *arg = nullptr;
+  std::mutex mutex;
+  std::condition_variable cv;
+  uint64_t due_us = 0;
+  uint64_t period_us = 0;
+  bool armed = false;
+};
+
+static void esp_timer_thread(esp_timer_handle_t timer) {
+  t_current_task = xTaskGetIdleTaskHandleForCPU(0);
+  std::unique_lock<std::mutex> lock(timer->mutex);
+  while(true) {
+    timer->cv.wait(lock, [timer]() { return timer->armed; });
+    const uint64_t now = host_micros();
+    if(now < timer->due_us) {
+      timer->cv.wait_for(lock, std::chrono::microseconds(timer->due_us - now));
+      continue;
+    }
+    if(timer->period_us > 0) {
+      timer->due_us += timer->period_us;
+    } else {
+      timer->armed = false;
+    }
+    lock.unlock();
+    timer->callback(timer->arg);
+    lock.lock();
+  }
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out_handle) {
+  if(args == nullptr || args->callback == nullptr || out_handle == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  esp_timer_handle_t timer = new esp_timer();
+  timer->callback = args->callback;
+  timer->arg = args->arg;
+  std::thread(esp_timer_thread, timer).detach();
+  *out_handle = timer;
+  return ESP_OK;
+}
+
+static esp_err_t esp_timer_arm(esp_timer_handle_t timer, uint64_t timeout_us, uint64_t period_us) {
+  if(timer == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::lock_guard<std::mutex> lock(timer->mutex);
+  if(timer->armed) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->due_us = host_micros() + timeout_us;
+  timer->period_us = period_us;
+  timer->armed = true;
+  timer->cv.notify_all();
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+  return esp_timer_arm(timer, timeout_us, 0);
+}
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us) {
+  return esp_timer_arm(timer, period_us, period_us);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+  if(timer == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  std::lock_guard<std::mutex> lock(timer->mutex);
+  if(!timer->armed) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->armed = false;
+  timer->cv.notify_all();
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+  // The dispatch thread owns the timer for the life of the process.
+  return esp_timer_stop(timer) == ESP_ERR_INVALID_ARG ? ESP_ERR_INVALID_ARG : ESP_OK;
+}
+
+// --- M5 display and speaker -------------------------------------------------
+
+M5CardputerClass M5Cardputer;
+M5UnifiedClass M5;
+
+void DisplayClass::writePixels(const uint16_t *data, uint32_t len, bool swap) {
+  pixels_written_ += len;
+  for(uint32_t i = 0; i < len && win_w_ > 0; ++i, ++win_pos_) {
+    const int32_t x = win_x_ + static_cast<int32_t>(win_pos_ % win_w_);
+    const int32_t y = win_y_ + static_cast<int32_t>(win_pos_ / win_w_);
+    if(y >= win_y_ + win_h_) {
+      break;
+    }
+    if(x < 0 || y < 0 || x >= PANEL_W || y >= PANEL_H) {
+      continue;
+    }
+    const uint16_t pixel = data[i];
+    panel_[y * PANEL_W + x] = swap ? pixel : static_cast<uint16_t>((pixel >> 8) | (pixel << 8));
+  }
+}
+
+void DisplayClass::fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color) {
+  pixels_written_ += w > 0 && h > 0 ? static_cast<uint64_t>(w) * static_cast<uint64_t>(h) : 0;
+  for(int32_t row = y < 0 ? 0 : y; row < y + h && row < PANEL_H; ++row) {
+    for(int32_t col = x < 0 ? 0 : x; col < x + w && col < PANEL_W; ++col) {
+      panel_[row * PANEL_W + col] = static_cast<uint16_t>(color);
+    }
+  }
+}
+
+bool SpeakerClass::begin() {
+  running_ = true;
+  stop();
+  return true;
+}
+
+void SpeakerClass::end() {
+  stop();
+  running_ = false;
+}
+
+void SpeakerClass::stop() {
+  for(int i = 0; i < CHANNELS; ++i) {
+    stop(static_cast<uint8_t>(i));
+  }
+}
+
+void SpeakerClass::stop(uint8_t channel) {
+  if(channel < CHANNELS) {
+    busy_until_us_[channel] = 0;
+    prev_until_us_[channel] = 0;
+  }
+}
+
+size_t SpeakerClass::isPlaying(int channel) const {
+  const uint64_t now = host_micros();
+  if(channel < 0) {
+    size_t playing = 0;
+    for(int i = 0; i < CHANNELS; ++i) {
+      playing += isPlaying(i) > 0 ? 1 : 0;
+    }
+    return playing;
+  }
+  if(channel >= CHANNELS) {
+    return 0;
+  }
+  return (now < busy_until_us_[channel] ? 1 : 0) + (now < prev_until_us_[channel] ? 1 : 0);
+}
+
+bool SpeakerClass::queue(size_t frames, uint32_t rate, int channel, bool stop_current) {
+  if(!running_ || rate == 0) {
+    return false;
+  }
+  if(channel < 0) {
+    channel = 0;
+  }
+  if(channel >= CHANNELS) {
+    return false;
+  }
+  if(stop_current) {
+    stop(static_cast<uint8_t>(channel));
+  }
+  if(isPlaying(channel) >= 2) {
+    return false;
+  }
+  const uint64_t now = host_micros();
+  if(busy_until_us_[channel] != 0 && busy_until_us_[channel] < now) {
+    gaps_++;
+  }
+  const uint64_t start = busy_until_us_[channel] > now ? busy_until_us_[channel] : now;
+  prev_until_us_[channel] = busy_until_us_[channel];
+  busy_until_us_[channel] = start + static_cast<uint64_t>(frames) * 1000000u / rate;
+  samples_queued_ += frames;
+  return true;
+}
+
+bool SpeakerClass::playRaw(const int16_t *data, size_t len, uint32_t rate, bool stereo, uint32_t repeat,
+                           int channel, bool stop_current) {
+  (void)data;
+  return queue((stereo ? len / 2 : len) * (repeat > 0 ? repeat : 1), rate, channel, stop_current);
+}
+
+bool SpeakerClass::playRaw(const uint8_t *data, size_t len, uint32_t rate, bool stereo, uint32_t repeat,
+                           int channel, bool stop_current) {
+  (void)data;
+  return queue((stereo ? len / 2 : len) * (repeat > 0 ? repeat : 1), rate, channel, stop_current);
+}
+
+// --- SD card ----------------------------------------------------------------
+
+SDFS SD;
+SPIClass SDFS::default_spi_;
+
+static std::string g_sd_root = "native_sd";
+
+const char *native_sd_root() { return g_sd_root.c_str(); }
+void native_set_sd_root(const char *path) { g_sd_root = path != nullptr ? path : "native_sd"; }
+
+static std::string sd_host_path(const char *path) {
+  std::string host = g_sd_root;
+  if(path == nullptr || path[0] != '/') {
+    host += '/';
+  }
+  if(path != nullptr) {
+    host += path;
+  }
+  return host;
+}
+
+struct File::State {
+  FILE *file = nullptr;
+  DIR *dir = nullptr;
+  std::string path;
+  std::string name;
+
+  ~State() {
+    if(file != nullptr) {
+      fclose(file);
+    }
+    if(dir != nullptr) {
+      closedir(dir);
+    }
+  }
+};
+
+int File::available() {
+  if(!state_ || state_->file == nullptr) {
+    return 0;
+  }
+  const size_t remaining = size() - position();
+  return remaining > INT32_MAX ? INT32_MAX : static_cast<int>(remaining);
+}
+
+size_t File::size() const {
+  if(!state_ || state_->file == nullptr) {
+    return 0;
+  }
+  struct stat st = {};
+  return fstat(fileno(state_->file), &st) == 0 ? static_cast<size_t>(st.st_size) : 0;
+}
+
+size_t File::position() const {
+  if(!state_ || state_->file == nullptr) {
+    return 0;
+  }
+  const long pos = ftell(state_->file);
+  return pos > 0 ? static_cast<size_t>(pos) : 0;
+}
+
+bool File::seek(uint32_t pos, fs::SeekMode mode) {
+  if(!state_ || state_->file == nullptr) {
+    return false;
+  }
+  const int whence = mode == fs::SeekCur ? SEEK_CUR : (mode == fs::SeekEnd ? SEEK_END : SEEK_SET);
+  return fseek(state_->file, static_cast<long>(pos), whence) == 0;
+}
+
+int File::read() {
+  uint8_t c = 0;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+size_t File::read(uint8_t *buffer, size_t size) {
+  if(!state_ || state_->file == nullptr) {
+    return 0;
+  }
+  return fread(buffer, 1, size, state_->file);
+}
+
+int File::peek() {
+  if(!state_ || state_->file == nullptr) {
+    return -1;
+  }
+  const int c = fgetc(state_->file);
+  if(c != EOF) {
+    ungetc(c, state_->file);
+  }
+  return c == EOF ? -1 : c;
+}
+
+size_t File::write(uint8_t c) { return write(&c, 1); }
+
+size_t File::write(const uint8_t *buffer, size_t size) {
+  if(!state_ || state_->file == nullptr) {
+    return 0;
+  }
+  return fwrite(buffer, 1, size, state_->file);
+}
+
+void File::flush() {
+  if(state_ && state_->file != nullptr) {
+    fflush(state_->file);
+  }
+}
+
+String File::readStringUntil(char terminator) {
+  std::string out;
+  int c;
+  while((c = read()) >= 0 && c != terminator) {
+    out += static_cast<char>(c);
+  }
+  return String(out);
+}
+
+bool File::isDirectory() const { return state_ && state_->dir != nullptr; }
+
+File File::openNextFile(const char *mode) {
+  if(!isDirectory()) {
+    return File();
+  }
+  while(struct dirent *entry = readdir(state_->dir)) {
+    if(strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+      continue;
+    }
+    std::string child = state_->path;
+    if(child.empty() || child.back() != '/') {
+      child += '/';
+    }
+    child += entry->d_name;
+    return SD.open(child.c_str(), mode);
+  }
+  return File();
+}
+
+void File::rewindDirectory() {
+  if(isDirectory()) {
+    rewinddir(state_->dir);
+  }
+}
+
+const char *File::name() const { return state_ ? state_->name.c_str() : ""; }
+const char *File::path() const { return state_ ? state_->path.c_str() : ""; }
+
+bool SDFS::begin(uint8_t ss, SPIClass &spi, uint32_t frequency, const char *mountpoint, uint8_t max_files,
+                 bool format_if_empty) {
+  (void)ss;
+  (void)spi;
+  (void)frequency;
+  (void)mountpoint;
+  (void)max_files;
+  (void)format_if_empty;
+  struct stat st = {};
+  return stat(g_sd_root.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+File SDFS::open(const char *path, const char *mode, bool create) {
+  (void)create;
+  File file;
+  if(path == nullptr) {
+    return file;
+  }
+  const std::string host = sd_host_path(path);
+  auto state = std::make_shared<File::State>();
+  state->path = path;
+  const size_t slash = state->path.find_last_of('/');
+  state->name = slash == std::string::npos ? state->path : state->path.substr(slash + 1);
+
+  struct stat st = {};
+  const bool reading = mode == nullptr || mode[0] == 'r';
+  if(reading && stat(host.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+    state->dir = opendir(host.c_str());
+  } else {
+    const char *host_mode = reading ? "rb" : (mode[0] == 'a' ? "ab" : "w+b");
+    state->file = fopen(host.c_str(), host_mode);
+  }
+  if(state->dir != nullptr || state->file != nullptr) {
+    file.state_ = state;
+  }
+  return file;
+}
+
+bool SDFS::exists(const char *path) {
+  struct stat st = {};
+  return path != nullptr && stat(sd_host_path(path).c_str(), &st) == 0;
+}
+
+bool SDFS::mkdir(const char *path) { return path != nullptr && ::mkdir(sd_host_path(path).c_str(), 0755) == 0; }
+bool SDFS::remove(const char *path) { return path != nullptr && ::remove(sd_host_path(path).c_str()) == 0; }
+bool SDFS::rmdir(const char *path) { return path != nullptr && ::rmdir(sd_host_path(path).c_str()) == 0; }
+bool SDFS::rename(const char *from, const char *to) {
+  return from != nullptr && to != nullptr && ::rename(sd_host_path(from).c_str(), sd_host_path(to).c_str()) == 0;
+}
@@ -0,0 +1,264 @@
+// Host stand-in for the parts of the Arduino-ESP32 core the firmware uses.
+// Only built by the PlatformIO `native` environment.
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define EXT_RAM_ATTR
+#define PROGMEM
+#define SET_LOOP_TASK_STACK_SIZE(size)
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+long random(long max);
+long random(long min, long max);
+bool psramInit();
+bool psramFound();
+
+class String {
+ public:
+  String() {}
+  String(const char *text) : value_(text != nullptr ? text : "") {}
+  String(const std::string &text) : value_(text) {}
+  String(const String &other) = default;
+  String(String &&other) = default;
+  explicit String(char c) : value_(1, c) {}
+  explicit String(int number) : value_(std::to_string(number)) {}
+  explicit String(unsigned int number) : value_(std::to_string(number)) {}
+  explicit String(long number) : value_(std::to_string(number)) {}
+  explicit String(unsigned long number) : value_(std::to_string(number)) {}
+  explicit String(unsigned char number) : value_(std::to_string(number)) {}
+  String(double number, unsigned int decimals) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%.*f", static_cast<int>(decimals), number);
+    value_ = buffer;
+  }
+  explicit String(double number) : String(number, 2) {}
+  explicit String(float number) : String(static_cast<double>(number), 2) {}
+
+  String &operator=(const String &other) = default;
+  String &operator=(String &&other) = default;
+  String &operator=(const char *text) {
+    value_ = text != nullptr ? text : "";
+    return *this;
+  }
+
+  unsigned int length() const { return static_cast<unsigned int>(value_.size()); }
+  bool isEmpty() const { return value_.empty(); }
+  const char *c_str() const { return value_.c_str(); }
+  void reserve(unsigned int size) { value_.reserve(size); }
+
+  char charAt(unsigned int index) const { return index < value_.size() ? value_[index] : '\0'; }
+  char operator[](unsigned int index) const { return charAt(index); }
+  char &operator[](unsigned int index) { return value_[index]; }
+
+  int indexOf(char c, unsigned int from = 0) const { return find_result(value_.find(c, from)); }
+  int indexOf(const String &text, unsigned int from = 0) const { return find_result(value_.find(text.value_, from)); }
+  int indexOf(const char *text, unsigned int from = 0) const { return find_result(value_.find(text, from)); }
+  int lastIndexOf(char c) const { return find_result(value_.rfind(c)); }
+  int lastIndexOf(const String &text) const { return find_result(value_.rfind(text.value_)); }
+
+  String substring(unsigned int begin) const {
+    return begin < value_.size() ? String(value_.substr(begin)) : String();
+  }
+  String substring(unsigned int begin, unsigned int end) const {
+    if(begin > end) {
+      std::swap(begin, end);
+    }
+    if(begin >= value_.size()) {
+      return String();
+    }
+    return String(value_.substr(begin, std::min<size_t>(end, value_.size()) - begin));
+  }
+
+  bool startsWith(const String &prefix) const { return value_.compare(0, prefix.value_.size(), prefix.value_) == 0; }
+  bool endsWith(const String &suffix) const {
+    return value_.size() >= suffix.value_.size() &&
+           value_.compare(value_.size() - suffix.value_.size(), suffix.value_.size(), suffix.value_) == 0;
+  }
+  bool equals(const String &other) const { return value_ == other.value_; }
+  bool equalsIgnoreCase(const String &other) const {
+    if(value_.size() != other.value_.size()) {
+      return false;
+    }
+    for(size_t i = 0; i < value_.size(); ++i) {
+      if(std::tolower(static_cast<unsigned char>(value_[i])) !=
+         std::tolower(static_cast<unsigned char>(other.value_[i]))) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void trim() {
+    const size_t first = value_.find_first_not_of(" \t\r\n");
+    if(first == std::string::npos) {
+      value_.clear();
+      return;
+    }
+    value_ = value_.substr(first, value_.find_last_not_of(" \t\r\n") - first + 1);
+  }
+  void toLowerCase() {
+    for(char &c : value_) {
+      c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+  }
+  void toUpperCase() {
+    for(char &c : value_) {
+      c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+    }
+  }
+  void remove(unsigned int index, unsigned int count = UINT32_MAX) {
+    if(index < value_.size()) {
+      value_.erase(index, count);
+    }
+  }
+  void replace(const String &from, const String &to) {
+    if(from.value_.empty()) {
+      return;
+    }
+    size_t pos = 0;
+    while((pos = value_.find(from.value_, pos)) != std::string::npos) {
+      value_.replace(pos, from.value_.size(), to.value_);
+      pos += to.value_.size();
+    }
+  }
+
+  long toInt() const { return std::strtol(value_.c_str(), nullptr, 10); }
+  float toFloat() const { return std::strtof(value_.c_str(), nullptr); }
+
+  String &operator+=(const String &other) {
+    value_ += other.value_;
+    return *this;
+  }
+  String &operator+=(const char *text) {
+    value_ += text != nullptr ? text : "";
+    return *this;
+  }
+  String &operator+=(char c) {
+    value_ += c;
+    return *this;
+  }
+  bool concat(const String &other) {
+    value_ += other.value_;
+    return true;
+  }
+
+  friend String operator+(const String &a, const String &b) { return String(a.value_ + b.value_); }
+  friend String operator+(const String &a, const char *b) { return String(a.value_ + (b != nullptr ? b : "")); }
+  friend String operator+(const char *a, const String &b) { return String((a != nullptr ? a : "") + b.value_); }
+  friend String operator+(const String &a, char b) { return String(a.value_ + b); }
+
+  bool operator==(const String &other) const { return value_ == other.value_; }
+  bool operator==(const char *other) const { return other != nullptr && value_ == other; }
+  bool operator!=(const String &other) const { return value_ != other.value_; }
+  bool operator!=(const char *other) const { return !(*this == other); }
+  bool operator<(const String &other) const { return value_ < other.value_; }
+
+ private:
+  static int find_result(size_t pos) { return pos == std::string::npos ? -1 : static_cast<int>(pos); }
+
+  std::string value_;
+};
+
+class Print {
+ public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size) {
+    size_t written = 0;
+    while(written < size && write(buffer[written])) {
+      written++;
+    }
+    return written;
+  }
+  size_t write(const char *text) { return text != nullptr ? write(reinterpret_cast<const uint8_t *>(text), strlen(text)) : 0; }
+  size_t write(const char *buffer, size_t size) { return write(reinterpret_cast<const uint8_t *>(buffer), size); }
+  virtual void flush() {}
+
+  size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3))) {
+    char stack_buffer[256];
+    va_list args;
+    va_start(args, format);
+    const int needed = vsnprintf(stack_buffer, sizeof(stack_buffer), format, args);
+    va_end(args);
+    if(needed < 0) {
+      return 0;
+    }
+    if(static_cast<size_t>(needed) < sizeof(stack_buffer)) {
+      return write(reinterpret_cast<const uint8_t *>(stack_buffer), static_cast<size_t>(needed));
+    }
+    std::string heap_buffer(static_cast<size_t>(needed) + 1, '\0');
+    va_start(args, format);
+    vsnprintf(&heap_buffer[0], heap_buffer.size(), format, args);
+    va_end(args);
+    return write(reinterpret_cast<const uint8_t *>(heap_buffer.data()), static_cast<size_t>(needed));
+  }
+
+  size_t print(const char *text) { return write(text); }
+  size_t print(const String &text) { return write(text.c_str()); }
+  size_t print(char c) { return write(static_cast<uint8_t>(c)); }
+  size_t print(int value, int base = 10) { return print(static_cast<long>(value), base); }
+  size_t print(unsigned int value, int base = 10) { return print(static_cast<unsigned long>(value), base); }
+  size_t print(long value, int base = 10) { return base == 16 ? printf("%lx", value) : printf("%ld", value); }
+  size_t print(unsigned long value, int base = 10) { return base == 16 ? printf("%lx", value) : printf("%lu", value); }
+  size_t print(double value, int digits = 2) { return printf("%.*f", digits, value); }
+
+  size_t println() { return write("\r\n"); }
+  template <class T>
+  size_t println(const T &value) {
+    const size_t written = print(value);
+    return written + println();
+  }
+  template <class T>
+  size_t println(const T &value, int format) {
+    const size_t written = print(value, format);
+    return written + println();
+  }
+};
+
+class HardwareSerial : public Print {
+ public:
+  void begin(unsigned long baud) { (void)baud; }
+  void end() {}
+  int available() { return 0; }
+  int read() { return -1; }
+  int availableForWrite() { return 4096; }
+  void setTxBufferSize(size_t size) { (void)size; }
+  void setTxTimeoutMs(uint32_t timeout) { (void)timeout; }
+  operator bool() const { return true; }
+  using Print::write;
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  void flush() override;
+};
+
+extern HardwareSerial Serial;
+
+class EspClass {
+ public:
+  uint32_t getPsramSize();
+  uint32_t getFreePsram();
+  uint32_t getFreeHeap();
+  uint32_t getCpuFreqMHz();
+  [[noreturn]] void restart();
+};
+
+extern EspClass ESP;
@@ -0,0 +1,244 @@
+// Host stand-in for M5Cardputer/M5Unified. The display keeps a 240x135 RGB565
+// copy of everything streamed through setAddrWindow()/writePixelsDMA() so a
+// benchmark run can dump the last presented frame; text and shape drawing are
+// no-ops. The speaker consumes queued buffers in real time so audio pacing
+// and queue depth behave like the I2S DMA path.
+#pragma once
+
+#include "Arduino.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace m5 {
+enum class board_t { board_unknown, board_M5Cardputer, board_M5CardputerADV };
+enum class pin_name_t { sd_spi_sclk, sd_spi_miso, sd_spi_mosi, sd_spi_ss };
+}  // namespace m5
+
+struct speaker_config_t {
+  int pin_data_out = -1;
+  int pin_bck = -1;
+  int pin_ws = -1;
+  int pin_mck = -1;
+  uint32_t sample_rate = 48000;
+  bool stereo = false;
+  bool buzzer = false;
+  bool use_dac = false;
+  uint8_t dac_zero_level = 0;
+  uint8_t magnification = 16;
+  size_t dma_buf_len = 256;
+  size_t dma_buf_count = 8;
+  uint8_t task_priority = 2;
+  uint8_t task_pinned_core = 0;
+  int i2s_port = 0;
+};
+
+class SpeakerClass {
+ public:
+  static constexpr int CHANNELS = 8;
+
+  speaker_config_t config() const { return config_; }
+  void config(const speaker_config_t &cfg) { config_ = cfg; }
+  bool begin();
+  void end();
+  bool isEnabled() const { return true; }
+  bool isRunning() const { return running_; }
+  size_t isPlaying(int channel = -1) const;
+  void setVolume(uint8_t volume) { volume_ = volume; }
+  void setAllChannelVolume(uint8_t volume) { (void)volume; }
+  void setChannelVolume(uint8_t channel, uint8_t volume) { (void)channel; (void)volume; }
+  void stop();
+  void stop(uint8_t channel);
+  bool playRaw(const int16_t *data, size_t len, uint32_t rate, bool stereo = false, uint32_t repeat = 1,
+               int channel = -1, bool stop_current = false);
+  bool playRaw(const uint8_t *data, size_t len, uint32_t rate, bool stereo = false, uint32_t repeat = 1,
+               int channel = -1, bool stop_current = false);
+
+  // Samples accepted since begin(), summed over all channels.
+  uint64_t samplesQueued() const { return samples_queued_; }
+  // Buffers queued after their channel had run dry (audible gaps), since
+  // begin(); stop() ends a channel's run without counting one.
+  uint64_t gaps() const { return gaps_; }
+
+ private:
+  bool queue(size_t frames, uint32_t rate, int channel, bool stop_current);
+
+  speaker_config_t config_;
+  bool running_ = false;
+  uint8_t volume_ = 0;
+  // Host time (us) at which the last queued buffer on each channel finishes,
+  // and when the one before it does; two buffers per channel may be queued.
+  uint64_t busy_until_us_[CHANNELS] = {};
+  uint64_t prev_until_us_[CHANNELS] = {};
+  uint64_t samples_queued_ = 0;
+  uint64_t gaps_ = 0;
+};
+
+class DisplayClass : public Print {
+ public:
+  static constexpr int PANEL_W = 240;
+  static constexpr int PANEL_H = 135;
+
+  DisplayClass() : panel_(PANEL_W * PANEL_H, 0) {}
+
+  size_t write(uint8_t c) override {
+    (void)c;
+    return 1;
+  }
+  using Print::write;
+
+  void setAddrWindow(int32_t x, int32_t y, int32_t w, int32_t h) {
+    win_x_ = x;
+    win_y_ = y;
+    win_w_ = w > 0 ? w : 0;
+    win_h_ = h > 0 ? h : 0;
+    win_pos_ = 0;
+  }
+  void writePixelsDMA(const uint16_t *data, uint32_t len, bool swap = true) { writePixels(data, len, swap); }
+  void writePixels(const uint16_t *data, uint32_t len, bool swap = true);
+  bool dmaBusy() { return false; }
+  void waitDMA() {}
+  void startWrite() {}
+  void endWrite() {}
+  void initDMA() {}
+
+  void clearDisplay(uint32_t color = 0) { fillScreen(color); }
+  void fillScreen(uint32_t color) { fillRect(0, 0, PANEL_W, PANEL_H, color); }
+  void fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color);
+  template <class... A> void drawRect(A...) {}
+  template <class... A> void fillRoundRect(A...) {}
+  template <class... A> void drawRoundRect(A...) {}
+  template <class... A> void drawLine(A...) {}
+  template <class... A> void drawFastHLine(A...) {}
+  template <class... A> void drawFastVLine(A...) {}
+  template <class... A> void drawPixel(A...) {}
+  template <class... A> void drawCircle(A...) {}
+  template <class... A> void fillCircle(A...) {}
+  template <class... A> bool drawJpgFile(A...) { return false; }
+  template <class... A> bool drawPngFile(A...) { return false; }
+  template <class... A> int drawString(A...) { return 0; }
+  template <class... A> void setCursor(A...) {}
+  template <class... A> void setTextColor(A...) {}
+  void setTextFont(int font) { (void)font; }
+  void setTextSize(float size) { (void)size; }
+  void setTextSize(float sx, float sy) { (void)sx; (void)sy; }
+  void setTextWrap(bool wrap_x, bool wrap_y = false) { (void)wrap_x; (void)wrap_y; }
+  void setRotation(int rotation) { (void)rotation; }
+  void setBrightness(uint8_t brightness) { (void)brightness; }
+  uint8_t getBrightness() { return 0; }
+  void sleep() {}
+  void wakeup() {}
+  template <class T> int textWidth(T text) {
+    (void)text;
+    return 0;
+  }
+  int fontHeight() { return 8; }
+  int width() { return PANEL_W; }
+  int height() { return PANEL_H; }
+  static uint16_t color565(uint8_t r, uint8_t g, uint8_t b) {
+    return static_cast<uint16_t>(((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3));
+  }
+  uint16_t color(uint8_t r, uint8_t g, uint8_t b) { return color565(r, g, b); }
+
+  // Panel contents as RGB565, row-major.
+  const uint16_t *panel() const { return panel_.data(); }
+  // Pixels written or filled since boot, counting ones clipped off the panel.
+  uint64_t pixelsWritten() const { return pixels_written_; }
+
+ private:
+  std::vector<uint16_t> panel_;
+  int32_t win_x_ = 0;
+  int32_t win_y_ = 0;
+  int32_t win_w_ = 0;
+  int32_t win_h_ = 0;
+  uint32_t win_pos_ = 0;
+  uint64_t pixels_written_ = 0;
+};
+
+class M5Canvas : public DisplayClass {
+ public:
+  explicit M5Canvas(DisplayClass *parent = nullptr) { (void)parent; }
+  void setColorDepth(int depth) { (void)depth; }
+  void *createSprite(int32_t w, int32_t h) {
+    sprite_.assign(static_cast<size_t>(w > 0 ? w : 0) * (h > 0 ? h : 0), 0);
+    return sprite_.empty() ? nullptr : sprite_.data();
+  }
+  void deleteSprite() { sprite_.clear(); }
+  template <class... A> void fillSprite(A...) {}
+  uint16_t readPixel(int32_t x, int32_t y) {
+    (void)x;
+    (void)y;
+    return 0;
+  }
+
+ private:
+  std::vector<uint16_t> sprite_;
+};
+
+class Keyboard_Class {
+ public:
+  struct KeysState {
+    std::vector<char> word;
+    std::vector<uint8_t> hid_keys;
+    std::vector<uint8_t> modifier_keys;
+    bool tab = false;
+    bool fn = false;
+    bool shift = false;
+    bool ctrl = false;
+    bool opt = false;
+    bool alt = false;
+    bool del = false;
+    bool enter = false;
+    bool space = false;
+    uint8_t modifiers = 0;
+  };
+
+  bool isPressed() { return false; }
+  bool isChange() { return false; }
+  template <class T> bool isKeyPressed(T key) {
+    (void)key;
+    return false;
+  }
+  KeysState keysState() { return KeysState(); }
+};
+
+class M5CardputerClass {
+ public:
+  DisplayClass Display;
+  Keyboard_Class Keyboard;
+  SpeakerClass Speaker;
+
+  template <class... A> void begin(A...) {}
+  void update() {}
+};
+
+extern M5CardputerClass M5Cardputer;
+
+struct M5Config {
+  bool internal_spk = true;
+  bool internal_mic = true;
+  bool internal_imu = true;
+  bool internal_rtc = true;
+  bool output_power = true;
+  bool clear_display = true;
+  m5::board_t fallback_board = m5::board_t::board_unknown;
+  int serial_baudrate = 115200;
+};
+
+class M5LcdClass : public DisplayClass {
+ public:
+  template <class... A> void qrcode(A...) {}
+};
+
+class M5UnifiedClass {
+ public:
+  M5LcdClass Lcd;
+  M5Config config() { return M5Config(); }
+  m5::board_t getBoard() { return m5::board_t::board_M5Cardputer; }
+  int getPin(m5::pin_name_t pin) {
+    (void)pin;
+    return -1;
+  }
+};
+
+extern M5UnifiedClass M5;
@@ -0,0 +1,98 @@
+// Host stand-in for the Arduino SD library. Paths are resolved under a host
+// directory (see native_sd_root()), so ROMs, saves and settings written by a
+// benchmark run land in ordinary files.
+#pragma once
+
+#include "Arduino.h"
+
+#include <cstdio>
+#include <memory>
+#include <string>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+}  // namespace fs
+using fs::SeekCur;
+using fs::SeekEnd;
+using fs::SeekSet;
+
+// Host directory standing in for the card's root. Set by the benchmark
+// driver before setup() runs.
+const char *native_sd_root();
+void native_set_sd_root(const char *path);
+
+class File : public Print {
+ public:
+  File() {}
+
+  operator bool() const { return state_ != nullptr; }
+  int available();
+  void close() { state_.reset(); }
+  size_t size() const;
+  size_t position() const;
+  bool seek(uint32_t pos, fs::SeekMode mode = fs::SeekSet);
+  int read();
+  size_t read(uint8_t *buffer, size_t size);
+  int peek();
+  using Print::write;
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  void flush() override;
+  String readStringUntil(char terminator);
+  bool isDirectory() const;
+  File openNextFile(const char *mode = FILE_READ);
+  void rewindDirectory();
+  const char *name() const;
+  const char *path() const;
+
+ private:
+  friend class SDFS;
+  struct State;
+  std::shared_ptr<State> state_;
+};
+
+class SPIClass {
+ public:
+  explicit SPIClass(int bus = 0) { (void)bus; }
+  void begin(int8_t sck = -1, int8_t miso = -1, int8_t mosi = -1, int8_t ss = -1) {
+    (void)sck;
+    (void)miso;
+    (void)mosi;
+    (void)ss;
+  }
+  void end() {}
+};
+
+#define FSPI 0
+#define HSPI 1
+
+class SDFS {
+ public:
+  bool begin(uint8_t ss = 0, SPIClass &spi = default_spi_, uint32_t frequency = 4000000,
+             const char *mountpoint = "/sd", uint8_t max_files = 5, bool format_if_empty = false);
+  void end() {}
+  File open(const char *path, const char *mode = FILE_READ, bool create = false);
+  File open(const String &path, const char *mode = FILE_READ, bool create = false) {
+    return open(path.c_str(), mode, create);
+  }
+  bool exists(const char *path);
+  bool exists(const String &path) { return exists(path.c_str()); }
+  bool mkdir(const char *path);
+  bool mkdir(const String &path) { return mkdir(path.c_str()); }
+  bool remove(const char *path);
+  bool remove(const String &path) { return remove(path.c_str()); }
+  bool rename(const char *from, const char *to);
+  bool rmdir(const char *path);
+  uint64_t cardSize() { return 0; }
+  uint64_t totalBytes() { return 0; }
+  uint64_t usedBytes() { return 0; }
+
+ private:
+  static SPIClass default_spi_;
+};
+
+extern SDFS SD;
@@ -0,0 +1,10 @@
+// Host stand-in for <esp32-hal-cpu.h>. Frequency changes are recorded but
+// have no effect on host speed.
+#pragma once
+
+#include <cstdint>
+
+bool setCpuFrequencyMhz(uint32_t mhz);
+uint32_t getCpuFrequencyMhz();
+uint32_t getXtalFrequencyMhz();
+uint32_t getApbFrequency();
@@ -0,0 +1,4 @@
+// Host stand-in for <esp32-hal-psram.h>; see psramInit() in Arduino.h.
+#pragma once
+
+#include "Arduino.h"
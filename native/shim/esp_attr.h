@@ -0,0 +1,4 @@
+// Host stand-in for <esp_attr.h>.
+#pragma once
+
+#include "Arduino.h"
@@ -0,0 +1,12 @@
+// Host stand-in for <esp_cpu.h>: the cycle counter counts nanoseconds of a
+// nominal 240 MHz core.
+#pragma once
+
+#include <cstdint>
+
+uint32_t esp_cpu_get_cycle_count();
+static inline uint32_t esp_cpu_get_ccount() { return esp_cpu_get_cycle_count(); }
+
+// Host only: shifts the counter so it reads `cycles` now. Tests use it to
+// cross the 32-bit wrap without waiting ~18 s for it.
+void native_set_cycle_count(uint32_t cycles);
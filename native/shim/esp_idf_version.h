@@ -0,0 +1,5 @@
+// Host stand-in for <esp_idf_version.h>; reports the IDF the firmware targets.
+#pragma once
+
+#define ESP_IDF_VERSION_VAL(major, minor, patch) (((major) << 16) | ((minor) << 8) | (patch))
+#define ESP_IDF_VERSION ESP_IDF_VERSION_VAL(4, 4, 7)
@@ -0,0 +1,13 @@
+// Host stand-in for <esp_pm.h>. CONFIG_PM_ENABLE is not defined, so the
+// firmware skips power-management setup on the host.
+#pragma once
+
+#include "esp_err.h"
+
+typedef struct {
+  int max_freq_mhz;
+  int min_freq_mhz;
+  bool light_sleep_enable;
+} esp_pm_config_t;
+
+esp_err_t esp_pm_configure(const void *config);
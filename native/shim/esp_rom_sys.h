@@ -0,0 +1,6 @@
+// Host stand-in for <esp_rom_sys.h>.
+#pragma once
+
+#include <cstdint>
+
+void esp_rom_delay_us(uint32_t us);
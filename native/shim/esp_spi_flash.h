@@ -0,0 +1,14 @@
+// Host stand-in for <esp_spi_flash.h>.
+#pragma once
+
+#include <cstdint>
+
+#include "esp_partition.h"
+
+#define SPI_FLASH_SEC_SIZE 4096
+#define SPI_FLASH_MMU_PAGE_SIZE 0x10000
+#define SPI_FLASH_MMAP_DATA ESP_PARTITION_MMAP_DATA
+
+typedef uint32_t spi_flash_mmap_handle_t;
+
+void spi_flash_munmap(spi_flash_mmap_handle_t handle);
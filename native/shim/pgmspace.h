@@ -0,0 +1,10 @@
+// Host stand-in for <pgmspace.h>: program memory is ordinary memory.
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#define pgm_read_byte(addr) (*reinterpret_cast<const uint8_t *>(addr))
+#define pgm_read_word(addr) (*reinterpret_cast<const uint16_t *>(addr))
+#define pgm_read_dword(addr) (*reinterpret_cast<const uint32_t *>(addr))
+#define memcpy_P memcpy
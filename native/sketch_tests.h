@@ -0,0 +1,790 @@
+// Tests of firmware internals for `program --test NAME` (native/native_main.cpp).
+// Included by gb_cardputer_native.cpp after the sketch, so the tests call its
+// static functions and read its state directly. `pio run -e native_test`
+// builds the program with every feature the tests cover enabled.
+//
+//   trace  ENABLE_TRACE_PROBES: nesting, per-core rings and task names, writers
+//          racing on one core, ring wrap, the 32-bit cycle counter wrap and
+//          the Chrome trace-event JSON the dump produces. Runs without a ROM.
+//   wav    ENABLE_AUDIO_CAPTURE: records about 30 s of the ROM's audio with
+//          the Fn+W toggle and walks the finished file's chunks; the RIFF and
+//          data sizes must match the samples the capture committed.
+//   audio-only  ENABLE_AUDIO_ONLY: enters and leaves the mode with the Fn+B
+//          toggle; renderTask must be suspended and the panel untouched in
+//          it, rendering must come back after it, and the speaker must be
+//          fed throughout with no underrun or gap.
+//   movie  records a power-on input movie, scribbles over the cartridge RAM
+//          and replays it; the replay must restore the RAM the recording
+//          started with and match every frame hash, and must refuse to start
+//          once the saved start has been altered. Needs a ROM with cart RAM.
+#pragma once
+
+#include <cstdarg>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static bool g_test_ok = true;
+
+static void test_expect(bool condition, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+// Records a failed check and says which; the test carries on so one run
+// reports every broken property.
+static void test_expect(bool condition, const char *format, ...) {
+  if(condition) {
+    return;
+  }
+  g_test_ok = false;
+  char message[256];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(message, sizeof(message), format, args);
+  va_end(args);
+  printf("[TEST] FAIL: %s\n", message);
+}
+
+static NativeTestResult test_verdict() {
+  return g_test_ok ? NATIVE_TEST_PASSED : NATIVE_TEST_FAILED;
+}
+
+#if ENABLE_TRACE_PROBES
+// Collects what trace_dump writes.
+class TraceTestCapture : public Print {
+ public:
+  size_t write(uint8_t c) override {
+    text.push_back(static_cast<char>(c));
+    return 1;
+  }
+  size_t write(const uint8_t *buffer, size_t size) override {
+    text.append(reinterpret_cast<const char *>(buffer), size);
+    writes++;
+    return size;
+  }
+  using Print::write;
+
+  std::string text;
+  size_t writes = 0;
+};
+
+struct TraceTestEvent {
+  std::string name;
+  char phase;
+  double ts;
+  unsigned pid;
+  unsigned tid;
+};
+
+struct TraceTestDump {
+  size_t written = 0;
+  size_t writes = 0;
+  std::vector<TraceTestEvent> events;
+  std::vector<std::string> processes;           // indexed by pid
+  std::vector<std::pair<unsigned, std::string>> threads;  // (tid, name)
+};
+
+// Dumps the rings and parses the JSON back, checking that every line is one
+// of the three shapes trace_dump writes.
+static TraceTestDump trace_test_dump(const char *label) {
+  TraceTestCapture capture;
+  TraceTestDump dump;
+  dump.written = trace_dump(capture);
+  dump.writes = capture.writes;
+
+  const std::string &json = capture.text;
+  static const char kHead[] = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  static const char kTail[] = "\n]}\n";
+  const size_t head = sizeof(kHead) - 1;
+  const size_t tail = sizeof(kTail) - 1;
+  if(json.size() < head + tail || json.compare(0, head, kHead) != 0 ||
+     json.compare(json.size() - tail, tail, kTail) != 0) {
+    test_expect(false, "%s: dump is not a trace-event JSON object", label);
+    return dump;
+  }
+
+  const std::string body = json.substr(head, json.size() - head - tail);
+  size_t start = 0;
+  while(start < body.size()) {
+    size_t end = body.find(",\n", start);
+    if(end == std::string::npos) {
+      end = body.size();
+    }
+    const std::string item = body.substr(start, end - start);
+    start = end + 2;
+
+    char name[64] = {0};
+    char phase = 0;
+    unsigned pid = 0;
+    unsigned tid = 0;
+    double ts = 0.0;
+    char arg[64] = {0};
+    int used = 0;
+    if(sscanf(item.c_str(), "{\"name\":\"%63[^\"]\",\"ph\":\"%c\"", name, &phase) != 2) {
+      test_expect(false, "%s: unparsable event '%s'", label, item.c_str());
+      continue;
+    }
+    if(phase == 'M' && strcmp(name, "process_name") == 0 &&
+       sscanf(item.c_str(), "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"args\":{\"name\":\"%63[^\"]\"}}%n",
+              &pid, arg, &used) == 2 && static_cast<size_t>(used) == item.size()) {
+      if(dump.processes.size() <= pid) {
+        dump.processes.resize(pid + 1);
+      }
+      dump.processes[pid] = arg;
+    } else if(phase == 'M' && strcmp(name, "thread_name") == 0 &&
+              sscanf(item.c_str(),
+                     "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"%63[^\"]\"}}%n",
+                     &pid, &tid, arg, &used) == 3 && static_cast<size_t>(used) == item.size()) {
+      dump.threads.emplace_back(tid, arg);
+    } else if((phase == 'B' || phase == 'E') &&
+              sscanf(item.c_str(), "{\"name\":\"%*[^\"]\",\"ph\":\"%*c\",\"ts\":%lf,\"pid\":%u,\"tid\":%u}%n",
+                     &ts, &pid, &tid, &used) == 3 && static_cast<size_t>(used) == item.size()) {
+      dump.events.push_back({name, phase, ts, pid, tid});
+    } else {
+      test_expect(false, "%s: malformed event '%s'", label, item.c_str());
+    }
+  }
+  test_expect(dump.events.size() == dump.written, "%s: %zu events in the JSON, trace_dump reported %zu", label,
+              dump.events.size(), dump.written);
+  return dump;
+}
+
+static const char *trace_test_thread_name(const TraceTestDump &dump, unsigned tid) {
+  for(const auto &thread : dump.threads) {
+    if(thread.first == tid) {
+      return thread.second.c_str();
+    }
+  }
+  return "";
+}
+
+// Each thread's events must alternate begin/end of `name`, with timestamps
+// that never go backwards and spans of at least `min_span_us`. Returns the
+// number of events checked.
+static size_t trace_test_check_spans(const TraceTestDump &dump, unsigned pid, unsigned tid, const char *name,
+                                     double min_span_us, const char *label) {
+  size_t count = 0;
+  double last_ts = 0.0;
+  double begin_ts = 0.0;
+  bool open = false;
+  bool ordered = true;
+  bool paired = true;
+  double shortest = 1e300;
+  for(const TraceTestEvent &event : dump.events) {
+    if(event.pid != pid || event.tid != tid) {
+      continue;
+    }
+    ordered = ordered && (count == 0 || event.ts >= last_ts);
+    paired = paired && event.name == name && (event.phase == 'B') != open;
+    if(event.phase == 'B') {
+      begin_ts = event.ts;
+    } else if(event.ts - begin_ts < shortest) {
+      shortest = event.ts - begin_ts;
+    }
+    open = event.phase == 'B';
+    last_ts = event.ts;
+    count++;
+  }
+  test_expect(ordered, "%s: timestamps on core %u thread %u go backwards", label, pid, tid);
+  test_expect(paired && !open, "%s: %s events on core %u thread %u do not pair up", label, name, pid, tid);
+  test_expect(count == 0 || shortest >= min_span_us, "%s: shortest %s span %.3f us, expected at least %.1f us",
+              label, name, shortest, min_span_us);
+  return count;
+}
+
+static void trace_test_spin_us(uint64_t us) {
+  const uint64_t until = micros64() + us;
+  while(micros64() < until) {
+  }
+}
+
+struct TraceTestWorker {
+  TraceProbeId probe;
+  uint32_t scopes;
+  uint32_t span_us;
+  SemaphoreHandle_t done;
+};
+
+static void trace_test_worker(void *param) {
+  TraceTestWorker *worker = static_cast<TraceTestWorker *>(param);
+  for(uint32_t i = 0; i < worker->scopes; ++i) {
+    TRACE_SCOPE(worker->probe);
+    trace_test_spin_us(worker->span_us);
+    if((i & 7) == 7) {
+      vTaskDelay(0);  // let a worker on the same core interleave with this one
+    }
+  }
+  xSemaphoreGive(worker->done);
+  vTaskDelete(nullptr);
+}
+
+static NativeTestResult trace_test_run() {
+  trace_init();
+  const uint32_t capacity = g_trace_rings[0].mask + 1;
+  test_expect(g_trace_enabled.load() && capacity >= 2 * TRACE_ANCHOR_BLOCK && (capacity & (capacity - 1)) == 0,
+              "rings were not set up (capacity %u)", static_cast<unsigned>(capacity));
+  if(!g_test_ok) {
+    return test_verdict();
+  }
+  const unsigned loop_core = static_cast<unsigned>(xPortGetCoreID());
+
+  // Nested scopes on the loop task: the JSON must keep their order and
+  // nesting and measure each span.
+  {
+    const uint64_t start_us = micros64();
+    {
+      TRACE_SCOPE(TRACE_PROBE_RUN_FRAME);
+      for(int line = 0; line < 3; ++line) {
+        TRACE_SCOPE(TRACE_PROBE_LCD_DRAW_LINE);
+        trace_test_spin_us(20);
+      }
+      TRACE_SCOPE(TRACE_PROBE_AUDIO_PUMP);
+    }
+    const uint64_t end_us = micros64();
+    const TraceTestDump dump = trace_test_dump("nesting");
+    static const char *const kExpected[] = {"gb_run_frame",  "lcd_draw_line", "lcd_draw_line", "lcd_draw_line",
+                                            "lcd_draw_line", "lcd_draw_line", "lcd_draw_line", "audioPump",
+                                            "audioPump",     "gb_run_frame"};
+    static const char kPhases[] = "BBEBEBEBEE";
+    bool sequence_ok = dump.events.size() == 10;
+    for(size_t i = 0; sequence_ok && i < dump.events.size(); ++i) {
+      const TraceTestEvent &event = dump.events[i];
+      sequence_ok = event.name == kExpected[i] && event.phase == kPhases[i] && event.pid == loop_core &&
+                    event.tid == dump.events[0].tid && (i == 0 || event.ts >= dump.events[i - 1].ts) &&
+                    event.ts >= static_cast<double>(start_us) - 1.0 && event.ts <= static_cast<double>(end_us) + 1.0;
+    }
+    test_expect(sequence_ok, "nesting: expected 10 nested events on core %u within the scope's wall time, got %zu",
+                loop_core, dump.events.size());
+    if(sequence_ok) {
+      for(size_t i = 1; i <= 5; i += 2) {
+        const double span = dump.events[i + 1].ts - dump.events[i].ts;
+        test_expect(span >= 19.0 && span < 20000.0, "nesting: lcd_draw_line span %.3f us for a 20 us scope", span);
+      }
+      test_expect(strcmp(trace_test_thread_name(dump, dump.events[0].tid), "loopTask") == 0,
+                  "nesting: thread named '%s', expected loopTask", trace_test_thread_name(dump, dump.events[0].tid));
+    }
+    test_expect(dump.processes.size() == portNUM_PROCESSORS && dump.processes[0] == "core0" &&
+                    dump.processes[portNUM_PROCESSORS - 1] == "core" + std::to_string(portNUM_PROCESSORS - 1),
+                "nesting: expected one process per core");
+    test_expect(dump.writes < dump.events.size(), "nesting: %zu writes for %zu events; output is not batched",
+                dump.writes, dump.events.size());
+  }
+
+  // A dump empties the rings; probes pause while the dump runs and resume
+  // after it, and nothing is recorded while they are off.
+  {
+    const TraceTestDump empty = trace_test_dump("after dump");
+    test_expect(empty.written == 0, "after dump: %zu events left in the rings", empty.written);
+    g_trace_enabled.store(false);
+    {
+      TRACE_SCOPE(TRACE_PROBE_RUN_FRAME);
+    }
+    g_trace_enabled.store(true);
+    const TraceTestDump disabled = trace_test_dump("disabled");
+    test_expect(disabled.written == 0, "disabled: %zu events recorded while probes were off", disabled.written);
+    {
+      TRACE_SCOPE(TRACE_PROBE_RUN_FRAME);
+    }
+    const TraceTestDump resumed = trace_test_dump("resumed");
+    test_expect(resumed.written == 2, "resumed: %zu events after the dump, expected 2", resumed.written);
+  }
+
+  // One worker on each core next to the loop task: every core gets its own
+  // process, every task its own named thread, and all timestamps land inside
+  // the run's wall time, so the cores share one timeline.
+  {
+    static constexpr uint32_t kScopes = 64;
+    SemaphoreHandle_t done = xSemaphoreCreateCounting(portNUM_PROCESSORS, 0);
+    TraceTestWorker workers[portNUM_PROCESSORS];
+    const uint64_t start_us = micros64();
+    for(unsigned core = 0; core < portNUM_PROCESSORS; ++core) {
+      workers[core] = {TRACE_PROBE_ROM_FILL_BANK, kScopes, 10, done};
+      char name[16];
+      snprintf(name, sizeof(name), "TraceCore%u", core);
+      xTaskCreatePinnedToCore(trace_test_worker, name, 4096, &workers[core], 1, nullptr, core);
+    }
+    for(uint32_t i = 0; i < kScopes; ++i) {
+      TRACE_SCOPE(TRACE_PROBE_FIT_FRAME);
+      trace_test_spin_us(10);
+    }
+    for(unsigned core = 0; core < portNUM_PROCESSORS; ++core) {
+      xSemaphoreTake(done, portMAX_DELAY);
+    }
+    const uint64_t end_us = micros64();
+    vSemaphoreDelete(done);
+
+    const TraceTestDump dump = trace_test_dump("cores");
+    test_expect(dump.written == (portNUM_PROCESSORS + 1) * kScopes * 2, "cores: %zu events, expected %u",
+                dump.written, static_cast<unsigned>((portNUM_PROCESSORS + 1) * kScopes * 2));
+    bool in_window = true;
+    for(const TraceTestEvent &event : dump.events) {
+      in_window = in_window && event.ts >= static_cast<double>(start_us) - 1.0 &&
+                  event.ts <= static_cast<double>(end_us) + 1.0;
+    }
+    test_expect(in_window, "cores: timestamps outside the %llu..%llu us the run took",
+                static_cast<unsigned long long>(start_us), static_cast<unsigned long long>(end_us));
+    for(const auto &thread : dump.threads) {
+      const std::string &name = thread.second;
+      unsigned pid = portNUM_PROCESSORS;
+      for(const TraceTestEvent &event : dump.events) {
+        if(event.tid == thread.first) {
+          pid = event.pid;
+          break;
+        }
+      }
+      const bool worker = name.compare(0, 9, "TraceCore") == 0;
+      test_expect(worker ? name == "TraceCore" + std::to_string(pid) : (name == "loopTask" && pid == loop_core),
+                  "cores: thread '%s' recorded on core %u", name.c_str(), pid);
+      const size_t count = trace_test_check_spans(dump, pid, thread.first,
+                                                  worker ? "rom_cache_fill_bank" : "fit_frame_rows", 9.0, "cores");
+      test_expect(count == kScopes * 2, "cores: thread '%s' has %zu events, expected %u", name.c_str(), count,
+                  static_cast<unsigned>(kScopes * 2));
+    }
+    test_expect(dump.threads.size() == portNUM_PROCESSORS + 1, "cores: %zu named threads, expected %u",
+                dump.threads.size(), static_cast<unsigned>(portNUM_PROCESSORS + 1));
+  }
+
+  // Two tasks sharing core 0's ring, yielding to each other mid-stream:
+  // reserving slots with fetch_add must not lose or mix up any event.
+  {
+    static constexpr uint32_t kScopes = 128;
+    SemaphoreHandle_t done = xSemaphoreCreateCounting(2, 0);
+    TraceTestWorker workers[2] = {{TRACE_PROBE_AUDIO_PUMP, kScopes, 2, done},
+                                  {TRACE_PROBE_SAVE_CART_RAM, kScopes, 2, done}};
+    xTaskCreatePinnedToCore(trace_test_worker, "TraceShareA", 4096, &workers[0], 1, nullptr, 0);
+    xTaskCreatePinnedToCore(trace_test_worker, "TraceShareB", 4096, &workers[1], 1, nullptr, 0);
+    xSemaphoreTake(done, portMAX_DELAY);
+    xSemaphoreTake(done, portMAX_DELAY);
+    vSemaphoreDelete(done);
+
+    const TraceTestDump dump = trace_test_dump("shared core");
+    test_expect(dump.written == 4 * kScopes, "shared core: %zu events, expected %u", dump.written,
+                static_cast<unsigned>(4 * kScopes));
+    for(const auto &thread : dump.threads) {
+      const bool a = thread.second == "TraceShareA";
+      test_expect(a || thread.second == "TraceShareB", "shared core: unexpected thread '%s'", thread.second.c_str());
+      const size_t count =
+          trace_test_check_spans(dump, 0, thread.first, a ? "audioPump" : "save_cart_ram_to_sd", 1.0, "shared core");
+      test_expect(count == 2 * kScopes, "shared core: thread '%s' has %zu events, expected %u",
+                  thread.second.c_str(), count, static_cast<unsigned>(2 * kScopes));
+    }
+  }
+
+  // One and a half times the ring's capacity: the dump keeps the newest
+  // events, less the oldest anchor block, which the wrap has partly
+  // overwritten. Spans of next to nothing cross many anchor blocks, and no
+  // block boundary may step time back.
+  {
+    for(uint32_t i = 0; i < capacity * 3 / 2; ++i) {
+      TRACE_SCOPE(TRACE_PROBE_LCD_DRAW_LINE);
+    }
+    const TraceTestDump dump = trace_test_dump("ring wrap");
+    test_expect(dump.written == capacity - TRACE_ANCHOR_BLOCK, "ring wrap: %zu events kept, expected %u",
+                dump.written, static_cast<unsigned>(capacity - TRACE_ANCHOR_BLOCK));
+    if(!dump.events.empty()) {
+      trace_test_check_spans(dump, loop_core, dump.events[0].tid, "lcd_draw_line", 0.0, "ring wrap");
+    }
+  }
+
+  // The 32-bit cycle counter wraps every ~18 s at 240 MHz. Scopes across the
+  // wrap must still convert to steady timestamps against their anchor.
+  {
+    static constexpr uint32_t kScopes = 40;
+    static constexpr uint32_t kSpanUs = 50;
+    native_set_cycle_count(0u - 240u * kSpanUs * kScopes / 2);
+    const uint32_t before = esp_cpu_get_cycle_count();
+    const uint64_t start_us = micros64();
+    for(uint32_t i = 0; i < kScopes; ++i) {
+      TRACE_SCOPE(TRACE_PROBE_RUN_FRAME);
+      trace_test_spin_us(kSpanUs);
+    }
+    const uint64_t end_us = micros64();
+    const uint32_t after = esp_cpu_get_cycle_count();
+    test_expect(after < before, "cycle wrap: counter went from %u to %u without wrapping",
+                static_cast<unsigned>(before), static_cast<unsigned>(after));
+    const TraceTestDump dump = trace_test_dump("cycle wrap");
+    test_expect(dump.written == 2 * kScopes, "cycle wrap: %zu events, expected %u", dump.written,
+                static_cast<unsigned>(2 * kScopes));
+    if(!dump.events.empty()) {
+      trace_test_check_spans(dump, loop_core, dump.events[0].tid, "gb_run_frame", kSpanUs - 1.0, "cycle wrap");
+      test_expect(dump.events.front().ts >= static_cast<double>(start_us) - 1.0 &&
+                      dump.events.back().ts <= static_cast<double>(end_us) + 1.0,
+                  "cycle wrap: events span %.1f..%.1f us, the run %llu..%llu us", dump.events.front().ts,
+                  dump.events.back().ts, static_cast<unsigned long long>(start_us),
+                  static_cast<unsigned long long>(end_us));
+    }
+  }
+  return test_verdict();
+}
+#endif
+
+#if ENABLE_AUDIO_CAPTURE
+static constexpr uint32_t WAV_TEST_WARMUP_FRAMES = 30;
+static constexpr uint32_t WAV_TEST_SAVE_TIMEOUT_FRAMES = 600;
+
+struct WavTestState {
+  int stage = 0;
+  uint32_t stage_frame = 0;
+  uint32_t record_frames = 0;
+};
+
+static WavTestState g_wav_test;
+
+// Walks the chunks of the finished file: RIFF size, fmt, the header's JUNK
+// padding, data at the second sector with exactly the samples the capture
+// committed, and the trailing JUNK chunk ending at the end of the file.
+static void wav_test_check_file(uint32_t recorded_frames) {
+  const AudioCaptureState &cap = g_audio_capture;
+  const uint32_t frame_bytes = audio_samples_per_buffer() * sizeof(int16_t);
+  test_expect(cap.file_ok, "the writer reported a failed capture");
+  test_expect(cap.frames + cap.dropped_frames == recorded_frames,
+              "%u frames captured and %u dropped while %u frames ran", static_cast<unsigned>(cap.frames),
+              static_cast<unsigned>(cap.dropped_frames), static_cast<unsigned>(recorded_frames));
+
+  const std::string host_path = std::string(native_sd_root()) + cap.path;
+  FILE *file = fopen(host_path.c_str(), "rb");
+  test_expect(file != nullptr, "cannot open %s", host_path.c_str());
+  if(file == nullptr) {
+    return;
+  }
+  fseek(file, 0, SEEK_END);
+  const long file_size = ftell(file);
+  WavCaptureHeader header = {};
+  fseek(file, 0, SEEK_SET);
+  const bool header_read = fread(&header, sizeof(header), 1, file) == 1;
+  test_expect(header_read, "file is %ld bytes, shorter than its header", file_size);
+  test_expect(file_size == static_cast<long>(cap.file_bytes) &&
+                  cap.file_bytes > AUDIO_CAPTURE_PREALLOC_BYTES,
+              "file is %ld bytes, the writer preallocated %u (expected more than one %u byte step)", file_size,
+              static_cast<unsigned>(cap.file_bytes), static_cast<unsigned>(AUDIO_CAPTURE_PREALLOC_BYTES));
+  if(!header_read) {
+    fclose(file);
+    return;
+  }
+
+  test_expect(memcmp(header.riff_id, "RIFF", 4) == 0 && memcmp(header.wave_id, "WAVE", 4) == 0,
+              "not a RIFF WAVE file");
+  test_expect(header.riff_size == static_cast<uint32_t>(file_size - 8), "RIFF size %u for a %ld byte file",
+              static_cast<unsigned>(header.riff_size), file_size);
+  test_expect(memcmp(header.fmt_id, "fmt ", 4) == 0 && header.fmt_size == 16 && header.format == 1 &&
+                  header.channels == 2 && header.bits_per_sample == 16 && header.block_align == 4,
+              "fmt chunk is not 16-bit stereo PCM");
+  test_expect(header.sample_rate == cap.sample_rate && header.byte_rate == cap.sample_rate * 4,
+              "fmt says %u Hz at %u bytes/s, the capture ran at %u Hz", static_cast<unsigned>(header.sample_rate),
+              static_cast<unsigned>(header.byte_rate), static_cast<unsigned>(cap.sample_rate));
+  test_expect(header.data_size == cap.frames * frame_bytes && header.data_size == cap.data_bytes,
+              "data chunk holds %u bytes; %u frames of %u bytes were captured and %u written",
+              static_cast<unsigned>(header.data_size), static_cast<unsigned>(cap.frames),
+              static_cast<unsigned>(frame_bytes), static_cast<unsigned>(cap.data_bytes));
+
+  // The chunk sizes alone must lead from the first chunk to the end of file.
+  static const char *const kChunks[] = {"fmt ", "JUNK", "data", "JUNK"};
+  long offset = 12;
+  size_t chunk = 0;
+  long data_offset = -1;
+  while(offset < file_size && chunk < 4) {
+    char id[4];
+    uint32_t size = 0;
+    fseek(file, offset, SEEK_SET);
+    if(fread(id, 4, 1, file) != 1 || fread(&size, 4, 1, file) != 1) {
+      break;
+    }
+    test_expect(memcmp(id, kChunks[chunk], 4) == 0, "chunk %zu at offset %ld is '%.4s', expected '%s'", chunk,
+                offset, id, kChunks[chunk]);
+    if(chunk == 2) {
+      data_offset = offset + 8;
+    }
+    offset += 8 + static_cast<long>(size) + (size & 1);
+    chunk++;
+  }
+  test_expect(chunk == 4 && offset == file_size, "%zu chunks end at offset %ld in a %ld byte file", chunk, offset,
+              file_size);
+  test_expect(data_offset == static_cast<long>(AUDIO_CAPTURE_SECTOR), "samples start at offset %ld, expected %u",
+              data_offset, static_cast<unsigned>(AUDIO_CAPTURE_SECTOR));
+  fclose(file);
+}
+
+// Records from the loaded ROM with Fn+W's toggle, then checks the file.
+static NativeTestResult wav_test_frame(uint32_t frame) {
+  WavTestState &state = g_wav_test;
+  AudioCaptureState &cap = g_audio_capture;
+  const uint32_t elapsed = frame - state.stage_frame;
+  switch(state.stage) {
+    case 0:
+      if(frame < WAV_TEST_WARMUP_FRAMES) {
+        return NATIVE_TEST_RUNNING;
+      }
+      test_expect(g_audio_sync.active, "audio is off, so nothing can be recorded");
+      // Record past the first preallocation step, so the trailing JUNK chunk
+      // and the RIFF size have to cover a grown file.
+      state.record_frames = AUDIO_CAPTURE_PREALLOC_BYTES / (audio_samples_per_buffer() * sizeof(int16_t)) + 600;
+      audio_capture_toggle();
+      test_expect(cap.mode.load() == static_cast<uint8_t>(AudioCaptureMode::Recording), "capture did not start");
+      if(!g_test_ok) {
+        return NATIVE_TEST_FAILED;
+      }
+      state.stage = 1;
+      state.stage_frame = frame;
+      return NATIVE_TEST_RUNNING;
+    case 1:
+      if(elapsed < state.record_frames) {
+        return NATIVE_TEST_RUNNING;
+      }
+      audio_capture_toggle();
+      state.stage = 2;
+      state.stage_frame = frame;
+      return NATIVE_TEST_RUNNING;
+    default:
+      if(cap.mode.load() != static_cast<uint8_t>(AudioCaptureMode::Idle)) {
+        test_expect(elapsed < WAV_TEST_SAVE_TIMEOUT_FRAMES, "capture still saving after %u frames",
+                    static_cast<unsigned>(elapsed));
+        return g_test_ok ? NATIVE_TEST_RUNNING : NATIVE_TEST_FAILED;
+      }
+      printf("[TEST] wav: %s, %u frames, %u bytes of samples in a %u byte file\n", cap.path,
+             static_cast<unsigned>(cap.frames), static_cast<unsigned>(cap.data_bytes),
+             static_cast<unsigned>(cap.file_bytes));
+      wav_test_check_file(state.record_frames);
+      return test_verdict();
+  }
+}
+#endif
+
+#if ENABLE_AUDIO_ONLY
+static constexpr uint32_t AUDIO_ONLY_TEST_WARMUP_FRAMES = 120;
+static constexpr uint32_t AUDIO_ONLY_TEST_FRAMES = 600;       // in the mode
+static constexpr uint32_t AUDIO_ONLY_TEST_AFTER_FRAMES = 120; // after leaving it
+
+struct AudioOnlyTestState {
+  int stage = 0;
+  uint32_t stage_frame = 0;
+  uint64_t stage_us = 0;
+  uint64_t pixels = 0;
+  uint64_t samples = 0;
+  uint64_t gaps = 0;
+  uint32_t glitches = 0;
+};
+
+static AudioOnlyTestState g_audio_only_test;
+
+// How many video frames' worth of audio the speaker was given less than
+// real time took since the stage began. Buffers queued before the stage
+// still play in it, so a steady feed stays within a few frames.
+static constexpr double AUDIO_ONLY_TEST_MAX_SHORTFALL_FRAMES = 4.0;
+
+static double audio_only_test_shortfall(const AudioOnlyTestState &state) {
+  const double wall_s = static_cast<double>(micros64() - state.stage_us) / 1e6;
+  const double queued = static_cast<double>(M5Cardputer.Speaker.samplesQueued() - state.samples);
+  return wall_s * VERTICAL_SYNC - queued / audio_samples_per_frame();
+}
+
+static void audio_only_test_mark(AudioOnlyTestState &state, int stage, uint32_t frame) {
+  state.stage = stage;
+  state.stage_frame = frame;
+  state.stage_us = micros64();
+  state.pixels = M5Cardputer.Display.pixelsWritten();
+  state.samples = M5Cardputer.Speaker.samplesQueued();
+}
+
+// Enters and leaves the mode through the Fn+B toggle. In the mode renderTask
+// must be suspended and the panel untouched while the speaker keeps playing;
+// after it, rendering must resume. No underrun, stall or speaker gap may
+// occur at any point.
+static NativeTestResult audio_only_test_frame(uint32_t frame) {
+  AudioOnlyTestState &state = g_audio_only_test;
+  const uint32_t elapsed = frame - state.stage_frame;
+  switch(state.stage) {
+    case 0:
+      if(frame == 1) {
+        audio_only_test_mark(state, 0, frame);
+      }
+      if(frame < AUDIO_ONLY_TEST_WARMUP_FRAMES) {
+        return NATIVE_TEST_RUNNING;
+      }
+      test_expect(audio_initialised && render_task_handle != nullptr,
+                  "needs audio and the render task (audio %d, render task %p)", audio_initialised ? 1 : 0,
+                  static_cast<void *>(render_task_handle));
+      test_expect(M5Cardputer.Display.pixelsWritten() > state.pixels, "nothing was drawn while warming up");
+      if(!g_test_ok) {
+        return NATIVE_TEST_FAILED;
+      }
+      state.gaps = M5Cardputer.Speaker.gaps();
+      state.glitches = audio_only_glitches();
+      audio_only_request_toggle();
+      state.stage = 1;
+      return NATIVE_TEST_RUNNING;
+    case 1:
+      // The toggle applies in the main loop iteration after the request.
+      test_expect(g_audio_only.active, "the mode did not start");
+      test_expect(eTaskGetState(render_task_handle) == eSuspended, "renderTask was not suspended");
+      if(!g_test_ok) {
+        return NATIVE_TEST_FAILED;
+      }
+      audio_only_test_mark(state, 2, frame);
+      return NATIVE_TEST_RUNNING;
+    case 2:
+      if(M5Cardputer.Display.pixelsWritten() != state.pixels) {
+        test_expect(false, "%llu pixels drawn %u frames into the mode",
+                    static_cast<unsigned long long>(M5Cardputer.Display.pixelsWritten() - state.pixels),
+                    static_cast<unsigned>(elapsed));
+        return NATIVE_TEST_FAILED;
+      }
+      if(elapsed < AUDIO_ONLY_TEST_FRAMES) {
+        return NATIVE_TEST_RUNNING;
+      }
+      {
+        const double shortfall = audio_only_test_shortfall(state);
+        printf("[TEST] audio-only: %u frames in %.2f s in the mode, speaker audio short by %.1f frames\n",
+               static_cast<unsigned>(elapsed), static_cast<double>(micros64() - state.stage_us) / 1e6, shortfall);
+        test_expect(shortfall <= AUDIO_ONLY_TEST_MAX_SHORTFALL_FRAMES,
+                    "the speaker got %.1f frames less audio than real time in the mode", shortfall);
+        test_expect(eTaskGetState(render_task_handle) == eSuspended, "renderTask resumed while in the mode");
+      }
+      audio_only_request_toggle();
+      state.stage = 3;
+      return NATIVE_TEST_RUNNING;
+    case 3:
+      test_expect(!g_audio_only.active, "the mode did not end");
+      test_expect(eTaskGetState(render_task_handle) != eSuspended, "renderTask was not resumed");
+      if(!g_test_ok) {
+        return NATIVE_TEST_FAILED;
+      }
+      audio_only_test_mark(state, 4, frame);
+      return NATIVE_TEST_RUNNING;
+    default:
+      if(elapsed < AUDIO_ONLY_TEST_AFTER_FRAMES) {
+        return NATIVE_TEST_RUNNING;
+      }
+      test_expect(M5Cardputer.Display.pixelsWritten() > state.pixels, "nothing drawn %u frames after the mode",
+                  static_cast<unsigned>(elapsed));
+      test_expect(audio_only_test_shortfall(state) <= AUDIO_ONLY_TEST_MAX_SHORTFALL_FRAMES,
+                  "the speaker got %.1f frames less audio than real time after the mode",
+                  audio_only_test_shortfall(state));
+      test_expect(audio_only_glitches() == state.glitches, "%u audio underruns or stalls",
+                  static_cast<unsigned>(audio_only_glitches() - state.glitches));
+      test_expect(M5Cardputer.Speaker.gaps() == state.gaps, "the speaker ran dry %llu times",
+                  static_cast<unsigned long long>(M5Cardputer.Speaker.gaps() - state.gaps));
+      return test_verdict();
+  }
+}
+#endif
+
+
+static constexpr uint32_t MOVIE_TEST_WARMUP_FRAMES = 30;
+static constexpr uint32_t MOVIE_TEST_RECORD_FRAMES = 240;
+
+struct MovieTestState {
+  int stage = 0;
+  uint32_t stage_frame = 0;
+};
+
+static MovieTestState g_movie_test;
+
+static void movie_test_fill_cart_ram(uint8_t seed) {
+  for(size_t i = 0; i < priv.cart_ram_size; ++i) {
+    priv.cart_ram[i] = static_cast<uint8_t>(seed + i * 7);
+  }
+}
+
+static bool movie_test_cart_ram_is(uint8_t seed) {
+  for(size_t i = 0; i < priv.cart_ram_size; ++i) {
+    if(priv.cart_ram[i] != static_cast<uint8_t>(seed + i * 7)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Flips one cartridge RAM byte in the saved start, leaving its size intact.
+static bool movie_test_alter_start_file() {
+  char path[MAX_PATH_LEN];
+  snprintf(path, sizeof(path), "%s.sav", g_movie.base_path);
+  File file = SD.open(path, FILE_READ);
+  std::vector<uint8_t> bytes(file ? file.size() : 0);
+  const bool read_ok = file && file.read(bytes.data(), bytes.size()) == static_cast<int>(bytes.size());
+  file.close();
+  const size_t offset = sizeof(MovieStartFileHeader) + sizeof(gb);
+  if(!read_ok || bytes.size() <= offset) {
+    return false;
+  }
+  bytes[offset] ^= 0x5A;
+  file = SD.open(path, FILE_WRITE);
+  const bool ok = file && file.write(bytes.data(), bytes.size()) == bytes.size();
+  file.close();
+  return ok;
+}
+
+// Records from power-on with one cartridge RAM image, replays with another
+// in place, then replays against an altered start file.
+static NativeTestResult movie_test_frame(uint32_t frame) {
+  MovieTestState &state = g_movie_test;
+  const uint32_t elapsed = frame - state.stage_frame;
+  switch(state.stage) {
+    case 0:
+      if(frame < MOVIE_TEST_WARMUP_FRAMES) {
+        return NATIVE_TEST_RUNNING;
+      }
+      test_expect(priv.cart_ram != nullptr && priv.cart_ram_size > 0, "the ROM has no cartridge RAM");
+      if(!g_test_ok) {
+        return NATIVE_TEST_FAILED;
+      }
+      movie_test_fill_cart_ram(0x11);
+      input_movie_start_recording();
+      test_expect(g_movie.mode == InputMovieMode::Recording, "recording did not start");
+      test_expect(g_movie.header.start_slot == INPUT_MOVIE_POWER_ON, "the movie does not start at power-on");
+      if(!g_test_ok) {
+        return NATIVE_TEST_FAILED;
+      }
+      state.stage = 1;
+      state.stage_frame = frame;
+      return NATIVE_TEST_RUNNING;
+    case 1:
+      if(elapsed < MOVIE_TEST_RECORD_FRAMES) {
+        return NATIVE_TEST_RUNNING;
+      }
+      input_movie_stop_recording();
+      movie_test_fill_cart_ram(0x22);
+      input_movie_start_replay();
+      test_expect(g_movie.mode == InputMovieMode::Replaying, "the replay did not start");
+      test_expect(movie_test_cart_ram_is(0x11), "the replay did not restore the recorded cartridge RAM");
+      if(!g_test_ok) {
+        return NATIVE_TEST_FAILED;
+      }
+      state.stage = 2;
+      state.stage_frame = frame;
+      return NATIVE_TEST_RUNNING;
+    default:
+      if(g_movie.mode == InputMovieMode::Replaying) {
+        test_expect(elapsed < MOVIE_TEST_RECORD_FRAMES * 2, "replay still running after %u frames",
+                    static_cast<unsigned>(elapsed));
+        return g_test_ok ? NATIVE_TEST_RUNNING : NATIVE_TEST_FAILED;
+      }
+      printf("[TEST] movie: replayed %u frames, %u of %u hashes differ\n", static_cast<unsigned>(g_movie.frame),
+             static_cast<unsigned>(g_movie.mismatches), static_cast<unsigned>(g_movie.reference_frames));
+      test_expect(g_movie.frame == g_movie.header.frames, "the replay stopped at frame %u of %u",
+                  static_cast<unsigned>(g_movie.frame), static_cast<unsigned>(g_movie.header.frames));
+      test_expect(g_movie.reference_frames > 0 && g_movie.mismatches == 0, "%u frame hashes differ",
+                  static_cast<unsigned>(g_movie.mismatches));
+
+      test_expect(movie_test_alter_start_file(), "cannot alter the saved start");
+      movie_test_fill_cart_ram(0x33);
+      input_movie_start_replay();
+      test_expect(g_movie.mode == InputMovieMode::Idle, "a replay started from an altered start file");
+      test_expect(movie_test_cart_ram_is(0x33), "a refused replay changed the cartridge RAM");
+      if(g_movie.mode != InputMovieMode::Idle) {
+        input_movie_stop_replay(false);
+      }
+      return test_verdict();
+  }
+}
+
+extern const NativeTest NATIVE_TESTS[] = {
+#if ENABLE_TRACE_PROBES
+  {"trace", trace_test_run, nullptr},
+#endif
+#if ENABLE_AUDIO_CAPTURE
+  {"wav", nullptr, wav_test_frame},
+#endif
+#if ENABLE_AUDIO_ONLY
+  {"audio-only", nullptr, audio_only_test_frame},
+#endif
+  {"movie", nullptr, movie_test_frame},
+  {nullptr, nullptr, nullptr}
+};
@@ -0,0 +1,78 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+usage() {
+    cat <<'EOF'
+Usage: scripts/apu_golden_check.sh [OPTIONS]
+
+Build the host APU benchmark (PlatformIO env apu_bench) and check its output for the
+synthetic register logs against the goldens committed in native/apu_bench/golden/.
+Every input is rendered at 44100 and 16384 Hz in the fast, native and high synthesis
+modes; the script exits non-zero if any second of output differs.
+
+Options:
+      --update          Rewrite the goldens instead of checking them (after an intended
+                        change to the APU output; review the diff before committing).
+      --bench <path>    Use an already built apu_bench binary; skip the PlatformIO build.
+  -h, --help            Show this help text and exit.
+
+Environment variables:
+  PIO_BIN   Override the PlatformIO executable to invoke (defaults to 'pio').
+EOF
+}
+
+if [[ -n "${PIO_BIN:-}" ]]; then
+    PIO_BIN="$PIO_BIN"
+else
+    if command -v pio >/dev/null 2>&1; then
+        PIO_BIN="$(command -v pio)"
+    elif [[ -x "$HOME/.platformio/penv/bin/platformio" ]]; then
+        PIO_BIN="$HOME/.platformio/penv/bin/platformio"
+    elif command -v platformio >/dev/null 2>&1; then
+        PIO_BIN="$(command -v platformio)"
+    else
+        PIO_BIN="pio"
+    fi
+fi
+
+ROOT="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+GOLDEN_DIR="$ROOT/native/apu_bench/golden"
+# Seeded random register traffic, 60 s each; needs no game ROM.
+GOLDEN_INPUTS=(synthetic:1 synthetic:2 synthetic:3 synthetic:4)
+MODE="--check-golden"
+BENCH=""
+
+while [[ $# -gt 0 ]]; do
+    case "$1" in
+        --update)
+            MODE="--write-golden"
+            shift
+            ;;
+        --bench)
+            [[ $# -ge 2 ]] || { echo "Error: missing value for $1" >&2; usage; exit 1; }
+            BENCH="$2"
+            shift 2
+            ;;
+        -h|--help)
+            usage
+            exit 0
+            ;;
+        *)
+            echo "Error: unknown option '$1'" >&2
+            usage
+            exit 1
+            ;;
+    esac
+done
+
+if [[ -z "$BENCH" ]]; then
+    if ! "$PIO_BIN" --version >/dev/null 2>&1; then
+        echo "Error: PlatformIO CLI ('$PIO_BIN') not found or not executable. Install PlatformIO, set PIO_BIN or pass --bench." >&2
+        exit 1
+    fi
+    "$PIO_BIN" run -d "$ROOT" -e apu_bench
+    BENCH="$ROOT/.pio/build/apu_bench/program"
+fi
+
+mkdir -p "$GOLDEN_DIR"
+"$BENCH" --runs 1 --quality all "$MODE" "$GOLDEN_DIR" "${GOLDEN_INPUTS[@]}"
@@ -0,0 +1,161 @@
+#!/usr/bin/env python3
+"""Frequency response of the APU's polyphase resampler.
+
+The "Native" and "High" audio quality modes synthesise the channels at
+32768 Hz or 65536 Hz and convert to the speaker rate with the windowed-sinc
+kernel built by rs_configure() in minigb_apu_cardputer/minigb_apu.c. This
+script rebuilds the same fixed-point kernel, including the per-row rounding,
+and reports for each mode and output rate:
+
+* the pass-band ripple up to ``--passband`` of the output Nyquist rate,
+* the worst gain in the band that folds onto the pass band (alias rejection),
+* the -3 dB and -60 dB points.
+
+``--plot response.png`` also draws the magnitude responses (needs
+matplotlib). "Fast" mode has no resampler: channels are point-sampled at the
+output rate and everything above its Nyquist rate aliases.
+"""
+
+from __future__ import annotations
+
+import argparse
+import cmath
+import math
+import sys
+from dataclasses import dataclass
+
+DMG_CLOCK = 4194304
+# Must match the RS_* constants and rs_output_taps() in minigb_apu.c.
+RS_PHASE_BITS = 7
+RS_PHASES = 1 << RS_PHASE_BITS
+RS_MAX_TAPS = 32
+RS_KERNEL_BITS = 14
+RS_CUTOFF = 0.90
+MODES = {
+    "native": (DMG_CLOCK // 128, 8),
+    "high": (DMG_CLOCK // 64, 16),
+}
+
+
+@dataclass
+class Kernel:
+    in_rate: int
+    out_rate: int
+    taps: int
+    rows: list[list[int]]
+
+
+def build_kernel(in_rate: int, out_rate: int, output_taps: int) -> Kernel:
+    ratio = in_rate / out_rate
+    taps = math.ceil(output_taps * max(ratio, 1.0))
+    taps = min((taps + 1) & ~1, RS_MAX_TAPS)
+    fc = 0.5 * RS_CUTOFF * (1.0 / ratio if ratio > 1.0 else 1.0)
+    centre = taps // 2 - 1
+    rows = []
+    for p in range(RS_PHASES + 1):
+        h = []
+        for k in range(taps):
+            x = centre + p / RS_PHASES - k
+            arg = 2.0 * math.pi * fc * x
+            sinc = 1.0 if abs(arg) < 1e-9 else math.sin(arg) / arg
+            w = (x + taps / 2.0) / taps
+            window = 0.42 - 0.5 * math.cos(2.0 * math.pi * w) + 0.08 * math.cos(4.0 * math.pi * w)
+            h.append(sinc * max(window, 0.0))
+        total = sum(h)
+        # C lrint() rounds half to even, as does Python's round().
+        row = [int(round(v / total * (1 << RS_KERNEL_BITS))) for v in h]
+        peak = max(range(taps), key=lambda k: (row[k], -k))
+        row[peak] += (1 << RS_KERNEL_BITS) - sum(row)
+        rows.append(row)
+    return Kernel(in_rate, out_rate, taps, rows)
+
+
+def response_db(kernel: Kernel, freq: float) -> float:
+    """Gain of the interleaved prototype filter (all phases) at freq Hz."""
+    centre = kernel.taps // 2 - 1
+    acc = 0j
+    for p in range(RS_PHASES):
+        for k, tap in enumerate(kernel.rows[p]):
+            x = centre + p / RS_PHASES - k
+            acc += tap * cmath.exp(-2j * math.pi * freq * x / kernel.in_rate)
+    gain = abs(acc) / (RS_PHASES * (1 << RS_KERNEL_BITS))
+    return 20.0 * math.log10(max(gain, 1e-12))
+
+
+def sweep(kernel: Kernel, points: int) -> tuple[list[float], list[float]]:
+    top = max(kernel.in_rate, kernel.out_rate)
+    freqs = [top * i / (points - 1) for i in range(points)]
+    return freqs, [response_db(kernel, f) for f in freqs]
+
+
+def first_below(freqs: list[float], gains: list[float], level: float) -> float:
+    for f, g in zip(freqs, gains):
+        if g < level:
+            return f
+    return float("nan")
+
+
+def summarise(name: str, kernel: Kernel, freqs: list[float], gains: list[float], passband: float) -> str:
+    nyquist = min(kernel.in_rate, kernel.out_rate) / 2.0
+    edge = passband * nyquist
+    in_band = [g for f, g in zip(freqs, gains) if f <= edge]
+    # Content at or above (rate - edge) folds onto the pass band, where rate
+    # is the output rate when decimating and the input rate when expanding.
+    fold = 2.0 * nyquist - edge
+    alias = [g for f, g in zip(freqs, gains) if f >= fold]
+    return (
+        f"{name:>6} {kernel.in_rate:>5}->{kernel.out_rate:<5} taps={kernel.taps:<2} "
+        f"ripple={max(in_band) - min(in_band):5.2f} dB (0-{edge / 1000:.1f} kHz) "
+        f"alias={max(alias):6.1f} dB (>{fold / 1000:.1f} kHz) "
+        f"-3dB={first_below(freqs, gains, -3.0) / 1000:5.2f} kHz "
+        f"-60dB={first_below(freqs, gains, -60.0) / 1000:5.2f} kHz"
+    )
+
+
+def write_plot(curves: list[tuple[str, Kernel, list[float], list[float]]], path: str) -> None:
+    try:
+        import matplotlib
+
+        matplotlib.use("Agg")
+        import matplotlib.pyplot as plt
+    except ImportError:
+        raise SystemExit("--plot needs matplotlib (pip install matplotlib)")
+
+    fig, ax = plt.subplots(figsize=(12, 6))
+    for name, kernel, freqs, gains in curves:
+        ax.plot([f / 1000 for f in freqs], gains, lw=0.8,
+                label=f"{name} {kernel.in_rate}->{kernel.out_rate} ({kernel.taps} taps)")
+    ax.set_xlabel("kHz")
+    ax.set_ylabel("dB")
+    ax.set_ylim(-120, 5)
+    ax.grid(True, lw=0.3)
+    ax.legend(loc="lower left")
+    fig.tight_layout()
+    fig.savefig(path, dpi=120)
+
+
+def main(argv: list[str]) -> int:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--rate", type=int, action="append",
+                        help="Output rate in Hz (repeatable; default 16384 and 44100, the firmware's rates)")
+    parser.add_argument("--mode", choices=sorted(MODES), action="append", help="Mode to analyse (default both)")
+    parser.add_argument("--passband", type=float, default=0.8, help="Pass band as a fraction of Nyquist (default 0.8)")
+    parser.add_argument("--points", type=int, default=400, help="Frequencies evaluated per curve (default 400)")
+    parser.add_argument("--plot", help="Write the magnitude responses (PNG) to this path")
+    args = parser.parse_args(argv)
+
+    curves = []
+    for name in args.mode or sorted(MODES):
+        in_rate, output_taps = MODES[name]
+        for out_rate in args.rate or [16384, 44100]:
+            kernel = build_kernel(in_rate, out_rate, output_taps)
+            freqs, gains = sweep(kernel, args.points)
+            print(summarise(name, kernel, freqs, gains, args.passband))
+            curves.append((name, kernel, freqs, gains))
+    if args.plot:
+        write_plot(curves, args.plot)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
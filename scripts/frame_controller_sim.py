@@ -0,0 +1,431 @@
+#!/usr/bin/env python3
+"""Replay frame-time traces through the old and new frame-skip controllers.
+
+Traces come from firmware built with ``-DENABLE_FRAME_TRACE=1``, which prints
+one ``[FT] <kind> <active_us> <handoff_us> <level>`` line per frame (kind is
+F for a full frame, I for an interlaced field, S for a suppressed frame). A
+raw serial log can be passed directly; non-trace lines are ignored.
+
+Because a controller's choices change what each frame costs, every recorded
+frame is first normalised to a full-frame equivalent. The emulation part is
+split into CPU and PPU pixel work using ``--pixel-share`` (estimated from the
+trace when it contains both full and skipped frames), and the counterfactual
+cost of any frame kind is rebuilt from that split. Without a trace,
+``--synthetic`` generates a workload with light, heavy and spiky phases.
+"""
+
+from __future__ import annotations
+
+import argparse
+import csv
+import math
+import random
+import re
+import statistics
+import sys
+from dataclasses import dataclass, field
+from pathlib import Path
+
+VERTICAL_SYNC = 4194304.0 / 70224.0
+FRAME_BUDGET_US = 1_000_000.0 / VERTICAL_SYNC
+
+LEVEL_FULL = 0
+LEVEL_INTERLACE = 1
+LEVEL_SKIP = 2
+LEVEL_INTERLACE_SKIP = 3
+
+TRACE_RE = re.compile(r"\[FT\]\s+([FIS])\s+(\d+)\s+(\d+)")
+
+
+@dataclass
+class TraceFrame:
+    cpu_us: float
+    pixel_us: float
+    handoff_us: float
+
+
+@dataclass
+class Decision:
+    interlace: bool
+    skip: bool
+
+
+# ---------------------------------------------------------------------------
+# Trace loading
+
+
+def load_trace(path: Path, pixel_share: float | None) -> list[TraceFrame]:
+    rows: list[tuple[str, float, float]] = []
+    with path.open("r", encoding="utf-8", errors="replace") as handle:
+        for line in handle:
+            match = TRACE_RE.search(line)
+            if match:
+                rows.append((match.group(1), float(match.group(2)), float(match.group(3))))
+                continue
+            parts = [p.strip() for p in line.split(",")]
+            if len(parts) >= 3 and parts[0] in ("F", "I", "S"):
+                try:
+                    rows.append((parts[0], float(parts[1]), float(parts[2])))
+                except ValueError:
+                    pass
+    if not rows:
+        raise ValueError(f"{path}: no [FT] trace lines found")
+
+    visible_handoff = [h for kind, _, h in rows if kind != "S"]
+    mean_handoff = statistics.fmean(visible_handoff) if visible_handoff else 0.0
+
+    if pixel_share is None:
+        full = [a - h for kind, a, h in rows if kind == "F"]
+        skipped = [a for kind, a, _ in rows if kind == "S"]
+        if full and skipped and statistics.fmean(full) > statistics.fmean(skipped):
+            pixel_share = 1.0 - statistics.fmean(skipped) / statistics.fmean(full)
+        else:
+            pixel_share = 0.35
+    pixel_share = min(max(pixel_share, 0.0), 0.95)
+
+    frames: list[TraceFrame] = []
+    for kind, active, handoff in rows:
+        lines = {"F": 1.0, "I": 0.5, "S": 0.0}[kind]
+        work = active - (handoff if kind != "S" else 0.0)
+        full_equivalent = work / (1.0 - pixel_share + pixel_share * lines)
+        frames.append(
+            TraceFrame(
+                cpu_us=full_equivalent * (1.0 - pixel_share),
+                pixel_us=full_equivalent * pixel_share,
+                handoff_us=handoff if kind != "S" else mean_handoff,
+            )
+        )
+    print(f"Loaded {len(frames)} frames from {path} (pixel share {pixel_share:.2f})")
+    return frames
+
+
+def synthetic_trace(seconds: float, seed: int) -> list[TraceFrame]:
+    rng = random.Random(seed)
+    phases = [
+        (0.20, 11_500.0, 600.0),   # menus / light scenes
+        (0.25, 17_800.0, 900.0),   # sustained heavy scene
+        (0.15, 15_200.0, 700.0),   # borderline
+        (0.20, 13_000.0, 2_500.0), # spiky gameplay
+        (0.20, 19_500.0, 1_200.0), # very heavy (CGB double speed)
+    ]
+    total = int(seconds * VERTICAL_SYNC)
+    frames: list[TraceFrame] = []
+    for share, mean, spread in phases:
+        for _ in range(int(total * share)):
+            full = max(2_000.0, rng.gauss(mean, spread))
+            if rng.random() < 0.02:
+                full += rng.uniform(3_000.0, 9_000.0)  # SD/ROM bank load spike
+            frames.append(TraceFrame(cpu_us=full * 0.62, pixel_us=full * 0.30, handoff_us=full * 0.08))
+    print(f"Generated {len(frames)} synthetic frames")
+    return frames
+
+
+def frame_cost(frame: TraceFrame, interlace: bool, skipped: bool) -> tuple[float, float]:
+    """Return (active_us, handoff_us) for `frame` rendered as the given kind."""
+    if skipped:
+        return frame.cpu_us, 0.0
+    lines = 0.5 if interlace else 1.0
+    return frame.cpu_us + lines * frame.pixel_us + frame.handoff_us, frame.handoff_us
+
+
+# ---------------------------------------------------------------------------
+# Controllers
+
+
+class StreakController:
+    """Port of the streak-counter updateAdaptiveFrameSkip (full-cache tuning)."""
+
+    ENABLE_STREAK = 6
+    DISABLE_STREAK = 30
+    MIN_ACTIVE_FRAMES = 24
+    HOLD_FRAMES = 6
+    IL_ENABLE_STREAK = 4
+    IL_DISABLE_STREAK = 24
+    IL_HOLD_FRAMES = 16
+
+    def __init__(self, interlace_allowed: bool) -> None:
+        self.interlace_allowed = interlace_allowed
+        self.debounce = 0
+        self.since_toggle = 0
+        self.over = 0
+        self.under = 0
+        self.skip = False
+        self.il_over = 0
+        self.il_under = 0
+        self.il_hold = 0
+        self.il_active = False
+
+    def update(self, active_us: float, handoff_us: float, skipped: bool, interlaced: bool) -> Decision:
+        over_budget = active_us >= FRAME_BUDGET_US
+        if self.debounce > 0:
+            self.debounce -= 1
+        self.since_toggle = min(self.since_toggle + 1, 255)
+        if over_budget:
+            self.over = min(self.over + 1, 255)
+            self.under = 0
+        else:
+            self.under = min(self.under + 1, 255)
+            self.over = max(self.over - 1, 0)
+        can_toggle = self.debounce == 0 and self.since_toggle >= self.MIN_ACTIVE_FRAMES
+
+        if self.interlace_allowed:
+            if over_budget:
+                self.il_over = min(self.il_over + 1, 255)
+                self.il_under = 0
+                self.il_hold = self.IL_HOLD_FRAMES
+            else:
+                self.il_under = min(self.il_under + 1, 255)
+                self.il_over = max(self.il_over - 1, 0)
+                self.il_hold = max(self.il_hold - 1, 0)
+            if not self.il_active:
+                if self.il_over >= self.IL_ENABLE_STREAK:
+                    self.il_active = True
+                    self.il_hold = self.IL_HOLD_FRAMES
+                    self.il_under = 0
+            elif self.il_hold == 0 and self.il_under >= self.IL_DISABLE_STREAK:
+                self.il_active = False
+                self.il_over = self.il_under = self.il_hold = 0
+            if self.il_active and self.over > self.ENABLE_STREAK * 2:
+                self.il_over = self.IL_ENABLE_STREAK
+
+        if not self.skip:
+            if can_toggle and self.over >= self.ENABLE_STREAK:
+                self.skip = True
+                self.debounce = self.HOLD_FRAMES
+                self.since_toggle = 0
+                self.over = self.under = 0
+        elif can_toggle and self.under >= self.DISABLE_STREAK:
+            self.skip = False
+            self.debounce = self.HOLD_FRAMES
+            self.since_toggle = 0
+            self.over = self.under = 0
+        return Decision(self.il_active, self.skip)
+
+
+class PredictiveController:
+    """Port of the firmware's predictive controller (FrameCostController)."""
+
+    ALPHA = 0.0625
+    JITTER_ALPHA = 0.0625
+    JITTER_MARGIN = 1.0
+    JITTER_CLAMP = 0.05
+    RECOVER_HEADROOM = 0.02
+    DEGRADE_FRAMES = 4
+    RECOVER_FRAMES = 30
+    INITIAL_PIXEL_SHARE = 0.35
+
+    def __init__(self, interlace_allowed: bool) -> None:
+        self.interlace_allowed = interlace_allowed
+        self.base = 0.0
+        self.pixel = 0.0
+        self.handoff = 0.0
+        self.jitter = 0.0
+        self.level = LEVEL_FULL
+        self.degrade = 0
+        self.recover = 0
+        self.primed = False
+
+    def level_cost(self, level: int) -> float:
+        full = self.base + self.pixel + self.handoff
+        field_cost = self.base + 0.5 * self.pixel + self.handoff
+        if level == LEVEL_FULL:
+            return full
+        if level == LEVEL_INTERLACE:
+            return field_cost
+        if level == LEVEL_SKIP:
+            return 0.5 * (full + self.base)
+        return 0.5 * (field_cost + self.base)
+
+    def observe(self, active_us: float, handoff_us: float, skipped: bool, interlaced: bool) -> None:
+        handoff = 0.0 if skipped else handoff_us
+        lines = 0.0 if skipped else (0.5 if interlaced else 1.0)
+        work = active_us - handoff
+        if not self.primed:
+            share = self.INITIAL_PIXEL_SHARE
+            full_equivalent = work / (1.0 - share + share * lines)
+            self.pixel = full_equivalent * share
+            self.base = full_equivalent - self.pixel
+            self.handoff = handoff
+            self.primed = True
+            return
+        predicted = self.base + lines * self.pixel + (0.0 if skipped else self.handoff)
+        deviation = min(abs(active_us - predicted), self.JITTER_CLAMP * FRAME_BUDGET_US)
+        self.jitter += self.JITTER_ALPHA * (deviation - self.jitter)
+        error = work - (self.base + lines * self.pixel)
+        norm = 1.0 + lines * lines
+        self.base = max(0.0, self.base + self.ALPHA * error / norm)
+        self.pixel = max(0.0, self.pixel + self.ALPHA * error * lines / norm)
+        if not skipped:
+            self.handoff += self.ALPHA * (handoff - self.handoff)
+
+    def allowed(self, level: int) -> bool:
+        return self.interlace_allowed or level in (LEVEL_FULL, LEVEL_SKIP)
+
+    def update(self, active_us: float, handoff_us: float, skipped: bool, interlaced: bool) -> Decision:
+        self.observe(active_us, handoff_us, skipped, interlaced)
+        margin = self.JITTER_MARGIN * self.jitter
+
+        def best_level(budget: float) -> int:
+            best = LEVEL_FULL
+            for level in range(4):
+                if not self.allowed(level):
+                    continue
+                best = level
+                if self.level_cost(level) + margin <= budget:
+                    break
+            return best
+
+        desired = best_level(FRAME_BUDGET_US)
+        if not self.allowed(self.level):
+            self.level = desired
+            self.degrade = self.recover = 0
+        elif desired > self.level:
+            self.recover = 0
+            self.degrade += 1
+            if self.degrade >= self.DEGRADE_FRAMES:
+                self.level = desired
+                self.degrade = 0
+        else:
+            self.degrade = 0
+            target = best_level(FRAME_BUDGET_US * (1.0 - self.RECOVER_HEADROOM))
+            if target < self.level:
+                self.recover += 1
+                if self.recover >= self.RECOVER_FRAMES:
+                    self.level = target
+                    self.recover = 0
+            else:
+                self.recover = 0
+        return Decision(self.level in (LEVEL_INTERLACE, LEVEL_INTERLACE_SKIP),
+                        self.level in (LEVEL_SKIP, LEVEL_INTERLACE_SKIP))
+
+
+# ---------------------------------------------------------------------------
+# Simulation
+
+
+@dataclass
+class SimResult:
+    name: str
+    frames: int = 0
+    elapsed_us: float = 0.0
+    visible: int = 0
+    fields: int = 0
+    behind_frames: int = 0
+    mode_switches: int = 0
+    display_intervals: list[float] = field(default_factory=list)
+    per_frame: list[tuple[int, str, float, float]] = field(default_factory=list)
+
+
+def simulate(name: str, controller, frames: list[TraceFrame], deadline_pacer: bool) -> SimResult:
+    result = SimResult(name)
+    decision = Decision(False, False)
+    skip_phase = 0
+    now = 0.0
+    deadline = 0.0
+    last_display: float | None = None
+    last_mode: tuple[bool, bool] | None = None
+    for index, frame in enumerate(frames):
+        # Frame skip alternates presented and suppressed frames, like the core's
+        # frame_skip_count toggle.
+        skipped = decision.skip and skip_phase == 0
+        skip_phase = (skip_phase + 1) % 2 if decision.skip else 0
+        active, handoff = frame_cost(frame, decision.interlace, skipped)
+
+        start = now
+        now += active
+        kind = "S" if skipped else ("I" if decision.interlace else "F")
+        if not skipped:
+            result.visible += 1
+            if decision.interlace:
+                result.fields += 1
+            if last_display is not None:
+                result.display_intervals.append(now - last_display)
+            last_display = now
+
+        if deadline_pacer:
+            deadline += FRAME_BUDGET_US
+            if now > deadline:
+                result.behind_frames += 1
+            if now < deadline:
+                now = deadline
+            elif now - deadline > 4 * FRAME_BUDGET_US:
+                deadline = now  # too far behind: resynchronise instead of bursting
+        else:
+            if active > FRAME_BUDGET_US:
+                result.behind_frames += 1
+            now = max(now, start + FRAME_BUDGET_US)
+
+        decision = controller.update(active, handoff, skipped, decision.interlace)
+        mode = (decision.interlace, decision.skip)
+        if last_mode is not None and mode != last_mode:
+            result.mode_switches += 1
+        last_mode = mode
+        result.per_frame.append((index, kind, active, now))
+    result.frames = len(frames)
+    result.elapsed_us = now
+    return result
+
+
+def report(results: list[SimResult]) -> None:
+    header = (f"{'controller':<12} {'speed%':>7} {'disp fps':>8} {'behind%':>7} {'fields%':>7} "
+              f"{'switches':>8} {'judder avg/p99 ms':>18}")
+    print(header)
+    print("-" * len(header))
+    for result in results:
+        seconds = result.elapsed_us / 1e6 if result.elapsed_us else 1.0
+        speed = 100.0 * (result.frames / VERTICAL_SYNC) / seconds
+        fps = result.visible / seconds
+        behind = 100.0 * result.behind_frames / max(result.frames, 1)
+        fields = 100.0 * result.fields / max(result.visible, 1)
+        # Judder: change in spacing between consecutive presented frames. A
+        # steady 30 fps cadence scores zero; alternating 17/33 ms does not.
+        intervals = result.display_intervals
+        deltas = sorted(abs(b - a) / 1000.0 for a, b in zip(intervals, intervals[1:]))
+        if deltas:
+            avg = statistics.fmean(deltas)
+            p99 = deltas[min(len(deltas) - 1, math.ceil(len(deltas) * 0.99) - 1)]
+        else:
+            avg = p99 = 0.0
+        print(f"{result.name:<12} {speed:7.1f} {fps:8.2f} {behind:7.1f} {fields:7.1f} "
+              f"{result.mode_switches:8d} {avg:8.2f}/{p99:<8.2f}")
+
+
+def main(argv: list[str]) -> int:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument("trace", nargs="?", type=Path, help="Serial log or CSV with [FT] frame records")
+    source.add_argument("--synthetic", type=float, metavar="SECONDS", help="Generate a synthetic workload instead")
+    parser.add_argument("--seed", type=int, default=1, help="Seed for --synthetic")
+    parser.add_argument("--pixel-share", type=float, default=None,
+                        help="Fraction of full-frame emulation spent on PPU pixels (default: estimate, else 0.35)")
+    parser.add_argument("--dmg", action="store_true", help="Disallow interlace (it is only used for CGB titles)")
+    parser.add_argument("--deadline-pacer", action="store_true",
+                        help="Pace against absolute deadlines so short frames repay long ones")
+    parser.add_argument("--csv", type=Path, help="Write per-frame decisions for both controllers to this file")
+    args = parser.parse_args(argv)
+
+    if args.synthetic is not None:
+        frames = synthetic_trace(args.synthetic, args.seed)
+    else:
+        frames = load_trace(args.trace, args.pixel_share)
+
+    interlace_allowed = not args.dmg
+    results = [
+        simulate("streak", StreakController(interlace_allowed), frames, args.deadline_pacer),
+        simulate("predictive", PredictiveController(interlace_allowed), frames, args.deadline_pacer),
+    ]
+    report(results)
+
+    if args.csv:
+        with args.csv.open("w", newline="", encoding="utf-8") as handle:
+            writer = csv.writer(handle)
+            writer.writerow(["controller", "frame", "kind", "active_us", "end_us"])
+            for result in results:
+                for index, kind, active, end in result.per_frame:
+                    writer.writerow([result.name, index, kind, f"{active:.0f}", f"{end:.0f}"])
+        print(f"Wrote {args.csv}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,290 @@
+#!/usr/bin/env python3
+"""Decode the binary per-frame telemetry stream into CSV and plots.
+
+Firmware built with ``-DENABLE_TELEMETRY=1`` writes one 38-byte record per
+main-loop iteration to the USB serial port, interleaved with the usual text
+log. Capture the raw port to a file, for example::
+
+    stty -F /dev/ttyACM0 raw 115200
+    cat /dev/ttyACM0 > telemetry.bin
+
+and decode it with ``telemetry_decode.py telemetry.bin --csv frames.csv``.
+Records are found by their sync word and validated with a CRC-8, so log text
+and partial records at the start of the capture are skipped. Gaps in the
+frame counter and the firmware's own drop counter are both reported.
+
+``--write-sample`` produces a synthetic capture (records with text noise in
+between) so the decoder can be exercised without hardware.
+"""
+
+from __future__ import annotations
+
+import argparse
+import csv
+import random
+import statistics
+import struct
+import sys
+from dataclasses import dataclass, fields
+from pathlib import Path
+
+SYNC = b"\xA5\x5A"
+RECORD_FRAME = 0x01
+# Must match TelemetryFrameRecord in gb_cardputer.ino.
+RECORD_FORMAT = struct.Struct("<BBBBIIHHHHHHHHHHBBBBBB")
+RECORD_SIZE = RECORD_FORMAT.size
+
+FLAG_COMPLETED = 0x01
+FLAG_SUPPRESSED = 0x02
+FLAG_INTERLACED = 0x04
+FLAG_OVER_BUDGET = 0x08
+FLAG_AUDIO_PACED = 0x10
+
+LEVEL_NAMES = ("full", "interlace", "skip", "interlace+skip")
+
+
+@dataclass
+class FrameRecord:
+    frame: int
+    start_us: int
+    frame_us: int
+    poll_us: int
+    emu_us: int
+    handoff_us: int
+    idle_us: int
+    render_us: int
+    pace_dev_us: int
+    rom_misses: int
+    audio_fill: int
+    dropped: int
+    dirty_rows: int
+    flags: int
+    level: int
+    audio_queue: int
+
+    @property
+    def completed(self) -> bool:
+        return bool(self.flags & FLAG_COMPLETED)
+
+    @property
+    def suppressed(self) -> bool:
+        return bool(self.flags & FLAG_SUPPRESSED)
+
+    @property
+    def interlaced(self) -> bool:
+        return bool(self.flags & FLAG_INTERLACED)
+
+    @property
+    def over_budget(self) -> bool:
+        return bool(self.flags & FLAG_OVER_BUDGET)
+
+    @property
+    def audio_paced(self) -> bool:
+        return bool(self.flags & FLAG_AUDIO_PACED)
+
+
+def crc8(data: bytes) -> int:
+    crc = 0
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+
+def encode(record: FrameRecord) -> bytes:
+    body = RECORD_FORMAT.pack(
+        SYNC[0], SYNC[1], RECORD_FRAME, RECORD_SIZE,
+        record.frame, record.start_us,
+        record.frame_us, record.poll_us, record.emu_us, record.handoff_us, record.idle_us,
+        record.render_us, record.pace_dev_us, record.rom_misses, record.audio_fill, record.dropped,
+        record.dirty_rows, record.flags, record.level, record.audio_queue, 0, 0,
+    )
+    return body[:-1] + bytes([crc8(body[:-1])])
+
+
+@dataclass
+class DecodeStats:
+    records: int = 0
+    crc_errors: int = 0
+    skipped_bytes: int = 0
+    frame_gaps: int = 0
+    missing_frames: int = 0
+    firmware_dropped: int = 0
+
+
+def decode(data: bytes) -> tuple[list[FrameRecord], DecodeStats]:
+    stats = DecodeStats()
+    records: list[FrameRecord] = []
+    pos = 0
+    first_dropped = None
+    last_dropped = 0
+    while True:
+        index = data.find(SYNC, pos)
+        if index < 0 or index + RECORD_SIZE > len(data):
+            stats.skipped_bytes += len(data) - pos
+            break
+        stats.skipped_bytes += index - pos
+        chunk = data[index : index + RECORD_SIZE]
+        values = RECORD_FORMAT.unpack(chunk)
+        if values[2] != RECORD_FRAME or values[3] != RECORD_SIZE or crc8(chunk[:-1]) != chunk[-1]:
+            if values[2] == RECORD_FRAME and values[3] == RECORD_SIZE:
+                stats.crc_errors += 1
+            stats.skipped_bytes += 1
+            pos = index + 1
+            continue
+        record = FrameRecord(*values[4:20])
+        if records:
+            expected = (records[-1].frame + 1) & 0xFFFFFFFF
+            if record.frame != expected:
+                stats.frame_gaps += 1
+                stats.missing_frames += (record.frame - expected) & 0xFFFFFFFF
+        if first_dropped is None:
+            first_dropped = record.dropped
+        last_dropped = record.dropped
+        records.append(record)
+        pos = index + RECORD_SIZE
+    stats.records = len(records)
+    if first_dropped is not None:
+        stats.firmware_dropped = (last_dropped - first_dropped) & 0xFFFF
+    return records, stats
+
+
+def percentile(values: list[int], pct: float) -> float:
+    if not values:
+        return 0.0
+    ordered = sorted(values)
+    rank = max(0, min(len(ordered) - 1, int(round(pct / 100.0 * (len(ordered) - 1)))))
+    return float(ordered[rank])
+
+
+def summarise(records: list[FrameRecord], stats: DecodeStats) -> str:
+    lines = [
+        f"records={stats.records} crc_errors={stats.crc_errors} skipped_bytes={stats.skipped_bytes} "
+        f"gaps={stats.frame_gaps} missing={stats.missing_frames} fw_dropped={stats.firmware_dropped}"
+    ]
+    if not records:
+        return "\n".join(lines)
+    span_us = (records[-1].start_us - records[0].start_us) & 0xFFFFFFFF
+    completed = sum(1 for r in records if r.completed)
+    if span_us:
+        lines.append(f"span={span_us / 1e6:.2f}s fps={completed * 1e6 / span_us:.2f}")
+    for name in ("frame_us", "emu_us", "handoff_us", "render_us", "pace_dev_us"):
+        values = [getattr(r, name) for r in records]
+        lines.append(
+            f"{name:>12}: avg={statistics.fmean(values):8.1f} p50={percentile(values, 50):6.0f} "
+            f"p90={percentile(values, 90):6.0f} p99={percentile(values, 99):6.0f} "
+            f"p99.9={percentile(values, 99.9):6.0f} max={max(values)}"
+        )
+    levels = [0] * len(LEVEL_NAMES)
+    for r in records:
+        if r.level < len(levels):
+            levels[r.level] += 1
+    lines.append(
+        "levels: " + " ".join(f"{name}={count}" for name, count in zip(LEVEL_NAMES, levels))
+        + f" over_budget={sum(1 for r in records if r.over_budget)}"
+        + f" rom_misses={sum(r.rom_misses for r in records)}"
+    )
+    return "\n".join(lines)
+
+
+def write_csv(records: list[FrameRecord], path: Path) -> None:
+    names = [f.name for f in fields(FrameRecord)]
+    extra = ["completed", "suppressed", "interlaced", "over_budget", "audio_paced"]
+    with path.open("w", newline="") as handle:
+        writer = csv.writer(handle)
+        writer.writerow(names + extra)
+        for r in records:
+            writer.writerow([getattr(r, n) for n in names] + [int(getattr(r, n)) for n in extra])
+
+
+def write_plot(records: list[FrameRecord], path: Path) -> None:
+    try:
+        import matplotlib
+
+        matplotlib.use("Agg")
+        import matplotlib.pyplot as plt
+    except ImportError:
+        raise SystemExit("--plot needs matplotlib (pip install matplotlib)")
+
+    t0 = records[0].start_us
+    t = [((r.start_us - t0) & 0xFFFFFFFF) / 1e6 for r in records]
+    fig, axes = plt.subplots(3, 1, sharex=True, figsize=(12, 8))
+    axes[0].plot(t, [r.frame_us for r in records], lw=0.6, label="frame")
+    axes[0].plot(t, [r.emu_us for r in records], lw=0.6, label="emu")
+    axes[0].plot(t, [r.render_us for r in records], lw=0.6, label="render")
+    axes[0].set_ylabel("us")
+    axes[0].legend(loc="upper right")
+    axes[1].plot(t, [r.pace_dev_us for r in records], lw=0.6, label="pace dev")
+    axes[1].plot(t, [r.idle_us for r in records], lw=0.6, label="idle")
+    axes[1].set_ylabel("us")
+    axes[1].legend(loc="upper right")
+    axes[2].step(t, [r.level for r in records], lw=0.8, where="post", label="level")
+    axes[2].plot(t, [r.dirty_rows / 144.0 * 3 for r in records], lw=0.4, label="dirty rows (scaled)")
+    axes[2].plot(t, [r.audio_queue for r in records], lw=0.6, label="audio queue")
+    axes[2].set_xlabel("s")
+    axes[2].legend(loc="upper right")
+    fig.tight_layout()
+    fig.savefig(path, dpi=120)
+
+
+def write_sample(path: Path, frames: int, seed: int) -> None:
+    rng = random.Random(seed)
+    out = bytearray(b"Booting...\n[PROF] fps=59.7 ...\n")
+    start = 1_000_000
+    dropped = 0
+    for frame in range(frames):
+        emu = int(rng.gauss(9000, 1500))
+        if rng.random() < 0.01:
+            emu += 20000
+        emu = max(1000, emu)
+        handoff = rng.randint(200, 900)
+        active = 400 + emu + handoff
+        idle = max(0, 16743 - active)
+        record = FrameRecord(
+            frame=frame, start_us=start & 0xFFFFFFFF, frame_us=min(65535, active + idle), poll_us=400,
+            emu_us=min(65535, emu), handoff_us=handoff, idle_us=idle, render_us=rng.randint(3000, 7000),
+            pace_dev_us=rng.randint(5, 60) if idle else active - 16743, rom_misses=rng.randint(0, 2),
+            audio_fill=0, dropped=dropped, dirty_rows=rng.randint(0, 144),
+            flags=FLAG_COMPLETED | (FLAG_OVER_BUDGET if not idle else 0),
+            level=0, audio_queue=rng.randint(1, 2),
+        )
+        start += max(active, 16743)
+        if rng.random() < 0.002:
+            dropped += 1  # firmware ring overflowed: this record never reaches the port
+            continue
+        out += encode(record)
+        if rng.random() < 0.003:
+            out += b"[PROF] text line between records\n"
+    path.write_bytes(bytes(out))
+
+
+def main(argv: list[str]) -> int:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("capture", type=Path, nargs="?", help="Raw serial capture ('-' for stdin)")
+    parser.add_argument("--csv", type=Path, help="Write decoded records to this CSV file")
+    parser.add_argument("--plot", type=Path, help="Write a timing plot (PNG) to this path")
+    parser.add_argument("--write-sample", type=Path, metavar="PATH", help="Write a synthetic capture and exit")
+    parser.add_argument("--frames", type=int, default=3600, help="Frames in the synthetic capture (default 3600)")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args(argv)
+
+    if args.write_sample:
+        write_sample(args.write_sample, args.frames, args.seed)
+        print(f"wrote {args.write_sample}")
+        return 0
+    if args.capture is None:
+        parser.error("a capture file is required")
+
+    data = sys.stdin.buffer.read() if str(args.capture) == "-" else args.capture.read_bytes()
+    records, stats = decode(data)
+    print(summarise(records, stats))
+    if args.csv:
+        write_csv(records, args.csv)
+    if args.plot and records:
+        write_plot(records, args.plot)
+    return 0 if records else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))